@@ -0,0 +1,65 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include "../mock/MockKVStore.h"
+#include <cstdio>
+
+// boot path of a typical application: 40 configuration keys
+static constexpr size_t KEYS = 40;
+
+// cost of a single flash commit
+static constexpr uint32_t COMMIT_LATENCY_US = 20;
+
+TEST_CASE( "Batch put compared to a loop of puts", "[benchmark][batch]" ) {
+    MockKVStore store;
+    store.setCommitLatency(COMMIT_LATENCY_US);
+
+    char keys[KEYS][8];
+    uint32_t values[KEYS];
+    KVStoreInterface::PutEntry entries[KEYS];
+
+    for(size_t i=0; i<KEYS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "k%zu", i);
+        values[i] = i;
+        entries[i] = KVStoreInterface::PutEntry(keys[i], (uint8_t*)&values[i], sizeof(values[i]), KVStoreInterface::PT_U32);
+    }
+
+    BENCHMARK("put loop") {
+        for(size_t i=0; i<KEYS; i++) {
+            store.putUInt(keys[i], values[i]);
+        }
+        return store.size();
+    };
+
+    BENCHMARK("putMany") {
+        return store.putMany(entries, KEYS);
+    };
+
+    BENCHMARK("get loop") {
+        uint32_t sum = 0;
+        for(size_t i=0; i<KEYS; i++) {
+            sum += store.getUInt(keys[i]);
+        }
+        return sum;
+    };
+
+    BENCHMARK("getMany") {
+        uint32_t res[KEYS];
+        KVStoreInterface::GetEntry gets[KEYS];
+        for(size_t i=0; i<KEYS; i++) {
+            gets[i] = KVStoreInterface::GetEntry(keys[i], (uint8_t*)&res[i], sizeof(res[i]), KVStoreInterface::PT_U32);
+        }
+        return store.getMany(gets, KEYS);
+    };
+}
@@ -0,0 +1,110 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/ESP32.h>
+#include <nvs_fake.h>
+#include <chrono>
+#include <cstdio>
+
+static constexpr uint32_t KEYS = 200;
+
+// a lookup in nvs scans the entries of its pages, on the order of tens of microseconds
+static constexpr uint32_t LOOKUP_LATENCY_US = 20;
+
+TEST_CASE( "ESP32KVStore metadata lookups", "[benchmark][esp32]" ) {
+    nvs_fake_format();
+    ESP32KVStore store;
+    store.begin();
+
+    char key[16];
+    uint8_t blob[32] = {};
+    for(uint32_t i=0; i<KEYS; i++) {
+        snprintf(key, sizeof(key), "key%u", i);
+        // blobs are the worst case for probing, they are the last type tried
+        store.putBytes(key, blob, sizeof(blob));
+    }
+    store.end();
+
+    nvs_fake_set_lookup_latency(LOOKUP_LATENCY_US);
+    store.begin();
+
+    uint32_t i = 0;
+    nvs_fake_reset_stats();
+    for(uint32_t j=0; j<KEYS; j++) {
+        snprintf(key, sizeof(key), "key%u", j);
+        store.exists(key);
+        store.getBytesLength(key);
+        store.getType(key);
+    }
+    printf("exists + getBytesLength + getType of %u keys: %zu nvs lookups\n", KEYS, nvs_fake_stats().gets);
+
+    BENCHMARK("exists") {
+        snprintf(key, sizeof(key), "key%u", i++ % KEYS);
+        return store.exists(key);
+    };
+
+    BENCHMARK("exists of a missing key") {
+        snprintf(key, sizeof(key), "miss%u", i++ % KEYS);
+        return store.exists(key);
+    };
+
+    BENCHMARK("getBytes") {
+        snprintf(key, sizeof(key), "key%u", i++ % KEYS);
+        return store.getBytes(key, blob, sizeof(blob));
+    };
+
+    store.end();
+    nvs_fake_set_lookup_latency(0);
+}
+
+// a commit programs the pending entries to flash, on the order of milliseconds
+static constexpr uint32_t COMMIT_LATENCY_US = 1000;
+static constexpr uint32_t WRITES = 500;
+
+TEST_CASE( "ESP32KVStore commit policies", "[benchmark][esp32]" ) {
+    struct Policy {
+        const char* name;
+        ESP32KVStore::CommitPolicy policy;
+        uint32_t param;
+    } policies[] = {
+        { "immediate",          ESP32KVStore::COMMIT_IMMEDIATE, 0 },
+        { "every 16 writes",    ESP32KVStore::COMMIT_EVERY_N,   16 },
+        { "window of 10 ms",    ESP32KVStore::COMMIT_WINDOW,    10 },
+        { "explicit",           ESP32KVStore::COMMIT_EXPLICIT,  0 },
+    };
+
+    nvs_fake_set_commit_latency(COMMIT_LATENCY_US);
+
+    for(auto& p: policies) {
+        nvs_fake_format();
+        ESP32KVStore store;
+        store.begin();
+        store.setCommitPolicy(p.policy, p.param);
+        nvs_fake_reset_stats();
+
+        char key[16];
+        auto start = std::chrono::steady_clock::now();
+        for(uint32_t i=0; i<WRITES; i++) {
+            snprintf(key, sizeof(key), "key%u", i % 50);
+            store.putUInt(key, i);
+        }
+        store.end();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%-16s %u writes: %4zu commits, %.1f ms, %.0f writes/s\n",
+            p.name, WRITES, nvs_fake_stats().commits, ms, WRITES / ms * 1000);
+    }
+
+    nvs_fake_set_commit_latency(0);
+}
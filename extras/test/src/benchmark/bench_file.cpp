@@ -0,0 +1,90 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+
+static const char PATH[] = "bench_kvstore_file.log";
+static constexpr uint32_t KEYS = 100000;
+
+template<typename F>
+static double elapsedMs(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST_CASE( "FileKVStore throughput and latency", "[benchmark][file]" ) {
+    ::unlink(PATH);
+    FileKVStore store(PATH);
+    store.begin();
+
+    char key[16];
+    double ms = elapsedMs([&]() {
+        for(uint32_t i=0; i<KEYS; i++) {
+            snprintf(key, sizeof(key), "key%u", i);
+            store.putUInt(key, i);
+        }
+    });
+    printf("put %u keys: %.1f ms, %.0f ops/s\n", KEYS, ms, KEYS / ms * 1000);
+
+    ms = elapsedMs([&]() {
+        for(uint32_t i=0; i<KEYS; i++) {
+            snprintf(key, sizeof(key), "key%u", i);
+            store.getUInt(key);
+        }
+    });
+    printf("get %u keys: %.1f ms, %.0f ops/s\n", KEYS, ms, KEYS / ms * 1000);
+
+    store.end();
+    ms = elapsedMs([&]() { store.begin(); });
+    printf("begin with %u keys: %.1f ms, file size %llu bytes\n", KEYS, ms, (unsigned long long)store.fileSize());
+
+    for(uint32_t i=0; i<KEYS; i++) {
+        snprintf(key, sizeof(key), "key%u", i);
+        store.putUInt(key, i + 1);
+    }
+    ms = elapsedMs([&]() { store.compact(); });
+    printf("compact %u keys: %.1f ms\n", KEYS, ms);
+
+    uint32_t i = 0;
+    BENCHMARK("put latency") {
+        snprintf(key, sizeof(key), "key%u", i++ % KEYS);
+        return store.putUInt(key, i);
+    };
+
+    BENCHMARK("get latency") {
+        snprintf(key, sizeof(key), "key%u", i++ % KEYS);
+        return store.getUInt(key);
+    };
+
+    BENCHMARK("putMany of 40 keys") {
+        uint32_t values[40];
+        char keys[40][16];
+        KVStoreInterface::PutEntry entries[40];
+
+        for(size_t j=0; j<40; j++) {
+            snprintf(keys[j], sizeof(keys[j]), "key%zu", j);
+            values[j] = j;
+            entries[j] = KVStoreInterface::PutEntry(keys[j], (uint8_t*)&values[j], sizeof(values[j]), KVStoreInterface::PT_U32);
+        }
+
+        return store.putMany(entries, 40);
+    };
+
+    store.end();
+    ::unlink(PATH);
+}
@@ -0,0 +1,167 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+// many small frequently updated integers
+static constexpr uint32_t KEYS = 1000;
+static constexpr uint32_t UPDATES = 100000;
+
+template<typename F>
+static double elapsedMs(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST_CASE( "FlashKVStore against a std::map baseline", "[benchmark][flash]" ) {
+    char key[16];
+
+    std::map<std::string, uint32_t> baseline;
+    double ms = elapsedMs([&]() {
+        for(uint32_t i=0; i<UPDATES; i++) {
+            snprintf(key, sizeof(key), "key%u", i % KEYS);
+            baseline[key] = i;
+        }
+    });
+    printf("std::map: %u updates of %u keys %.1f ms, %.0f ops/s\n", UPDATES, KEYS, ms, UPDATES / ms * 1000);
+
+    FlashSimulator flash;
+    FlashKVStore store(flash);
+    store.begin();
+
+    ms = elapsedMs([&]() {
+        for(uint32_t i=0; i<UPDATES; i++) {
+            snprintf(key, sizeof(key), "key%u", i % KEYS);
+            store.putUInt(key, i);
+        }
+    });
+    printf("FlashKVStore: %u updates of %u keys %.1f ms, %.0f ops/s\n", UPDATES, KEYS, ms, UPDATES / ms * 1000);
+
+    const FlashSimulator::Stats& stats = flash.getStats();
+    printf("  simulated flash time %.1f ms, %llu erases, max erases per block %u\n",
+        stats.elapsedUs / 1000.0, (unsigned long long)stats.erases, flash.getMaxEraseCount());
+    printf("  write amplification %.2f, garbage collections %zu, index %zu bytes for %zu keys\n",
+        flash.getWriteAmplification((uint64_t)UPDATES * sizeof(uint32_t)),
+        store.getStats().collections, store.indexBytes(), store.size());
+
+    char wear[512];
+    flash.getWearMap(wear, sizeof(wear));
+    printf("  wear [%s]\n", wear);
+
+    store.end();
+    ms = elapsedMs([&]() { store.begin(); });
+    printf("FlashKVStore: begin with %zu keys %.1f ms\n", store.size(), ms);
+
+    uint32_t i = 0;
+    BENCHMARK("std::map put") {
+        snprintf(key, sizeof(key), "key%u", i++ % KEYS);
+        return baseline[key] = i;
+    };
+
+    BENCHMARK("std::map get") {
+        snprintf(key, sizeof(key), "key%u", i++ % KEYS);
+        return baseline[key];
+    };
+
+    BENCHMARK("FlashKVStore put") {
+        snprintf(key, sizeof(key), "key%u", i++ % KEYS);
+        return store.putUInt(key, i);
+    };
+
+    BENCHMARK("FlashKVStore get") {
+        snprintf(key, sizeof(key), "key%u", i++ % KEYS);
+        return store.getUInt(key);
+    };
+
+    store.end();
+}
+
+static FlashSimulator* simulated = nullptr;
+
+static uint32_t simulatedClock() {
+    return simulated->getStats().elapsedUs;
+}
+
+// put latency on the simulated device, garbage collection included
+static void putLatency(const char* name, uint32_t budgetUs) {
+    FlashSimulator flash;
+    FlashKVStore store(flash);
+    store.begin();
+
+    simulated = &flash;
+    store.setClock(simulatedClock);
+    store.setIncrementalGC(budgetUs);
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(UPDATES);
+    char key[16];
+
+    for(uint32_t i=0; i<UPDATES; i++) {
+        snprintf(key, sizeof(key), "key%u", i % KEYS);
+
+        uint64_t start = flash.getStats().elapsedUs;
+        store.putUInt(key, i);
+        latencies.push_back(flash.getStats().elapsedUs - start);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("%s: put latency p50 %llu us, p99 %llu us, max %llu us, %zu collections\n", name,
+        (unsigned long long)latencies[latencies.size() / 2],
+        (unsigned long long)latencies[latencies.size() * 99 / 100],
+        (unsigned long long)latencies.back(),
+        store.getStats().collections);
+
+    simulated = nullptr;
+    store.end();
+}
+
+TEST_CASE( "FlashKVStore put latency with and without incremental garbage collection", "[benchmark][flash][gc]" ) {
+    putLatency("blocking gc", 0);
+    putLatency("incremental gc, 1ms budget", 1000);
+}
+
+// simulated time spent by begin() with a log of the given number of records over KEYS keys
+static uint64_t mountUs(size_t checkpointSlots, uint32_t records) {
+    FlashSimulator flash;
+    FlashKVStore store(flash, checkpointSlots);
+    store.begin();
+
+    char key[16];
+    for(uint32_t i=0; i<records; i++) {
+        snprintf(key, sizeof(key), "key%u", i % KEYS);
+        store.putUInt(key, i);
+    }
+    store.end();
+
+    uint64_t start = flash.getStats().elapsedUs;
+    store.begin();
+    uint64_t res = flash.getStats().elapsedUs - start;
+
+    store.end();
+    return res;
+}
+
+TEST_CASE( "FlashKVStore mount time with and without index checkpoints", "[benchmark][flash][checkpoint]" ) {
+    for(uint32_t records: { 1000, 4000, 16000 }) {
+        printf("begin with %u records of %u keys: full scan %llu us, checkpoint %llu us\n", records, KEYS,
+            (unsigned long long)mountUs(0, records), (unsigned long long)mountUs(DEFAULT_CHECKPOINT_SLOTS, records));
+    }
+}
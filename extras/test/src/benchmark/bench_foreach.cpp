@@ -0,0 +1,122 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include <mbed_fake.h>
+#include <nvs_fake.h>
+#include <cstdio>
+#include <unistd.h>
+
+static constexpr uint32_t KEYS = 10000;
+
+static void fill(KVStoreInterface& store) {
+    char key[16];
+    uint8_t blob[64] = {};
+
+    for(uint32_t i=0; i<KEYS; i++) {
+        snprintf(key, sizeof(key), "%s%u", i % 2 ? "dev." : "cfg.", i);
+        REQUIRE( store.putBytes(key, blob, sizeof(blob)) == sizeof(blob) );
+    }
+}
+
+static bool count(const char* key, KVStoreInterface::Type t, size_t len, void* ctx) {
+    (void) key;
+    (void) t;
+    (void) len;
+    (*(size_t*)ctx)++;
+    return true;
+}
+
+static size_t enumerate(KVStoreInterface& store, const char* prefix) {
+    size_t n = 0;
+    store.forEach(prefix, count, &n);
+
+    return n;
+}
+
+static void benchmarks(KVStoreInterface& store) {
+    REQUIRE( enumerate(store, nullptr) == KEYS );
+    REQUIRE( enumerate(store, "dev.") == KEYS / 2 );
+
+    BENCHMARK("all the keys") {
+        return enumerate(store, nullptr);
+    };
+
+    BENCHMARK("keys with a prefix") {
+        return enumerate(store, "dev.");
+    };
+}
+
+TEST_CASE( "FileKVStore enumeration of 10k keys", "[benchmark][foreach][file]" ) {
+    ::unlink("bench_foreach.log");
+    FileKVStore store("bench_foreach.log");
+    store.begin();
+    fill(store);
+
+    benchmarks(store);
+
+    store.end();
+    ::unlink("bench_foreach.log");
+}
+
+TEST_CASE( "FlashKVStore enumeration of 10k keys", "[benchmark][foreach][flash]" ) {
+    FlashSimulator flash({ 512 * 4096, 4096, 4, 0, 0, 0 });
+    FlashKVStore store(flash);
+    store.begin();
+    fill(store);
+
+    uint64_t start = flash.getStats().bytesRead;
+    enumerate(store, nullptr);
+    printf("FlashKVStore enumeration of %u keys with 64 bytes values: %llu bytes read\n",
+        KEYS, (unsigned long long)(flash.getStats().bytesRead - start));
+
+    benchmarks(store);
+}
+
+TEST_CASE( "ESP32KVStore enumeration of 10k keys", "[benchmark][foreach][esp32]" ) {
+    nvs_fake_format();
+    ESP32KVStore store;
+    store.begin();
+    fill(store);
+    store.end();
+
+    // the first enumeration after begin reads the length of every blob
+    store.begin();
+    nvs_fake_reset_stats();
+    enumerate(store, nullptr);
+    printf("ESP32KVStore enumeration of %u keys with 64 bytes values: %zu nvs lookups %zu bytes read\n",
+        KEYS, nvs_fake_stats().gets, nvs_fake_stats().bytesRead);
+
+    benchmarks(store);
+    store.end();
+}
+
+TEST_CASE( "STM32H7KVStore enumeration of 10k keys", "[benchmark][foreach][stm32h7]" ) {
+    mbed_fake_format();
+    STM32H7KVStore store;
+    store.begin();
+    fill(store);
+
+    mbed_fake_reset_stats();
+    enumerate(store, nullptr);
+    printf("STM32H7KVStore enumeration of %u keys with 64 bytes values: %zu bytes read\n",
+        KEYS, mbed_fake_stats().bytesRead);
+
+    benchmarks(store);
+    store.end();
+}
@@ -0,0 +1,93 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <kvstore/implementation/Nina.h>
+#include <mbed_fake.h>
+#include <nina_fake.h>
+#include <cstdio>
+
+static constexpr uint32_t RECORDS = 100;
+
+// QSPI and MBR init read the flash id and the partition table, TDBStore reads every record
+static constexpr uint32_t QSPI_INIT_US = 500;
+static constexpr uint32_t MBR_INIT_US = 200;
+static constexpr uint32_t SCAN_US_PER_RECORD = 20;
+
+// wifiDriverInit resets the module and waits for it to boot
+static constexpr uint32_t NINA_INIT_US = 5000;
+
+static void printProfile(const char* name, const InitProfile& profile) {
+    printf("%s init:", name);
+    for(size_t i=0; i<profile.size(); i++) {
+        printf(" %s %uus", profile[i].name, profile[i].us);
+    }
+    printf(", total %uus\n", profile.total());
+}
+
+TEST_CASE( "STM32H7KVStore begin", "[benchmark][init][stm32h7]" ) {
+    mbed_fake_format();
+    STM32H7KVStore store;
+    store.begin();
+
+    char key[16];
+    for(uint32_t i=0; i<RECORDS; i++) {
+        snprintf(key, sizeof(key), "key%u", i);
+        store.putUInt(key, i);
+    }
+    store.end();
+
+    mbed_fake_set_init_latency(QSPI_INIT_US, MBR_INIT_US, SCAN_US_PER_RECORD);
+
+    store.begin();
+    printProfile("STM32H7KVStore", store.getInitProfile());
+    store.end();
+
+    BENCHMARK("begin") {
+        store.begin();
+        store.end();
+    };
+
+    store.setLazyInit(true);
+    BENCHMARK("lazy begin") {
+        store.begin();
+        store.end();
+    };
+
+    mbed_fake_set_init_latency(0, 0, 0);
+}
+
+TEST_CASE( "NinaKVStore begin", "[benchmark][init][nina]" ) {
+    nina_fake_format();
+    NinaKVStore store;
+
+    nina_fake_set_init_latency(NINA_INIT_US);
+
+    store.begin();
+    printProfile("NinaKVStore", store.getInitProfile());
+    store.end();
+
+    BENCHMARK("begin") {
+        store.begin();
+        store.end();
+    };
+
+    store.setLazyInit(true);
+    BENCHMARK("lazy begin") {
+        store.begin();
+        store.end();
+    };
+
+    nina_fake_set_init_latency(0);
+}
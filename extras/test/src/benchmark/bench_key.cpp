@@ -0,0 +1,93 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/decorators/ReadCacheKVStore.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include "../mock/MockKVStore.h"
+#include <cstdio>
+#include <unistd.h>
+
+static const char PATH[] = "bench_key.log";
+
+static constexpr uint32_t KEYS = 32;
+
+// keys sharing a long prefix, as the ones of a configuration
+static constexpr KVKey KEY("config.network.wifi.station.ssid");
+
+template<typename Store>
+static void fill(Store& store) {
+    char key[48];
+
+    for(uint32_t i=0; i<KEYS; i++) {
+        snprintf(key, sizeof(key), "config.network.wifi.station.k%u", i);
+        store.putUInt(key, i);
+    }
+    store.putUInt(KEY, 0x55555555);
+}
+
+TEST_CASE( "ReadCacheKVStore lookups by key type", "[benchmark][key][readcache]" ) {
+    MockKVStore backend;
+    ReadCacheKVStore store(backend);
+    store.begin();
+    fill(store);
+
+    const char* plain = KEY.c_str();
+
+    BENCHMARK("getUInt() with a const char* key, hashed on every call") {
+        return store.getUInt(plain);
+    };
+
+    BENCHMARK("getUInt() with a constexpr KVKey") {
+        return store.getUInt(KEY);
+    };
+}
+
+TEST_CASE( "FlashKVStore lookups by key type", "[benchmark][key][flash]" ) {
+    FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+    FlashKVStore store(flash);
+    store.begin();
+    fill(store);
+
+    const char* plain = KEY.c_str();
+
+    BENCHMARK("exists() with a const char* key, hashed on every call") {
+        return store.exists(plain);
+    };
+
+    BENCHMARK("exists() with a constexpr KVKey") {
+        return store.exists(KEY);
+    };
+}
+
+TEST_CASE( "FileKVStore lookups by key type", "[benchmark][key][file]" ) {
+    ::unlink(PATH);
+    FileKVStore store(PATH);
+    store.begin();
+    fill(store);
+
+    const char* plain = KEY.c_str();
+
+    BENCHMARK("getBytesLength() with a const char* key, hashed on every call") {
+        return store.getBytesLength(plain);
+    };
+
+    BENCHMARK("getBytesLength() with a constexpr KVKey") {
+        return store.getBytesLength(KEY);
+    };
+
+    store.end();
+    ::unlink(PATH);
+}
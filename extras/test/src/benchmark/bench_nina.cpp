@@ -0,0 +1,63 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/Nina.h>
+#include <nina_fake.h>
+#include <cstdio>
+
+static constexpr uint32_t KEYS = 16;
+
+// a preference command over SPI, including the wait for the module to answer
+static constexpr uint32_t TRANSACTION_LATENCY_US = 50;
+
+TEST_CASE( "NinaKVStore transactions per operation", "[benchmark][nina]" ) {
+    nina_fake_format();
+    NinaKVStore store;
+    store.begin();
+
+    char key[16];
+    char value[16];
+    for(uint32_t i=0; i<KEYS; i++) {
+        snprintf(key, sizeof(key), "key%u", i);
+        store.putString(key, "value");
+    }
+
+    // the usual pattern of reading a string of unknown length
+    auto read = [&]() {
+        for(uint32_t i=0; i<KEYS; i++) {
+            snprintf(key, sizeof(key), "key%u", i);
+            if(store.exists(key) && store.getBytesLength(key) < sizeof(value)) {
+                store.getString(key, value, sizeof(value));
+            }
+        }
+    };
+
+    nina_fake_reset_stats();
+    read();
+    printf("exists + getBytesLength + getString of %u keys: %zu transactions\n", KEYS, nina_fake_stats().transactions);
+
+    store.end();
+    store.begin();
+    nina_fake_reset_stats();
+    read();
+    printf("same after a restart: %zu transactions\n", nina_fake_stats().transactions);
+
+    nina_fake_set_transaction_latency(TRANSACTION_LATENCY_US);
+    BENCHMARK("exists + getBytesLength + getString") {
+        read();
+    };
+    nina_fake_set_transaction_latency(0);
+
+    store.end();
+}
@@ -0,0 +1,99 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include <mbed_fake.h>
+#include <nvs_fake.h>
+#include <cstdio>
+
+// a config blob of which a single field is read, or a single byte is updated
+static constexpr size_t BLOB_SIZE = 2048;
+static constexpr size_t FIELD_OFFSET = 1000;
+static constexpr size_t FIELD_SIZE = 4;
+
+struct Transfer {
+    uint64_t read;
+    uint64_t written;
+};
+
+// the bytes moved to and from the storage by each operation, as counted by the fakes
+template<typename Counter>
+static void measure(const char* name, KVStoreInterface& store, Counter counter) {
+    static uint8_t blob[BLOB_SIZE];
+    uint8_t field[FIELD_SIZE];
+
+    REQUIRE( store.putBytes("cfg", blob, sizeof(blob)) == sizeof(blob) );
+
+    Transfer before = counter();
+    REQUIRE( store.getBytes("cfg", blob, sizeof(blob)) == sizeof(blob) );
+    Transfer full = counter();
+    REQUIRE( store.getBytes("cfg", FIELD_OFFSET, field, sizeof(field)) == sizeof(field) );
+    Transfer range = counter();
+
+    printf("%s read %zu bytes: getBytes %llu bytes read, range getBytes %llu bytes read\n", name, FIELD_SIZE,
+        (unsigned long long)(full.read - before.read), (unsigned long long)(range.read - full.read));
+
+    before = counter();
+    blob[FIELD_OFFSET] = 1;
+    REQUIRE( store.putBytes("cfg", blob, sizeof(blob)) == sizeof(blob) );
+    full = counter();
+    REQUIRE( store.patchBytes("cfg", FIELD_OFFSET, field, 1) == 1 );
+    range = counter();
+
+    printf("%s update 1 byte: putBytes %llu bytes read %llu written, patchBytes %llu bytes read %llu written\n", name,
+        (unsigned long long)(full.read - before.read), (unsigned long long)(full.written - before.written),
+        (unsigned long long)(range.read - full.read), (unsigned long long)(range.written - full.written));
+}
+
+TEST_CASE( "FlashKVStore range access", "[benchmark][range][flash]" ) {
+    FlashSimulator flash({ 16 * 4096, 4096, 4, 1, 2, 1000 });
+    FlashKVStore store(flash);
+    store.begin();
+
+    measure("FlashKVStore", store, [&flash]() {
+        return Transfer{ flash.getStats().bytesRead, flash.getStats().bytesProgrammed };
+    });
+
+    uint8_t field[FIELD_SIZE];
+    BENCHMARK("getBytes range") {
+        return store.getBytes("cfg", FIELD_OFFSET, field, sizeof(field));
+    };
+
+    BENCHMARK("patchBytes") {
+        return store.patchBytes("cfg", FIELD_OFFSET, field, 1);
+    };
+}
+
+TEST_CASE( "STM32H7KVStore range access", "[benchmark][range][stm32h7]" ) {
+    mbed_fake_format();
+    STM32H7KVStore store;
+    store.begin();
+
+    measure("STM32H7KVStore", store, []() {
+        return Transfer{ mbed_fake_stats().bytesRead, mbed_fake_stats().bytesWritten };
+    });
+}
+
+TEST_CASE( "ESP32KVStore range access", "[benchmark][range][esp32]" ) {
+    nvs_fake_format();
+    ESP32KVStore store;
+    store.begin();
+
+    measure("ESP32KVStore (default)", store, []() {
+        return Transfer{ nvs_fake_stats().bytesRead, nvs_fake_stats().bytesWritten };
+    });
+}
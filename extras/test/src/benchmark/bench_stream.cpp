@@ -0,0 +1,157 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include <mbed_fake.h>
+#include <nvs_fake.h>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Heap usage is tracked by replacing the global allocation functions of the benchmark
+ * executable, each block is prefixed by its size
+ */
+static size_t heapInUse = 0;
+static size_t heapPeak = 0;
+
+static constexpr size_t HEAP_PREFIX = sizeof(max_align_t);
+
+void* operator new(size_t size) {
+    uint8_t* p = (uint8_t*)malloc(size + HEAP_PREFIX);
+    if(p == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    *(size_t*)p = size;
+    heapInUse += size;
+    heapPeak = heapInUse > heapPeak ? heapInUse : heapPeak;
+
+    return p + HEAP_PREFIX;
+}
+
+void operator delete(void* ptr) noexcept {
+    if(ptr != nullptr) {
+        uint8_t* p = (uint8_t*)ptr - HEAP_PREFIX;
+        heapInUse -= *(size_t*)p;
+        free(p);
+    }
+}
+
+void* operator new[](size_t size)                   { return operator new(size); }
+void operator delete[](void* ptr) noexcept          { operator delete(ptr); }
+void operator delete(void* ptr, size_t) noexcept    { operator delete(ptr); }
+void operator delete[](void* ptr, size_t) noexcept  { operator delete(ptr); }
+
+static constexpr size_t VALUE_SIZE = 64 * 1024;
+static constexpr size_t CHUNK_SIZE = 256;
+
+// the ram used by the write, the data stored by in memory fakes is not counted
+struct HeapUsage {
+    HeapUsage(): base(heapInUse) { heapPeak = heapInUse; }
+
+    size_t transient() const { return heapPeak - (heapInUse > base ? heapInUse : base); }
+
+    size_t base;
+};
+
+static size_t streamedWrite(KVStoreInterface& store) {
+    uint8_t chunk[CHUNK_SIZE];
+    memset(chunk, 0x55, sizeof(chunk));
+
+    HeapUsage usage;
+    auto w = store.openWriter("blob", VALUE_SIZE);
+    for(size_t done=0; done < VALUE_SIZE; done += sizeof(chunk)) {
+        w.write(chunk, sizeof(chunk));
+    }
+    REQUIRE( w.close() );
+
+    return usage.transient();
+}
+
+static size_t bufferedWrite(KVStoreInterface& store) {
+    HeapUsage usage;
+    uint8_t* value = new uint8_t[VALUE_SIZE];
+    memset(value, 0x55, VALUE_SIZE);
+
+    REQUIRE( store.putBytes("blob", value, VALUE_SIZE) == (KVStoreInterface::res_t)VALUE_SIZE );
+    delete [] value;
+
+    return usage.transient();
+}
+
+static void report(const char* name, size_t streamed, size_t buffered) {
+    printf("%s 64KB value: peak heap %zu bytes with a writer, %zu bytes with putBytes\n", name, streamed, buffered);
+}
+
+TEST_CASE( "FlashKVStore streamed write", "[benchmark][stream][flash]" ) {
+    FlashSimulator flash({ 128 * 4096, 4096, 4, 0, 0, 0 });
+    FlashKVStore store(flash);
+    store.begin();
+
+    size_t streamed = streamedWrite(store);
+    report("FlashKVStore", streamed, bufferedWrite(store));
+    REQUIRE( streamed < 1024 );
+
+    BENCHMARK("write 64KB") {
+        return streamedWrite(store);
+    };
+}
+
+TEST_CASE( "FileKVStore streamed write", "[benchmark][stream][file]" ) {
+    ::unlink("bench_stream.log");
+    FileKVStore store("bench_stream.log");
+    store.begin();
+
+    size_t streamed = streamedWrite(store);
+    report("FileKVStore", streamed, bufferedWrite(store));
+    REQUIRE( streamed < 1024 );
+
+    BENCHMARK("write 64KB") {
+        return streamedWrite(store);
+    };
+
+    store.end();
+    ::unlink("bench_stream.log");
+}
+
+TEST_CASE( "STM32H7KVStore streamed write", "[benchmark][stream][stm32h7]" ) {
+    mbed_fake_format();
+    STM32H7KVStore store;
+    store.begin();
+
+    size_t streamed = streamedWrite(store);
+    report("STM32H7KVStore", streamed, bufferedWrite(store));
+    REQUIRE( streamed < 1024 );
+}
+
+TEST_CASE( "ESP32KVStore streamed write", "[benchmark][stream][esp32]" ) {
+    nvs_fake_format();
+    ESP32KVStore store;
+    store.begin();
+
+    size_t streamed = streamedWrite(store);
+    report("ESP32KVStore (chunked)", streamed, bufferedWrite(store));
+    REQUIRE( streamed < 4 * KVStoreInterface::STREAM_CHUNK_SIZE );
+
+    BENCHMARK("write 64KB") {
+        return streamedWrite(store);
+    };
+}
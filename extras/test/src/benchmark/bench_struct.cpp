@@ -0,0 +1,103 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/ESP32.h>
+#include "../mock/MockKVStore.h"
+#include <nvs_fake.h>
+#include <cstdio>
+
+static constexpr uint32_t FIELDS = 30;
+
+// cost of a single lookup on the store
+static constexpr uint32_t LOOKUP_LATENCY_US = 5;
+
+struct Config {
+    uint32_t fields[FIELDS];
+};
+
+static size_t lookups(const MockKVStore& store) {
+    return store.stats.exists + store.stats.getBytes + store.stats.getBytesLength;
+}
+
+template<typename Store>
+static void fill(Store& store, Config& config) {
+    char key[16];
+
+    for(uint32_t i=0; i<FIELDS; i++) {
+        snprintf(key, sizeof(key), "f%u", i);
+        config.fields[i] = i;
+        store.putUInt(key, i);
+    }
+    store.put("config", config);
+}
+
+template<typename Store>
+static uint32_t loadFields(Store& store, Config& config) {
+    char key[16];
+
+    for(uint32_t i=0; i<FIELDS; i++) {
+        snprintf(key, sizeof(key), "f%u", i);
+        config.fields[i] = store.getUInt(key);
+    }
+
+    return config.fields[FIELDS - 1];
+}
+
+TEST_CASE( "Configuration loaded at boot as fields or as a struct", "[benchmark][struct]" ) {
+    MockKVStore store;
+    Config config;
+    fill(store, config);
+    store.setLookupLatency(LOOKUP_LATENCY_US);
+
+    store.resetStats();
+    loadFields(store, config);
+    size_t fields = lookups(store);
+
+    store.resetStats();
+    store.tryGet("config", config);
+    size_t record = lookups(store);
+
+    printf("backend lookups to load %u fields: %zu as keys, %zu as a struct\n", FIELDS, fields, record);
+    REQUIRE( record * 10 <= fields );
+
+    BENCHMARK("a key per field") {
+        return loadFields(store, config);
+    };
+
+    BENCHMARK("a struct") {
+        return store.tryGet("config", config);
+    };
+}
+
+TEST_CASE( "ESP32KVStore configuration loaded at boot", "[benchmark][struct][esp32]" ) {
+    nvs_fake_format();
+
+    Config config;
+    ESP32KVStore store;
+    store.begin();
+    fill(store, config);
+    store.end();
+
+    BENCHMARK("a key per field") {
+        ESP32KVStore store;
+        store.begin();
+        return loadFields(store, config);
+    };
+
+    BENCHMARK("a struct") {
+        ESP32KVStore store;
+        store.begin();
+        return store.tryGet("config", config);
+    };
+}
@@ -0,0 +1,108 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include <nvs_fake.h>
+#include <cstdio>
+#include <unistd.h>
+
+// a WiFi credential update, written key by key or as a transaction
+static void individualPuts(KVStoreInterface& store) {
+    REQUIRE( store.putString("ssid", "office") == 6 );
+    REQUIRE( store.putString("pass", "correct horse") == 13 );
+    REQUIRE( store.putUInt("security", 3) == 4 );
+}
+
+static void transaction(KVStoreInterface& store) {
+    REQUIRE( store.beginTransaction() );
+    individualPuts(store);
+    REQUIRE( store.commit() );
+}
+
+TEST_CASE( "ESP32KVStore transaction throughput", "[benchmark][transaction][esp32]" ) {
+    nvs_fake_format();
+    nvs_fake_set_commit_latency(500);
+    ESP32KVStore store;
+    store.begin();
+
+    nvs_fake_reset_stats();
+    individualPuts(store);
+    NvsFakeStats individual = nvs_fake_stats();
+
+    nvs_fake_reset_stats();
+    transaction(store);
+    NvsFakeStats txn = nvs_fake_stats();
+
+    printf("ESP32KVStore 3 keys: individual puts %zu sets %zu commits, transaction %zu sets %zu erases %zu commits\n",
+        individual.sets, individual.commits, txn.sets, txn.erases, txn.commits);
+    // one commit for the journal and one for the writes
+    REQUIRE( txn.commits == 2 );
+
+    BENCHMARK("individual puts") {
+        individualPuts(store);
+    };
+
+    BENCHMARK("transaction") {
+        transaction(store);
+    };
+
+    nvs_fake_set_commit_latency(0);
+    store.end();
+}
+
+TEST_CASE( "FileKVStore transaction throughput", "[benchmark][transaction][file]" ) {
+    ::unlink("bench_transaction.log");
+    FileKVStore store;
+    // every write is synced to disk
+    store.begin("bench_transaction.log", true);
+
+    BENCHMARK("individual puts") {
+        individualPuts(store);
+    };
+
+    BENCHMARK("transaction") {
+        transaction(store);
+    };
+
+    store.end();
+    ::unlink("bench_transaction.log");
+}
+
+TEST_CASE( "FlashKVStore transaction throughput", "[benchmark][transaction][flash]" ) {
+    FlashSimulator flash({ 64 * 4096, 4096, 4, 1, 2, 1000 });
+    FlashKVStore store(flash);
+    store.begin();
+
+    uint64_t start = flash.getStats().bytesProgrammed;
+    individualPuts(store);
+    uint64_t individual = flash.getStats().bytesProgrammed - start;
+
+    start = flash.getStats().bytesProgrammed;
+    transaction(store);
+    uint64_t txn = flash.getStats().bytesProgrammed - start;
+
+    printf("FlashKVStore 3 keys: individual puts %llu bytes programmed, transaction %llu bytes programmed\n",
+        (unsigned long long)individual, (unsigned long long)txn);
+
+    BENCHMARK("individual puts") {
+        individualPuts(store);
+    };
+
+    BENCHMARK("transaction") {
+        transaction(store);
+    };
+}
@@ -0,0 +1,59 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include "../mock/MockKVStore.h"
+#include <cstdio>
+
+// cost of a single lookup on the store
+static constexpr uint32_t LOOKUP_LATENCY_US = 5;
+
+static size_t lookups(const MockKVStore& store) {
+    return store.stats.exists + store.stats.getBytes + store.stats.getBytesLength;
+}
+
+TEST_CASE( "Typed get compared to exists() followed by get", "[benchmark][tryget]" ) {
+    MockKVStore store;
+    store.putUInt("present", 0x55555555);
+    store.setLookupLatency(LOOKUP_LATENCY_US);
+
+    // before tryGet a typed get used to check for the existence of the key twice
+    store.resetStats();
+    if(store.exists("present") && store.exists("present")) {
+        store.getBytes("present", nullptr, 0);
+    }
+    size_t before = lookups(store);
+
+    store.resetStats();
+    store.getUInt("present");
+    size_t after = lookups(store);
+
+    printf("backend lookups per typed get: %zu before, %zu after\n", before, after);
+    REQUIRE( after < before );
+
+    BENCHMARK("exists() + getUInt() on a present key") {
+        return store.exists("present") ? store.getUInt("present") : 0;
+    };
+
+    BENCHMARK("getUInt() on a present key") {
+        return store.getUInt("present");
+    };
+
+    BENCHMARK("exists() + getUInt() on a missing key") {
+        return store.exists("missing") ? store.getUInt("missing") : 0;
+    };
+
+    BENCHMARK("getUInt() on a missing key") {
+        return store.getUInt("missing");
+    };
+}
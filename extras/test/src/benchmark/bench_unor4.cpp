@@ -0,0 +1,144 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/UnoR4.h>
+#include <modem_fake.h>
+#include <cstdio>
+
+static constexpr size_t KEYS = 64;
+
+// the default link of the UNO R4 WiFi and a preference access on the bridge
+static constexpr uint32_t BAUDRATE = 115200;
+static constexpr uint32_t PROCESSING_US = 300;
+
+TEST_CASE( "Unor4KVStore pipelined throughput", "[benchmark][unor4]" ) {
+    modem_fake_set_link(BAUDRATE, PROCESSING_US);
+    modem_fake_format();
+
+    Unor4KVStore store;
+    store.begin();
+
+    uint32_t values[KEYS];
+    char keys[KEYS][8];
+    KVStoreInterface::PutEntry puts[KEYS];
+    KVStoreInterface::GetEntry gets[KEYS];
+    for(size_t i=0; i<KEYS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "k%zu", i);
+        values[i] = i * 1000;
+        puts[i] = KVStoreInterface::PutEntry(keys[i], (uint8_t*)&values[i], sizeof(values[i]), KVStoreInterface::PT_U32);
+        gets[i] = KVStoreInterface::GetEntry(keys[i], (uint8_t*)&values[i], sizeof(values[i]), KVStoreInterface::PT_U32);
+    }
+
+    for(size_t depth: { 0, 1, 2, 4, 8, 16 }) {
+        store.setPipelineDepth(depth);
+
+        modem_fake_reset_stats();
+        store.putMany(puts, KEYS);
+        ModemFakeStats put = modem_fake_stats();
+
+        modem_fake_reset_stats();
+        store.getMany(gets, KEYS);
+        ModemFakeStats get = modem_fake_stats();
+
+        printf("depth %2zu: putMany %zu keys %6.1f ms (%4.0f ops/s), getMany %6.1f ms (%4.0f ops/s), %zu commands\n",
+            depth, KEYS, put.elapsedUs / 1000.0, KEYS * 1e6 / put.elapsedUs,
+            get.elapsedUs / 1000.0, KEYS * 1e6 / get.elapsedUs, put.commands + get.commands);
+    }
+
+    store.end();
+    modem_fake_set_link(115200, 100);
+}
+
+TEST_CASE( "Unor4KVStore round trips per read", "[benchmark][unor4]" ) {
+    modem_fake_set_link(BAUDRATE, PROCESSING_US);
+    modem_fake_format();
+
+    Unor4KVStore store;
+    store.begin();
+
+    uint8_t blob[32] = {};
+    char str[16];
+    store.putUInt("u32", 1);
+    store.putULong64("u64", 2);
+    store.putDouble("d", 3.0);
+    store.putString("str", "pippo");
+    store.putBytes("blob", blob, sizeof(blob));
+
+    struct Read {
+        const char* name;
+        void (*read)(Unor4KVStore& store, uint8_t blob[], char str[]);
+    } reads[] = {
+        { "getUInt",        [](Unor4KVStore& s, uint8_t[], char[]) { s.getUInt("u32"); } },
+        { "getULong64",     [](Unor4KVStore& s, uint8_t[], char[]) { s.getULong64("u64"); } },
+        { "getDouble",      [](Unor4KVStore& s, uint8_t[], char[]) { s.getDouble("d"); } },
+        { "getString",      [](Unor4KVStore& s, uint8_t[], char str[]) { s.getString("str", str, 16); } },
+        { "getBytes",       [](Unor4KVStore& s, uint8_t blob[], char[]) { s.getBytes("blob", blob, 32); } },
+        { "view",           [](Unor4KVStore& s, uint8_t[], char[]) { s.view("blob", [](const uint8_t[], size_t, void*) {}); } },
+        { "exists",         [](Unor4KVStore& s, uint8_t[], char[]) { s.exists("blob"); } },
+        { "getBytesLength", [](Unor4KVStore& s, uint8_t[], char[]) { s.getBytesLength("blob"); } },
+    };
+
+    for(auto& r: reads) {
+        modem_fake_reset_stats();
+        r.read(store, blob, str);
+
+        printf("%-16s %zu round trips, %zu bytes on the wire, %.2f ms\n", r.name, modem_fake_stats().commands,
+            modem_fake_stats().bytesSent + modem_fake_stats().bytesReceived, modem_fake_stats().elapsedUs / 1000.0);
+    }
+
+    store.end();
+    modem_fake_set_link(115200, 100);
+}
+
+TEST_CASE( "Unor4KVStore numeric encodings", "[benchmark][unor4]" ) {
+    modem_fake_set_link(BAUDRATE, PROCESSING_US);
+    modem_fake_format();
+
+    Unor4KVStore store;
+    store.begin();
+
+    for(bool binary: { false, true }) {
+        store.setBinaryNumbers(binary);
+        const char* name = binary ? "binary" : "text";
+
+        modem_fake_reset_stats();
+        store.putUInt("u32", 4000000000u);
+        ModemFakeStats put = modem_fake_stats();
+        modem_fake_reset_stats();
+        store.getUInt("u32");
+        ModemFakeStats get = modem_fake_stats();
+
+        printf("%-6s putUInt %zu bytes on the wire, getUInt %zu bytes on the wire\n", name,
+            put.bytesSent + put.bytesReceived, get.bytesSent + get.bytesReceived);
+
+        modem_fake_reset_stats();
+        store.putULong64("u64", 0xFFFFFFFFFFFFFFFF);
+        store.getULong64("u64");
+        printf("%-6s putULong64 + getULong64 %zu bytes on the wire\n", name,
+            modem_fake_stats().bytesSent + modem_fake_stats().bytesReceived);
+
+        // host time per operation, including the fake bridge
+        uint32_t i = 0;
+        BENCHMARK(std::string(name) + " putUInt") {
+            return store.putUInt("u32", i++);
+        };
+
+        BENCHMARK(std::string(name) + " getUInt") {
+            return store.getUInt("u32");
+        };
+    }
+
+    store.end();
+    modem_fake_set_link(115200, 100);
+}
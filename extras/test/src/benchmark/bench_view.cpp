@@ -0,0 +1,69 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/decorators/KVStoreView.h>
+#include <nvs_fake.h>
+
+static constexpr uint32_t KEYS = 50;
+
+// two modules updating their state alternately, each one in its own namespace
+TEST_CASE( "ESP32KVStore namespaces", "[benchmark][view][esp32]" ) {
+    nvs_fake_format();
+
+    uint32_t i = 0;
+    char key[16];
+
+    ESP32KVStore shared;
+    shared.begin("shared");
+    KVStoreView net(shared, "n/");
+    KVStoreView app(shared, "a/");
+
+    ESP32KVStore netStore, appStore;
+    netStore.begin("net");
+    appStore.begin("app");
+
+    for(uint32_t j=0; j<KEYS; j++) {
+        snprintf(key, sizeof(key), "k%u", j);
+        net.putUInt(key, j);
+        app.putUInt(key, j);
+        netStore.putUInt(key, j);
+        appStore.putUInt(key, j);
+    }
+
+    netStore.end();
+    appStore.end();
+
+    BENCHMARK("a store per namespace, reopened by each module") {
+        ESP32KVStore store;
+        snprintf(key, sizeof(key), "k%u", i++ % KEYS);
+
+        store.begin("net");
+        store.putUInt(key, i);
+        store.end();
+
+        store.begin("app");
+        store.putUInt(key, i);
+        return store.end();
+    };
+
+    BENCHMARK("views over a shared store") {
+        snprintf(key, sizeof(key), "k%u", i++ % KEYS);
+
+        net.putUInt(key, i);
+        return app.putUInt(key, i);
+    };
+
+    shared.end();
+}
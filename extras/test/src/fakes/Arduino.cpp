@@ -0,0 +1,37 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "Arduino.h"
+#include <chrono>
+
+static const auto start = std::chrono::steady_clock::now();
+static size_t errors = 0;
+
+FakeSerial Serial;
+
+uint32_t millis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void fake_log_e(const char* format, ...) {
+    (void) format;
+    errors++;
+}
+
+size_t fake_log_errors() {
+    return errors;
+}
+
+void fake_log_reset() {
+    errors = 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+/*
+ * Minimal host replacement of the Arduino core, providing what the board specific
+ * backends use, so that they can be built and tested on the host
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+uint32_t millis();
+uint32_t micros();
+
+// errors logged by the backends are counted instead of being printed
+void fake_log_e(const char* format, ...) __attribute__((format(printf, 1, 2)));
+size_t fake_log_errors();
+void fake_log_reset();
+
+#define log_e(...) fake_log_e(__VA_ARGS__)
+
+// strings are not moved to flash on the host
+#define F(s) s
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while(size-- > 0 && write(*buffer++) == 1) {
+            n++;
+        }
+        return n;
+    }
+    virtual void flush() {}
+
+    size_t print(const char* s)     { return write((const uint8_t*)s, strlen(s)); }
+    size_t println(const char* s)   { return print(s) + print("\r\n"); }
+};
+
+class Stream: public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class String: public std::string {
+public:
+    String(const char* s="") : std::string(s) {}
+    String(const std::string& s) : std::string(s) {}
+
+    bool concat(const char* s, size_t len) { append(s, len); return true; }
+};
+
+// output written to Serial is discarded
+class FakeSerial: public Stream {
+public:
+    size_t write(uint8_t) override  { return 1; }
+    int available() override        { return 0; }
+    int read() override             { return -1; }
+    int peek() override             { return -1; }
+};
+
+extern FakeSerial Serial;
@@ -0,0 +1,37 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+/*
+ * Host fake of the parts of the mbed storage API used by STM32H7KVStore, see mbed_fake.h
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+#define MBED_SUCCESS 0
+
+namespace mbed {
+
+typedef uint64_t bd_addr_t;
+typedef uint64_t bd_size_t;
+
+class BlockDevice {
+public:
+    virtual ~BlockDevice() {}
+
+    virtual int init() = 0;
+    virtual int deinit() = 0;
+    virtual int erase(bd_addr_t addr, bd_size_t size) = 0;
+    virtual bd_size_t get_erase_size() const = 0;
+
+    static BlockDevice* get_default_instance();
+};
+
+} // namespace mbed
@@ -0,0 +1,52 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include "BlockDevice.h"
+
+#define MBED_ERROR_ITEM_NOT_FOUND (-311)
+#define MBED_ERROR_NOT_READY (-308)
+#define MBED_ERROR_INVALID_SIZE (-263)
+
+namespace mbed {
+
+class KVStore {
+public:
+    typedef struct _opaque_set_handle* set_handle_t;
+    typedef struct _opaque_key_iterator* iterator_t;
+
+    enum {
+        MAX_KEY_SIZE = 128, // including the null terminator
+    };
+
+    struct info_t {
+        size_t size;
+        uint32_t flags;
+    };
+
+    virtual ~KVStore() {}
+
+    virtual int init() = 0;
+    virtual int deinit() = 0;
+    virtual int reset() = 0;
+    virtual int set(const char* key, const void* buffer, size_t size, uint32_t create_flags) = 0;
+    virtual int get(const char* key, void* buffer, size_t buffer_size, size_t* actual_size=nullptr, size_t offset=0) = 0;
+    virtual int get_info(const char* key, info_t* info) = 0;
+    virtual int remove(const char* key) = 0;
+
+    virtual int set_start(set_handle_t* handle, const char* key, size_t final_data_size, uint32_t create_flags) = 0;
+    virtual int set_add_data(set_handle_t handle, const void* value_data, size_t data_size) = 0;
+    virtual int set_finalize(set_handle_t handle) = 0;
+
+    virtual int iterator_open(iterator_t* it, const char* prefix=nullptr) = 0;
+    virtual int iterator_next(iterator_t it, char* key, size_t key_size) = 0;
+    virtual int iterator_close(iterator_t it) = 0;
+};
+
+} // namespace mbed
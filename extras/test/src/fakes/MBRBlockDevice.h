@@ -0,0 +1,32 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include "BlockDevice.h"
+
+#define BD_ERROR_INVALID_MBR (-3102)
+
+namespace mbed {
+
+class MBRBlockDevice: public BlockDevice {
+public:
+    MBRBlockDevice(BlockDevice* bd, int part);
+
+    int init() override;
+    int deinit() override;
+    int erase(bd_addr_t addr, bd_size_t size) override;
+    bd_size_t get_erase_size() const override;
+
+    static int partition(BlockDevice* bd, int part, uint8_t type, bd_addr_t start, bd_addr_t stop);
+private:
+    BlockDevice* bd;
+    int part;
+};
+
+} // namespace mbed
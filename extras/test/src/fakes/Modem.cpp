@@ -0,0 +1,391 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "Modem.h"
+#include "modem_fake.h"
+#include <deque>
+#include <map>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// value types, as numbered by KVStoreInterface and by the bridge firmware
+enum {
+    T_I8, T_U8, T_I16, T_U16, T_I32, T_U32, T_I64, T_U64, T_STR, T_BLOB, T_INVALID,
+};
+
+static size_t widthOf(int type) {
+    switch(type) {
+    case T_I8: case T_U8:   return 1;
+    case T_I16: case T_U16: return 2;
+    case T_I32: case T_U32: return 4;
+    case T_I64: case T_U64: return 8;
+    default:                return 0;
+    }
+}
+
+static bool isSigned(int type) {
+    return type == T_I8 || type == T_I16 || type == T_I32 || type == T_I64;
+}
+
+class FakeBridge: public Stream {
+public:
+    FakeBridge(): baudrate(115200), processingUs(100), now(0), start(0), txFree(0), bridgeFree(0), rxFree(0),
+        payload(0), stats() {}
+
+    size_t write(uint8_t b) override {
+        stats.bytesSent++;
+        txFree = (txFree > now ? txFree : now) + byteUs();
+
+        if(payload > 0) {
+            data.push_back(b);
+            if(--payload == 0) {
+                execute();
+            }
+            return 1;
+        }
+
+        line.push_back(b);
+        if(line.size() >= 2 && line.compare(line.size() - 2, 2, "\r\n") == 0) {
+            line.resize(line.size() - 2);
+            parse();
+        }
+
+        return 1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        return Print::write(buffer, size);
+    }
+
+    int available() override {
+        if(rx.empty()) {
+            return 0;
+        }
+
+        // waiting for the first byte of a response blocks until it arrives
+        if(rx.front().second > now) {
+            now = rx.front().second;
+        }
+
+        int n = 0;
+        for(auto& b: rx) {
+            if(b.second > now) {
+                break;
+            }
+            n++;
+        }
+
+        return n;
+    }
+
+    int read() override {
+        if(available() == 0) {
+            return -1;
+        }
+
+        int b = rx.front().first;
+        rx.pop_front();
+        stats.bytesReceived++;
+
+        return b;
+    }
+
+    int peek() override {
+        return available() > 0 ? rx.front().first : -1;
+    }
+
+    void format() {
+        prefs.clear();
+    }
+
+    void resetStats() {
+        stats = ModemFakeStats();
+        start = now;
+    }
+
+    const ModemFakeStats& getStats() {
+        stats.elapsedUs = now - start;
+        return stats;
+    }
+
+    uint32_t baudrate;
+    uint32_t processingUs;
+
+private:
+    struct Value {
+        int type;
+        std::string bytes;
+    };
+
+    // 10 bits per byte on the line
+    inline uint64_t byteUs() const { return 10000000ull / baudrate; }
+
+    void parse() {
+        // AT<command>[=<args>]
+        size_t eq = line.find('=');
+        command = line.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+        args.clear();
+
+        if(eq != std::string::npos) {
+            size_t pos = eq + 1;
+            while(true) {
+                size_t comma = line.find(',', pos);
+                args.push_back(line.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos));
+                if(comma == std::string::npos) {
+                    break;
+                }
+                pos = comma + 1;
+            }
+        }
+        line.clear();
+        data.clear();
+
+        // strings and blobs are followed by their content
+        if(command == _PREF_PUT && args.size() == 3) {
+            int type = atoi(args[1].c_str());
+            if(type == T_STR || type == T_BLOB) {
+                payload = strtoul(args[2].c_str(), nullptr, 10);
+            }
+        }
+
+        if(payload == 0) {
+            execute();
+        }
+    }
+
+    void execute() {
+        stats.commands++;
+
+        std::string res;
+        bool ok = true;
+        auto arg = [this](size_t i) { return i < args.size() ? args[i] : std::string(); };
+
+        if(command == _PREF_BEGIN || command == _PREF_CLEAR) {
+            if(command == _PREF_CLEAR) {
+                prefs.clear();
+            }
+            res = "1";
+        } else if(command == _PREF_END) {
+            res = "";
+        } else if(command == _PREF_REMOVE) {
+            res = prefs.erase(arg(0)) > 0 ? "1" : "0";
+        } else if(command == _PREF_LEN) {
+            auto it = prefs.find(arg(0));
+            res = std::to_string(it != prefs.end() ? it->second.bytes.size() : 0);
+        } else if(command == _PREF_TYPE) {
+            auto it = prefs.find(arg(0));
+            res = std::to_string(it != prefs.end() ? it->second.type : T_INVALID);
+        } else if(command == _PREF_PUT) {
+            ok = put(arg(0), atoi(arg(1).c_str()), arg(2), res);
+        } else if(command == _PREF_GET) {
+            ok = get(arg(0), atoi(arg(1).c_str()), arg(2), res);
+        } else {
+            ok = false;
+        }
+
+        respond(ok ? std::string(command) + ": " + res + "\r\nOK\r\n" : std::string("ERROR\r\n"));
+    }
+
+    bool put(const std::string& key, int type, const std::string& arg, std::string& res) {
+        if(key.empty()) {
+            return false;
+        }
+
+        Value v = { type, std::string() };
+        size_t width = widthOf(type);
+
+        if(type == T_STR || type == T_BLOB) {
+            v.bytes = data;
+        } else if(width > 0) {
+            uint64_t n = isSigned(type) ? (uint64_t)strtoll(arg.c_str(), nullptr, 10) : strtoull(arg.c_str(), nullptr, 10);
+            v.bytes.assign((const char*)&n, width);
+        } else {
+            return false;
+        }
+
+        prefs[key] = v;
+        res = std::to_string(v.bytes.size());
+
+        return true;
+    }
+
+    bool get(const std::string& key, int type, const std::string& def, std::string& res) {
+        auto it = prefs.find(key);
+        bool found = it != prefs.end() && it->second.type == type;
+
+        if(type == T_STR || type == T_BLOB) {
+            std::string value = found ? it->second.bytes : (type == T_STR ? def : std::string());
+            res = std::to_string(value.size()) + "|" + value;
+        } else if(widthOf(type) > 0) {
+            uint64_t n = 0;
+            if(found) {
+                memcpy(&n, it->second.bytes.data(), it->second.bytes.size());
+            }
+
+            if(!found) {
+                res = def.empty() ? "0" : def;
+            } else if(isSigned(type)) {
+                // sign extension of the stored width
+                int shift = 64 - 8 * widthOf(type);
+                res = std::to_string((int64_t)(n << shift) >> shift);
+            } else {
+                res = std::to_string(n);
+            }
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+
+    void respond(const std::string& res) {
+        uint64_t done = (txFree > bridgeFree ? txFree : bridgeFree) + processingUs;
+        bridgeFree = done;
+
+        for(char c: res) {
+            rxFree = (rxFree > done ? rxFree : done) + byteUs();
+            rx.push_back(std::make_pair((uint8_t)c, rxFree));
+        }
+    }
+
+    std::map<std::string, Value> prefs;
+
+    uint64_t now;           // time of the board
+    uint64_t start;
+    uint64_t txFree;        // time the last byte sent reaches the bridge
+    uint64_t bridgeFree;    // time the bridge completes the last command
+    uint64_t rxFree;        // time the last byte of the responses reaches the board
+
+    std::string line;
+    std::string command;
+    std::vector<std::string> args;
+    std::string data;
+    size_t payload;
+
+    std::deque<std::pair<uint8_t, uint64_t>> rx;
+
+    ModemFakeStats stats;
+};
+
+static FakeBridge bridge;
+Stream& Serial2 = bridge;
+ModemClass modem(&Serial2);
+
+ModemClass::ModemClass(Stream* serial): _serial(serial), _timeout(10000), read_by_size(false) {}
+
+void ModemClass::begin(int baudrate) {
+    (void) baudrate;
+}
+
+bool ModemClass::write(const std::string& prompt, std::string& data_res, const char* fmt, ...) {
+    char buf[256];
+    va_list va;
+    va_start(va, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, va);
+    va_end(va);
+
+    _serial->write((const uint8_t*)buf, len);
+
+    return buf_read(prompt, data_res);
+}
+
+void ModemClass::write_nowait(const std::string& prompt, std::string& data_res, const char* fmt, ...) {
+    (void) prompt;
+    (void) data_res;
+
+    char buf[256];
+    va_list va;
+    va_start(va, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, va);
+    va_end(va);
+
+    _serial->write((const uint8_t*)buf, len);
+}
+
+bool ModemClass::passthrough(const uint8_t* data, size_t size) {
+    std::string res;
+    _serial->write(data, size);
+
+    return buf_read("", res);
+}
+
+void ModemClass::read_using_size() {
+    read_by_size = true;
+}
+
+void ModemClass::timeout(size_t timeout_ms) {
+    _timeout = timeout_ms;
+}
+
+bool ModemClass::buf_read(const std::string& prompt, std::string& data_res) {
+    std::string line;
+    size_t remaining = 0;
+    bool sized = read_by_size;
+    bool res = false;
+    uint32_t start = millis();
+
+    read_by_size = false;
+    data_res.clear();
+
+    while(millis() - start < _timeout) {
+        if(_serial->available() == 0) {
+            continue;
+        }
+
+        char c = _serial->read();
+
+        if(remaining > 0) {
+            data_res.push_back(c);
+            remaining--;
+            continue;
+        }
+
+        line.push_back(c);
+
+        if(sized && !prompt.empty() && line.size() > prompt.size() && c == '|' && line.compare(0, prompt.size(), prompt) == 0) {
+            remaining = strtoul(line.c_str() + prompt.size(), nullptr, 10);
+            sized = false;
+            line.clear();
+        } else if(line.size() >= 2 && line.compare(line.size() - 2, 2, "\r\n") == 0) {
+            line.resize(line.size() - 2);
+
+            if(line == "OK") {
+                res = true;
+                break;
+            } else if(line == "ERROR") {
+                break;
+            } else if(!prompt.empty() && line.compare(0, prompt.size(), prompt) == 0) {
+                size_t pos = line.find_first_not_of(' ', prompt.size());
+                data_res += pos != std::string::npos ? line.substr(pos) : std::string();
+            }
+            line.clear();
+        }
+    }
+
+    return res;
+}
+
+const ModemFakeStats& modem_fake_stats() {
+    return bridge.getStats();
+}
+
+void modem_fake_reset_stats() {
+    bridge.resetStats();
+}
+
+void modem_fake_format() {
+    bridge.format();
+}
+
+void modem_fake_set_link(uint32_t baudrate, uint32_t processingUs) {
+    bridge.baudrate = baudrate;
+    bridge.processingUs = processingUs;
+}
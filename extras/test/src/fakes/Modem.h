@@ -0,0 +1,56 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+/*
+ * Host fake of the ModemClass of the UNO R4 WiFi core, talking to the fake AT bridge
+ * of modem_fake.h instead of the ESP32-S3 module. Responses have the framing of the bridge
+ * firmware: "<prompt> <data>\r\nOK\r\n", or "ERROR\r\n" on failure; after read_using_size()
+ * the data of the next response is "<len>|<len bytes>"
+ */
+#include "Arduino.h"
+#include <string>
+
+#define _PREF_BEGIN     "+PREFBEGIN"
+#define _PREF_END       "+PREFEND"
+#define _PREF_CLEAR     "+PREFCLEAR"
+#define _PREF_REMOVE    "+PREFREMOVE"
+#define _PREF_LEN       "+PREFLEN"
+#define _PREF_PUT       "+PREFPUT"
+#define _PREF_GET       "+PREFGET"
+#define _PREF_TYPE      "+PREFTYPE"
+
+#define CMD(x)          "AT" x "\r\n"
+#define CMD_WRITE(x)    "AT" x "="
+#define PROMPT(x)       x ":"
+
+// the serial port connected to the bridge
+extern Stream& Serial2;
+
+class ModemClass {
+public:
+    ModemClass(Stream* serial);
+
+    void begin(int baudrate=115200);
+    bool write(const std::string& prompt, std::string& data_res, const char* fmt, ...);
+    void write_nowait(const std::string& prompt, std::string& data_res, const char* fmt, ...);
+    bool passthrough(const uint8_t* data, size_t size);
+    void read_using_size();
+    void timeout(size_t timeout_ms);
+
+private:
+    bool buf_read(const std::string& prompt, std::string& data_res);
+
+    Stream* _serial;
+    unsigned long _timeout;
+    bool read_by_size;
+};
+
+extern ModemClass modem;
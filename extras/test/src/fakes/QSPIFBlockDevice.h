@@ -0,0 +1,14 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include "BlockDevice.h"
+
+#define QSPIF_BD_ERROR_OK 0
+#define QSPIF_BD_ERROR_DEVICE_ERROR (-4001)
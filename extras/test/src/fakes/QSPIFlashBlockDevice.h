@@ -0,0 +1,22 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include "BlockDevice.h"
+#include "MBRBlockDevice.h"
+#include "TDBStore.h"
+
+// the Renesas core of the Portenta C33 declares the storage classes in the global namespace,
+// they are the mbed fakes, and names the KVStore error codes on its own
+#define KVSTORE_SUCCESS MBED_SUCCESS
+#define KVSTORE_ERROR_ITEM_NOT_FOUND MBED_ERROR_ITEM_NOT_FOUND
+
+using mbed::BlockDevice;
+using mbed::MBRBlockDevice;
+using mbed::TDBStore;
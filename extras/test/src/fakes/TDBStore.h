@@ -0,0 +1,48 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include "KVStore.h"
+#include <string>
+
+namespace mbed {
+
+// the content is kept in memory and survives the instances, like the flash would
+class TDBStore: public KVStore {
+public:
+    TDBStore(BlockDevice* bd);
+
+    int init() override;
+    int deinit() override;
+    int reset() override;
+    int set(const char* key, const void* buffer, size_t size, uint32_t create_flags) override;
+    int get(const char* key, void* buffer, size_t buffer_size, size_t* actual_size=nullptr, size_t offset=0) override;
+    int get_info(const char* key, info_t* info) override;
+    int remove(const char* key) override;
+
+    // a single incremental set can be in progress, like on the real store
+    int set_start(set_handle_t* handle, const char* key, size_t final_data_size, uint32_t create_flags) override;
+    int set_add_data(set_handle_t handle, const void* value_data, size_t data_size) override;
+    int set_finalize(set_handle_t handle) override;
+
+    // iterators walk the keys present when they were opened
+    int iterator_open(iterator_t* it, const char* prefix=nullptr) override;
+    int iterator_next(iterator_t it, char* key, size_t key_size) override;
+    int iterator_close(iterator_t it) override;
+private:
+    BlockDevice* bd;
+    bool initialized;
+
+    bool setting;
+    std::string setKey;
+    std::string setData;
+    size_t setSize;
+};
+
+} // namespace mbed
@@ -0,0 +1,134 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "WiFi.h"
+#include "nina_fake.h"
+#include <chrono>
+#include <map>
+
+struct Value {
+    PreferenceType type;
+    std::string bytes;
+};
+
+static std::map<std::string, Value> prefs;
+static NinaFakeStats stats;
+static uint32_t latencyUs = 0;
+static uint32_t initLatencyUs = 0;
+
+WiFiClass WiFi;
+
+static void wait(uint32_t us) {
+    auto start = std::chrono::steady_clock::now();
+    while(std::chrono::steady_clock::now() - start < std::chrono::microseconds(us));
+}
+
+static void transaction() {
+    stats.transactions++;
+    wait(latencyUs);
+}
+
+void WiFiDrv::wifiDriverInit() {
+    stats.driverInits++;
+    wait(initLatencyUs);
+}
+
+const char* WiFiDrv::getFwVersion() {
+    transaction();
+    return "3.0.0";
+}
+
+bool WiFiDrv::prefBegin(const char* name, bool readOnly, const char* partition_label) {
+    (void) name;
+    (void) readOnly;
+    (void) partition_label;
+    transaction();
+    return true;
+}
+
+void WiFiDrv::prefEnd() {
+    transaction();
+}
+
+bool WiFiDrv::prefClear() {
+    transaction();
+    prefs.clear();
+    return true;
+}
+
+bool WiFiDrv::prefRemove(const char* key) {
+    transaction();
+    return prefs.erase(key) > 0;
+}
+
+size_t WiFiDrv::prefLen(const char* key) {
+    transaction();
+    stats.len++;
+
+    auto it = prefs.find(key);
+    return it != prefs.end() ? it->second.bytes.size() : 0;
+}
+
+size_t WiFiDrv::prefStat() {
+    transaction();
+    return prefs.size();
+}
+
+size_t WiFiDrv::prefPut(const char* key, PreferenceType type, const uint8_t value[], size_t len) {
+    transaction();
+    stats.put++;
+
+    if(key == nullptr || value == nullptr || len == 0 || type == PT_INVALID) {
+        return 0;
+    }
+
+    prefs[key] = { type, std::string((const char*)value, len) };
+    return len;
+}
+
+size_t WiFiDrv::prefGet(const char* key, PreferenceType type, uint8_t value[], size_t len) {
+    transaction();
+    stats.get++;
+
+    auto it = prefs.find(key);
+    if(it == prefs.end() || it->second.type != type || it->second.bytes.size() > len) {
+        return 0;
+    }
+
+    memcpy(value, it->second.bytes.data(), it->second.bytes.size());
+    return it->second.bytes.size();
+}
+
+PreferenceType WiFiDrv::prefGetType(const char* key) {
+    transaction();
+    stats.getType++;
+
+    auto it = prefs.find(key);
+    return it != prefs.end() ? it->second.type : PT_INVALID;
+}
+
+NinaFakeStats& nina_fake_stats() {
+    return stats;
+}
+
+void nina_fake_reset_stats() {
+    stats = NinaFakeStats();
+}
+
+void nina_fake_format() {
+    prefs.clear();
+}
+
+void nina_fake_set_transaction_latency(uint32_t us) {
+    latencyUs = us;
+}
+
+void nina_fake_set_init_latency(uint32_t us) {
+    initLatencyUs = us;
+}
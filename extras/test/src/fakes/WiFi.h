@@ -0,0 +1,44 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+/*
+ * Host fake of the preferences API of WiFiNINA, the values are kept in memory instead
+ * of the NINA module. Every WiFiDrv call is a SPI transaction with the module, they are
+ * recorded and their cost can be simulated, see nina_fake.h
+ */
+#include "Arduino.h"
+
+typedef enum {
+    PT_I8, PT_U8, PT_I16, PT_U16, PT_I32, PT_U32, PT_I64, PT_U64, PT_STR, PT_BLOB, PT_INVALID,
+} PreferenceType;
+
+class WiFiDrv {
+public:
+    static void wifiDriverInit();
+    static const char* getFwVersion();
+
+    static bool prefBegin(const char* name, bool readOnly=false, const char* partition_label=NULL);
+    static void prefEnd();
+    static bool prefClear();
+    static bool prefRemove(const char* key);
+    static size_t prefLen(const char* key);
+    static size_t prefStat();
+    static size_t prefPut(const char* key, PreferenceType type, const uint8_t value[], size_t len);
+    static size_t prefGet(const char* key, PreferenceType type, uint8_t value[], size_t len);
+    static PreferenceType prefGetType(const char* key);
+};
+
+class WiFiClass {
+public:
+    const char* firmwareVersion() { return WiFiDrv::getFwVersion(); }
+};
+
+extern WiFiClass WiFi;
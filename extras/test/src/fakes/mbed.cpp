@@ -0,0 +1,273 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "mbed_fake.h"
+#include "QSPIFBlockDevice.h"
+#include <chrono>
+#include <map>
+#include <string>
+#include <string.h>
+#include <vector>
+
+static std::map<std::string, std::string> records;
+static MbedFakeStats stats;
+static uint32_t qspiLatencyUs = 0;
+static uint32_t mbrLatencyUs = 0;
+static uint32_t scanLatencyUs = 0;
+
+static void wait(uint64_t us) {
+    auto start = std::chrono::steady_clock::now();
+    while(std::chrono::steady_clock::now() - start < std::chrono::microseconds(us));
+}
+
+namespace mbed {
+
+class FakeQSPIF: public BlockDevice {
+public:
+    int init() override {
+        stats.qspiInits++;
+        wait(qspiLatencyUs);
+        return QSPIF_BD_ERROR_OK;
+    }
+
+    int deinit() override                                   { return 0; }
+    int erase(bd_addr_t addr, bd_size_t size) override      { (void) addr; (void) size; return 0; }
+    bd_size_t get_erase_size() const override               { return 4096; }
+};
+
+BlockDevice* BlockDevice::get_default_instance() {
+    static FakeQSPIF qspif;
+    return &qspif;
+}
+
+MBRBlockDevice::MBRBlockDevice(BlockDevice* bd, int part): bd(bd), part(part) {}
+
+int MBRBlockDevice::init() {
+    stats.mbrInits++;
+    wait(mbrLatencyUs);
+    return part >= 1 && part <= 4 ? 0 : BD_ERROR_INVALID_MBR;
+}
+
+int MBRBlockDevice::deinit()                                    { return 0; }
+int MBRBlockDevice::erase(bd_addr_t addr, bd_size_t size)       { return bd->erase(addr, size); }
+bd_size_t MBRBlockDevice::get_erase_size() const                { return bd->get_erase_size(); }
+
+int MBRBlockDevice::partition(BlockDevice* bd, int part, uint8_t type, bd_addr_t start, bd_addr_t stop) {
+    (void) bd;
+    (void) part;
+    (void) type;
+    (void) start;
+    (void) stop;
+    return 0;
+}
+
+TDBStore::TDBStore(BlockDevice* bd): bd(bd), initialized(false), setting(false), setSize(0) {}
+
+int TDBStore::init() {
+    stats.tdbInits++;
+    if(bd == nullptr) {
+        return MBED_ERROR_NOT_READY;
+    }
+
+    wait((uint64_t)scanLatencyUs * records.size());
+    initialized = true;
+    return MBED_SUCCESS;
+}
+
+int TDBStore::deinit() {
+    initialized = false;
+    return MBED_SUCCESS;
+}
+
+int TDBStore::reset() {
+    if(!initialized) {
+        return MBED_ERROR_NOT_READY;
+    }
+
+    records.clear();
+    return MBED_SUCCESS;
+}
+
+int TDBStore::set(const char* key, const void* buffer, size_t size, uint32_t create_flags) {
+    (void) create_flags;
+    if(!initialized) {
+        return MBED_ERROR_NOT_READY;
+    }
+
+    records[key] = std::string((const char*)buffer, size);
+    stats.bytesWritten += size;
+    return MBED_SUCCESS;
+}
+
+int TDBStore::get(const char* key, void* buffer, size_t buffer_size, size_t* actual_size, size_t offset) {
+    if(!initialized) {
+        return MBED_ERROR_NOT_READY;
+    }
+
+    auto it = records.find(key);
+    if(it == records.end()) {
+        return MBED_ERROR_ITEM_NOT_FOUND;
+    }
+
+    size_t len = it->second.size() > offset ? it->second.size() - offset : 0;
+    len = len < buffer_size ? len : buffer_size;
+    memcpy(buffer, it->second.data() + offset, len);
+    stats.bytesRead += len;
+
+    if(actual_size != nullptr) {
+        *actual_size = len;
+    }
+
+    return MBED_SUCCESS;
+}
+
+int TDBStore::get_info(const char* key, info_t* info) {
+    if(!initialized) {
+        return MBED_ERROR_NOT_READY;
+    }
+
+    auto it = records.find(key);
+    if(it == records.end()) {
+        return MBED_ERROR_ITEM_NOT_FOUND;
+    }
+
+    if(info != nullptr) {
+        *info = { it->second.size(), 0 };
+    }
+
+    return MBED_SUCCESS;
+}
+
+int TDBStore::remove(const char* key) {
+    if(!initialized) {
+        return MBED_ERROR_NOT_READY;
+    }
+
+    return records.erase(key) > 0 ? MBED_SUCCESS : MBED_ERROR_ITEM_NOT_FOUND;
+}
+
+int TDBStore::set_start(set_handle_t* handle, const char* key, size_t final_data_size, uint32_t create_flags) {
+    (void) create_flags;
+    if(!initialized || setting) {
+        return MBED_ERROR_NOT_READY;
+    }
+
+    setting = true;
+    setKey = key;
+    setData.clear();
+    setSize = final_data_size;
+    *handle = (set_handle_t)this;
+
+    return MBED_SUCCESS;
+}
+
+int TDBStore::set_add_data(set_handle_t handle, const void* value_data, size_t data_size) {
+    if(handle != (set_handle_t)this || !setting) {
+        return MBED_ERROR_NOT_READY;
+    } else if(setData.size() + data_size > setSize) {
+        setting = false;
+        return MBED_ERROR_INVALID_SIZE;
+    }
+
+    setData.append((const char*)value_data, data_size);
+    stats.bytesWritten += data_size;
+
+    return MBED_SUCCESS;
+}
+
+int TDBStore::set_finalize(set_handle_t handle) {
+    if(handle != (set_handle_t)this || !setting) {
+        return MBED_ERROR_NOT_READY;
+    }
+
+    // an incomplete value is discarded
+    setting = false;
+    if(setData.size() != setSize) {
+        return MBED_ERROR_INVALID_SIZE;
+    }
+
+    records[setKey] = setData;
+
+    return MBED_SUCCESS;
+}
+
+struct _opaque_key_iterator {
+    std::vector<std::string> keys;
+    size_t pos;
+};
+
+int TDBStore::iterator_open(iterator_t* it, const char* prefix) {
+    if(!initialized) {
+        return MBED_ERROR_NOT_READY;
+    }
+
+    size_t prefixLen = prefix != nullptr ? strlen(prefix) : 0;
+    iterator_t i = new _opaque_key_iterator { {}, 0 };
+
+    for(auto& el: records) {
+        if(el.first.compare(0, prefixLen, prefix != nullptr ? prefix : "", prefixLen) == 0) {
+            i->keys.push_back(el.first);
+        }
+    }
+
+    *it = i;
+
+    return MBED_SUCCESS;
+}
+
+int TDBStore::iterator_next(iterator_t it, char* key, size_t key_size) {
+    if(!initialized || it == nullptr) {
+        return MBED_ERROR_NOT_READY;
+    }
+
+    // keys removed after the iterator was opened are skipped
+    while(it->pos < it->keys.size() && records.find(it->keys[it->pos]) == records.end()) {
+        it->pos++;
+    }
+
+    if(it->pos >= it->keys.size()) {
+        return MBED_ERROR_ITEM_NOT_FOUND;
+    }
+
+    const std::string& k = it->keys[it->pos];
+    if(k.size() + 1 > key_size) {
+        return MBED_ERROR_INVALID_SIZE;
+    }
+
+    memcpy(key, k.c_str(), k.size() + 1);
+    it->pos++;
+
+    return MBED_SUCCESS;
+}
+
+int TDBStore::iterator_close(iterator_t it) {
+    delete it;
+
+    return MBED_SUCCESS;
+}
+
+} // namespace mbed
+
+MbedFakeStats& mbed_fake_stats() {
+    return stats;
+}
+
+void mbed_fake_reset_stats() {
+    stats = MbedFakeStats();
+}
+
+void mbed_fake_format() {
+    records.clear();
+}
+
+void mbed_fake_set_init_latency(uint32_t qspiUs, uint32_t mbrUs, uint32_t scanUsPerRecord) {
+    qspiLatencyUs = qspiUs;
+    mbrLatencyUs = mbrUs;
+    scanLatencyUs = scanUsPerRecord;
+}
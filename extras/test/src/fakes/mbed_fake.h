@@ -0,0 +1,30 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include "TDBStore.h"
+#include "MBRBlockDevice.h"
+
+// control of the fake mbed storage, not part of the mbed API
+struct MbedFakeStats {
+    size_t qspiInits;
+    size_t mbrInits;
+    size_t tdbInits;
+    size_t bytesRead;       // of values copied out of and into the TDBStore
+    size_t bytesWritten;
+};
+
+MbedFakeStats& mbed_fake_stats();
+void mbed_fake_reset_stats();
+
+// drop the content of the TDBStore, the partition table is kept
+void mbed_fake_format();
+
+// busy wait in the init of the devices, TDBStore::init scans every record of its area
+void mbed_fake_set_init_latency(uint32_t qspiUs, uint32_t mbrUs, uint32_t scanUsPerRecord);
@@ -0,0 +1,33 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include "Modem.h"
+
+/*
+ * Control of the fake AT bridge behind Serial2, not part of the core API. The bridge keeps
+ * the preferences in memory and simulates the time spent on the link: bytes are sent
+ * at the baud rate in both directions and each command takes a fixed processing time
+ * on the bridge. Sending never blocks, while waiting for a response advances the simulated
+ * clock up to the arrival of its bytes, so requests sent back to back overlap
+ */
+struct ModemFakeStats {
+    size_t commands;        // commands executed by the bridge
+    size_t bytesSent;       // bytes from the board to the bridge
+    size_t bytesReceived;   // bytes from the bridge to the board
+    uint64_t elapsedUs;     // simulated time
+};
+
+const ModemFakeStats& modem_fake_stats();
+void modem_fake_reset_stats();
+
+// drop all the preferences stored in the bridge
+void modem_fake_format();
+
+void modem_fake_set_link(uint32_t baudrate, uint32_t processingUs);
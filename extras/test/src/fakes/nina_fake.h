@@ -0,0 +1,33 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include "WiFi.h"
+
+// control of the fake NINA module, not part of the WiFiNINA API
+struct NinaFakeStats {
+    size_t transactions;    // SPI transactions, one for each WiFiDrv call
+    size_t driverInits;
+    size_t getType;
+    size_t len;
+    size_t get;
+    size_t put;
+};
+
+NinaFakeStats& nina_fake_stats();
+void nina_fake_reset_stats();
+
+// drop all the stored preferences
+void nina_fake_format();
+
+// busy wait in every transaction, simulating the SPI exchange with the module
+void nina_fake_set_transaction_latency(uint32_t us);
+
+// busy wait in wifiDriverInit, simulating the reset of the module
+void nina_fake_set_init_latency(uint32_t us);
@@ -0,0 +1,379 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "nvs_fake.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string.h>
+#include <vector>
+
+struct Item {
+    nvs_type_t type;
+    std::vector<uint8_t> data;
+};
+
+// partition -> namespace -> key -> item
+typedef std::map<std::string, Item> Namespace;
+static std::map<std::string, std::map<std::string, Namespace>> partitions;
+
+struct Handle {
+    std::string partition;
+    std::string ns;
+    bool readOnly;
+};
+static std::map<nvs_handle_t, Handle> handles;
+static nvs_handle_t nextHandle = 1;
+
+struct nvs_opaque_iterator_t {
+    std::string ns;
+    nvs_type_t type;
+    std::vector<std::pair<std::string, nvs_type_t>> entries;
+    size_t pos;
+};
+
+static NvsFakeStats stats;
+static uint32_t lookupLatencyUs = 0;
+static uint32_t commitLatencyUs = 0;
+static size_t writesLeft = SIZE_MAX;     // before losing power
+
+static void wait(uint32_t us) {
+    auto start = std::chrono::steady_clock::now();
+    while(std::chrono::steady_clock::now() - start < std::chrono::microseconds(us));
+}
+
+// returns false if power was lost before the write
+static bool powerStep() {
+    if(writesLeft == 0) {
+        return false;
+    } else if(writesLeft != SIZE_MAX) {
+        writesLeft--;
+    }
+
+    return true;
+}
+
+static Namespace* lookup(nvs_handle_t handle) {
+    auto it = handles.find(handle);
+
+    return it != handles.end() ? &partitions[it->second.partition][it->second.ns] : nullptr;
+}
+
+static esp_err_t set(nvs_handle_t handle, const char* key, nvs_type_t type, const void* value, size_t len) {
+    auto it = handles.find(handle);
+
+    if(it == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    } else if(it->second.readOnly) {
+        return ESP_ERR_NVS_READ_ONLY;
+    } else if(key == nullptr || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    } else if(!powerStep()) {
+        return ESP_FAIL;
+    }
+
+    stats.sets++;
+
+    // a value of a different type replaces the previous one
+    Item& item = (*lookup(handle))[key];
+    item.type = type;
+    item.data.assign((const uint8_t*)value, (const uint8_t*)value + len);
+    stats.bytesWritten += len;
+
+    return ESP_OK;
+}
+
+static esp_err_t get(nvs_handle_t handle, const char* key, nvs_type_t type, const Item** out) {
+    Namespace* ns = lookup(handle);
+
+    if(ns == nullptr) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    } else if(key == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    stats.gets++;
+    wait(lookupLatencyUs);
+
+    auto it = ns->find(key);
+    if(it == ns->end() || it->second.type != type) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    *out = &it->second;
+
+    return ESP_OK;
+}
+
+template<typename T>
+static esp_err_t getValue(nvs_handle_t handle, const char* key, nvs_type_t type, T* out) {
+    const Item* item;
+    esp_err_t err = get(handle, key, type, &item);
+
+    if(err == ESP_OK) {
+        memcpy(out, item->data.data(), sizeof(T));
+        stats.bytesRead += sizeof(T);
+    }
+
+    return err;
+}
+
+static esp_err_t getBuffer(nvs_handle_t handle, const char* key, nvs_type_t type, void* out, size_t* length) {
+    const Item* item;
+    esp_err_t err = get(handle, key, type, &item);
+
+    if(err != ESP_OK) {
+        return err;
+    } else if(length == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    } else if(out == nullptr) {
+        *length = item->data.size();
+        return ESP_OK;
+    } else if(*length < item->data.size()) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    memcpy(out, item->data.data(), item->data.size());
+    *length = item->data.size();
+    stats.bytesRead += item->data.size();
+
+    return ESP_OK;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch(code) {
+    case ESP_OK:                        return "ESP_OK";
+    case ESP_ERR_NVS_NOT_FOUND:         return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_READ_ONLY:         return "ESP_ERR_NVS_READ_ONLY";
+    case ESP_ERR_NVS_INVALID_HANDLE:    return "ESP_ERR_NVS_INVALID_HANDLE";
+    case ESP_ERR_NVS_KEY_TOO_LONG:      return "ESP_ERR_NVS_KEY_TOO_LONG";
+    case ESP_ERR_NVS_INVALID_LENGTH:    return "ESP_ERR_NVS_INVALID_LENGTH";
+    default:                            return "ESP_FAIL";
+    }
+}
+
+esp_err_t nvs_flash_init() {
+    return nvs_flash_init_partition(NVS_DEFAULT_PART_NAME);
+}
+
+esp_err_t nvs_flash_init_partition(const char* partition_label) {
+    partitions[partition_label];
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    return nvs_open_from_partition(NVS_DEFAULT_PART_NAME, namespace_name, open_mode, out_handle);
+}
+
+esp_err_t nvs_open_from_partition(const char* part_name, const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    if(namespace_name == nullptr || strlen(namespace_name) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+
+    handles[nextHandle] = { part_name, namespace_name, open_mode == NVS_READONLY };
+    *out_handle = nextHandle++;
+
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    handles.erase(handle);
+}
+
+esp_err_t nvs_set_i8(nvs_handle_t handle, const char* key, int8_t value)      { return set(handle, key, NVS_TYPE_I8, &value, sizeof(value)); }
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value)     { return set(handle, key, NVS_TYPE_U8, &value, sizeof(value)); }
+esp_err_t nvs_set_i16(nvs_handle_t handle, const char* key, int16_t value)    { return set(handle, key, NVS_TYPE_I16, &value, sizeof(value)); }
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char* key, uint16_t value)   { return set(handle, key, NVS_TYPE_U16, &value, sizeof(value)); }
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value)    { return set(handle, key, NVS_TYPE_I32, &value, sizeof(value)); }
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value)   { return set(handle, key, NVS_TYPE_U32, &value, sizeof(value)); }
+esp_err_t nvs_set_i64(nvs_handle_t handle, const char* key, int64_t value)    { return set(handle, key, NVS_TYPE_I64, &value, sizeof(value)); }
+esp_err_t nvs_set_u64(nvs_handle_t handle, const char* key, uint64_t value)   { return set(handle, key, NVS_TYPE_U64, &value, sizeof(value)); }
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    // strings are stored with their null terminator
+    return set(handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    return set(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_i8(nvs_handle_t handle, const char* key, int8_t* out_value)     { return getValue(handle, key, NVS_TYPE_I8, out_value); }
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value)    { return getValue(handle, key, NVS_TYPE_U8, out_value); }
+esp_err_t nvs_get_i16(nvs_handle_t handle, const char* key, int16_t* out_value)   { return getValue(handle, key, NVS_TYPE_I16, out_value); }
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char* key, uint16_t* out_value)  { return getValue(handle, key, NVS_TYPE_U16, out_value); }
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value)   { return getValue(handle, key, NVS_TYPE_I32, out_value); }
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value)  { return getValue(handle, key, NVS_TYPE_U32, out_value); }
+esp_err_t nvs_get_i64(nvs_handle_t handle, const char* key, int64_t* out_value)   { return getValue(handle, key, NVS_TYPE_I64, out_value); }
+esp_err_t nvs_get_u64(nvs_handle_t handle, const char* key, uint64_t* out_value)  { return getValue(handle, key, NVS_TYPE_U64, out_value); }
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    return getBuffer(handle, key, NVS_TYPE_STR, out_value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+    return getBuffer(handle, key, NVS_TYPE_BLOB, out_value, length);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    auto it = handles.find(handle);
+
+    if(it == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    } else if(it->second.readOnly) {
+        return ESP_ERR_NVS_READ_ONLY;
+    } else if(!powerStep()) {
+        return ESP_FAIL;
+    }
+
+    stats.erases++;
+
+    return lookup(handle)->erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    auto it = handles.find(handle);
+
+    if(it == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    } else if(it->second.readOnly) {
+        return ESP_ERR_NVS_READ_ONLY;
+    } else if(!powerStep()) {
+        return ESP_FAIL;
+    }
+
+    stats.erases++;
+    lookup(handle)->clear();
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    if(handles.find(handle) == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    } else if(writesLeft == 0) {
+        return ESP_FAIL;
+    }
+
+    stats.commits++;
+    wait(commitLatencyUs);
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_find(const char* part_name, const char* namespace_name, nvs_type_t type, nvs_iterator_t* output_iterator) {
+    *output_iterator = nullptr;
+
+    auto part = partitions.find(part_name);
+    if(part == partitions.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    nvs_iterator_t it = new nvs_opaque_iterator_t { namespace_name != nullptr ? namespace_name : "", type, {}, 0 };
+
+    for(auto& ns: part->second) {
+        if(namespace_name != nullptr && ns.first != namespace_name) {
+            continue;
+        }
+
+        for(auto& item: ns.second) {
+            if(type == NVS_TYPE_ANY || item.second.type == type) {
+                it->entries.push_back(std::make_pair(item.first, item.second.type));
+            }
+        }
+    }
+
+    if(it->entries.empty()) {
+        delete it;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    stats.iterations++;
+    *output_iterator = it;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_find_in_handle(nvs_handle_t handle, nvs_type_t type, nvs_iterator_t* output_iterator) {
+    auto it = handles.find(handle);
+
+    if(it == handles.end()) {
+        *output_iterator = nullptr;
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    return nvs_entry_find(it->second.partition.c_str(), it->second.ns.c_str(), type, output_iterator);
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t* iterator) {
+    if(iterator == nullptr || *iterator == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // the iterator is released when the end is reached
+    if(++(*iterator)->pos >= (*iterator)->entries.size()) {
+        delete *iterator;
+        *iterator = nullptr;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    stats.iterations++;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t iterator, nvs_entry_info_t* out_info) {
+    if(iterator == nullptr || out_info == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    strncpy(out_info->namespace_name, iterator->ns.c_str(), sizeof(out_info->namespace_name) - 1);
+    out_info->namespace_name[sizeof(out_info->namespace_name) - 1] = '\0';
+    strncpy(out_info->key, iterator->entries[iterator->pos].first.c_str(), sizeof(out_info->key) - 1);
+    out_info->key[sizeof(out_info->key) - 1] = '\0';
+    out_info->type = iterator->entries[iterator->pos].second;
+
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator) {
+    delete iterator;
+}
+
+NvsFakeStats& nvs_fake_stats() {
+    return stats;
+}
+
+void nvs_fake_reset_stats() {
+    stats = NvsFakeStats();
+}
+
+void nvs_fake_format() {
+    partitions.clear();
+}
+
+void nvs_fake_set_lookup_latency(uint32_t us) {
+    lookupLatencyUs = us;
+}
+
+void nvs_fake_set_commit_latency(uint32_t us) {
+    commitLatencyUs = us;
+}
+
+void nvs_fake_power_cut_after(size_t writes) {
+    writesLeft = writes;
+}
+
+void nvs_fake_power_on() {
+    writesLeft = SIZE_MAX;
+}
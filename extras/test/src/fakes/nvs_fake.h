@@ -0,0 +1,37 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include "nvs.h"
+
+// control of the fake nvs, not part of the ESP-IDF API
+struct NvsFakeStats {
+    size_t gets;        // nvs_get_* calls, each one scans the pages of the partition
+    size_t sets;
+    size_t erases;
+    size_t commits;
+    size_t iterations;  // entries visited by iterators
+    size_t bytesRead;   // of values copied out of and into the partition
+    size_t bytesWritten;
+};
+
+NvsFakeStats& nvs_fake_stats();
+void nvs_fake_reset_stats();
+
+// drop the content of all the partitions
+void nvs_fake_format();
+
+// busy wait in nvs_get_* calls and in nvs_commit, simulating the cost of accessing flash
+void nvs_fake_set_lookup_latency(uint32_t us);
+void nvs_fake_set_commit_latency(uint32_t us);
+
+// lose power after the specified number of sets and erases, the following writes fail
+// until nvs_fake_power_on() is called, while the content written before is preserved
+void nvs_fake_power_cut_after(size_t writes);
+void nvs_fake_power_on();
@@ -0,0 +1,571 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include <cstdio>
+#include <cstring>
+
+// 16 blocks of 512 bytes, each area is 4KB
+static constexpr FlashSimulator::Config SMALL = { 16 * 512, 512, 4, 1, 10, 1000 };
+static constexpr FlashSimulator::Config BYTE_PROGRAM = { 16 * 512, 512, 1, 1, 10, 1000 };
+
+TEST_CASE( "FlashKVStore stores values on a flash device", "[flash][kvstore]" ) {
+    FlashSimulator flash(GENERATE(SMALL, BYTE_PROGRAM));
+    FlashKVStore store(flash);
+    REQUIRE( store.begin() );
+
+    SECTION( "values of different types can be stored and read back" ) {
+        REQUIRE( store.putUChar("0", 0x55) == 1 );
+        REQUIRE( store.putUInt("1", 0x55555555) == 4 );
+        REQUIRE( store.putULong64("2", 0x5555555555555555) == 8 );
+        REQUIRE( store.putString("3", "pippo") == 5 );
+
+        char res[6];
+        REQUIRE( store.getUChar("0") == 0x55 );
+        REQUIRE( store.getUInt("1") == 0x55555555 );
+        REQUIRE( store.getULong64("2") == 0x5555555555555555 );
+        REQUIRE( store.getString("3", res, sizeof(res)) == 5 );
+        REQUIRE( strcmp(res, "pippo") == 0 );
+        REQUIRE( store.getBytesLength("3") == 5 );
+        REQUIRE( store.size() == 4 );
+
+        REQUIRE( store.remove("1") == 1 );
+        REQUIRE_FALSE( store.exists("1") );
+        REQUIRE( store.remove("1") == 0 );
+        REQUIRE( store.getUInt("1", 7) == 7 );
+        REQUIRE( store.size() == 3 );
+    }
+
+    SECTION( "overwritten values become garbage" ) {
+        REQUIRE( store.putUInt("a", 1) == 4 );
+        REQUIRE( store.garbageBytes() == 0 );
+
+        REQUIRE( store.putUInt("a", 2) == 4 );
+        REQUIRE( store.getUInt("a") == 2 );
+        REQUIRE( store.garbageBytes() > 0 );
+        REQUIRE( store.size() == 1 );
+    }
+
+    SECTION( "invalid keys are rejected" ) {
+        char longKey[FLASH_KVSTORE_MAX_KEY_LEN + 2];
+        memset(longKey, 'k', sizeof(longKey) - 1);
+        longKey[sizeof(longKey) - 1] = '\0';
+
+        REQUIRE( store.putUInt(longKey, 1) == 0 );
+        REQUIRE( store.putUInt("", 1) == 0 );
+        REQUIRE( store.putBytes(nullptr, nullptr, 0) == 0 );
+    }
+
+    SECTION( "values are read through view" ) {
+        uint8_t blob[200];
+        for(size_t i=0; i<sizeof(blob); i++) {
+            blob[i] = i;
+        }
+        REQUIRE( store.putBytes("blob", blob, sizeof(blob)) == sizeof(blob) );
+
+        bool equal = false;
+        auto cb = [](const uint8_t value[], size_t len, void* ctx) {
+            uint8_t expected[200];
+            for(size_t i=0; i<sizeof(expected); i++) {
+                expected[i] = i;
+            }
+            *(bool*)ctx = len == sizeof(expected) && memcmp(value, expected, len) == 0;
+        };
+
+        REQUIRE( store.view("blob", cb, &equal) == sizeof(blob) );
+        REQUIRE( equal );
+        REQUIRE( store.view("missing", cb, &equal) == 0 );
+    }
+
+    SECTION( "the index grows with the number of keys" ) {
+        char key[16];
+        for(uint32_t i=0; i<100; i++) {
+            snprintf(key, sizeof(key), "k%u", i);
+            REQUIRE( store.putUShort(key, i) == 2 );
+        }
+
+        REQUIRE( store.size() == 100 );
+        REQUIRE( store.indexBytes() >= 100 * 8 );
+
+        for(uint32_t i=0; i<100; i+=2) {
+            snprintf(key, sizeof(key), "k%u", i);
+            REQUIRE( store.remove(key) == 1 );
+        }
+
+        for(uint32_t i=0; i<100; i++) {
+            snprintf(key, sizeof(key), "k%u", i);
+            REQUIRE( store.exists(key) == (i % 2 == 1) );
+            REQUIRE( store.getUShort(key, 0xFFFF) == (i % 2 == 1 ? i : 0xFFFF) );
+        }
+    }
+
+    SECTION( "values are persisted across restarts" ) {
+        REQUIRE( store.putUInt("a", 1) == 4 );
+        REQUIRE( store.putUInt("b", 2) == 4 );
+        REQUIRE( store.putUInt("a", 3) == 4 );
+        REQUIRE( store.remove("b") == 1 );
+        uint32_t garbage = store.garbageBytes();
+
+        REQUIRE( store.end() );
+        REQUIRE( store.begin() );
+
+        REQUIRE( store.getUInt("a") == 3 );
+        REQUIRE_FALSE( store.exists("b") );
+        REQUIRE( store.size() == 1 );
+        // the checkpoint written by end() is garbage once the index is restored from it
+        REQUIRE( store.garbageBytes() == garbage + 40 );
+    }
+
+    SECTION( "clear removes all the values" ) {
+        REQUIRE( store.putUInt("a", 1) == 4 );
+        REQUIRE( store.clear() );
+        REQUIRE_FALSE( store.exists("a") );
+        REQUIRE( store.size() == 0 );
+
+        REQUIRE( store.end() );
+        REQUIRE( store.begin() );
+        REQUIRE_FALSE( store.exists("a") );
+    }
+
+    store.end();
+}
+
+TEST_CASE( "FlashKVStore collects garbage when an area is full", "[flash][kvstore]" ) {
+    FlashSimulator flash(SMALL);
+    FlashKVStore store(flash);
+    REQUIRE( store.begin() );
+    REQUIRE( store.areaSize() == 8 * 512 );
+
+    char key[16];
+    for(uint32_t i=0; i<10; i++) {
+        snprintf(key, sizeof(key), "k%u", i);
+        REQUIRE( store.putUInt(key, i) == 4 );
+    }
+
+    // every record takes 24 bytes, overwrites fill the area a few times
+    for(uint32_t i=0; i<2000; i++) {
+        snprintf(key, sizeof(key), "k%u", i % 10);
+        REQUIRE( store.putUInt(key, i) == 4 );
+    }
+
+    REQUIRE( store.getStats().collections > 0 );
+    REQUIRE( store.size() == 10 );
+
+    for(uint32_t i=0; i<10; i++) {
+        snprintf(key, sizeof(key), "k%u", i);
+        REQUIRE( store.getUInt(key) == 1990 + i );
+    }
+
+    // both areas are erased alternately
+    REQUIRE( flash.getEraseCount(0) > 0 );
+    REQUIRE( flash.getEraseCount(8) > 0 );
+
+    REQUIRE( store.end() );
+    REQUIRE( store.begin() );
+    for(uint32_t i=0; i<10; i++) {
+        snprintf(key, sizeof(key), "k%u", i);
+        REQUIRE( store.getUInt(key) == 1990 + i );
+    }
+
+    SECTION( "a value larger than an area is rejected" ) {
+        static uint8_t big[8 * 512];
+        REQUIRE( store.putBytes("big", big, sizeof(big)) == 0 );
+        REQUIRE( store.getUInt("k0") == 1990 );
+    }
+
+    SECTION( "a full store rejects new values" ) {
+        static uint8_t blob[1000];
+        REQUIRE( store.putBytes("b0", blob, sizeof(blob)) == sizeof(blob) );
+        REQUIRE( store.putBytes("b1", blob, sizeof(blob)) == sizeof(blob) );
+        REQUIRE( store.putBytes("b2", blob, sizeof(blob)) == sizeof(blob) );
+        REQUIRE( store.putBytes("b3", blob, sizeof(blob)) == 0 );
+        REQUIRE( store.getUInt("k0") == 1990 );
+    }
+
+    store.end();
+}
+
+static constexpr uint32_t KEYS = 7;
+static constexpr int64_t ABSENT = -1;
+
+// overwrites and removals of a few keys, until power is lost, keeping track of the values
+// that were acknowledged and of the operation that was interrupted
+struct Workload {
+    int64_t acknowledged[KEYS];
+    uint32_t interruptedKey;
+    int64_t interruptedValue;
+
+    void run(FlashKVStore& store, FlashSimulator& flash) {
+        char key[16];
+        interruptedKey = KEYS;
+
+        for(uint32_t k=0; k<KEYS; k++) {
+            acknowledged[k] = ABSENT;
+        }
+
+        for(uint32_t i=0; i<300; i++) {
+            uint32_t k = i % KEYS;
+            int64_t value = i % 11 == 0 ? ABSENT : i;
+            snprintf(key, sizeof(key), "k%u", k);
+
+            if(value == ABSENT) {
+                store.remove(key);
+            } else {
+                store.putUInt(key, value);
+            }
+
+            if(!flash.isPowered()) {
+                interruptedKey = k;
+                interruptedValue = value;
+                return;
+            }
+            acknowledged[k] = value;
+        }
+    }
+};
+
+TEST_CASE( "FlashKVStore survives a power cut at any step", "[flash][kvstore]" ) {
+    uint32_t budget = GENERATE(0, 1);
+
+    // count the steps the workload takes
+    uint64_t steps;
+    {
+        FlashSimulator flash(SMALL);
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+        store.setIncrementalGC(budget);
+
+        uint64_t start = flash.getSteps();
+        Workload().run(store, flash);
+        steps = flash.getSteps() - start;
+        REQUIRE( store.getStats().collections > 0 );
+    }
+
+    for(uint64_t cut=0; cut<steps; cut++) {
+        FlashSimulator flash(SMALL);
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+        store.setIncrementalGC(budget);
+
+        Workload workload;
+        flash.powerCutAfter(cut);
+        workload.run(store, flash);
+        store.end();
+        REQUIRE_FALSE( flash.isPowered() );
+
+        flash.powerOn();
+        REQUIRE( store.begin() );
+
+        // every key holds the last acknowledged value, or the interrupted one
+        char key[16];
+        for(uint32_t k=0; k<KEYS; k++) {
+            snprintf(key, sizeof(key), "k%u", k);
+            int64_t value = store.exists(key) ? store.getUInt(key) : ABSENT;
+
+            if(k == workload.interruptedKey && value == workload.interruptedValue) {
+                continue;
+            }
+            REQUIRE( value == workload.acknowledged[k] );
+        }
+
+        // and the store is still writable
+        REQUIRE( store.putUInt("after", 1) == 4 );
+        REQUIRE( store.getUInt("after") == 1 );
+        store.end();
+    }
+}
+
+// a flash rejecting a single program operation, while still readable
+class FlakyFlash: public FlashSimulator {
+public:
+    FlakyFlash(const Config& config): FlashSimulator(config), failAfter(NEVER) {}
+
+    void failProgramAfter(uint64_t programs) { failAfter = programs; }
+
+    res_t program(const void* buf, uint32_t addr, uint32_t size) override {
+        if(failAfter != NEVER && failAfter-- == 0) {
+            failAfter = NEVER;
+            return BD_ERROR;
+        }
+
+        return FlashSimulator::program(buf, addr, size);
+    }
+private:
+    static constexpr uint64_t NEVER = UINT64_MAX;
+    uint64_t failAfter;
+};
+
+TEST_CASE( "FlashKVStore does not write over a torn record after a failed collection", "[flash][kvstore]" ) {
+    uint64_t failing = GENERATE(0, 1, 2);
+
+    for(uint64_t cut=0; cut<400; cut++) {
+        FlakyFlash flash(SMALL);
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+
+        // a power cut leaves a torn record, the store is used again without a restart
+        Workload workload;
+        flash.powerCutAfter(cut);
+        workload.run(store, flash);
+        REQUIRE_FALSE( flash.isPowered() );
+        flash.powerOn();
+
+        // the collection started by the next write fails and the area is scanned again
+        flash.failProgramAfter(failing);
+
+        char key[16];
+        int64_t acknowledged[5] = { ABSENT, ABSENT, ABSENT, ABSENT, ABSENT };
+        for(uint32_t i=0; i<100; i++) {
+            snprintf(key, sizeof(key), "a%u", i % 5);
+            if(store.putUInt(key, i) == 4) {
+                acknowledged[i % 5] = i;
+            }
+        }
+        REQUIRE( flash.getStats().programErrors == 0 );
+
+        REQUIRE( store.end() );
+        REQUIRE( store.begin() );
+        for(uint32_t k=0; k<5; k++) {
+            snprintf(key, sizeof(key), "a%u", k);
+            REQUIRE( acknowledged[k] != ABSENT );
+            REQUIRE( store.getUInt(key) == acknowledged[k] );
+        }
+        store.end();
+    }
+}
+
+static FlashSimulator* simulated = nullptr;
+
+static uint32_t simulatedClock() {
+    return simulated->getStats().elapsedUs;
+}
+
+TEST_CASE( "FlashKVStore collects garbage incrementally", "[flash][kvstore]" ) {
+    // 64 blocks of 512 bytes, each area is 16KB
+    FlashSimulator flash({ 64 * 512, 512, 4, 1, 10, 1000 });
+    FlashKVStore store(flash);
+    REQUIRE( store.begin() );
+
+    simulated = &flash;
+    store.setClock(simulatedClock);
+
+    uint32_t n = 0;
+    auto workload = [&](uint32_t updates) {
+        char key[16];
+        uint64_t max = 0;
+
+        for(uint32_t i=n; i<n+updates; i++) {
+            snprintf(key, sizeof(key), "k%u", i % 50);
+            uint64_t start = flash.getStats().elapsedUs;
+
+            if(i % 13 == 0) {
+                store.remove(key);
+            } else {
+                REQUIRE( store.putUInt(key, i) == 4 );
+            }
+
+            uint64_t elapsed = flash.getStats().elapsedUs - start;
+            max = elapsed > max ? elapsed : max;
+        }
+        n += updates;
+
+        return max;
+    };
+
+    auto check = [&]() {
+        char key[16];
+        for(uint32_t i=n-50; i<n; i++) {
+            snprintf(key, sizeof(key), "k%u", i % 50);
+            REQUIRE( store.exists(key) == (i % 13 != 0) );
+            if(i % 13 != 0) {
+                REQUIRE( store.getUInt(key) == i );
+            }
+        }
+    };
+
+    uint64_t blocking = workload(5000);
+    check();
+    REQUIRE( store.getStats().collections > 0 );
+
+    store.clear();
+    store.setIncrementalGC(100);
+    size_t collections = store.getStats().collections;
+
+    uint64_t incremental = workload(5000);
+    check();
+    REQUIRE( store.getStats().collections > collections );
+
+    // an erase and a few records are the most a write waits for
+    REQUIRE( blocking >= 32 * 1000 );
+    REQUIRE( incremental < 2 * 1000 );
+
+    SECTION( "values written while collecting are persisted" ) {
+        while(!store.collecting()) {
+            workload(1);
+        }
+
+        REQUIRE( store.putUInt("k1", 1234) == 4 );
+        REQUIRE( store.remove("k2") == 1 );
+        REQUIRE( store.end() );
+        REQUIRE( store.begin() );
+
+        REQUIRE( store.getUInt("k1") == 1234 );
+        REQUIRE_FALSE( store.exists("k2") );
+    }
+
+    SECTION( "maintenance completes the collection" ) {
+        while(!store.collecting()) {
+            workload(1);
+        }
+
+        while(store.maintenance(1000)) {}
+        REQUIRE_FALSE( store.collecting() );
+        REQUIRE( store.getUInt("k1", 0) != 0 );
+    }
+
+    simulated = nullptr;
+    store.end();
+}
+
+TEST_CASE( "FlashKVStore restores its index from a checkpoint", "[flash][kvstore]" ) {
+    FlashSimulator flash(GENERATE(SMALL, BYTE_PROGRAM));
+    FlashKVStore store(flash);
+    REQUIRE( store.begin() );
+    REQUIRE( store.getStats().restores == 0 );
+
+    char key[16];
+    for(uint32_t i=0; i<20; i++) {
+        snprintf(key, sizeof(key), "k%u", i);
+        REQUIRE( store.putUInt(key, i) == 4 );
+    }
+    REQUIRE( store.remove("k0") == 1 );
+
+    REQUIRE( store.end() );
+    REQUIRE( store.begin() );
+    REQUIRE( store.getStats().restores == 1 );
+    REQUIRE( store.size() == 19 );
+    REQUIRE_FALSE( store.exists("k0") );
+    for(uint32_t i=1; i<20; i++) {
+        snprintf(key, sizeof(key), "k%u", i);
+        REQUIRE( store.getUInt(key) == i );
+    }
+
+    SECTION( "writes after a restore are checkpointed again" ) {
+        REQUIRE( store.putUInt("k1", 100) == 4 );
+        REQUIRE( store.end() );
+        REQUIRE( store.begin() );
+        REQUIRE( store.getStats().restores == 2 );
+        REQUIRE( store.getUInt("k1") == 100 );
+    }
+
+    SECTION( "the area is scanned if the store was not closed cleanly" ) {
+        REQUIRE( store.putUInt("k1", 100) == 4 );
+
+        // end() cannot write the checkpoint
+        flash.powerCutAfter(0);
+        store.end();
+        flash.powerOn();
+
+        REQUIRE( store.begin() );
+        REQUIRE( store.getStats().restores == 1 );
+        REQUIRE( store.getUInt("k1") == 100 );
+        REQUIRE( store.size() == 19 );
+    }
+
+    SECTION( "checkpoints can be disabled" ) {
+        REQUIRE( store.end() );
+
+        FlashKVStore scanning(flash, 0);
+        REQUIRE( scanning.begin() );
+        REQUIRE( scanning.getStats().restores == 0 );
+        REQUIRE( scanning.size() == 19 );
+        REQUIRE( scanning.end() );
+    }
+
+    store.end();
+}
+
+TEST_CASE( "FlashKVStore scans the area once the checkpoint slots are used up", "[flash][kvstore]" ) {
+    // 64 blocks of 512 bytes, the checkpoints fit in an area without collecting
+    FlashSimulator flash({ 64 * 512, 512, 4, 1, 10, 1000 });
+    FlashKVStore store(flash);
+    REQUIRE( store.begin() );
+
+    char key[16];
+    for(uint32_t i=0; i<20; i++) {
+        snprintf(key, sizeof(key), "k%u", i);
+        REQUIRE( store.putUInt(key, i) == 4 );
+    }
+
+    for(uint32_t i=0; i<DEFAULT_CHECKPOINT_SLOTS + 2; i++) {
+        REQUIRE( store.putUInt("k1", i) == 4 );
+        REQUIRE( store.end() );
+        REQUIRE( store.begin() );
+    }
+    REQUIRE( store.getStats().collections == 0 );
+    REQUIRE( store.getStats().restores == DEFAULT_CHECKPOINT_SLOTS );
+    REQUIRE( store.getUInt("k1") == DEFAULT_CHECKPOINT_SLOTS + 1 );
+
+    // a garbage collection makes the slots of the other area available
+    REQUIRE( store.gc() );
+    REQUIRE( store.end() );
+    REQUIRE( store.begin() );
+    REQUIRE( store.getStats().restores == DEFAULT_CHECKPOINT_SLOTS + 1 );
+    REQUIRE( store.getUInt("k1") == DEFAULT_CHECKPOINT_SLOTS + 1 );
+    REQUIRE( store.size() == 20 );
+
+    store.end();
+}
+
+TEST_CASE( "FlashKVStore survives a power cut while writing a checkpoint", "[flash][kvstore]" ) {
+    uint64_t steps;
+    {
+        FlashSimulator flash(SMALL);
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+        Workload().run(store, flash);
+
+        uint64_t start = flash.getSteps();
+        REQUIRE( store.end() );
+        steps = flash.getSteps() - start;
+        REQUIRE( steps > 0 );
+    }
+
+    for(uint64_t cut=0; cut<=steps; cut++) {
+        FlashSimulator flash(SMALL);
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+
+        Workload workload;
+        workload.run(store, flash);
+        flash.powerCutAfter(cut);
+        store.end();
+
+        flash.powerOn();
+        REQUIRE( store.begin() );
+        REQUIRE( store.getStats().restores == (cut == steps ? 1 : 0) );
+
+        char key[16];
+        for(uint32_t k=0; k<KEYS; k++) {
+            snprintf(key, sizeof(key), "k%u", k);
+            REQUIRE( (store.exists(key) ? store.getUInt(key) : ABSENT) == workload.acknowledged[k] );
+        }
+
+        REQUIRE( store.putUInt("after", 1) == 4 );
+        REQUIRE( store.end() );
+        REQUIRE( store.begin() );
+        REQUIRE( store.getUInt("after") == 1 );
+        store.end();
+    }
+}
@@ -0,0 +1,162 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/flash/FlashSimulator.h>
+#include <cstring>
+
+static constexpr FlashSimulator::Config SMALL = { 8 * 256, 256, 4, 1, 10, 1000 };
+
+TEST_CASE( "FlashSimulator behaves like a NOR flash", "[flash][simulator]" ) {
+    FlashSimulator flash(SMALL);
+    REQUIRE( flash.init() == FlashSimulator::BD_OK );
+
+    uint8_t buf[8];
+
+    SECTION( "the device starts erased" ) {
+        REQUIRE( flash.read(buf, 0, sizeof(buf)) == FlashSimulator::BD_OK );
+
+        for(uint8_t b: buf) {
+            REQUIRE( b == 0xFF );
+        }
+    }
+
+    SECTION( "programming can only clear bits" ) {
+        const uint8_t first[4]  = { 0xF0, 0xF0, 0xF0, 0xF0 };
+        const uint8_t second[4] = { 0x0F, 0xFF, 0x00, 0xF0 };
+
+        REQUIRE( flash.program(first, 0, 4) == FlashSimulator::BD_OK );
+        REQUIRE( flash.getStats().programErrors == 0 );
+
+        REQUIRE( flash.program(second, 0, 4) == FlashSimulator::BD_OK );
+        REQUIRE( flash.getStats().programErrors == 2 );
+
+        REQUIRE( flash.read(buf, 0, 4) == FlashSimulator::BD_OK );
+        REQUIRE( buf[0] == 0x00 );
+        REQUIRE( buf[1] == 0xF0 );
+        REQUIRE( buf[2] == 0x00 );
+        REQUIRE( buf[3] == 0xF0 );
+
+        REQUIRE( flash.erase(0, 256) == FlashSimulator::BD_OK );
+        REQUIRE( flash.read(buf, 0, 4) == FlashSimulator::BD_OK );
+        REQUIRE( buf[0] == 0xFF );
+    }
+
+    SECTION( "unaligned or out of range operations are rejected" ) {
+        REQUIRE( flash.program(buf, 2, 4) == FlashSimulator::BD_ERROR_PARAM );
+        REQUIRE( flash.program(buf, 0, 3) == FlashSimulator::BD_ERROR_PARAM );
+        REQUIRE( flash.erase(128, 256) == FlashSimulator::BD_ERROR_PARAM );
+        REQUIRE( flash.erase(0, 9 * 256) == FlashSimulator::BD_ERROR_PARAM );
+        REQUIRE( flash.read(buf, 8 * 256 - 4, 8) == FlashSimulator::BD_ERROR_PARAM );
+    }
+}
+
+TEST_CASE( "FlashSimulator accounts for wear and latency", "[flash][simulator]" ) {
+    FlashSimulator flash(SMALL);
+    uint8_t data[16];
+    memset(data, 0, sizeof(data));
+
+    REQUIRE( flash.program(data, 0, 16) == FlashSimulator::BD_OK );
+    REQUIRE( flash.read(data, 0, 16) == FlashSimulator::BD_OK );
+
+    for(int i=0; i<4; i++) {
+        REQUIRE( flash.erase(0, 256) == FlashSimulator::BD_OK );
+    }
+    REQUIRE( flash.erase(256, 512) == FlashSimulator::BD_OK );
+
+    const FlashSimulator::Stats& stats = flash.getStats();
+    REQUIRE( stats.programs == 1 );
+    REQUIRE( stats.bytesProgrammed == 16 );
+    REQUIRE( stats.reads == 1 );
+    REQUIRE( stats.bytesRead == 16 );
+    REQUIRE( stats.erases == 6 );
+
+    // 4 program units, one read and 6 erased blocks
+    REQUIRE( stats.elapsedUs == 4 * 10 + 1 + 6 * 1000 );
+
+    REQUIRE( flash.getEraseCount(0) == 4 );
+    REQUIRE( flash.getEraseCount(1) == 1 );
+    REQUIRE( flash.getEraseCount(2) == 1 );
+    REQUIRE( flash.getEraseCount(3) == 0 );
+    REQUIRE( flash.getMaxEraseCount() == 4 );
+
+    REQUIRE( flash.getWriteAmplification(8) == 2.0 );
+
+    char map[16];
+    REQUIRE( flash.getWearMap(map, sizeof(map)) == 8 );
+    REQUIRE( strcmp(map, "@::     ") == 0 );
+
+    flash.resetStats();
+    REQUIRE( flash.getStats().erases == 0 );
+    REQUIRE( flash.getEraseCount(0) == 4 );
+}
+
+TEST_CASE( "FlashSimulator can lose power at any step", "[flash][simulator]" ) {
+    FlashSimulator flash(SMALL);
+    uint8_t data[16];
+    memset(data, 0, sizeof(data));
+
+    SECTION( "a program is interrupted in the middle of a program unit" ) {
+        flash.powerCutAfter(2);
+
+        REQUIRE( flash.program(data, 0, 16) == FlashSimulator::BD_ERROR_POWER );
+        REQUIRE_FALSE( flash.isPowered() );
+        REQUIRE( flash.read(data, 0, 16) == FlashSimulator::BD_ERROR_POWER );
+
+        flash.powerOn();
+
+        // two units and half of the third one are programmed
+        const uint8_t* content = flash.data();
+        REQUIRE( content[9] == 0x00 );
+        REQUIRE( content[10] == 0xFF );
+        REQUIRE( content[12] == 0xFF );
+    }
+
+    SECTION( "an erase is interrupted leaving the block partially erased" ) {
+        REQUIRE( flash.program(data, 0, 16) == FlashSimulator::BD_OK );
+        flash.program(data, 200, 16);
+
+        flash.powerCutAfter(0);
+        REQUIRE( flash.erase(0, 256) == FlashSimulator::BD_ERROR_POWER );
+        REQUIRE( flash.erase(0, 256) == FlashSimulator::BD_ERROR_POWER );
+
+        flash.powerOn();
+        REQUIRE( flash.isPowered() );
+
+        const uint8_t* content = flash.data();
+        REQUIRE( content[0] == 0xFF );
+        REQUIRE( content[200] == 0x00 );
+
+        REQUIRE( flash.erase(0, 256) == FlashSimulator::BD_OK );
+        REQUIRE( content[200] == 0xFF );
+    }
+
+    SECTION( "every step can be interrupted" ) {
+        uint64_t steps = 0;
+        REQUIRE( flash.program(data, 0, 16) == FlashSimulator::BD_OK );
+        REQUIRE( flash.erase(0, 512) == FlashSimulator::BD_OK );
+        steps = flash.getSteps();
+        REQUIRE( steps == 6 );
+
+        for(uint64_t cut=0; cut<steps; cut++) {
+            FlashSimulator f(SMALL);
+            f.powerCutAfter(cut);
+
+            FlashSimulator::res_t res = f.program(data, 0, 16);
+            if(res == FlashSimulator::BD_OK) {
+                res = f.erase(0, 512);
+            }
+
+            REQUIRE( res == FlashSimulator::BD_ERROR_POWER );
+            REQUIRE( f.getSteps() == cut + 1 );
+        }
+    }
+}
@@ -12,78 +12,11 @@
 #include <catch2/catch_template_test_macros.hpp>
 
 #include <kvstore/kvstore.h>
-#include <map>
+#include "../mock/MockKVStore.h"
 #include <cstdint>
 #include <cstring>
-#include <stdexcept>
 
-class KVStore: public KVStoreInterface {
-public:
-    bool begin() { return true; }
-    bool end()   { return true; }
-    bool clear();
-
-    typename KVStoreInterface::res_t remove(const Key& key) override;
-    bool exists(const Key& key) const override;
-    typename KVStoreInterface::res_t putBytes(const Key& key, const uint8_t b[], size_t s) override;
-    typename KVStoreInterface::res_t getBytes(const Key& key, uint8_t b[], size_t s) const override;
-    size_t getBytesLength(const Key& key) const override;
-
-private:
-    std::map<Key, std::pair<uint8_t*, size_t>> kvmap;
-};
-
-bool KVStore::clear() {
-    kvmap.clear();
-
-    return true;
-}
-
-typename KVStoreInterface::res_t KVStore::remove(const Key& key) {
-    auto el = kvmap.at(key);
-    kvmap.erase(key);
-
-    delete [] el.first;
-
-    return 1;
-}
-
-bool KVStore::exists(const Key& key) const {
-    try {
-        kvmap.at(key);
-        return true;
-    } catch(const std::out_of_range&) {
-        return false;
-    }
-}
-
-typename KVStoreInterface::res_t KVStore::putBytes(const Key& key, const uint8_t b[], size_t s) {
-    if(exists(key)) {
-        remove(key);
-    }
-
-    uint8_t* buf = new uint8_t[s];
-    std::memset(buf, 0, s);
-    std::memcpy(buf, b, s);
-
-    kvmap[key] = {buf, s};
-
-    return s;
-}
-
-typename KVStoreInterface::res_t KVStore::getBytes(const Key& key, uint8_t b[], size_t s) const {
-    auto el = kvmap.at(key);
-
-    std::memcpy(b, el.first, s <= el.second? s : el.second);
-
-    return el.second;
-}
-
-size_t KVStore::getBytesLength(const Key& key) const {
-    auto el = kvmap.at(key);
-
-    return el.second;
-}
+typedef MockKVStore KVStore;
 
 TEST_CASE( "KVStore can store values of different types, get them and remove them", "[kvstore][putgetremove]" ) {
     KVStore store;
@@ -197,3 +130,112 @@ TEST_CASE( "KVStore references are a useful tool to indirectly access kvstore",
     REQUIRE( store.remove("2") == 1 );
     REQUIRE( store.remove("3") == 1 );
 }
+
+TEST_CASE( "KVStore typed gets perform a single lookup on the store", "[kvstore][tryget]" ) {
+    KVStore store;
+    store.begin();
+
+    REQUIRE( store.putUInt("0", 0x55555555) == 4 );
+    store.resetStats();
+
+    SECTION( "getting an existing value" ) {
+        REQUIRE( store.getUInt("0") == 0x55555555 );
+        REQUIRE( store.stats.exists + store.stats.getBytes + store.stats.getBytesLength == 1 );
+    }
+
+    SECTION( "getting a missing value returns the default one" ) {
+        REQUIRE( store.getUInt("1", 0x56) == 0x56 );
+        REQUIRE( store.stats.exists + store.stats.getBytes + store.stats.getBytesLength == 1 );
+    }
+
+    SECTION( "tryGet reports whether the value was found" ) {
+        uint32_t value = 0x56;
+
+        REQUIRE( store.tryGet("1", value) <= 0 );
+        REQUIRE( value == 0x56 );
+        REQUIRE( store.tryGet("0", value) > 0 );
+        REQUIRE( value == 0x55555555 );
+    }
+
+    SECTION( "references load the value with a single lookup" ) {
+        auto ref = store.get<uint32_t>("0");
+        store.putUInt("0", 0x56565656);
+        store.resetStats();
+
+        ref.load();
+        REQUIRE( ref == 0x56565656 );
+        REQUIRE( store.stats.exists + store.stats.getBytes + store.stats.getBytesLength == 1 );
+    }
+}
+
+// KVStore relying on the default implementation of view()
+class CopyKVStore: public MockKVStore {
+public:
+    res_t view(const key_t& key, ViewCallback cb, void* ctx=nullptr, Type t=PT_BLOB) override {
+        return KVStoreInterface::view(key, cb, ctx, t);
+    }
+};
+
+struct ViewResult {
+    const uint8_t* ptr;
+    size_t len;
+    uint8_t copy[256];
+};
+
+static void viewCallback(const uint8_t value[], size_t len, void* ctx) {
+    ViewResult* res = (ViewResult*)ctx;
+
+    res->ptr = value;
+    res->len = len;
+    memcpy(res->copy, value, len <= sizeof(res->copy) ? len : sizeof(res->copy));
+}
+
+TEST_CASE( "KVStore values can be accessed without copying them", "[kvstore][view]" ) {
+    KVStore store;
+    CopyKVStore copyStore;
+    uint8_t blob[200];
+
+    for(size_t i=0; i<sizeof(blob); i++) {
+        blob[i] = i;
+    }
+
+    SECTION( "in memory stores provide direct access to the value" ) {
+        ViewResult res = {};
+        store.putBytes("0", blob, sizeof(blob));
+        store.resetStats();
+
+        REQUIRE( store.view("0", viewCallback, &res) == sizeof(blob) );
+        REQUIRE( res.len == sizeof(blob) );
+        REQUIRE( memcmp(res.copy, blob, sizeof(blob)) == 0 );
+        REQUIRE( store.stats.getBytes == 1 );
+
+        ViewResult again = {};
+        store.view("0", viewCallback, &again);
+        REQUIRE( again.ptr == res.ptr );
+    }
+
+    SECTION( "other stores copy small values in an internal buffer" ) {
+        ViewResult res = {};
+        copyStore.putString("0", "pippo");
+
+        REQUIRE( copyStore.view("0", viewCallback, &res, KVStoreInterface::PT_STR) == 5 );
+        REQUIRE( res.len == 5 );
+        REQUIRE( memcmp(res.copy, "pippo", 5) == 0 );
+    }
+
+    SECTION( "other stores copy big values on the heap" ) {
+        ViewResult res = {};
+        copyStore.putBytes("0", blob, sizeof(blob));
+
+        REQUIRE( copyStore.view("0", viewCallback, &res) == sizeof(blob) );
+        REQUIRE( memcmp(res.copy, blob, sizeof(blob)) == 0 );
+    }
+
+    SECTION( "the callback is not called for missing keys" ) {
+        ViewResult res = {};
+
+        REQUIRE( store.view("missing", viewCallback, &res) <= 0 );
+        REQUIRE( copyStore.view("missing", viewCallback, &res) <= 0 );
+        REQUIRE( res.ptr == nullptr );
+    }
+}
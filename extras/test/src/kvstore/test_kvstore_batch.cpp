@@ -0,0 +1,80 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include "../mock/MockKVStore.h"
+
+// KVStore relying on the default, one at a time, batch implementation
+class LoopKVStore: public MockKVStore {
+public:
+    size_t putMany(PutEntry entries[], size_t n) override {
+        return KVStoreInterface::putMany(entries, n);
+    }
+
+    using KVStoreInterface::removeMany;
+
+    size_t removeMany(const key_t keys[], size_t n) override {
+        return KVStoreInterface::removeMany(keys, n);
+    }
+};
+
+TEST_CASE( "KVStore batch methods put, get and remove multiple values", "[kvstore][batch]" ) {
+    LoopKVStore loop;
+    MockKVStore batch;
+    KVStoreInterface* stores[] = { &loop, &batch };
+
+    const char* keys[] = { "0", "1", "2" };
+    uint8_t  v0 = 0x55;
+    uint16_t v1 = 0x5555;
+    uint32_t v2 = 0x55555555;
+
+    KVStoreInterface::PutEntry puts[] = {
+        { keys[0], (uint8_t*)&v0, sizeof(v0), KVStoreInterface::PT_U8 },
+        { keys[1], (uint8_t*)&v1, sizeof(v1), KVStoreInterface::PT_U16 },
+        { keys[2], (uint8_t*)&v2, sizeof(v2), KVStoreInterface::PT_U32 },
+    };
+
+    for(auto store: stores) {
+        REQUIRE( store->putMany(puts, 3) == 3 );
+        REQUIRE( puts[0].res == sizeof(v0) );
+        REQUIRE( puts[1].res == sizeof(v1) );
+        REQUIRE( puts[2].res == sizeof(v2) );
+
+        uint8_t  r0 = 0;
+        uint16_t r1 = 0;
+        uint32_t r2 = 0;
+        uint32_t r3 = 0;
+
+        KVStoreInterface::GetEntry gets[] = {
+            { keys[0], (uint8_t*)&r0, sizeof(r0), KVStoreInterface::PT_U8 },
+            { keys[1], (uint8_t*)&r1, sizeof(r1), KVStoreInterface::PT_U16 },
+            { keys[2], (uint8_t*)&r2, sizeof(r2), KVStoreInterface::PT_U32 },
+            { "missing", (uint8_t*)&r3, sizeof(r3), KVStoreInterface::PT_U32 },
+        };
+
+        REQUIRE( store->getMany(gets, 4) == 3 );
+        REQUIRE( r0 == v0 );
+        REQUIRE( r1 == v1 );
+        REQUIRE( r2 == v2 );
+        REQUIRE( gets[3].res == 0 );
+
+        REQUIRE( store->removeMany(keys, 3) == 3 );
+        REQUIRE_FALSE( store->exists(keys[0]) );
+        REQUIRE_FALSE( store->exists(keys[1]) );
+        REQUIRE_FALSE( store->exists(keys[2]) );
+    }
+
+    SECTION( "the default implementation commits every value, an overridden one can commit once" ) {
+        REQUIRE( loop.stats.commits == 6 );
+        REQUIRE( batch.stats.commits == 2 );
+    }
+}
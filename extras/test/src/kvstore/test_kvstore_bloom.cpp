@@ -0,0 +1,168 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/decorators/BloomKVStore.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include "../mock/MockKVStore.h"
+#include <cstdio>
+
+TEST_CASE( "BloomKVStore answers lookups of missing keys", "[kvstore][bloom]" ) {
+    MockKVStore backend;
+    BloomKVStore store(backend);
+
+    REQUIRE( store.begin() );
+    REQUIRE_FALSE( store.isPrimed() );
+
+    SECTION( "an unprimed filter forwards every lookup" ) {
+        REQUIRE_FALSE( store.exists("feature") );
+        REQUIRE( backend.stats.exists == 1 );
+        REQUIRE( store.getStats().filtered == 0 );
+    }
+
+    SECTION( "a cleared store primes the filter" ) {
+        REQUIRE( store.clear() );
+        REQUIRE( store.isPrimed() );
+
+        REQUIRE( store.putUInt("calibration", 0x55555555) == 4 );
+        backend.resetStats();
+
+        for(int i=0; i<100; i++) {
+            REQUIRE_FALSE( store.exists("feature") );
+            REQUIRE( store.getUInt("feature", 7) == 7 );
+        }
+        REQUIRE( backend.stats.exists == 0 );
+        REQUIRE( backend.stats.getBytes == 0 );
+        REQUIRE( store.getStats().filtered == 200 );
+
+        REQUIRE( store.exists("calibration") );
+        REQUIRE( store.getUInt("calibration") == 0x55555555 );
+        REQUIRE( store.getStats().forwarded == 2 );
+        REQUIRE( store.getStats().falsePositives == 0 );
+    }
+
+    SECTION( "the filter is saved by end and loaded by begin" ) {
+        REQUIRE( store.clear() );
+        REQUIRE( store.putUInt("calibration", 1) == 4 );
+        REQUIRE( store.end() );
+
+        BloomKVStore other(backend);
+        REQUIRE( other.begin() );
+        REQUIRE( other.isPrimed() );
+        REQUIRE( other.exists("calibration") );
+
+        backend.resetStats();
+        REQUIRE_FALSE( other.exists("feature") );
+        REQUIRE( backend.stats.exists == 0 );
+
+        SECTION( "the saved filter is dropped by the first write" ) {
+            REQUIRE( other.putUInt("feature", 2) == 4 );
+            REQUIRE_FALSE( backend.exists(BLOOM_FILTER_KEY) );
+
+            // a reset before end() leaves no filter to load
+            BloomKVStore reset(backend);
+            REQUIRE( reset.begin() );
+            REQUIRE_FALSE( reset.isPrimed() );
+            REQUIRE( reset.exists("feature") );
+
+            REQUIRE( other.end() );
+            REQUIRE( backend.exists(BLOOM_FILTER_KEY) );
+        }
+
+        SECTION( "removals keep the saved filter" ) {
+            REQUIRE( other.remove("calibration") == 1 );
+            REQUIRE( backend.exists(BLOOM_FILTER_KEY) );
+            REQUIRE_FALSE( other.exists("calibration") );
+            REQUIRE( other.getStats().falsePositives == 1 );
+        }
+    }
+
+    SECTION( "stores that cannot enumerate their keys are primed by the application" ) {
+        REQUIRE( backend.putUInt("calibration", 1) == 4 );
+
+        const char* keys[] = { "calibration", "ssid" };
+        REQUIRE( store.prime(keys, 2) );
+        REQUIRE( store.isPrimed() );
+        backend.resetStats();
+
+        REQUIRE( store.getUInt("calibration") == 1 );
+        REQUIRE_FALSE( store.exists("feature") );
+        REQUIRE( backend.stats.exists == 0 );
+        REQUIRE( store.getStats().filtered == 1 );
+
+        REQUIRE( store.end() );
+        BloomKVStore other(backend);
+        REQUIRE( other.begin() );
+        REQUIRE( other.isPrimed() );
+    }
+
+    SECTION( "a filter saved with different parameters is ignored" ) {
+        REQUIRE( store.clear() );
+        REQUIRE( store.end() );
+
+        BloomKVStore other(backend, 1000, 0.001);
+        REQUIRE( other.begin() );
+        REQUIRE_FALSE( other.isPrimed() );
+    }
+}
+
+TEST_CASE( "BloomKVStore does not end an open transaction", "[kvstore][bloom]" ) {
+    FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+    FlashKVStore backend(flash);
+    BloomKVStore store(backend);
+
+    REQUIRE( store.begin() );
+    REQUIRE( store.beginTransaction() );
+    REQUIRE( store.putUInt("calibration", 0x55555555) == 4 );
+
+    // the caller decides the outcome of the transaction
+    REQUIRE_FALSE( store.end() );
+    REQUIRE( store.commit() );
+    REQUIRE( store.end() );
+
+    BloomKVStore other(backend);
+    REQUIRE( other.begin() );
+    REQUIRE( other.isPrimed() );
+    REQUIRE( other.getUInt("calibration") == 0x55555555 );
+    REQUIRE_FALSE( other.exists("feature") );
+}
+
+TEST_CASE( "BloomKVStore is sized for the false positive rate", "[kvstore][bloom]" ) {
+    MockKVStore backend;
+
+    BloomKVStore small(backend, 100, 0.01);
+    REQUIRE( small.filterBytes() == 120 );
+    REQUIRE( small.hashCount() == 7 );
+
+    BloomKVStore capped(backend, 10000, 0.01, 64);
+    REQUIRE( capped.filterBytes() == 64 );
+
+    BloomKVStore store(backend, 200, 0.01);
+    REQUIRE( store.begin() );
+    REQUIRE( store.clear() );
+
+    char key[16];
+    for(int i=0; i<200; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        REQUIRE( store.putUChar(key, i) == 1 );
+    }
+
+    for(int i=200; i<10200; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        REQUIRE_FALSE( store.exists(key) );
+    }
+
+    // the measured rate is close to the configured one
+    REQUIRE( store.getStats().falsePositives < 10000 * 0.02 );
+    REQUIRE( store.getStats().filtered + store.getStats().falsePositives == 10000 );
+}
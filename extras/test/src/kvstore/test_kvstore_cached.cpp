@@ -0,0 +1,168 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/decorators/CachedKVStore.h>
+#include "../mock/MockKVStore.h"
+
+static uint32_t now = 0;
+static uint32_t fakeClock() { return now; }
+
+// backend whose removals fail until it is repaired
+class FailingRemoveKVStore: public MockKVStore {
+public:
+    using MockKVStore::removeMany;
+
+    size_t removeMany(const key_t keys[], size_t n) override {
+        return failing ? 0 : MockKVStore::removeMany(keys, n);
+    }
+
+    bool failing = true;
+};
+
+TEST_CASE( "CachedKVStore coalesces writes until flushed", "[kvstore][cached]" ) {
+    MockKVStore backend;
+    CachedKVStore store(backend);
+    store.begin();
+
+    SECTION( "a counter updated through a reference is written once" ) {
+        auto counter = store.get<uint32_t>("counter");
+
+        for(uint32_t i=1; i<=100; i++) {
+            counter = i;
+        }
+
+        REQUIRE( backend.stats.putBytes == 0 );
+        REQUIRE( store.getUInt("counter") == 100 );
+        REQUIRE( store.getStats().coalesced == 99 );
+
+        REQUIRE( store.flush() );
+        REQUIRE( backend.stats.putBytes == 1 );
+        REQUIRE( backend.stats.commits == 1 );
+        REQUIRE( backend.getUInt("counter") == 100 );
+        REQUIRE( store.pendingBytes() == 0 );
+    }
+
+    SECTION( "pending values are written on end" ) {
+        REQUIRE( store.putUShort("0", 0x5555) == 2 );
+        REQUIRE( store.putString("1", "pippo") == 5 );
+        REQUIRE_FALSE( backend.exists("0") );
+
+        REQUIRE( store.end() );
+        REQUIRE( backend.getUShort("0") == 0x5555 );
+
+        char res[6];
+        backend.getString("1", res, sizeof(res));
+        REQUIRE( strcmp(res, "pippo") == 0 );
+    }
+
+    SECTION( "removed values are not visible and are removed on flush" ) {
+        backend.putUInt("0", 0x55555555);
+
+        REQUIRE( store.exists("0") );
+        REQUIRE( store.remove("0") == 1 );
+        REQUIRE_FALSE( store.exists("0") );
+        REQUIRE( store.getBytesLength("0") == 0 );
+        REQUIRE( backend.exists("0") );
+
+        REQUIRE( store.flush() );
+        REQUIRE_FALSE( backend.exists("0") );
+        REQUIRE( store.remove("0") == 0 );
+    }
+
+    SECTION( "removals that fail are kept pending and retried" ) {
+        FailingRemoveKVStore failing;
+        CachedKVStore cached(failing);
+        REQUIRE( failing.putUInt("calibration", 1) == 4 );
+        REQUIRE( cached.putUInt("ssid", 2) == 4 );
+
+        REQUIRE( cached.remove("calibration") == 1 );
+        REQUIRE_FALSE( cached.flush() );
+        REQUIRE( failing.getUInt("ssid") == 2 );
+        REQUIRE( failing.exists("calibration") );
+        REQUIRE_FALSE( cached.exists("calibration") );
+
+        failing.failing = false;
+        REQUIRE( cached.flush() );
+        REQUIRE_FALSE( failing.exists("calibration") );
+        REQUIRE( cached.pendingBytes() == 0 );
+    }
+
+    SECTION( "clear drops pending values" ) {
+        store.putUInt("0", 1);
+        REQUIRE( store.clear() );
+        REQUIRE_FALSE( store.exists("0") );
+        REQUIRE( store.pendingBytes() == 0 );
+    }
+}
+
+TEST_CASE( "CachedKVStore flushes when thresholds are reached", "[kvstore][cached]" ) {
+    MockKVStore backend;
+
+    SECTION( "the memory budget is respected" ) {
+        CachedKVStore store(backend, 256);
+        char key[8];
+
+        for(int i=0; i<100; i++) {
+            snprintf(key, sizeof(key), "k%d", i);
+            store.putUInt(key, i);
+
+            REQUIRE( store.pendingBytes() <= 256 );
+        }
+
+        REQUIRE( backend.stats.commits > 0 );
+        REQUIRE( backend.stats.commits < 100 );
+        store.flush();
+        REQUIRE( backend.size() == 100 );
+    }
+
+    SECTION( "values bigger than the budget are written through" ) {
+        CachedKVStore store(backend, 64);
+        uint8_t blob[128] = {};
+
+        REQUIRE( store.putBytes("blob", blob, sizeof(blob)) == sizeof(blob) );
+        REQUIRE( backend.getBytesLength("blob") == sizeof(blob) );
+        REQUIRE( store.pendingBytes() == 0 );
+    }
+
+    SECTION( "pending values older than maxAge are flushed" ) {
+        CachedKVStore store(backend, 1024, 1000);
+        store.setClock(fakeClock);
+        now = 0;
+
+        store.putUInt("0", 1);
+        now = 500;
+        store.putUInt("0", 2);
+        REQUIRE( backend.stats.putBytes == 0 );
+
+        now = 1000;
+        store.putUInt("1", 3);
+        REQUIRE( backend.stats.putBytes == 2 );
+        REQUIRE( backend.getUInt("0") == 2 );
+    }
+
+    SECTION( "pending values older than maxAge are flushed by poll" ) {
+        CachedKVStore store(backend, 1024, 1000);
+        store.setClock(fakeClock);
+        now = 0;
+
+        store.putUInt("0", 1);
+        now = 999;
+        REQUIRE( store.poll() );
+        REQUIRE( backend.stats.putBytes == 0 );
+
+        now = 1000;
+        REQUIRE( store.poll() );
+        REQUIRE( backend.getUInt("0") == 1 );
+        REQUIRE( store.pendingBytes() == 0 );
+    }
+}
@@ -0,0 +1,205 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/ESP32.h>
+#include <nvs_fake.h>
+
+TEST_CASE( "ESP32KVStore stores values in nvs", "[kvstore][esp32]" ) {
+    nvs_fake_format();
+    fake_log_reset();
+
+    ESP32KVStore store;
+    REQUIRE( store.begin() );
+
+    SECTION( "values of different types can be stored and read back" ) {
+        REQUIRE( store.putUChar("0", 0x55) == 1 );
+        REQUIRE( store.putUInt("1", 0x55555555) == 4 );
+        REQUIRE( store.putULong64("2", 0x5555555555555555) == 8 );
+        REQUIRE( store.putString("3", "pippo") == 5 );
+        REQUIRE( store.putFloat("4", 1.5f) == 4 );
+
+        uint8_t blob[] = { 1, 2, 3 };
+        REQUIRE( store.putBytes("5", blob, sizeof(blob)) == 3 );
+
+        char res[6];
+        REQUIRE( store.getUChar("0") == 0x55 );
+        REQUIRE( store.getUInt("1") == 0x55555555 );
+        REQUIRE( store.getULong64("2") == 0x5555555555555555 );
+        // the length reported by nvs includes the terminator
+        REQUIRE( store.getString("3", res, sizeof(res)) == 6 );
+        REQUIRE( strcmp(res, "pippo") == 0 );
+        REQUIRE( store.getFloat("4") == 1.5f );
+
+        uint8_t out[3] = {};
+        REQUIRE( store.getBytes("5", out, sizeof(out)) == 3 );
+        REQUIRE( memcmp(blob, out, sizeof(blob)) == 0 );
+
+        REQUIRE( store.getType("0") == KVStoreInterface::PT_U8 );
+        REQUIRE( store.getType("3") == KVStoreInterface::PT_STR );
+        REQUIRE( store.getType("4") == KVStoreInterface::PT_U32 );
+        REQUIRE( store.getType("5") == KVStoreInterface::PT_BLOB );
+        REQUIRE( store.getBytesLength("3") == 6 );
+        REQUIRE( store.getBytesLength("5") == 3 );
+
+        REQUIRE( store.remove("1") == 1 );
+        REQUIRE_FALSE( store.exists("1") );
+        REQUIRE( store.getUInt("1") == 0 );
+        REQUIRE( fake_log_errors() == 0 );
+    }
+
+    SECTION( "a value of a different type replaces the previous one" ) {
+        store.putUInt("0", 1);
+        store.putString("0", "pippo");
+
+        REQUIRE( store.getType("0") == KVStoreInterface::PT_STR );
+        REQUIRE( store.getBytesLength("0") == 6 );
+    }
+
+    SECTION( "the index is built at begin and answers without accessing nvs" ) {
+        store.putUInt("0", 1);
+        store.putString("1", "pippo");
+        uint8_t blob[10] = {};
+        store.putBytes("2", blob, sizeof(blob));
+        REQUIRE( store.end() );
+
+        ESP32KVStore reopened;
+        REQUIRE( reopened.begin() );
+        nvs_fake_reset_stats();
+
+        REQUIRE( reopened.exists("0") );
+        REQUIRE( reopened.getType("1") == KVStoreInterface::PT_STR );
+        REQUIRE( reopened.getBytesLength("0") == 4 );
+        REQUIRE_FALSE( reopened.exists("missing") );
+        REQUIRE( reopened.getUInt("missing") == 0 );
+        REQUIRE( nvs_fake_stats().gets == 0 );
+
+        // the length of strings and blobs is read once
+        REQUIRE( reopened.getBytesLength("1") == 6 );
+        REQUIRE( reopened.getBytesLength("2") == 10 );
+        REQUIRE( reopened.getBytesLength("2") == 10 );
+        REQUIRE( nvs_fake_stats().gets == 2 );
+
+        uint8_t out[10];
+        REQUIRE( reopened.getBytes("2", out, sizeof(out)) == 10 );
+        REQUIRE( nvs_fake_stats().gets == 3 );
+        REQUIRE( fake_log_errors() == 0 );
+        reopened.end();
+    }
+
+    SECTION( "the index follows removals and clear" ) {
+        store.putUInt("0", 1);
+        store.putUInt("1", 2);
+        store.putUInt("2", 3);
+
+        KVStoreInterface::key_t keys[] = { "0", "1" };
+        REQUIRE( store.removeMany(keys, 2) == 2 );
+        REQUIRE_FALSE( store.exists("0") );
+        REQUIRE_FALSE( store.exists("1") );
+        REQUIRE( store.exists("2") );
+
+        REQUIRE( store.clear() );
+        REQUIRE_FALSE( store.exists("2") );
+
+        store.putUInt("2", 4);
+        REQUIRE( store.getUInt("2") == 4 );
+    }
+
+    SECTION( "keys longer than the nvs limit do not exist" ) {
+        REQUIRE_FALSE( store.exists("a_key_longer_than_15") );
+        REQUIRE( store.getBytesLength("a_key_longer_than_15") == 0 );
+    }
+
+    store.end();
+}
+
+static uint32_t now = 0;
+
+TEST_CASE( "ESP32KVStore commits writes according to the commit policy", "[kvstore][esp32]" ) {
+    nvs_fake_format();
+    fake_log_reset();
+
+    ESP32KVStore store;
+    REQUIRE( store.begin() );
+    nvs_fake_reset_stats();
+
+    SECTION( "every write is committed by default" ) {
+        store.putUInt("0", 1);
+        store.putString("1", "pippo");
+        store.remove("0");
+
+        REQUIRE( nvs_fake_stats().commits == 3 );
+        REQUIRE( store.pendingWrites() == 0 );
+    }
+
+    SECTION( "explicit commits" ) {
+        store.setCommitPolicy(ESP32KVStore::COMMIT_EXPLICIT);
+
+        for(uint32_t i=0; i<10; i++) {
+            store.putUInt("0", i);
+        }
+        REQUIRE( nvs_fake_stats().commits == 0 );
+        REQUIRE( store.pendingWrites() == 10 );
+
+        // pending writes are readable
+        REQUIRE( store.getUInt("0") == 9 );
+
+        REQUIRE( store.commit() );
+        REQUIRE( store.commit() );
+        REQUIRE( nvs_fake_stats().commits == 1 );
+        REQUIRE( store.pendingWrites() == 0 );
+    }
+
+    SECTION( "commits every N writes" ) {
+        store.setCommitPolicy(ESP32KVStore::COMMIT_EVERY_N, 4);
+
+        for(uint32_t i=0; i<10; i++) {
+            store.putUInt("0", i);
+        }
+        REQUIRE( nvs_fake_stats().commits == 2 );
+        REQUIRE( store.pendingWrites() == 2 );
+    }
+
+    SECTION( "commits after a time window" ) {
+        store.setClock([]() { return now; });
+        store.setCommitPolicy(ESP32KVStore::COMMIT_WINDOW, 100);
+
+        now = 1000;
+        store.putUInt("0", 1);
+        now = 1050;
+        store.putUInt("1", 2);
+        REQUIRE( nvs_fake_stats().commits == 0 );
+
+        now = 1100;
+        store.putUInt("2", 3);
+        REQUIRE( nvs_fake_stats().commits == 1 );
+
+        // the window starts again from the next write
+        now = 1150;
+        store.putUInt("3", 4);
+        now = 1200;
+        store.putUInt("4", 5);
+        REQUIRE( nvs_fake_stats().commits == 1 );
+    }
+
+    SECTION( "end commits pending writes" ) {
+        store.setCommitPolicy(ESP32KVStore::COMMIT_EXPLICIT);
+        store.putUInt("0", 1);
+        store.clear();
+
+        REQUIRE( store.end() );
+        REQUIRE( nvs_fake_stats().commits == 1 );
+    }
+
+    store.end();
+    REQUIRE( fake_log_errors() == 0 );
+}
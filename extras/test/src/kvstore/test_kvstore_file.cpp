@@ -0,0 +1,154 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <cstdio>
+#include <unistd.h>
+
+static const char PATH[] = "test_kvstore_file.log";
+
+TEST_CASE( "FileKVStore stores values in a log file", "[kvstore][file]" ) {
+    ::unlink(PATH);
+    FileKVStore store(PATH);
+    REQUIRE( store.begin() );
+
+    SECTION( "values of different types can be stored and read back" ) {
+        REQUIRE( store.putUChar("0", 0x55) == 1 );
+        REQUIRE( store.putUInt("1", 0x55555555) == 4 );
+        REQUIRE( store.putULong64("2", 0x5555555555555555) == 8 );
+        REQUIRE( store.putString("3", "pippo") == 5 );
+
+        char res[6];
+        REQUIRE( store.getUChar("0") == 0x55 );
+        REQUIRE( store.getUInt("1") == 0x55555555 );
+        REQUIRE( store.getULong64("2") == 0x5555555555555555 );
+        REQUIRE( store.getString("3", res, sizeof(res)) == 5 );
+        REQUIRE( strcmp(res, "pippo") == 0 );
+
+        REQUIRE( store.remove("1") == 1 );
+        REQUIRE_FALSE( store.exists("1") );
+        REQUIRE( store.remove("1") == 0 );
+    }
+
+    SECTION( "values persist across begin and end" ) {
+        store.putUInt("0", 1);
+        store.putUInt("0", 2);
+        store.putUInt("1", 3);
+        store.remove("1");
+        REQUIRE( store.end() );
+
+        FileKVStore reopened(PATH);
+        REQUIRE( reopened.begin() );
+        REQUIRE( reopened.size() == 1 );
+        REQUIRE( reopened.getUInt("0") == 2 );
+        REQUIRE_FALSE( reopened.exists("1") );
+    }
+
+    SECTION( "a torn record at the end of the file is discarded" ) {
+        store.putUInt("0", 1);
+        store.putUInt("1", 2);
+        uint64_t size = store.fileSize();
+        store.end();
+
+        REQUIRE( truncate(PATH, size - 2) == 0 );
+
+        REQUIRE( store.begin() );
+        REQUIRE( store.getUInt("0") == 1 );
+        REQUIRE_FALSE( store.exists("1") );
+
+        // the store is still usable after recovery
+        REQUIRE( store.putUInt("1", 3) == 4 );
+        store.end();
+        REQUIRE( store.begin() );
+        REQUIRE( store.getUInt("1") == 3 );
+    }
+
+    SECTION( "a corrupted record and what follows it is discarded" ) {
+        store.putUInt("0", 1);
+        uint64_t offset = store.fileSize();
+        store.putUInt("1", 2);
+        store.end();
+
+        FILE* f = fopen(PATH, "r+b");
+        fseek(f, offset + 20, SEEK_SET);
+        fputc(0xFF, f);
+        fclose(f);
+
+        REQUIRE( store.begin() );
+        REQUIRE( store.getUInt("0") == 1 );
+        REQUIRE_FALSE( store.exists("1") );
+    }
+
+    SECTION( "compaction reclaims the space of overwritten values" ) {
+        store.setCompactionThreshold(0);
+
+        for(uint32_t i=0; i<1000; i++) {
+            store.putUInt("counter", i);
+        }
+        store.putString("name", "arduino");
+
+        uint64_t before = store.fileSize();
+        REQUIRE( store.garbageSize() > 0 );
+        REQUIRE( store.compact() );
+        REQUIRE( store.fileSize() < before );
+        REQUIRE( store.garbageSize() == 0 );
+        REQUIRE( store.getUInt("counter") == 999 );
+
+        store.end();
+        REQUIRE( store.begin() );
+        REQUIRE( store.getUInt("counter") == 999 );
+        char res[8];
+        REQUIRE( store.getString("name", res, sizeof(res)) == 7 );
+        REQUIRE( strcmp(res, "arduino") == 0 );
+    }
+
+    SECTION( "compaction is performed automatically" ) {
+        store.setCompactionThreshold(0.5, 1024);
+
+        for(uint32_t i=0; i<1000; i++) {
+            store.putUInt("counter", i);
+        }
+
+        REQUIRE( store.fileSize() < 1000 * 16 );
+        REQUIRE( store.getUInt("counter") == 999 );
+    }
+
+    SECTION( "values are accessed through view without copies" ) {
+        uint8_t blob[300];
+        memset(blob, 0x55, sizeof(blob));
+        store.putBytes("blob", blob, sizeof(blob));
+
+        REQUIRE( store.view("blob", [](const uint8_t value[], size_t len, void*) {
+            REQUIRE( len == 300 );
+            REQUIRE( value[0] == 0x55 );
+            REQUIRE( value[299] == 0x55 );
+        }) == 300 );
+    }
+
+    SECTION( "many keys can be stored" ) {
+        char key[16];
+
+        for(uint32_t i=0; i<10000; i++) {
+            snprintf(key, sizeof(key), "key%u", i);
+            store.putUInt(key, i);
+        }
+        store.end();
+
+        REQUIRE( store.begin() );
+        REQUIRE( store.size() == 10000 );
+        REQUIRE( store.getUInt("key1234") == 1234 );
+    }
+
+    store.end();
+    ::unlink(PATH);
+}
@@ -0,0 +1,226 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <kvstore/decorators/BloomKVStore.h>
+#include <kvstore/decorators/CachedKVStore.h>
+#include <kvstore/decorators/ReadCacheKVStore.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include "../mock/MockKVStore.h"
+#include <mbed_fake.h>
+#include <nvs_fake.h>
+#include <map>
+#include <string>
+#include <unistd.h>
+
+static const char PATH[] = "test_kvstore_foreach.log";
+
+struct Listed {
+    KVStoreInterface::Type type;
+    size_t len;
+};
+
+typedef std::map<std::string, Listed> Listing;
+
+static bool collect(const char* key, KVStoreInterface::Type t, size_t len, void* ctx) {
+    (*(Listing*)ctx)[key] = { t, len };
+    return true;
+}
+
+// typed tells if the store keeps the type of values, otherwise every key is reported as a blob
+static void enumerate(KVStoreInterface& store, bool typed=true) {
+    REQUIRE( store.putBytes("wifi.ssid", (const uint8_t*)"office", 6) == 6 );
+    REQUIRE( store.putUInt("wifi.security", 3) == 4 );
+    REQUIRE( store.putUShort("mqtt.port", 1883) == 2 );
+    REQUIRE( store.putUChar("boot", 1) == 1 );
+    REQUIRE( store.putUChar("wifi.old", 1) == 1 );
+    REQUIRE( store.remove("wifi.old") == 1 );
+
+    Listing listing;
+
+    SECTION( "every key is listed" ) {
+        REQUIRE( store.forEach(nullptr, collect, &listing) );
+        REQUIRE( listing.size() == 4 );
+
+        Listing other;
+        REQUIRE( store.forEach("", collect, &other) );
+        REQUIRE( other.size() == 4 );
+    }
+
+    SECTION( "keys are filtered by prefix" ) {
+        REQUIRE( store.forEach("wifi.", collect, &listing) );
+        REQUIRE( listing.size() == 2 );
+
+        REQUIRE( listing.count("wifi.ssid") == 1 );
+        REQUIRE( listing["wifi.ssid"].len == 6 );
+        REQUIRE( listing["wifi.ssid"].type == KVStoreInterface::PT_BLOB );
+
+        REQUIRE( listing.count("wifi.security") == 1 );
+        REQUIRE( listing["wifi.security"].len == 4 );
+        REQUIRE( listing["wifi.security"].type == (typed ? KVStoreInterface::PT_U32 : KVStoreInterface::PT_BLOB) );
+    }
+
+    SECTION( "a prefix matching no key lists nothing" ) {
+        REQUIRE( store.forEach("wifi.ssid.", collect, &listing) );
+        REQUIRE( store.forEach("lora", collect, &listing) );
+        REQUIRE( listing.empty() );
+    }
+
+    SECTION( "the callback stops the enumeration" ) {
+        size_t count = 0;
+        auto first = [](const char* key, KVStoreInterface::Type t, size_t len, void* ctx) -> bool {
+            (void) key;
+            (void) t;
+            (void) len;
+            (*(size_t*)ctx)++;
+            return false;
+        };
+
+        REQUIRE( store.forEach(nullptr, first, &count) );
+        REQUIRE( count == 1 );
+    }
+
+    SECTION( "keys are removed after the enumeration" ) {
+        REQUIRE( store.forEach("wifi.", collect, &listing) );
+        for(auto& el: listing) {
+            REQUIRE( store.remove(el.first.c_str()) == 1 );
+        }
+
+        listing.clear();
+        REQUIRE( store.forEach(nullptr, collect, &listing) );
+        REQUIRE( listing.size() == 2 );
+        REQUIRE( listing.count("boot") == 1 );
+        REQUIRE( listing.count("mqtt.port") == 1 );
+    }
+}
+
+TEST_CASE( "Keys are enumerated without reading values", "[kvstore][foreach]" ) {
+    SECTION( "FlashKVStore" ) {
+        FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+
+        enumerate(store);
+    }
+
+    SECTION( "FileKVStore" ) {
+        ::unlink(PATH);
+        FileKVStore store(PATH);
+        REQUIRE( store.begin() );
+
+        enumerate(store);
+
+        store.end();
+        ::unlink(PATH);
+    }
+
+    SECTION( "ESP32KVStore" ) {
+        nvs_fake_format();
+        ESP32KVStore store;
+        REQUIRE( store.begin() );
+
+        enumerate(store);
+    }
+
+    SECTION( "STM32H7KVStore" ) {
+        mbed_fake_format();
+        STM32H7KVStore store;
+        REQUIRE( store.begin() );
+
+        enumerate(store, false);
+    }
+
+    SECTION( "BloomKVStore" ) {
+        mbed_fake_format();
+        STM32H7KVStore inner;
+        BloomKVStore store(inner);
+        REQUIRE( store.begin() );
+
+        enumerate(store, false);
+    }
+
+    SECTION( "CachedKVStore" ) {
+        FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+        FlashKVStore inner(flash);
+        CachedKVStore store(inner);
+        REQUIRE( store.begin() );
+
+        enumerate(store);
+    }
+
+    SECTION( "ReadCacheKVStore" ) {
+        nvs_fake_format();
+        ESP32KVStore inner;
+        ReadCacheKVStore store(inner);
+        REQUIRE( store.begin() );
+
+        enumerate(store);
+    }
+
+    SECTION( "not supported" ) {
+        MockKVStore store;
+        Listing listing;
+
+        REQUIRE_FALSE( store.forEach(nullptr, collect, &listing) );
+    }
+}
+
+TEST_CASE( "FlashKVStore enumeration reads only record headers", "[kvstore][foreach][flash]" ) {
+    FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+    FlashKVStore store(flash);
+    REQUIRE( store.begin() );
+
+    uint8_t blob[1024] = {};
+    REQUIRE( store.putBytes("blob", blob, sizeof(blob)) == sizeof(blob) );
+
+    Listing listing;
+    uint64_t start = flash.getStats().bytesRead;
+    REQUIRE( store.forEach(nullptr, collect, &listing) );
+
+    REQUIRE( listing["blob"].len == sizeof(blob) );
+    REQUIRE( flash.getStats().bytesRead - start < sizeof(blob) );
+}
+
+TEST_CASE( "BloomKVStore rebuilds the filter from the keys of the store", "[kvstore][foreach][bloom]" ) {
+    FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+    FlashKVStore inner(flash);
+    REQUIRE( inner.begin() );
+    REQUIRE( inner.putUInt("calibration", 1) == 4 );
+    REQUIRE( inner.end() );
+
+    BloomKVStore store(inner);
+    REQUIRE( store.begin() );
+    REQUIRE( store.isPrimed() );
+
+    REQUIRE( store.exists("calibration") );
+    REQUIRE_FALSE( store.exists("feature") );
+    REQUIRE( store.getStats().filtered == 1 );
+
+    SECTION( "the saved filter is not listed" ) {
+        REQUIRE( store.end() );
+        REQUIRE( inner.begin() );
+        REQUIRE( inner.exists(BLOOM_FILTER_KEY) );
+        REQUIRE( inner.end() );
+
+        BloomKVStore other(inner);
+        REQUIRE( other.begin() );
+
+        Listing listing;
+        REQUIRE( other.forEach(nullptr, collect, &listing) );
+        REQUIRE( listing.size() == 1 );
+        REQUIRE( listing.count("calibration") == 1 );
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/decorators/ReadCacheKVStore.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include "../mock/MockKVStore.h"
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+static constexpr KVKey SSID("wifi.ssid");
+
+static_assert(SSID.length() == 9, "the length of a literal key is computed at compile time");
+static_assert(SSID.hash() == kvstore_hash("wifi.ssid", 9), "a literal key is hashed at compile time");
+static_assert("wifi.ssid"_kvkey.hash() == SSID.hash(), "keys built by the literal operator match");
+static_assert(KVKey().c_str() == nullptr, "the default key is nullptr");
+
+TEST_CASE( "KVKey carries the length and the hash of the key", "[kvstore][key]" ) {
+    SECTION( "keys built at runtime match the literal ones" ) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "wifi.%s", "ssid");
+        const char* ptr = buf;
+
+        KVKey fromBuffer(buf);
+        KVKey fromPointer(ptr);
+
+        REQUIRE( fromBuffer.length() == SSID.length() );
+        REQUIRE( fromBuffer.hash() == SSID.hash() );
+        REQUIRE( fromPointer.hash() == SSID.hash() );
+        REQUIRE( fromPointer.c_str() == buf );
+        REQUIRE( strcmp(fromPointer, SSID) == 0 );
+    }
+
+    SECTION( "different keys have different hashes" ) {
+        REQUIRE( KVKey("wifi.pass").hash() != SSID.hash() );
+        REQUIRE( KVKey("").length() == 0 );
+        REQUIRE( KVKey("").hash() == KVSTORE_HASH_SEED );
+    }
+
+    SECTION( "nullptr keys are rejected by the stores" ) {
+        const char* missing = nullptr;
+        FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+
+        REQUIRE( KVKey(missing).length() == 0 );
+        REQUIRE( store.putUInt(missing, 1) == 0 );
+        REQUIRE_FALSE( store.exists(missing) );
+    }
+}
+
+TEST_CASE( "KVKey and plain strings address the same values", "[kvstore][key]" ) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "wifi.%s", "ssid");
+
+    SECTION( "ReadCacheKVStore" ) {
+        MockKVStore backend;
+        ReadCacheKVStore store(backend);
+        REQUIRE( store.begin() );
+
+        char res[16];
+        REQUIRE( store.putString(SSID, "home") == 4 );
+        REQUIRE( store.getString(SSID, res, sizeof(res)) > 0 );
+        backend.resetStats();
+        store.resetStats();
+
+        REQUIRE( store.getString(buf, res, sizeof(res)) > 0 );
+        REQUIRE( strcmp(res, "home") == 0 );
+        REQUIRE( store.getString("wifi.ssid", res, sizeof(res)) > 0 );
+        REQUIRE( backend.stats.getBytes == 0 );
+        REQUIRE( store.getStats().hits == 2 );
+    }
+
+    SECTION( "FlashKVStore" ) {
+        FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+        {
+            FlashKVStore store(flash);
+            REQUIRE( store.begin() );
+            REQUIRE( store.putUInt(SSID, 0x55555555) == 4 );
+            REQUIRE( store.putUInt("wifi.pass", 0xAAAAAAAA) == 4 );
+            REQUIRE( store.getUInt(buf) == 0x55555555 );
+            REQUIRE( store.end() );
+        }
+
+        // the index is rebuilt from the keys read from flash, hashed the same way
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+        REQUIRE( store.getUInt(SSID) == 0x55555555 );
+        REQUIRE( store.getUInt(buf) == 0x55555555 );
+        REQUIRE( store.getUInt("wifi.pass"_kvkey) == 0xAAAAAAAA );
+        REQUIRE( store.remove(buf) == 1 );
+        REQUIRE_FALSE( store.exists(SSID) );
+    }
+
+    SECTION( "FileKVStore" ) {
+        static const char PATH[] = "test_kvstore_key.log";
+        ::unlink(PATH);
+        FileKVStore store(PATH);
+        REQUIRE( store.begin() );
+
+        REQUIRE( store.putUInt(SSID, 1) == 4 );
+        REQUIRE( store.putUInt("wifi.pass", 2) == 4 );
+        REQUIRE( store.getUInt(buf) == 1 );
+
+        // arrays of plain strings are still accepted
+        const char* keys[] = { buf, "wifi.pass", "missing" };
+        REQUIRE( store.removeMany(keys, 3) == 2 );
+        REQUIRE( store.size() == 0 );
+
+        store.end();
+        ::unlink(PATH);
+    }
+}
@@ -0,0 +1,220 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/Nina.h>
+#include <nina_fake.h>
+
+TEST_CASE( "NinaKVStore stores values in the NINA module", "[kvstore][nina]" ) {
+    nina_fake_format();
+
+    NinaKVStore store;
+    REQUIRE( store.begin() );
+
+    REQUIRE( store.putUChar("0", 0x55) == 1 );
+    REQUIRE( store.putUInt("1", 0x55555555) == 4 );
+    REQUIRE( store.putString("2", "pippo") == 6 );
+    REQUIRE( store.putFloat("3", 1.5f) == 4 );
+
+    uint8_t blob[] = { 1, 2, 3 };
+    REQUIRE( store.putBytes("4", blob, sizeof(blob)) == 3 );
+
+    char res[6];
+    REQUIRE( store.getUChar("0") == 0x55 );
+    REQUIRE( store.getUInt("1") == 0x55555555 );
+    REQUIRE( store.getString("2", res, sizeof(res)) == 6 );
+    REQUIRE( strcmp(res, "pippo") == 0 );
+    REQUIRE( store.getFloat("3") == 1.5f );
+
+    uint8_t out[3] = {};
+    REQUIRE( store.getBytes("4", out, sizeof(out)) == 3 );
+    REQUIRE( memcmp(blob, out, sizeof(blob)) == 0 );
+
+    REQUIRE( store.getBytesLength("2") == 5 );
+    REQUIRE( store.getBytesLength("4") == 3 );
+
+    REQUIRE( store.remove("1") == 1 );
+    REQUIRE_FALSE( store.exists("1") );
+    REQUIRE( store.getUInt("1") == 0 );
+    REQUIRE( store.getBytesLength("1") == 0 );
+
+    REQUIRE( store.putUInt("1", 7) == 4 );
+    REQUIRE( store.exists("1") );
+    REQUIRE( store.getUInt("1") == 7 );
+
+    REQUIRE( store.clear() );
+    REQUIRE_FALSE( store.exists("0") );
+
+    store.end();
+}
+
+TEST_CASE( "NinaKVStore saves SPI transactions with its index", "[kvstore][nina]" ) {
+    nina_fake_format();
+
+    NinaKVStore store;
+    REQUIRE( store.begin() );
+
+    SECTION( "metadata of written keys is answered locally" ) {
+        REQUIRE( store.putString("s", "pippo") == 6 );
+
+        nina_fake_reset_stats();
+        REQUIRE( store.exists("s") );
+        REQUIRE( store.getBytesLength("s") == 5 );
+        REQUIRE( nina_fake_stats().transactions == 0 );
+    }
+
+    SECTION( "keys written by a previous session are looked up once" ) {
+        REQUIRE( store.putUInt("u", 1) == 4 );
+        store.end();
+        REQUIRE( store.begin() );
+
+        nina_fake_reset_stats();
+        REQUIRE( store.getBytesLength("u") == 4 );
+        REQUIRE( store.getBytesLength("u") == 4 );
+        REQUIRE( store.exists("u") );
+        REQUIRE( nina_fake_stats().getType == 1 );
+        REQUIRE( nina_fake_stats().len == 1 );
+    }
+
+    SECTION( "missing keys are confirmed by the module" ) {
+        nina_fake_reset_stats();
+        REQUIRE( store.getBytesLength("missing") == 0 );
+        REQUIRE( nina_fake_stats().transactions == 1 );
+
+        REQUIRE_FALSE( store.exists("missing") );
+        REQUIRE( store.getUInt("missing") == 0 );
+        REQUIRE( nina_fake_stats().transactions == 3 );
+    }
+
+    SECTION( "removing a key looks up its chunks only if it may hold a manifest" ) {
+        REQUIRE( store.putUInt("u", 1) == 4 );
+
+        nina_fake_reset_stats();
+        REQUIRE( store.remove("u") == 1 );
+        REQUIRE( nina_fake_stats().transactions == 1 );
+
+        REQUIRE( store.putUInt("u", 1) == 4 );
+        store.end();
+        REQUIRE( store.begin() );
+
+        // a key missing from the index costs a single read
+        nina_fake_reset_stats();
+        REQUIRE( store.remove("u") == 1 );
+        REQUIRE( nina_fake_stats().transactions == 2 );
+    }
+
+    SECTION( "streamed values are removed with their chunks" ) {
+        uint8_t b[1000] = {};
+        {
+            auto w = store.openWriter("blob", sizeof(b));
+            REQUIRE( w.write(b, sizeof(b)) == sizeof(b) );
+            REQUIRE( w.close() );
+        }
+        // the manifest and 4 chunks
+        REQUIRE( WiFiDrv::prefStat() == 5 );
+
+        REQUIRE( store.putUInt("blob", 1) == 4 );
+        REQUIRE( WiFiDrv::prefStat() == 1 );
+    }
+
+    SECTION( "keys with the same hash are told apart" ) {
+        static_assert(kvstore_hash("gwzx", 4) == kvstore_hash("16cd", 4), "the keys collide");
+
+        REQUIRE( store.putUInt("gwzx", 1) == 4 );
+        REQUIRE_FALSE( store.exists("16cd") );
+        REQUIRE( store.putString("16cd", "pippo") == 6 );
+
+        nina_fake_reset_stats();
+        REQUIRE( store.getBytesLength("gwzx") == 4 );
+        REQUIRE( store.getBytesLength("16cd") == 5 );
+        REQUIRE( nina_fake_stats().transactions == 0 );
+
+        REQUIRE( store.remove("gwzx") == 1 );
+        char res[6];
+        REQUIRE( store.getString("16cd", res, sizeof(res)) == 6 );
+        REQUIRE( strcmp(res, "pippo") == 0 );
+    }
+
+    SECTION( "reads of unknown keys are not preceded by a lookup" ) {
+        REQUIRE( store.putUInt("u", 1) == 4 );
+        store.end();
+        REQUIRE( store.begin() );
+
+        nina_fake_reset_stats();
+        REQUIRE( store.getUInt("u") == 1 );
+        REQUIRE( nina_fake_stats().transactions == 1 );
+    }
+
+    store.end();
+}
+
+TEST_CASE( "NinaKVStore index is bounded", "[kvstore][nina]" ) {
+    nina_fake_format();
+
+    NinaKVStore store(DEFAULT_KVSTORE_NAME, 2);
+    REQUIRE( store.begin() );
+
+    REQUIRE( store.putUChar("a", 1) == 1 );
+    REQUIRE( store.putUChar("b", 2) == 1 );
+    REQUIRE( store.putUChar("c", 3) == 1 );
+
+    nina_fake_reset_stats();
+    REQUIRE( store.exists("a") );
+    REQUIRE( store.exists("b") );
+    REQUIRE( nina_fake_stats().transactions == 0 );
+
+    // keys beyond the capacity of the index are still served by the module
+    REQUIRE( store.exists("c") );
+    REQUIRE( store.getBytesLength("c") == 1 );
+    REQUIRE( store.getUChar("c") == 3 );
+    REQUIRE( nina_fake_stats().transactions > 0 );
+
+    store.end();
+}
+
+TEST_CASE( "NinaKVStore lazy init", "[kvstore][nina]" ) {
+    nina_fake_format();
+    nina_fake_reset_stats();
+
+    NinaKVStore store;
+    store.setLazyInit(true);
+    REQUIRE( store.begin() );
+    REQUIRE( nina_fake_stats().driverInits == 0 );
+    REQUIRE( nina_fake_stats().transactions == 0 );
+
+    SECTION( "the first access initializes the store" ) {
+        REQUIRE( store.putUChar("k", 1) == 1 );
+        REQUIRE( nina_fake_stats().driverInits == 1 );
+        REQUIRE( store.getUChar("k") == 1 );
+        REQUIRE( nina_fake_stats().driverInits == 1 );
+
+        const InitProfile& profile = store.getInitProfile();
+        REQUIRE( profile.size() == 3 );
+        REQUIRE( strcmp(profile[0].name, "driver") == 0 );
+        REQUIRE( strcmp(profile[1].name, "firmware") == 0 );
+        REQUIRE( strcmp(profile[2].name, "prefs") == 0 );
+    }
+
+    SECTION( "warmup initializes the store once" ) {
+        REQUIRE( store.warmup() );
+        REQUIRE( store.warmup() );
+        REQUIRE( nina_fake_stats().driverInits == 1 );
+    }
+
+    SECTION( "a store that was never accessed is not initialized by end" ) {
+        REQUIRE_FALSE( store.end() );
+        REQUIRE( nina_fake_stats().driverInits == 0 );
+        REQUIRE_FALSE( store.exists("k") );
+    }
+
+    store.end();
+}
@@ -0,0 +1,205 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <kvstore/implementation/portentac33.h>
+#include <kvstore/decorators/BloomKVStore.h>
+#include <kvstore/decorators/CachedKVStore.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include <mbed_fake.h>
+#include <nvs_fake.h>
+#include <cstring>
+#include <unistd.h>
+
+static const char PATH[] = "test_kvstore_range.log";
+
+static constexpr size_t BLOB_SIZE = 2048;
+
+static void rangeAccess(KVStoreInterface& store) {
+    uint8_t blob[BLOB_SIZE];
+    for(size_t i=0; i<sizeof(blob); i++) {
+        blob[i] = i * 7;
+    }
+    REQUIRE( store.putBytes("cfg", blob, sizeof(blob)) == sizeof(blob) );
+
+    SECTION( "a range of a value is read" ) {
+        uint8_t res[8];
+
+        REQUIRE( store.getBytes("cfg", 1000, res, 4) == 4 );
+        REQUIRE( memcmp(res, blob + 1000, 4) == 0 );
+
+        REQUIRE( store.getBytes("cfg", BLOB_SIZE - 3, res, sizeof(res)) == 3 );
+        REQUIRE( memcmp(res, blob + BLOB_SIZE - 3, 3) == 0 );
+
+        REQUIRE( store.getBytes("cfg", BLOB_SIZE, res, sizeof(res)) == 0 );
+        REQUIRE( store.getBytes("missing", 0, res, sizeof(res)) == 0 );
+    }
+
+    SECTION( "a range of a value is overwritten" ) {
+        const uint8_t patch[] = { 0xDE, 0xAD, 0xBE, 0xEF };
+
+        REQUIRE( store.patchBytes("cfg", 10, patch, sizeof(patch)) == sizeof(patch) );
+        memcpy(blob + 10, patch, sizeof(patch));
+
+        REQUIRE( store.patchBytes("cfg", BLOB_SIZE - 1, patch, 1) == 1 );
+        blob[BLOB_SIZE - 1] = patch[0];
+
+        uint8_t res[BLOB_SIZE];
+        REQUIRE( store.getBytesLength("cfg") == BLOB_SIZE );
+        REQUIRE( store.getBytes("cfg", res, sizeof(res)) == BLOB_SIZE );
+        REQUIRE( memcmp(res, blob, sizeof(blob)) == 0 );
+    }
+
+    SECTION( "a patch cannot extend a value or create a key" ) {
+        const uint8_t patch[] = { 1, 2 };
+
+        REQUIRE( store.patchBytes("cfg", BLOB_SIZE - 1, patch, sizeof(patch)) == 0 );
+        REQUIRE( store.patchBytes("missing", 0, patch, sizeof(patch)) == 0 );
+        REQUIRE_FALSE( store.exists("missing") );
+
+        uint8_t res[BLOB_SIZE];
+        REQUIRE( store.getBytes("cfg", res, sizeof(res)) == BLOB_SIZE );
+        REQUIRE( memcmp(res, blob, sizeof(blob)) == 0 );
+    }
+}
+
+TEST_CASE( "Ranges of values are read and patched", "[kvstore][range]" ) {
+    SECTION( "FlashKVStore" ) {
+        FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+
+        rangeAccess(store);
+    }
+
+    SECTION( "FileKVStore" ) {
+        ::unlink(PATH);
+        FileKVStore store(PATH);
+        REQUIRE( store.begin() );
+
+        rangeAccess(store);
+
+        store.end();
+        ::unlink(PATH);
+    }
+
+    SECTION( "STM32H7KVStore" ) {
+        mbed_fake_format();
+        STM32H7KVStore store;
+        REQUIRE( store.begin() );
+
+        rangeAccess(store);
+    }
+
+    SECTION( "PortentaC33KVStore" ) {
+        mbed_fake_format();
+        PortentaC33KVStore store;
+        REQUIRE( store.begin() );
+
+        rangeAccess(store);
+    }
+
+    SECTION( "default implementation" ) {
+        nvs_fake_format();
+        ESP32KVStore store;
+        REQUIRE( store.begin() );
+
+        rangeAccess(store);
+    }
+
+    SECTION( "BloomKVStore" ) {
+        mbed_fake_format();
+        STM32H7KVStore inner;
+        BloomKVStore store(inner);
+        REQUIRE( store.begin() );
+
+        rangeAccess(store);
+    }
+}
+
+TEST_CASE( "The default implementation patches only blobs", "[kvstore][range]" ) {
+    ::unlink(PATH);
+    FileKVStore store(PATH);
+    REQUIRE( store.begin() );
+
+    SECTION( "numbers and strings keep their type" ) {
+        REQUIRE( store.putUInt("n", 0x55555555) == 4 );
+        REQUIRE( store.putString("name", "pippo") == 5 );
+
+        REQUIRE( store.patchBytes("n", 0, (const uint8_t*)"\x01", 1) == 0 );
+        REQUIRE( store.patchBytes("name", 0, (const uint8_t*)"P", 1) == 0 );
+
+        char res[6];
+        REQUIRE( store.getUInt("n") == 0x55555555 );
+        REQUIRE( store.getString("name", res, sizeof(res)) == 5 );
+        REQUIRE( strcmp(res, "pippo") == 0 );
+    }
+
+    SECTION( "CachedKVStore patches pending values in place" ) {
+        CachedKVStore cache(store);
+        REQUIRE( cache.putUInt("n", 0x55555555) == 4 );
+        REQUIRE( cache.patchBytes("n", 0, (const uint8_t*)"\x01", 1) == 1 );
+        REQUIRE( cache.flush() );
+
+        REQUIRE( store.getUInt("n") == 0x55555501 );
+    }
+
+    store.end();
+    ::unlink(PATH);
+}
+
+TEST_CASE( "FlashKVStore patches values without reading them in RAM", "[kvstore][range][flash]" ) {
+    FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+    FlashKVStore store(flash);
+    REQUIRE( store.begin() );
+
+    SECTION( "the type of the value is kept" ) {
+        REQUIRE( store.putString("name", "pippo") == 5 );
+        REQUIRE( store.patchBytes("name", 0, (const uint8_t*)"P", 1) == 1 );
+
+        char res[6];
+        REQUIRE( store.getString("name", res, sizeof(res)) == 5 );
+        REQUIRE( strcmp(res, "Pippo") == 0 );
+    }
+
+    SECTION( "a patched value survives a restart" ) {
+        uint8_t blob[BLOB_SIZE] = {};
+        REQUIRE( store.putBytes("cfg", blob, sizeof(blob)) == sizeof(blob) );
+        REQUIRE( store.patchBytes("cfg", 1500, (const uint8_t*)"\x01\x02", 2) == 2 );
+        REQUIRE( store.end() );
+
+        FlashKVStore restarted(flash);
+        REQUIRE( restarted.begin() );
+
+        uint8_t res[4];
+        REQUIRE( restarted.getBytes("cfg", 1499, res, sizeof(res)) == sizeof(res) );
+        REQUIRE( res[0] == 0 );
+        REQUIRE( res[1] == 1 );
+        REQUIRE( res[2] == 2 );
+        REQUIRE( res[3] == 0 );
+    }
+
+    SECTION( "values cannot be patched while a writer is open" ) {
+        REQUIRE( store.putUInt("n", 1) == 4 );
+        auto w = store.openWriter("blob", 4);
+
+        REQUIRE( store.patchBytes("n", 0, (const uint8_t*)"\x02", 1) == 0 );
+        w.abort();
+
+        REQUIRE( store.patchBytes("n", 0, (const uint8_t*)"\x02", 1) == 1 );
+        REQUIRE( store.getUInt("n") == 2 );
+    }
+}
@@ -0,0 +1,149 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/decorators/ReadCacheKVStore.h>
+#include "../mock/MockKVStore.h"
+
+TEST_CASE( "ReadCacheKVStore serves repeated reads from RAM", "[kvstore][readcache]" ) {
+    MockKVStore backend;
+    ReadCacheKVStore store(backend);
+    store.begin();
+
+    backend.putUInt("calibration", 0x55555555);
+    backend.resetStats();
+
+    SECTION( "typed values are read once from the backend" ) {
+        REQUIRE( store.getUInt("calibration") == 0x55555555 );
+        REQUIRE( backend.stats.getBytes == 1 );
+        backend.resetStats();
+
+        for(int i=0; i<100; i++) {
+            REQUIRE( store.getUInt("calibration") == 0x55555555 );
+        }
+
+        REQUIRE( backend.stats.getBytes == 0 );
+        REQUIRE( backend.stats.exists == 0 );
+        REQUIRE( store.getStats().hits >= 100 );
+    }
+
+    SECTION( "byte arrays are read once from the backend" ) {
+        uint8_t blob[] = { 0x01, 0x02, 0x03 };
+        uint8_t res[3] = {};
+        store.putBytes("blob", blob, sizeof(blob));
+
+        REQUIRE( store.getBytes("blob", res, sizeof(res)) == 3 );
+        REQUIRE( store.getBytes("blob", res, sizeof(res)) == 3 );
+        REQUIRE( memcmp(blob, res, sizeof(blob)) == 0 );
+        REQUIRE( backend.stats.getBytes == 1 );
+        REQUIRE( store.getBytesLength("blob") == 3 );
+        REQUIRE( backend.stats.getBytesLength == 0 );
+    }
+
+    SECTION( "missing keys are remembered" ) {
+        for(int i=0; i<100; i++) {
+            REQUIRE_FALSE( store.exists("feature") );
+        }
+
+        REQUIRE( backend.stats.exists == 1 );
+        REQUIRE( store.getUInt("feature", 7) == 7 );
+        REQUIRE( backend.stats.getBytes == 0 );
+    }
+
+    SECTION( "writes invalidate cached values" ) {
+        REQUIRE_FALSE( store.exists("feature") );
+        REQUIRE( store.getUInt("calibration") == 0x55555555 );
+
+        store.putUInt("calibration", 0x56565656);
+        store.putBool("feature", true);
+
+        REQUIRE( store.getUInt("calibration") == 0x56565656 );
+        REQUIRE( store.exists("feature") );
+
+        REQUIRE( store.remove("calibration") == 1 );
+        REQUIRE_FALSE( store.exists("calibration") );
+    }
+
+    SECTION( "a key read with different types is cached once" ) {
+        char str[16];
+        uint8_t blob[16];
+        store.putString("k", "old");
+
+        REQUIRE( store.getBytes("k", blob, sizeof(blob)) == 3 );
+        REQUIRE( store.getString("k", str, sizeof(str)) > 0 );
+        REQUIRE( store.putString("k", "new") == 3 );
+
+        REQUIRE( store.getBytes("k", blob, sizeof(blob)) == 3 );
+        REQUIRE( memcmp(blob, "new", 3) == 0 );
+    }
+
+    SECTION( "truncated strings are not cached" ) {
+        char str[100];
+        store.putString("p", "pippo");
+
+        REQUIRE( store.getString("p", str, 5) > 0 );
+        REQUIRE( strcmp(str, "pipp") == 0 );
+        REQUIRE( store.getString("p", str, sizeof(str)) > 0 );
+        REQUIRE( strcmp(str, "pippo") == 0 );
+    }
+}
+
+TEST_CASE( "ReadCacheKVStore evicts least recently used values", "[kvstore][readcache]" ) {
+    MockKVStore backend;
+    ReadCacheKVStore store(backend, 256);
+    char key[8];
+
+    for(int i=0; i<20; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        backend.putUInt(key, i);
+    }
+    backend.resetStats();
+
+    for(int i=0; i<20; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        REQUIRE( store.getUInt(key) == (uint32_t)i );
+        REQUIRE( store.cachedBytes() <= 256 );
+
+        // k0 is kept hot
+        REQUIRE( store.getUInt("k0") == 0 );
+    }
+
+    REQUIRE( store.getStats().evictions > 0 );
+    REQUIRE( backend.stats.getBytes == 20 );
+
+    backend.resetStats();
+    REQUIRE( store.getUInt("k0") == 0 );
+    REQUIRE( store.getUInt("k19") == 19 );
+    REQUIRE( backend.stats.getBytes == 0 );
+    REQUIRE( store.getUInt("k1") == 1 );
+    REQUIRE( backend.stats.getBytes == 1 );
+}
+
+TEST_CASE( "ReadCacheKVStore provides direct access to cached values", "[kvstore][readcache][view]" ) {
+    MockKVStore backend;
+    ReadCacheKVStore store(backend);
+    const uint8_t* ptrs[2] = {};
+
+    backend.putString("url", "https://arduino.cc");
+    backend.resetStats();
+
+    for(int i=0; i<2; i++) {
+        REQUIRE( store.view("url", [](const uint8_t value[], size_t len, void* ctx) {
+            REQUIRE( memcmp(value, "https://arduino.cc", len) == 0 );
+            *(const uint8_t**)ctx = value;
+        }, &ptrs[i], KVStoreInterface::PT_STR) == 18 );
+    }
+
+    REQUIRE( backend.stats.getBytes == 1 );
+    REQUIRE( ptrs[0] != ptrs[1] ); // the second access points to the cache
+    REQUIRE( store.getStats().hits == 1 );
+}
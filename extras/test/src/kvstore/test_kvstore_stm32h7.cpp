@@ -0,0 +1,74 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <mbed_fake.h>
+
+TEST_CASE( "STM32H7KVStore stores values in a TDBStore", "[kvstore][stm32h7]" ) {
+    mbed_fake_format();
+
+    STM32H7KVStore store;
+    REQUIRE( store.begin() );
+    REQUIRE_FALSE( store.begin() );
+
+    REQUIRE( store.putUInt("1", 0x55555555) == 4 );
+    REQUIRE( store.getUInt("1") == 0x55555555 );
+    REQUIRE( store.getBytesLength("1") == 4 );
+    REQUIRE( store.exists("1") );
+    REQUIRE( store.remove("1") == 1 );
+    REQUIRE_FALSE( store.exists("1") );
+
+    REQUIRE( store.getInitProfile().size() == 3 );
+    REQUIRE( strcmp(store.getInitProfile()[0].name, "qspi") == 0 );
+    REQUIRE( strcmp(store.getInitProfile()[2].name, "tdbstore") == 0 );
+
+    REQUIRE( store.end() );
+    REQUIRE_FALSE( store.end() );
+}
+
+TEST_CASE( "STM32H7KVStore lazy init", "[kvstore][stm32h7]" ) {
+    mbed_fake_format();
+    mbed_fake_reset_stats();
+
+    STM32H7KVStore store;
+    store.setLazyInit(true);
+    REQUIRE( store.begin() );
+    REQUIRE( mbed_fake_stats().tdbInits == 0 );
+    REQUIRE( store.getInitProfile().size() == 0 );
+
+    SECTION( "the first access initializes the store" ) {
+        REQUIRE_FALSE( store.exists("k") );
+        REQUIRE( mbed_fake_stats().qspiInits == 1 );
+        REQUIRE( mbed_fake_stats().mbrInits == 1 );
+        REQUIRE( mbed_fake_stats().tdbInits == 1 );
+
+        REQUIRE( store.putUChar("k", 1) == 1 );
+        REQUIRE( store.getUChar("k") == 1 );
+        REQUIRE( mbed_fake_stats().tdbInits == 1 );
+        REQUIRE( store.getInitProfile().size() == 3 );
+    }
+
+    SECTION( "warmup initializes the store once" ) {
+        REQUIRE( store.warmup() );
+        REQUIRE( store.warmup() );
+        REQUIRE( mbed_fake_stats().tdbInits == 1 );
+    }
+
+    SECTION( "a store that was never accessed is not initialized by end" ) {
+        REQUIRE( store.end() );
+        REQUIRE( mbed_fake_stats().tdbInits == 0 );
+        REQUIRE_FALSE( store.warmup() );
+    }
+
+    store.end();
+}
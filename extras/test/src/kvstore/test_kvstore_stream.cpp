@@ -0,0 +1,464 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <kvstore/implementation/portentac33.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include <kvstore/decorators/CachedKVStore.h>
+#include <kvstore/decorators/ReadCacheKVStore.h>
+#include <kvstore/decorators/BloomKVStore.h>
+#include <mbed_fake.h>
+#include <nvs_fake.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char PATH[] = "test_kvstore_stream.log";
+
+// 128 blocks of 4KB, each area is 256KB
+static constexpr FlashSimulator::Config LARGE = { 128 * 4096, 4096, 4, 0, 0, 0 };
+
+static constexpr size_t VALUE_SIZE = 64 * 1024;
+
+// name of a chunk written by the chunked fallback
+static std::string chunk(const char* key, char generation, unsigned index) {
+    char name[16];
+    snprintf(name, sizeof(name), "#%08x%c%x", (unsigned)kvstore_hash(key, strlen(key)), generation, index);
+    return name;
+}
+
+static uint8_t pattern(size_t i, uint8_t seed) {
+    return (uint8_t)(i * 31 + (i >> 8) + seed);
+}
+
+static bool writeValue(KVStoreInterface& store, const char* key, size_t total, size_t chunk, uint8_t seed) {
+    auto w = store.openWriter(key, total);
+    std::vector<uint8_t> buf(chunk);
+
+    for(size_t done=0; done < total && w.isOpen();) {
+        size_t n = total - done < chunk ? total - done : chunk;
+        for(size_t i=0; i<n; i++) {
+            buf[i] = pattern(done + i, seed);
+        }
+
+        if(w.write(buf.data(), n) != n) {
+            return false;
+        }
+        done += n;
+    }
+
+    return w.close();
+}
+
+static bool checkValue(KVStoreInterface& store, const char* key, size_t total, size_t chunk, uint8_t seed) {
+    auto r = store.openReader(key);
+    std::vector<uint8_t> buf(chunk);
+
+    if(!r.isOpen() || r.size() != total) {
+        return false;
+    }
+
+    for(size_t done=0; done < total;) {
+        size_t n = r.read(buf.data(), chunk);
+        if(n == 0) {
+            return false;
+        }
+
+        for(size_t i=0; i<n; i++) {
+            if(buf[i] != pattern(done + i, seed)) {
+                return false;
+            }
+        }
+        done += n;
+    }
+
+    return r.read(buf.data(), chunk) == 0 && r.available() == 0;
+}
+
+static void streamValues(KVStoreInterface& store) {
+    REQUIRE( writeValue(store, "blob", VALUE_SIZE, 1000, 1) );
+
+    SECTION( "a value is read back in chunks of any size" ) {
+        REQUIRE( checkValue(store, "blob", VALUE_SIZE, 777, 1) );
+        REQUIRE( checkValue(store, "blob", VALUE_SIZE, 4096, 1) );
+    }
+
+    SECTION( "a reader can seek" ) {
+        auto r = store.openReader("blob");
+        uint8_t b[3];
+
+        REQUIRE( r.seek(VALUE_SIZE - 2) );
+        REQUIRE( r.read(b, sizeof(b)) == 2 );
+        REQUIRE( b[0] == pattern(VALUE_SIZE - 2, 1) );
+        REQUIRE( b[1] == pattern(VALUE_SIZE - 1, 1) );
+
+        REQUIRE( r.seek(300) );
+        REQUIRE( r.read(b, 1) == 1 );
+        REQUIRE( b[0] == pattern(300, 1) );
+
+        REQUIRE_FALSE( r.seek(VALUE_SIZE + 1) );
+    }
+
+    SECTION( "a new value replaces the previous one" ) {
+        REQUIRE( writeValue(store, "blob", VALUE_SIZE / 2, 333, 2) );
+        REQUIRE( checkValue(store, "blob", VALUE_SIZE / 2, 1024, 2) );
+
+        REQUIRE( writeValue(store, "blob", 10, 10, 3) );
+        REQUIRE( checkValue(store, "blob", 10, 10, 3) );
+    }
+
+    SECTION( "an aborted writer leaves the previous value untouched" ) {
+        auto w = store.openWriter("blob", VALUE_SIZE);
+        uint8_t b[100] = {};
+
+        REQUIRE( w.write(b, sizeof(b)) == sizeof(b) );
+        w.abort();
+        REQUIRE_FALSE( w.isOpen() );
+        REQUIRE_FALSE( w.close() );
+
+        REQUIRE( checkValue(store, "blob", VALUE_SIZE, 1000, 1) );
+    }
+
+    SECTION( "a writer destroyed without being closed is aborted" ) {
+        {
+            auto w = store.openWriter("blob", 200);
+            uint8_t b[200] = {};
+            REQUIRE( w.write(b, sizeof(b)) == sizeof(b) );
+        }
+
+        REQUIRE( checkValue(store, "blob", VALUE_SIZE, 1000, 1) );
+    }
+
+    SECTION( "closing a writer before all the data was written fails" ) {
+        auto w = store.openWriter("blob", 100);
+        uint8_t b[50] = {};
+
+        REQUIRE( w.write(b, sizeof(b)) == sizeof(b) );
+        REQUIRE_FALSE( w.close() );
+
+        REQUIRE( checkValue(store, "blob", VALUE_SIZE, 1000, 1) );
+    }
+
+    SECTION( "data beyond the size of the value is not written" ) {
+        auto w = store.openWriter("other", 4);
+        uint8_t b[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+        REQUIRE( w.write(b, sizeof(b)) == 4 );
+        REQUIRE( w.write(b, sizeof(b)) == 0 );
+        REQUIRE( w.written() == 4 );
+        REQUIRE( w.close() );
+
+        auto r = store.openReader("other");
+        uint8_t res[8];
+        REQUIRE( r.read(res, sizeof(res)) == 4 );
+        REQUIRE( memcmp(res, b, 4) == 0 );
+    }
+
+    SECTION( "values stored with putBytes can be read" ) {
+        uint8_t b[600];
+        for(size_t i=0; i<sizeof(b); i++) {
+            b[i] = pattern(i, 4);
+        }
+
+        REQUIRE( store.putBytes("bytes", b, sizeof(b)) == sizeof(b) );
+        REQUIRE( checkValue(store, "bytes", sizeof(b), 100, 4) );
+    }
+
+    SECTION( "missing keys cannot be read" ) {
+        REQUIRE_FALSE( store.openReader("missing").isOpen() );
+    }
+}
+
+TEST_CASE( "Writer and Reader stream values that do not fit in RAM", "[kvstore][stream]" ) {
+    SECTION( "FlashKVStore" ) {
+        FlashSimulator flash(LARGE);
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+
+        streamValues(store);
+    }
+
+    SECTION( "FileKVStore" ) {
+        ::unlink(PATH);
+        FileKVStore store(PATH);
+        REQUIRE( store.begin() );
+
+        streamValues(store);
+
+        store.end();
+        ::unlink(PATH);
+    }
+
+    SECTION( "STM32H7KVStore" ) {
+        mbed_fake_format();
+        STM32H7KVStore store;
+        REQUIRE( store.begin() );
+
+        streamValues(store);
+    }
+
+    SECTION( "PortentaC33KVStore" ) {
+        mbed_fake_format();
+        PortentaC33KVStore store;
+        REQUIRE( store.begin() );
+
+        streamValues(store);
+    }
+
+    SECTION( "decorators stream natively on the underlying store" ) {
+        FlashSimulator flash(LARGE);
+        FlashKVStore backend(flash);
+
+        // the decorators begin the underlying store
+        SECTION( "CachedKVStore" ) {
+            CachedKVStore store(backend);
+            REQUIRE( store.begin() );
+            streamValues(store);
+        }
+
+        SECTION( "ReadCacheKVStore" ) {
+            ReadCacheKVStore store(backend);
+            REQUIRE( store.begin() );
+            streamValues(store);
+        }
+
+        SECTION( "BloomKVStore" ) {
+            BloomKVStore store(backend);
+            REQUIRE( store.begin() );
+            streamValues(store);
+        }
+
+        REQUIRE( backend.forEach("#", [](const char*, KVStoreInterface::Type, size_t, void*) {
+            FAIL( "a chunk was written" );
+            return false;
+        }) );
+    }
+
+    SECTION( "chunked fallback" ) {
+        nvs_fake_format();
+        ESP32KVStore store;
+        REQUIRE( store.begin() );
+
+        streamValues(store);
+    }
+}
+
+TEST_CASE( "FlashKVStore writes streamed values in place", "[kvstore][stream][flash]" ) {
+    FlashSimulator flash(LARGE);
+    FlashKVStore store(flash);
+    REQUIRE( store.begin() );
+    REQUIRE( store.putUInt("n", 1) == 4 );
+
+    SECTION( "other writes are rejected while a writer is open" ) {
+        auto w = store.openWriter("blob", 16);
+
+        REQUIRE( w.isOpen() );
+        REQUIRE_FALSE( store.openWriter("other", 16).isOpen() );
+        REQUIRE( store.putUInt("n", 2) == 0 );
+        REQUIRE( store.remove("n") == 0 );
+        REQUIRE_FALSE( store.gc() );
+
+        uint8_t b[16] = {};
+        REQUIRE( w.write(b, sizeof(b)) == sizeof(b) );
+        REQUIRE( w.close() );
+
+        REQUIRE( store.putUInt("n", 2) == 4 );
+        REQUIRE( store.getUInt("n") == 2 );
+    }
+
+    SECTION( "streamed values survive a restart and garbage collection" ) {
+        REQUIRE( writeValue(store, "blob", VALUE_SIZE, 512, 1) );
+        REQUIRE( store.end() );
+
+        FlashKVStore restarted(flash);
+        REQUIRE( restarted.begin() );
+        REQUIRE( checkValue(restarted, "blob", VALUE_SIZE, 1000, 1) );
+
+        REQUIRE( restarted.gc() );
+        REQUIRE( checkValue(restarted, "blob", VALUE_SIZE, 1000, 1) );
+        REQUIRE( restarted.getUInt("n") == 1 );
+    }
+
+    SECTION( "a value interrupted by a power cut is discarded" ) {
+        REQUIRE( writeValue(store, "blob", 1000, 100, 1) );
+
+        auto w = store.openWriter("blob", VALUE_SIZE);
+        std::vector<uint8_t> b(VALUE_SIZE / 2);
+        REQUIRE( w.write(b.data(), b.size()) == b.size() );
+
+        // the store is not ended, like on a reset
+        FlashKVStore restarted(flash);
+        REQUIRE( restarted.begin() );
+        REQUIRE( checkValue(restarted, "blob", 1000, 100, 1) );
+        REQUIRE( restarted.putUInt("n", 3) == 4 );
+        REQUIRE( restarted.getUInt("n") == 3 );
+    }
+
+    SECTION( "an aborted writer does not leave chunks behind" ) {
+        auto w = store.openWriter("blob", 10000);
+        std::vector<uint8_t> b(5000);
+        REQUIRE( w.write(b.data(), b.size()) == b.size() );
+        w.abort();
+
+        REQUIRE_FALSE( store.exists("blob") );
+        REQUIRE_FALSE( store.exists(chunk("blob", 'a', 0).c_str()) );
+        REQUIRE( store.putUInt("n", 2) == 4 );
+        REQUIRE( store.getUInt("n") == 2 );
+    }
+}
+
+TEST_CASE( "FileKVStore writes streamed values in place", "[kvstore][stream][file]" ) {
+    ::unlink(PATH);
+    FileKVStore store(PATH);
+    REQUIRE( store.begin() );
+    REQUIRE( store.putUInt("n", 1) == 4 );
+
+    SECTION( "other writes are rejected while a writer is open" ) {
+        auto w = store.openWriter("blob", 16);
+
+        REQUIRE( w.isOpen() );
+        REQUIRE_FALSE( store.openWriter("other", 16).isOpen() );
+        REQUIRE( store.putUInt("n", 2) == 0 );
+        REQUIRE_FALSE( store.compact() );
+        REQUIRE_FALSE( store.clear() );
+
+        uint8_t b[16] = {};
+        REQUIRE( w.write(b, sizeof(b)) == sizeof(b) );
+        REQUIRE( w.close() );
+
+        REQUIRE( store.putUInt("n", 2) == 4 );
+        REQUIRE( store.getUInt("n") == 2 );
+    }
+
+    SECTION( "streamed values survive a restart and compaction" ) {
+        REQUIRE( writeValue(store, "blob", VALUE_SIZE, 512, 1) );
+        REQUIRE( writeValue(store, "blob", VALUE_SIZE, 512, 2) );
+        REQUIRE( store.end() );
+
+        REQUIRE( store.begin() );
+        REQUIRE( checkValue(store, "blob", VALUE_SIZE, 1000, 2) );
+
+        REQUIRE( store.compact() );
+        REQUIRE( store.fileSize() < VALUE_SIZE + 100 );
+        REQUIRE( checkValue(store, "blob", VALUE_SIZE, 1000, 2) );
+    }
+
+    SECTION( "a value that was not closed is discarded" ) {
+        auto w = store.openWriter("blob", VALUE_SIZE);
+        std::vector<uint8_t> b(VALUE_SIZE / 2);
+        REQUIRE( w.write(b.data(), b.size()) == b.size() );
+
+        // the writer is left open, like on a crash
+        FileKVStore restarted(PATH);
+        REQUIRE( restarted.begin() );
+        REQUIRE_FALSE( restarted.exists("blob") );
+        REQUIRE( restarted.getUInt("n") == 1 );
+    }
+
+    store.end();
+    ::unlink(PATH);
+}
+
+TEST_CASE( "The chunked fallback stores chunks under derived keys", "[kvstore][stream][esp32]" ) {
+    nvs_fake_format();
+    ESP32KVStore store;
+    REQUIRE( store.begin() );
+
+    REQUIRE( writeValue(store, "blob", 1000, 100, 1) );
+    REQUIRE( store.getBytesLength(chunk("blob", 'a', 0).c_str()) == KVStoreInterface::STREAM_CHUNK_SIZE );
+    REQUIRE( store.getBytesLength(chunk("blob", 'a', 3).c_str()) == 1000 - 3 * KVStoreInterface::STREAM_CHUNK_SIZE );
+    REQUIRE_FALSE( store.exists(chunk("blob", 'a', 4).c_str()) );
+
+    SECTION( "replacing a value removes the chunks of the previous one" ) {
+        REQUIRE( writeValue(store, "blob", 300, 100, 2) );
+        REQUIRE( store.exists(chunk("blob", 'b', 0).c_str()) );
+        REQUIRE( store.exists(chunk("blob", 'b', 1).c_str()) );
+        REQUIRE_FALSE( store.exists(chunk("blob", 'a', 0).c_str()) );
+        REQUIRE_FALSE( store.exists(chunk("blob", 'a', 3).c_str()) );
+    }
+
+    SECTION( "aborting a writer removes the chunks it wrote" ) {
+        auto w = store.openWriter("blob", 1000);
+        uint8_t b[600] = {};
+        REQUIRE( w.write(b, sizeof(b)) == sizeof(b) );
+        REQUIRE( store.exists(chunk("blob", 'b', 1).c_str()) );
+        w.abort();
+
+        REQUIRE_FALSE( store.exists(chunk("blob", 'b', 0).c_str()) );
+        REQUIRE_FALSE( store.exists(chunk("blob", 'b', 1).c_str()) );
+        REQUIRE( checkValue(store, "blob", 1000, 100, 1) );
+    }
+
+    SECTION( "chunk names fit the keys of ESP32" ) {
+        static const char KEY[] = "fifteen.chars.k";
+        static_assert(sizeof(KEY) - 1 == 15, "the longest key of ESP32");
+
+        REQUIRE( writeValue(store, KEY, 1000, 100, 3) );
+        REQUIRE( checkValue(store, KEY, 1000, 100, 3) );
+        REQUIRE( store.getBytesLength(chunk(KEY, 'a', 3).c_str()) == 1000 - 3 * KVStoreInterface::STREAM_CHUNK_SIZE );
+    }
+
+    SECTION( "removing a value removes its chunks" ) {
+        REQUIRE( store.remove("blob") == 1 );
+        REQUIRE_FALSE( store.exists(chunk("blob", 'a', 0).c_str()) );
+        REQUIRE_FALSE( store.exists(chunk("blob", 'a', 3).c_str()) );
+
+        REQUIRE( writeValue(store, "blob", 1000, 100, 1) );
+        KVStoreInterface::key_t keys[] = { "blob" };
+        REQUIRE( store.removeMany(keys, 1) == 1 );
+        REQUIRE_FALSE( store.exists(chunk("blob", 'a', 0).c_str()) );
+    }
+
+    SECTION( "replacing a value with a put removes its chunks" ) {
+        REQUIRE( store.putUInt("blob", 1) == 4 );
+        REQUIRE_FALSE( store.exists(chunk("blob", 'a', 0).c_str()) );
+        REQUIRE_FALSE( store.exists(chunk("blob", 'a', 3).c_str()) );
+
+        REQUIRE( writeValue(store, "blob", 1000, 100, 1) );
+        uint8_t b[3] = {};
+        REQUIRE( store.putBytes("blob", b, sizeof(b)) == sizeof(b) );
+        REQUIRE_FALSE( store.exists(chunk("blob", 'a', 0).c_str()) );
+    }
+
+    SECTION( "values of keys with the same hash do not share chunks" ) {
+        static_assert(kvstore_hash("gwzx", 4) == kvstore_hash("16cd", 4), "the keys collide");
+
+        REQUIRE( writeValue(store, "gwzx", 1000, 100, 4) );
+        REQUIRE( writeValue(store, "16cd", 600, 100, 5) );
+        REQUIRE( checkValue(store, "gwzx", 1000, 100, 4) );
+        REQUIRE( checkValue(store, "16cd", 600, 100, 5) );
+
+        REQUIRE( writeValue(store, "gwzx", 700, 100, 6) );
+        REQUIRE( checkValue(store, "16cd", 600, 100, 5) );
+
+        REQUIRE( store.remove("gwzx") == 1 );
+        REQUIRE( checkValue(store, "16cd", 600, 100, 5) );
+    }
+
+    SECTION( "chunks are not enumerated" ) {
+        size_t count = 0;
+        REQUIRE( store.putUInt("n", 1) == 4 );
+
+        REQUIRE( store.forEach("", [](const char* key, KVStoreInterface::Type, size_t, void* ctx) {
+            REQUIRE( key[0] != '#' );
+            (*(size_t*)ctx)++;
+            return true;
+        }, &count) );
+        REQUIRE( count == 2 );
+    }
+}
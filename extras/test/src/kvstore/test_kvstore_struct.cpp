@@ -0,0 +1,209 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include "../mock/MockKVStore.h"
+#include <mbed_fake.h>
+#include <nvs_fake.h>
+#include <cstring>
+#include <unistd.h>
+
+static const char PATH[] = "test_kvstore_struct.log";
+
+enum class Mode: uint8_t { OFF, STATION, ACCESS_POINT };
+
+// the same configuration as laid out by two releases of a firmware
+struct ConfigV1 {
+    uint16_t port;
+    uint8_t retries;
+    Mode mode;
+};
+
+struct ConfigV2 {
+    uint32_t port;
+    uint8_t retries;
+    Mode mode;
+    uint16_t timeout;   // added by version 2
+};
+
+struct Unversioned {
+    uint32_t a;
+    uint32_t b;
+};
+
+template<>
+struct KVSchema<ConfigV1> {
+    static constexpr uint16_t version = 1;
+
+    // a newer firmware stored version 2, it is downgraded
+    static bool migrate(uint16_t from, const uint8_t data[], size_t len, ConfigV1& out) {
+        ConfigV2 v2;
+        if(from != 2 || len != sizeof(v2)) {
+            return false;
+        }
+
+        memcpy(&v2, data, sizeof(v2));
+        out.port = v2.port;
+        out.retries = v2.retries;
+        out.mode = v2.mode;
+
+        return true;
+    }
+};
+
+template<>
+struct KVSchema<ConfigV2> {
+    static constexpr uint16_t version = 2;
+
+    static bool migrate(uint16_t from, const uint8_t data[], size_t len, ConfigV2& out) {
+        ConfigV1 v1;
+        if(from != 1 || len != sizeof(v1)) {
+            return false;
+        }
+
+        memcpy(&v1, data, sizeof(v1));
+        out.port = v1.port;
+        out.retries = v1.retries;
+        out.mode = v1.mode;
+
+        return true;
+    }
+};
+
+static_assert(KVStoreInterface::getType(ConfigV1()) == KVStoreInterface::PT_BLOB, "structs are stored as blobs");
+static_assert(KVStoreInterface::getType(Mode::OFF) == KVStoreInterface::PT_BLOB, "enums are stored as blobs");
+
+static void structs(KVStoreInterface& store) {
+    SECTION( "structs and enums are stored in a single record" ) {
+        ConfigV2 config = { 8883, 3, Mode::STATION, 500 };
+
+        REQUIRE( store.put("cfg", config) == sizeof(config) );
+        REQUIRE( store.getBytesLength("cfg") == sizeof(KVSchemaHeader) + sizeof(config) );
+        REQUIRE( store.put("mode", Mode::ACCESS_POINT) == sizeof(Mode) );
+
+        ConfigV2 res = store.get<ConfigV2>("cfg");
+        REQUIRE( memcmp(&res, &config, sizeof(config)) == 0 );
+        REQUIRE( store.get<Mode>("mode") == Mode::ACCESS_POINT );
+    }
+
+    SECTION( "the default value is returned for missing keys" ) {
+        ConfigV2 def = { 1883, 1, Mode::OFF, 100 };
+        ConfigV2 res = store.get("missing", def);
+
+        REQUIRE( res.port == 1883 );
+        REQUIRE( store.tryGet("missing", res) == 0 );
+    }
+
+    SECTION( "values written by an older layout are migrated" ) {
+        ConfigV1 old = { 1883, 5, Mode::STATION };
+        REQUIRE( store.put("cfg", old) == sizeof(old) );
+
+        ConfigV2 def = { 0, 0, Mode::OFF, 250 };
+        ConfigV2 res = store.get("cfg", def);
+
+        REQUIRE( res.port == 1883 );
+        REQUIRE( res.retries == 5 );
+        REQUIRE( res.mode == Mode::STATION );
+        REQUIRE( res.timeout == 250 );
+
+        // the migrated value is stored with the current layout by the next put
+        REQUIRE( store.put("cfg", res) == sizeof(res) );
+        REQUIRE( store.getBytesLength("cfg") == sizeof(KVSchemaHeader) + sizeof(res) );
+    }
+
+    SECTION( "values written by a newer layout are migrated" ) {
+        ConfigV2 config = { 8883, 3, Mode::ACCESS_POINT, 500 };
+        REQUIRE( store.put("cfg", config) == sizeof(config) );
+
+        ConfigV1 res = store.get<ConfigV1>("cfg");
+        REQUIRE( res.port == 8883 );
+        REQUIRE( res.retries == 3 );
+        REQUIRE( res.mode == Mode::ACCESS_POINT );
+    }
+
+    SECTION( "values that cannot be migrated are ignored" ) {
+        ConfigV1 old = { 1883, 5, Mode::STATION };
+        REQUIRE( store.put("cfg", old) == sizeof(old) );
+
+        Unversioned def = { 1, 2 };
+        Unversioned res = store.get("cfg", def);
+        REQUIRE( res.a == 1 );
+        REQUIRE( res.b == 2 );
+
+        REQUIRE( store.putUInt("raw", 7) == 4 );
+        REQUIRE( store.tryGet("raw", res) == 0 );
+    }
+}
+
+TEST_CASE( "Structs are stored with their schema", "[kvstore][struct]" ) {
+    SECTION( "MockKVStore" ) {
+        MockKVStore store;
+        REQUIRE( store.begin() );
+
+        structs(store);
+    }
+
+    SECTION( "FlashKVStore" ) {
+        FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+
+        structs(store);
+    }
+
+    SECTION( "FileKVStore" ) {
+        ::unlink(PATH);
+        FileKVStore store(PATH);
+        REQUIRE( store.begin() );
+
+        structs(store);
+
+        store.end();
+        ::unlink(PATH);
+    }
+
+    SECTION( "ESP32KVStore" ) {
+        nvs_fake_format();
+        ESP32KVStore store;
+        REQUIRE( store.begin() );
+
+        structs(store);
+    }
+
+    SECTION( "STM32H7KVStore" ) {
+        mbed_fake_format();
+        STM32H7KVStore store;
+        REQUIRE( store.begin() );
+
+        structs(store);
+    }
+}
+
+TEST_CASE( "Structs are read with a single lookup", "[kvstore][struct]" ) {
+    MockKVStore store;
+    ConfigV2 config = { 8883, 3, Mode::STATION, 500 };
+
+    REQUIRE( store.put("cfg", config) == sizeof(config) );
+    REQUIRE( store.stats.putBytes == 1 );
+
+    store.resetStats();
+    ConfigV2 res;
+    REQUIRE( store.tryGet("cfg", res) == sizeof(res) );
+    REQUIRE( store.stats.getBytes == 1 );
+    REQUIRE( store.stats.getBytesLength == 0 );
+    REQUIRE( store.stats.exists == 0 );
+}
@@ -0,0 +1,383 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <kvstore/decorators/BloomKVStore.h>
+#include <kvstore/decorators/ReadCacheKVStore.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include <mbed_fake.h>
+#include <nvs_fake.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+static const char PATH[] = "test_kvstore_transaction.log";
+
+// a WiFi credential update: the three values and the removal of a stale key go together
+static void oldCredentials(KVStoreInterface& store) {
+    REQUIRE( store.putString("ssid", "home") == 4 );
+    REQUIRE( store.putString("pass", "hunter22") == 8 );
+    REQUIRE( store.putUInt("security", 1) == 4 );
+    REQUIRE( store.putUInt("stale", 7) == 4 );
+}
+
+static void newCredentials(KVStoreInterface& store) {
+    REQUIRE( store.putString("ssid", "office") == 6 );
+    REQUIRE( store.putString("pass", "correct horse") == 13 );
+    REQUIRE( store.putUInt("security", 3) == 4 );
+    REQUIRE( store.remove("stale") == 1 );
+}
+
+enum State { OLD, NEW, MIXED };
+
+static State credentials(KVStoreInterface& store) {
+    char ssid[16] = {};
+    char pass[16] = {};
+    store.getString("ssid", ssid, sizeof(ssid));
+    store.getString("pass", pass, sizeof(pass));
+    uint32_t security = store.getUInt("security");
+    bool stale = store.exists("stale");
+
+    if(strcmp(ssid, "home") == 0 && strcmp(pass, "hunter22") == 0 && security == 1 && stale) {
+        return OLD;
+    } else if(strcmp(ssid, "office") == 0 && strcmp(pass, "correct horse") == 0 && security == 3 && !stale) {
+        return NEW;
+    }
+
+    return MIXED;
+}
+
+static void transactions(KVStoreInterface& store) {
+    oldCredentials(store);
+
+    SECTION( "the writes of a transaction are applied by commit" ) {
+        REQUIRE( store.beginTransaction() );
+        newCredentials(store);
+
+        // reads return the committed values until the transaction is committed
+        REQUIRE( credentials(store) == OLD );
+        REQUIRE( store.commit() );
+        REQUIRE( credentials(store) == NEW );
+    }
+
+    SECTION( "the writes of a transaction are discarded by abort" ) {
+        REQUIRE( store.beginTransaction() );
+        newCredentials(store);
+        REQUIRE( store.putUInt("added", 1) == 4 );
+
+        REQUIRE( store.abort() );
+        REQUIRE( credentials(store) == OLD );
+        REQUIRE_FALSE( store.exists("added") );
+    }
+
+    SECTION( "removals see the writes staged before them" ) {
+        REQUIRE( store.beginTransaction() );
+        REQUIRE( store.remove("missing") == 0 );
+        REQUIRE( store.putUInt("added", 1) == 4 );
+        REQUIRE( store.remove("added") == 1 );
+        REQUIRE( store.remove("added") == 0 );
+        REQUIRE( store.remove("stale") == 1 );
+        REQUIRE( store.remove("stale") == 0 );
+        REQUIRE( store.commit() );
+
+        REQUIRE_FALSE( store.exists("added") );
+        REQUIRE_FALSE( store.exists("stale") );
+    }
+
+    SECTION( "batches are staged as well" ) {
+        uint32_t a = 10, b = 20;
+        KVStoreInterface::PutEntry entries[] = {
+            { "a", (const uint8_t*)&a, sizeof(a), KVStoreInterface::PT_U32 },
+            { "b", (const uint8_t*)&b, sizeof(b), KVStoreInterface::PT_U32 },
+        };
+        const char* keys[] = { "ssid", "pass" };
+
+        REQUIRE( store.beginTransaction() );
+        REQUIRE( store.putMany(entries, 2) == 2 );
+        REQUIRE( store.removeMany(keys, 2) == 2 );
+        REQUIRE_FALSE( store.exists("a") );
+        REQUIRE( store.commit() );
+
+        REQUIRE( store.getUInt("a") == 10 );
+        REQUIRE( store.getUInt("b") == 20 );
+        REQUIRE_FALSE( store.exists("ssid") );
+        REQUIRE_FALSE( store.exists("pass") );
+    }
+
+    SECTION( "writes that do not fit in the journal are rejected" ) {
+        static uint8_t large[DEFAULT_JOURNAL_MAX_BYTES];
+
+        REQUIRE( store.beginTransaction() );
+        REQUIRE( store.putUInt("security", 3) == 4 );
+        REQUIRE( store.putBytes("large", large, sizeof(large)) == 0 );
+        REQUIRE( store.commit() );
+
+        REQUIRE( store.getUInt("security") == 3 );
+        REQUIRE_FALSE( store.exists("large") );
+    }
+
+    SECTION( "transactions do not nest" ) {
+        REQUIRE_FALSE( store.abort() );
+
+        REQUIRE( store.beginTransaction() );
+        REQUIRE_FALSE( store.beginTransaction() );
+        REQUIRE( store.commit() );
+        REQUIRE( credentials(store) == OLD );
+    }
+
+    SECTION( "a committed transaction survives a restart" ) {
+        REQUIRE( store.beginTransaction() );
+        newCredentials(store);
+        REQUIRE( store.commit() );
+
+        REQUIRE( store.end() );
+        REQUIRE( store.begin() );
+        REQUIRE( credentials(store) == NEW );
+    }
+}
+
+TEST_CASE( "Transactions are applied all together", "[kvstore][transaction]" ) {
+    SECTION( "FlashKVStore" ) {
+        FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+
+        transactions(store);
+    }
+
+    SECTION( "FileKVStore" ) {
+        ::unlink(PATH);
+        FileKVStore store(PATH);
+        REQUIRE( store.begin() );
+
+        transactions(store);
+
+        store.end();
+        ::unlink(PATH);
+    }
+
+    SECTION( "ESP32KVStore" ) {
+        nvs_fake_format();
+        ESP32KVStore store;
+        REQUIRE( store.begin() );
+
+        transactions(store);
+        store.end();
+    }
+
+    SECTION( "BloomKVStore" ) {
+        FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+        FlashKVStore inner(flash);
+        BloomKVStore store(inner);
+        REQUIRE( store.begin() );
+
+        transactions(store);
+    }
+
+    SECTION( "ReadCacheKVStore" ) {
+        nvs_fake_format();
+        ESP32KVStore inner;
+        ReadCacheKVStore store(inner);
+        REQUIRE( store.begin() );
+
+        transactions(store);
+        store.end();
+    }
+}
+
+TEST_CASE( "Backends without transactions reject them", "[kvstore][transaction]" ) {
+    mbed_fake_format();
+    STM32H7KVStore store;
+    REQUIRE( store.begin() );
+
+    REQUIRE_FALSE( store.beginTransaction() );
+    REQUIRE_FALSE( store.commit() );
+    REQUIRE_FALSE( store.abort() );
+}
+
+TEST_CASE( "FlashKVStore transactions survive a power cut at any step", "[kvstore][transaction][flash]" ) {
+    static const FlashSimulator::Config config = { 16 * 4096, 4096, 4, 0, 0, 0 };
+
+    // count the steps the commit takes
+    uint64_t steps;
+    {
+        FlashSimulator flash(config);
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+        oldCredentials(store);
+
+        REQUIRE( store.beginTransaction() );
+        newCredentials(store);
+
+        uint64_t start = flash.getSteps();
+        REQUIRE( store.commit() );
+        steps = flash.getSteps() - start;
+    }
+
+    for(uint64_t cut=0; cut<steps; cut++) {
+        FlashSimulator flash(config);
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+        oldCredentials(store);
+
+        REQUIRE( store.beginTransaction() );
+        newCredentials(store);
+
+        flash.powerCutAfter(cut);
+        REQUIRE_FALSE( store.commit() );
+        store.end();
+
+        flash.powerOn();
+        REQUIRE( store.begin() );
+
+        // the last program unit may hold its final content even if it was interrupted
+        State state = credentials(store);
+        REQUIRE( (state == OLD || (state == NEW && cut == steps - 1)) );
+
+        // the space after the interrupted transaction is reclaimed
+        REQUIRE( store.putUInt("security", 5) == 4 );
+        REQUIRE( store.getUInt("security") == 5 );
+    }
+}
+
+TEST_CASE( "FlashKVStore transactions are collected like other records", "[kvstore][transaction][flash]" ) {
+    uint32_t budget = GENERATE(0, 1);
+
+    FlashSimulator flash({ 8 * 4096, 4096, 4, 0, 0, 0 });
+    FlashKVStore store(flash);
+    REQUIRE( store.begin() );
+    store.setIncrementalGC(budget);
+
+    for(uint32_t i=0; i<500; i++) {
+        REQUIRE( store.beginTransaction() );
+        REQUIRE( store.putUInt("a", i) == 4 );
+        REQUIRE( store.putUInt("b", i * 2) == 4 );
+        REQUIRE( store.remove("c") == (i > 0 ? 1 : 0) );
+        REQUIRE( store.putUInt("c", i * 3) == 4 );
+        REQUIRE( store.commit() );
+    }
+    REQUIRE( store.getStats().collections > 0 );
+
+    REQUIRE( store.end() );
+    REQUIRE( store.begin() );
+    REQUIRE( store.getUInt("a") == 499 );
+    REQUIRE( store.getUInt("b") == 998 );
+    REQUIRE( store.getUInt("c") == 1497 );
+
+    SECTION( "writers and patches are rejected while a transaction is open" ) {
+        REQUIRE( store.beginTransaction() );
+        REQUIRE_FALSE( store.openWriter("blob", 4).isOpen() );
+        REQUIRE( store.patchBytes("a", 0, (const uint8_t*)"\x01", 1) == 0 );
+        REQUIRE( store.abort() );
+
+        auto w = store.openWriter("blob", 4);
+        REQUIRE( w.isOpen() );
+        REQUIRE_FALSE( store.beginTransaction() );
+        w.abort();
+    }
+}
+
+TEST_CASE( "FileKVStore transactions survive a torn write", "[kvstore][transaction][file]" ) {
+    ::unlink(PATH);
+    uint64_t before, after;
+    {
+        FileKVStore store(PATH);
+        REQUIRE( store.begin() );
+        oldCredentials(store);
+        before = store.fileSize();
+
+        REQUIRE( store.beginTransaction() );
+        newCredentials(store);
+        REQUIRE( store.commit() );
+        after = store.fileSize();
+        REQUIRE( store.end() );
+    }
+
+    std::ostringstream content;
+    content << std::ifstream(PATH, std::ios::binary).rdbuf();
+    std::string log = content.str();
+    REQUIRE( log.size() == after );
+
+    auto restart = [](const std::string& data) {
+        std::ofstream(PATH, std::ios::binary | std::ios::trunc).write(data.data(), data.size());
+
+        FileKVStore store(PATH);
+        REQUIRE( store.begin() );
+        State res = credentials(store);
+        store.end();
+
+        return res;
+    };
+
+    SECTION( "the transaction is discarded if the file ends within it" ) {
+        for(uint64_t len=before; len<after; len++) {
+            REQUIRE( restart(log.substr(0, len)) == OLD );
+        }
+        REQUIRE( restart(log) == NEW );
+    }
+
+    SECTION( "the transaction is discarded if one of its records is corrupted" ) {
+        log[after - 1] ^= 0xFF;
+        REQUIRE( restart(log) == OLD );
+    }
+
+    ::unlink(PATH);
+}
+
+TEST_CASE( "ESP32KVStore transactions survive a power cut at any write", "[kvstore][transaction][esp32]" ) {
+    // count the writes the commit takes
+    size_t writes;
+    {
+        nvs_fake_format();
+        ESP32KVStore store;
+        REQUIRE( store.begin() );
+        oldCredentials(store);
+
+        REQUIRE( store.beginTransaction() );
+        newCredentials(store);
+
+        nvs_fake_reset_stats();
+        REQUIRE( store.commit() );
+        writes = nvs_fake_stats().sets + nvs_fake_stats().erases;
+
+        // the journal is made durable before the writes
+        REQUIRE( nvs_fake_stats().commits == 2 );
+        store.end();
+    }
+
+    for(size_t cut=0; cut<writes; cut++) {
+        nvs_fake_format();
+        ESP32KVStore store;
+        REQUIRE( store.begin() );
+        oldCredentials(store);
+
+        REQUIRE( store.beginTransaction() );
+        newCredentials(store);
+
+        nvs_fake_power_cut_after(cut);
+        REQUIRE_FALSE( store.commit() );
+        store.end();
+        nvs_fake_power_on();
+
+        // once the journal is saved the transaction is completed by begin()
+        ESP32KVStore restarted;
+        REQUIRE( restarted.begin() );
+        REQUIRE( credentials(restarted) == (cut == 0 ? OLD : NEW) );
+        REQUIRE_FALSE( restarted.exists(ESP32_JOURNAL_KEY) );
+        restarted.end();
+    }
+}
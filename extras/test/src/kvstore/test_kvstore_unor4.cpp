@@ -0,0 +1,284 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/UnoR4.h>
+#include <modem_fake.h>
+
+TEST_CASE( "Unor4KVStore stores values in the preferences of the bridge", "[kvstore][unor4]" ) {
+    modem_fake_format();
+
+    Unor4KVStore store;
+    REQUIRE( store.begin() );
+
+    REQUIRE( store.putChar("0", -5) == 1 );
+    REQUIRE( store.putUInt("1", 0x55555555) == 4 );
+    REQUIRE( store.putULong64("2", 0x5555555555555555) == 8 );
+    REQUIRE( store.putString("3", "pippo") == 5 );
+
+    char res[8];
+    REQUIRE( store.getUInt("1") == 0x55555555 );
+    REQUIRE( store.getULong64("2") == 0x5555555555555555 );
+    REQUIRE( store.getString("3", res, sizeof(res)) == 6 );
+    REQUIRE( strcmp(res, "pippo") == 0 );
+
+    REQUIRE( store.exists("1") );
+    REQUIRE( store.remove("1") == 1 );
+    REQUIRE_FALSE( store.exists("1") );
+
+    REQUIRE( store.end() );
+}
+
+TEST_CASE( "Unor4KVStore pipelines batched commands", "[kvstore][unor4]" ) {
+    modem_fake_format();
+
+    Unor4KVStore store;
+    REQUIRE( store.begin() );
+
+    size_t depth = GENERATE(0, 1, 4, 64);
+    bool binary = GENERATE(true, false);
+    REQUIRE( store.setPipelineDepth(depth) );
+    store.setBinaryNumbers(binary);
+
+    int8_t i8 = -5;
+    uint16_t u16 = 0xABCD;
+    int32_t i32 = -100000;
+    uint32_t u32 = 0xFFFFFFFF;
+    uint64_t u64 = 0x0123456789ABCDEF;
+    double d = 1.25;
+    const char str[] = "pippo";
+    uint8_t blob[] = { 0, '\r', '\n', 'O', 'K', '\r', '\n', 0xFF };
+
+    KVStoreInterface::PutEntry puts[] = {
+        { "i8", (uint8_t*)&i8, sizeof(i8), KVStoreInterface::PT_I8 },
+        { "u16", (uint8_t*)&u16, sizeof(u16), KVStoreInterface::PT_U16 },
+        { "i32", (uint8_t*)&i32, sizeof(i32), KVStoreInterface::PT_I32 },
+        { "u32", (uint8_t*)&u32, sizeof(u32), KVStoreInterface::PT_U32 },
+        { "u64", (uint8_t*)&u64, sizeof(u64), KVStoreInterface::PT_U64 },
+        { "d", (uint8_t*)&d, sizeof(d), KVStoreInterface::PT_DOUBLE },
+        { "str", (uint8_t*)str, strlen(str), KVStoreInterface::PT_STR },
+        { "blob", blob, sizeof(blob), KVStoreInterface::PT_BLOB },
+    };
+    REQUIRE( store.putMany(puts, 8) == 8 );
+
+    int8_t ri8 = 0;
+    uint16_t ru16 = 0;
+    int32_t ri32 = 0;
+    uint32_t ru32 = 0;
+    uint64_t ru64 = 0;
+    double rd = 0;
+    char rstr[8] = {};
+    uint8_t rblob[8] = {};
+    uint32_t missing = 0;
+
+    KVStoreInterface::GetEntry gets[] = {
+        { "i8", (uint8_t*)&ri8, sizeof(ri8), KVStoreInterface::PT_I8 },
+        { "u16", (uint8_t*)&ru16, sizeof(ru16), KVStoreInterface::PT_U16 },
+        { "i32", (uint8_t*)&ri32, sizeof(ri32), KVStoreInterface::PT_I32 },
+        { "u32", (uint8_t*)&ru32, sizeof(ru32), KVStoreInterface::PT_U32 },
+        { "u64", (uint8_t*)&ru64, sizeof(ru64), KVStoreInterface::PT_U64 },
+        { "d", (uint8_t*)&rd, sizeof(rd), KVStoreInterface::PT_DOUBLE },
+        { "str", (uint8_t*)rstr, sizeof(rstr), KVStoreInterface::PT_STR },
+        { "blob", rblob, sizeof(rblob), KVStoreInterface::PT_BLOB },
+        { "missing", (uint8_t*)&missing, sizeof(missing), KVStoreInterface::PT_BLOB },
+    };
+    REQUIRE( store.getMany(gets, 9) == 8 );
+
+    REQUIRE( ri8 == i8 );
+    REQUIRE( ru16 == u16 );
+    REQUIRE( ri32 == i32 );
+    REQUIRE( ru32 == u32 );
+    REQUIRE( ru64 == u64 );
+    REQUIRE( rd == d );
+    REQUIRE( strcmp(rstr, str) == 0 );
+    REQUIRE( memcmp(rblob, blob, sizeof(blob)) == 0 );
+    REQUIRE( gets[8].res == 0 );
+
+    KVStoreInterface::key_t keys[] = { "i8", "missing", "blob" };
+    REQUIRE( store.removeMany(keys, 3) == 2 );
+    REQUIRE_FALSE( store.exists("i8") );
+    REQUIRE( store.exists("u16") );
+
+    REQUIRE( store.end() );
+}
+
+TEST_CASE( "Unor4KVStore pipelining overlaps the round trips", "[kvstore][unor4]" ) {
+    modem_fake_format();
+
+    Unor4KVStore store;
+    REQUIRE( store.begin() );
+
+    uint32_t values[16];
+    char keys[16][8];
+    KVStoreInterface::PutEntry entries[16];
+    for(size_t i=0; i<16; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "k%zu", i);
+        values[i] = i;
+        entries[i] = KVStoreInterface::PutEntry(keys[i], (uint8_t*)&values[i], sizeof(values[i]), KVStoreInterface::PT_U32);
+    }
+
+    modem_fake_reset_stats();
+    REQUIRE( store.putMany(entries, 16) == 16 );
+    uint64_t sequential = modem_fake_stats().elapsedUs;
+
+    REQUIRE( store.setPipelineDepth(8) );
+    modem_fake_reset_stats();
+    REQUIRE( store.putMany(entries, 16) == 16 );
+    uint64_t pipelined = modem_fake_stats().elapsedUs;
+
+    REQUIRE( modem_fake_stats().commands == 16 );
+    REQUIRE( store.getPipeline()->getStats().stalls == 8 );
+    // requests and responses are transferred at the same time
+    REQUIRE( pipelined * 5 < sequential * 3 );
+
+    store.end();
+}
+
+TEST_CASE( "Unor4KVStore reads a value with a single exchange", "[kvstore][unor4]" ) {
+    modem_fake_format();
+
+    Unor4KVStore store;
+    REQUIRE( store.begin() );
+
+    uint8_t blob[100];
+    for(size_t i=0; i<sizeof(blob); i++) {
+        blob[i] = i;
+    }
+    store.putBytes("blob", blob, sizeof(blob));
+    store.putULong64("u64", 0x0123456789ABCDEF);
+    store.putDouble("d", 1.25);
+
+    modem_fake_reset_stats();
+    uint8_t out[100] = {};
+    REQUIRE( store.getBytes("blob", out, sizeof(out)) == 100 );
+    REQUIRE( memcmp(blob, out, sizeof(blob)) == 0 );
+    REQUIRE( modem_fake_stats().commands == 1 );
+
+    modem_fake_reset_stats();
+    REQUIRE( store.getULong64("u64") == 0x0123456789ABCDEF );
+    REQUIRE( store.getDouble("d") == 1.25 );
+    REQUIRE( modem_fake_stats().commands == 2 );
+
+    modem_fake_reset_stats();
+    size_t viewed = 0;
+    REQUIRE( store.view("blob", [](const uint8_t value[], size_t len, void* ctx) {
+        (void) value;
+        *(size_t*)ctx = len;
+    }, &viewed) == 100 );
+    REQUIRE( viewed == 100 );
+    REQUIRE( modem_fake_stats().commands == 1 );
+
+    SECTION( "values larger than the buffer are not read" ) {
+        REQUIRE( store.getBytes("blob", out, 99) == 0 );
+    }
+
+    SECTION( "missing values are empty" ) {
+        REQUIRE( store.getBytes("missing", out, sizeof(out)) == 0 );
+        REQUIRE( store.view("missing", [](const uint8_t[], size_t, void*) {}) == 0 );
+    }
+
+    store.end();
+}
+
+TEST_CASE( "Unor4KVStore sends numbers in binary", "[kvstore][unor4]" ) {
+    modem_fake_format();
+
+    Unor4KVStore store;
+    REQUIRE( store.begin() );
+
+    SECTION( "integers are sent as text unless binary numbers are enabled" ) {
+        modem_fake_reset_stats();
+        REQUIRE( store.putUInt("text", 4000000000u) == 4 );
+        size_t text = modem_fake_stats().bytesSent;
+
+        store.setBinaryNumbers(true);
+        modem_fake_reset_stats();
+        REQUIRE( store.putUInt("binary", 4000000000u) == 4 );
+        size_t binary = modem_fake_stats().bytesSent;
+
+        // the value is sent as 10 digits or as 4 bytes
+        REQUIRE( text > binary );
+        REQUIRE( store.getUInt("text") == 4000000000u );
+    }
+
+    SECTION( "missing integers read as text are told apart from a stored 0" ) {
+        REQUIRE( store.putInt("zero", 0) == 4 );
+
+        int32_t v = 5;
+        REQUIRE( store.getInt("missing", 42) == 42 );
+        REQUIRE( store.getUShort("missing", 7) == 7 );
+        REQUIRE( store.tryGet(KVKey("missing"), v) <= 0 );
+        REQUIRE( store.getInt("zero", 42) == 0 );
+
+        store.setPipelineDepth(4);
+        int32_t zero = 5, missing = 42;
+        KVStoreInterface::GetEntry gets[] = {
+            { "zero", (uint8_t*)&zero, sizeof(zero), KVStoreInterface::PT_I32 },
+            { "missing", (uint8_t*)&missing, sizeof(missing), KVStoreInterface::PT_I32 },
+        };
+        REQUIRE( store.getMany(gets, 2) == 1 );
+        REQUIRE( zero == 0 );
+        REQUIRE( missing == 42 );
+    }
+
+    store.setBinaryNumbers(true);
+
+    SECTION( "every width is read back" ) {
+        REQUIRE( store.putChar("i8", -1) == 1 );
+        REQUIRE( store.putShort("i16", -300) == 2 );
+        REQUIRE( store.putInt("i32", -100000) == 4 );
+        REQUIRE( store.putUInt("u32", 0xFFFFFFFF) == 4 );
+        REQUIRE( store.putLong64("i64", -1) == 8 );
+        REQUIRE( store.putFloat("f", 0.5f) == 4 );
+
+        modem_fake_reset_stats();
+        REQUIRE( store.getChar("i8") == -1 );
+        REQUIRE( store.getShort("i16") == -300 );
+        REQUIRE( store.getInt("i32") == -100000 );
+        REQUIRE( store.getUInt("u32") == 0xFFFFFFFF );
+        REQUIRE( store.getLong64("i64") == -1 );
+        REQUIRE( store.getFloat("f") == 0.5f );
+        REQUIRE( modem_fake_stats().commands == 6 );
+    }
+
+    SECTION( "values of a different width are not read" ) {
+        store.putShort("0", 1);
+        REQUIRE( store.getInt("0", 7) == 7 );
+    }
+
+    SECTION( "integers written as text are still readable" ) {
+        store.setBinaryNumbers(false);
+        store.putShort("i16", -300);
+        store.putUInt("u32", 0xFFFFFFFF);
+        store.setBinaryNumbers(true);
+
+        REQUIRE( store.getShort("i16") == -300 );
+        REQUIRE( store.getUInt("u32") == 0xFFFFFFFF );
+        REQUIRE( store.getInt("missing", 7) == 7 );
+
+        store.setPipelineDepth(4);
+        int16_t i16 = 0;
+        uint32_t u32 = 0, missing = 7;
+        KVStoreInterface::GetEntry gets[] = {
+            { "i16", (uint8_t*)&i16, sizeof(i16), KVStoreInterface::PT_I16 },
+            { "u32", (uint8_t*)&u32, sizeof(u32), KVStoreInterface::PT_U32 },
+            { "missing", (uint8_t*)&missing, sizeof(missing), KVStoreInterface::PT_U32 },
+        };
+        REQUIRE( store.getMany(gets, 3) == 2 );
+        REQUIRE( i16 == -300 );
+        REQUIRE( u32 == 0xFFFFFFFF );
+        REQUIRE( missing == 7 );
+    }
+
+    store.end();
+}
@@ -0,0 +1,200 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <kvstore/kvstore.h>
+#include <kvstore/implementation/host.h>
+#include <kvstore/implementation/ESP32.h>
+#include <kvstore/implementation/stm32h7.h>
+#include <kvstore/decorators/KVStoreView.h>
+#include <kvstore/flash/FlashKVStore.h>
+#include <kvstore/flash/FlashSimulator.h>
+#include "../mock/MockKVStore.h"
+#include <mbed_fake.h>
+#include <nvs_fake.h>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <unistd.h>
+
+static const char PATH[] = "test_kvstore_view.log";
+
+static bool collect(const char* key, KVStoreInterface::Type t, size_t len, void* ctx) {
+    (void) t;
+    (void) len;
+    ((std::set<std::string>*)ctx)->insert(key);
+    return true;
+}
+
+// keys are kept short, ESP32 limits them to 15 characters prefix included
+static void namespaces(KVStoreInterface& store) {
+    KVStoreView net(store, "n/");
+    KVStoreView app(store, "a/");
+    REQUIRE( net.begin() );
+    REQUIRE( app.begin() );
+
+    REQUIRE( net.putUShort("port", 1883) == 2 );
+    REQUIRE( net.putString("host", "broker") == 6 );
+    REQUIRE( app.putUShort("port", 80) == 2 );
+    REQUIRE( store.putUChar("boot", 1) == 1 );
+
+    SECTION( "keys are prefixed in the underlying store" ) {
+        REQUIRE( store.getUShort("n/port") == 1883 );
+        REQUIRE( store.getUShort("a/port") == 80 );
+
+        REQUIRE( net.getUShort("port") == 1883 );
+        REQUIRE( app.getUShort("port") == 80 );
+        REQUIRE( net.exists("host") );
+        REQUIRE_FALSE( app.exists("host") );
+        REQUIRE_FALSE( net.exists("boot") );
+
+        char host[16];
+        REQUIRE( net.getString("host", host, sizeof(host)) > 0 );
+        REQUIRE( strcmp(host, "broker") == 0 );
+
+        REQUIRE( net.remove("port") == 1 );
+        REQUIRE_FALSE( store.exists("n/port") );
+        REQUIRE( app.exists("port") );
+    }
+
+    SECTION( "keys are enumerated without the prefix" ) {
+        std::set<std::string> keys;
+        REQUIRE( net.forEach(nullptr, collect, &keys) );
+        REQUIRE( keys == std::set<std::string>({ "host", "port" }) );
+
+        keys.clear();
+        REQUIRE( net.forEach("h", collect, &keys) );
+        REQUIRE( keys == std::set<std::string>({ "host" }) );
+    }
+
+    SECTION( "clear removes only the keys of the namespace" ) {
+        char key[16];
+        for(int i=0; i<40; i++) {
+            snprintf(key, sizeof(key), "k%d", i);
+            REQUIRE( net.putUInt(key, i) == 4 );
+        }
+
+        REQUIRE( net.clear() );
+
+        std::set<std::string> keys;
+        REQUIRE( net.forEach(nullptr, collect, &keys) );
+        REQUIRE( keys.empty() );
+
+        REQUIRE( app.getUShort("port") == 80 );
+        REQUIRE( store.getUChar("boot") == 1 );
+    }
+
+    REQUIRE( net.end() );
+    REQUIRE( app.end() );
+}
+
+TEST_CASE( "KVStoreView namespaces a shared store", "[kvstore][view]" ) {
+    SECTION( "FlashKVStore" ) {
+        FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+        FlashKVStore store(flash);
+        REQUIRE( store.begin() );
+
+        namespaces(store);
+    }
+
+    SECTION( "FileKVStore" ) {
+        ::unlink(PATH);
+        FileKVStore store(PATH);
+        REQUIRE( store.begin() );
+
+        namespaces(store);
+
+        store.end();
+        ::unlink(PATH);
+    }
+
+    SECTION( "ESP32KVStore" ) {
+        nvs_fake_format();
+        ESP32KVStore store;
+        REQUIRE( store.begin() );
+
+        namespaces(store);
+    }
+
+    SECTION( "STM32H7KVStore" ) {
+        mbed_fake_format();
+        STM32H7KVStore store;
+        REQUIRE( store.begin() );
+
+        namespaces(store);
+    }
+}
+
+TEST_CASE( "KVStoreView limits", "[kvstore][view]" ) {
+    FlashSimulator flash({ 16 * 4096, 4096, 4, 0, 0, 0 });
+    FlashKVStore store(flash);
+    REQUIRE( store.begin() );
+
+    SECTION( "keys too long with the prefix are rejected" ) {
+        KVStoreView view(store, "net/");
+
+        char key[KVSTORE_VIEW_MAX_KEY_LEN + 1];
+        memset(key, 'k', sizeof(key) - 1);
+        key[sizeof(key) - 1] = '\0';
+
+        REQUIRE( view.putUChar(key, 1) == 0 );
+        REQUIRE_FALSE( view.exists(key) );
+
+        key[KVSTORE_VIEW_MAX_KEY_LEN - 4] = '\0';
+        REQUIRE( view.putUChar(key, 1) == 1 );
+        REQUIRE( view.getUChar(key) == 1 );
+    }
+
+    SECTION( "values are streamed and patched through the view" ) {
+        KVStoreView view(store, "net/");
+        uint8_t cert[600];
+        for(size_t i=0; i<sizeof(cert); i++) {
+            cert[i] = i;
+        }
+
+        auto writer = view.openWriter("cert", sizeof(cert));
+        REQUIRE( writer.write(cert, sizeof(cert)) == sizeof(cert) );
+        REQUIRE( writer.close() );
+        REQUIRE( store.getBytesLength("net/cert") == sizeof(cert) );
+
+        auto reader = view.openReader("cert");
+        uint8_t res[sizeof(cert)];
+        REQUIRE( reader.size() == sizeof(cert) );
+        REQUIRE( reader.read(res, sizeof(res)) == sizeof(cert) );
+        REQUIRE( memcmp(res, cert, sizeof(cert)) == 0 );
+        reader.close();
+
+        REQUIRE( view.patchBytes("cert", 10, (const uint8_t*)"\x00", 1) == 1 );
+        uint8_t b;
+        REQUIRE( view.getBytes("cert", 10, &b, 1) == 1 );
+        REQUIRE( b == 0 );
+    }
+
+    SECTION( "transactions are forwarded" ) {
+        KVStoreView view(store, "net/");
+
+        REQUIRE( view.beginTransaction() );
+        REQUIRE( view.putUInt("a", 1) == 4 );
+        REQUIRE( view.putUInt("b", 2) == 4 );
+        REQUIRE_FALSE( store.exists("net/a") );
+        REQUIRE( view.commit() );
+        REQUIRE( store.getUInt("net/b") == 2 );
+    }
+
+    SECTION( "the store must enumerate its keys to clear a namespace" ) {
+        MockKVStore mock;
+        KVStoreView view(mock, "net/");
+
+        REQUIRE( view.putUChar("k", 1) == 1 );
+        REQUIRE_FALSE( view.clear() );
+    }
+}
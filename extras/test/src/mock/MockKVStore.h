@@ -0,0 +1,161 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include <kvstore/kvstore.h>
+#include <kvstore/utility/index.h>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+/** MockKVStore class
+ *
+ * In memory KVStore used by host tests and benchmarks. Every call to the backend is counted
+ * and every write is followed by a commit, like ESP32KVStore does. The cost of commits and
+ * lookups can be simulated with setCommitLatency() and setLookupLatency()
+ */
+class MockKVStore: public KVStoreInterface {
+public:
+    struct Stats {
+        size_t exists;
+        size_t putBytes;
+        size_t getBytes;
+        size_t getBytesLength;
+        size_t remove;
+        size_t commits;
+    };
+
+    MockKVStore(): stats(), commitLatencyUs(0), lookupLatencyUs(0) {}
+
+    bool begin() override { return true; }
+    bool end() override   { return true; }
+    bool clear() override {
+        kvmap.clear();
+        persist();
+
+        return true;
+    }
+
+    res_t remove(const key_t& key) override {
+        stats.remove++;
+        if(kvmap.erase(key) == 0) {
+            return 0;
+        }
+        persist();
+
+        return 1;
+    }
+
+    bool exists(const key_t& key) const override {
+        stats.exists++;
+        wait(lookupLatencyUs);
+
+        return kvmap.find(key) != kvmap.end();
+    }
+
+    res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override {
+        set(key, b, s);
+        persist();
+
+        return s;
+    }
+
+    using KVStoreInterface::getBytes;
+    res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override {
+        stats.getBytes++;
+        wait(lookupLatencyUs);
+        auto el = kvmap.find(key);
+
+        if(el == kvmap.end()) {
+            return 0;
+        }
+
+        std::memcpy(b, el->second.data(), s <= el->second.size()? s : el->second.size());
+
+        return el->second.size();
+    }
+
+    size_t getBytesLength(const key_t& key) const override {
+        stats.getBytesLength++;
+        wait(lookupLatencyUs);
+        auto el = kvmap.find(key);
+
+        return el != kvmap.end() ? el->second.size() : 0;
+    }
+
+    // values are kept in memory, hence they can be accessed directly
+    res_t view(const key_t& key, ViewCallback cb, void* ctx=nullptr, Type t=PT_BLOB) override {
+        (void) t;
+        stats.getBytes++;
+        wait(lookupLatencyUs);
+        auto el = kvmap.find(key);
+
+        if(el == kvmap.end()) {
+            return 0;
+        }
+
+        cb(el->second.data(), el->second.size(), ctx);
+
+        return el->second.size();
+    }
+
+    // the whole batch is committed once
+    size_t putMany(PutEntry entries[], size_t n) override {
+        for(size_t i=0; i<n; i++) {
+            set(entries[i].key, entries[i].value, entries[i].len);
+            entries[i].res = entries[i].len;
+        }
+        persist();
+
+        return n;
+    }
+
+    using KVStoreInterface::removeMany;
+
+    size_t removeMany(const key_t keys[], size_t n) override {
+        size_t count = 0;
+
+        for(size_t i=0; i<n; i++) {
+            stats.remove++;
+            count += kvmap.erase(keys[i]);
+        }
+        persist();
+
+        return count;
+    }
+
+    void setCommitLatency(uint32_t us) { commitLatencyUs = us; }
+    void setLookupLatency(uint32_t us) { lookupLatencyUs = us; }
+    void resetStats()                  { stats = Stats(); }
+    size_t size() const                { return kvmap.size(); }
+
+    mutable Stats stats;
+protected:
+    void set(const key_t& key, const uint8_t b[], size_t s) {
+        stats.putBytes++;
+        kvmap[key] = std::vector<uint8_t>(b, b + s);
+    }
+
+    // counts a commit of the storage, transactions are not supported
+    void persist() {
+        stats.commits++;
+        wait(commitLatencyUs);
+    }
+
+    // busy wait in order to simulate the cost of accessing the storage
+    static void wait(uint32_t us) {
+        auto start = std::chrono::steady_clock::now();
+        while(std::chrono::steady_clock::now() - start < std::chrono::microseconds(us));
+    }
+
+    KVIndex<std::vector<uint8_t>> kvmap;
+    uint32_t commitLatencyUs;
+    uint32_t lookupLatencyUs;
+};
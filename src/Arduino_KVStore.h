@@ -10,6 +10,12 @@
 
 #pragma once
 #include "kvstore/kvstore.h"
+#include "kvstore/decorators/CachedKVStore.h"
+#include "kvstore/decorators/ReadCacheKVStore.h"
+#include "kvstore/decorators/BloomKVStore.h"
+#include "kvstore/decorators/KVStoreView.h"
+#include "kvstore/flash/FlashKVStore.h"
+#include "kvstore/flash/MbedBlockDevice.h"
 
 #if defined(ARDUINO_UNOR4_WIFI)
 #include "kvstore/implementation/UnoR4.h"
@@ -40,6 +46,12 @@ using KVStore = NinaKVStore;
 
 using KVStore = ESP32KVStore;
 
+#elif defined(HOST)
+
+#include "kvstore/implementation/host.h"
+
+using KVStore = FileKVStore;
+
 #else
 #error "Arduino KVStore is not supported on current platform"
 #endif
@@ -0,0 +1,425 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "BloomKVStore.h"
+#include <math.h>
+
+static constexpr uint32_t FILTER_MAGIC = 0x464C424B; // "KBLF"
+static constexpr uint8_t MAX_HASHES = 16;
+static constexpr double LN2 = 0.6931471805599453;
+
+struct FilterHeader {
+    uint32_t magic;
+    uint32_t bits;
+    uint8_t hashes;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(FilterHeader) == 12, "FilterHeader must not be padded");
+
+// the positions of a key in the filter are derived from two hashes, h1 + i * h2
+static inline void hash(const KVKey& key, uint32_t& h1, uint32_t& h2) {
+    // FNV-1a, computed once by KVKey
+    h1 = key.hash();
+
+    // murmur3 finalizer, odd so that it never cycles on a subset of the positions
+    h2 = h1;
+    h2 ^= h2 >> 16;
+    h2 *= 0x85ebca6bu;
+    h2 ^= h2 >> 13;
+    h2 *= 0xc2b2ae35u;
+    h2 ^= h2 >> 16;
+    h2 |= 1;
+}
+
+BloomKVStore::BloomKVStore(KVStoreInterface& store, size_t expectedKeys, float falsePositiveRate, size_t maxBytes)
+: store(store), filter(nullptr), bits(0), hashes(1), primed(false), persisted(false), transaction(false), stats() {
+    // optimal size and number of hashes for the expected keys and false positive rate
+    double n = expectedKeys > 0 ? expectedKeys : 1;
+    double m = ceil(-n * log(falsePositiveRate) / (LN2 * LN2));
+
+    if(m > maxBytes * 8.0) {
+        m = maxBytes * 8.0;
+    }
+
+    bits = m >= 8 ? (uint32_t)m : 8;
+    long k = lround(bits / n * LN2);
+    hashes = k < 1 ? 1 : (k > MAX_HASHES ? MAX_HASHES : k);
+
+    filter = new uint8_t[filterBytes()]();
+    if(filter == nullptr) {
+        bits = 0;
+    }
+}
+
+BloomKVStore::~BloomKVStore() {
+    delete [] filter;
+}
+
+bool BloomKVStore::begin() {
+    if(!store.begin()) {
+        return false;
+    }
+
+    persisted = store.getBytesLength(BLOOM_FILTER_KEY) > 0;
+    primed = (persisted && load()) || rebuild();
+
+    return true;
+}
+
+bool BloomKVStore::end() {
+    bool res = true;
+
+    // the filter would be staged by the open transaction, which belongs to the caller
+    if(transaction) {
+        return false;
+    }
+
+    if(primed && !persisted) {
+        res = save();
+    }
+
+    return store.end() && res;
+}
+
+bool BloomKVStore::clear() {
+    if(!store.clear()) {
+        return false;
+    }
+
+    // the store is known to be empty, the filter is primed
+    if(filter != nullptr) {
+        memset(filter, 0, filterBytes());
+        primed = true;
+    }
+    persisted = false;
+
+    return true;
+}
+
+bool BloomKVStore::prime(const char* const keys[], size_t n) {
+    if(filter == nullptr) {
+        return false;
+    }
+
+    // a loaded or rebuilt filter is extended, otherwise the keys are all the ones stored
+    if(!primed) {
+        memset(filter, 0, filterBytes());
+    }
+
+    for(size_t i=0; i<n; i++) {
+        if(keys[i] != nullptr) {
+            add(keys[i]);
+        }
+    }
+    primed = true;
+
+    return true;
+}
+
+typename KVStoreInterface::res_t BloomKVStore::remove(const key_t& key) {
+    // a filter is still valid after removals, keys are never removed from it
+    if(!mayContain(key)) {
+        return 0;
+    }
+
+    return store.remove(key);
+}
+
+bool BloomKVStore::exists(const key_t& key) const {
+    if(!mayContain(key)) {
+        return false;
+    }
+
+    bool res = store.exists(key);
+    account(res);
+
+    return res;
+}
+
+typename KVStoreInterface::res_t BloomKVStore::putBytes(const key_t& key, const uint8_t b[], size_t s) {
+    return _put(key, b, s, PT_BLOB);
+}
+
+typename KVStoreInterface::res_t BloomKVStore::getBytes(const key_t& key, uint8_t b[], size_t s) const {
+    if(!mayContain(key)) {
+        return 0;
+    }
+
+    res_t res = store.getBytes(key, b, s);
+    account(res > 0);
+
+    return res;
+}
+
+typename KVStoreInterface::res_t BloomKVStore::getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const {
+    if(!mayContain(key)) {
+        return 0;
+    }
+
+    res_t res = store.getBytes(key, offset, b, s);
+    account(res > 0);
+
+    return res;
+}
+
+typename KVStoreInterface::res_t BloomKVStore::patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) {
+    // only existing keys can be patched, they are already in the filter
+    if(!mayContain(key)) {
+        return 0;
+    }
+
+    return store.patchBytes(key, offset, b, s);
+}
+
+size_t BloomKVStore::getBytesLength(const key_t& key) const {
+    if(!mayContain(key)) {
+        return 0;
+    }
+
+    size_t res = store.getBytesLength(key);
+    account(res > 0);
+
+    return res;
+}
+
+size_t BloomKVStore::putMany(PutEntry entries[], size_t n) {
+    if(!beforeWrite()) {
+        return 0;
+    }
+
+    for(size_t i=0; i<n; i++) {
+        add(entries[i].key);
+    }
+
+    return store.putMany(entries, n);
+}
+
+size_t BloomKVStore::removeMany(const key_t keys[], size_t n) {
+    return store.removeMany(keys, n);
+}
+
+typename KVStoreInterface::res_t BloomKVStore::view(const key_t& key, ViewCallback cb, void* ctx, Type t) {
+    if(!mayContain(key)) {
+        return 0;
+    }
+
+    res_t res = store.view(key, cb, ctx, t);
+    account(res > 0);
+
+    return res;
+}
+
+bool BloomKVStore::forEach(const char* prefix, KeyCallback cb, void* ctx) {
+    struct Forward {
+        KeyCallback cb;
+        void* ctx;
+    } forward = { cb, ctx };
+
+    // the saved filter is hidden from the enumeration
+    auto skip = [](const char* key, Type t, size_t len, void* ctx) -> bool {
+        Forward* f = (Forward*)ctx;
+        return strcmp(key, BLOOM_FILTER_KEY) == 0 || f->cb(key, t, len, f->ctx);
+    };
+
+    return cb != nullptr && store.forEach(prefix, skip, &forward);
+}
+
+bool BloomKVStore::beginTransaction() {
+    // the saved filter is removed outside of the transaction, keys of aborted ones are false positives
+    transaction = beforeWrite() && store.beginTransaction();
+
+    return transaction;
+}
+
+bool BloomKVStore::commit() {
+    bool res = store.commit();
+    transaction = transaction && !res;
+
+    return res;
+}
+
+bool BloomKVStore::abort() {
+    bool res = store.abort();
+    transaction = transaction && !res;
+
+    return res;
+}
+
+typename KVStoreInterface::res_t BloomKVStore::_put(const key_t& key, const uint8_t value[], size_t len, Type t) {
+    PutEntry entry(key, value, len, t);
+    putMany(&entry, 1);
+
+    return entry.res;
+}
+
+typename KVStoreInterface::res_t BloomKVStore::_get(const key_t& key, uint8_t value[], size_t len, Type t) {
+    if(!mayContain(key)) {
+        return 0;
+    }
+
+    GetEntry entry(key, value, len, t);
+    store.getMany(&entry, 1);
+    account(entry.res > 0);
+
+    return entry.res;
+}
+
+bool BloomKVStore::_openWriter(const key_t& key, size_t total, void*& state) {
+    if(key == nullptr || !beforeWrite()) {
+        return false;
+    }
+    add(key);
+
+    return _wrapWriter(store, key, total, state);
+}
+
+bool BloomKVStore::_write(void* state, const uint8_t data[], size_t len) {
+    return _writeWrapped(state, data, len);
+}
+
+bool BloomKVStore::_closeWriter(void* state, bool commit) {
+    return _closeWrappedWriter(state, commit);
+}
+
+bool BloomKVStore::_openReader(const key_t& key, size_t& total, void*& state) {
+    if(!mayContain(key)) {
+        return false;
+    }
+
+    return _wrapReader(store, key, total, state);
+}
+
+size_t BloomKVStore::_read(void* state, size_t offset, uint8_t data[], size_t len) {
+    return _readWrapped(state, offset, data, len);
+}
+
+void BloomKVStore::_closeReader(void* state) {
+    _closeWrappedReader(state);
+}
+
+bool BloomKVStore::mayContain(const key_t& key) const {
+    if(!primed || key == nullptr) {
+        return true;
+    }
+
+    uint32_t h1, h2;
+    hash(key, h1, h2);
+
+    for(uint8_t i=0; i<hashes; i++) {
+        uint32_t bit = (h1 + i * h2) % bits;
+
+        if((filter[bit / 8] & (1 << (bit % 8))) == 0) {
+            stats.filtered++;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void BloomKVStore::add(const key_t& key) {
+    if(filter == nullptr || key == nullptr) {
+        return;
+    }
+
+    uint32_t h1, h2;
+    hash(key, h1, h2);
+
+    for(uint8_t i=0; i<hashes; i++) {
+        uint32_t bit = (h1 + i * h2) % bits;
+        filter[bit / 8] |= 1 << (bit % 8);
+    }
+}
+
+void BloomKVStore::account(bool found) const {
+    if(!primed) {
+        return;
+    }
+
+    stats.forwarded++;
+    if(!found) {
+        stats.falsePositives++;
+    }
+}
+
+bool BloomKVStore::beforeWrite() {
+    // the saved filter would miss the key being written if the session ended without end()
+    if(persisted) {
+        if(store.remove(BLOOM_FILTER_KEY) == 0 && store.exists(BLOOM_FILTER_KEY)) {
+            return false;
+        }
+
+        persisted = false;
+    }
+
+    return true;
+}
+
+bool BloomKVStore::rebuild() {
+    if(filter == nullptr) {
+        return false;
+    }
+
+    memset(filter, 0, filterBytes());
+
+    auto insert = [](const char* key, Type t, size_t len, void* ctx) -> bool {
+        (void) t;
+        (void) len;
+        ((BloomKVStore*)ctx)->add(key);
+        return true;
+    };
+
+    return store.forEach("", insert, this);
+}
+
+bool BloomKVStore::load() {
+    size_t len = sizeof(FilterHeader) + filterBytes();
+
+    if(filter == nullptr || store.getBytesLength(BLOOM_FILTER_KEY) != len) {
+        return false;
+    }
+
+    uint8_t* buf = new uint8_t[len];
+    if(buf == nullptr) {
+        return false;
+    }
+
+    FilterHeader header;
+    bool res = (size_t)store.getBytes(BLOOM_FILTER_KEY, buf, len) == len;
+    memcpy(&header, buf, sizeof(header));
+
+    // a filter saved with different parameters cannot be used
+    res = res && header.magic == FILTER_MAGIC && header.bits == bits && header.hashes == hashes;
+    if(res) {
+        memcpy(filter, buf + sizeof(header), filterBytes());
+    }
+
+    delete [] buf;
+
+    return res;
+}
+
+bool BloomKVStore::save() {
+    size_t len = sizeof(FilterHeader) + filterBytes();
+    uint8_t* buf = new uint8_t[len];
+
+    if(buf == nullptr) {
+        return false;
+    }
+
+    FilterHeader header = { FILTER_MAGIC, bits, hashes, {} };
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + sizeof(header), filter, filterBytes());
+
+    persisted = (size_t)store.putBytes(BLOOM_FILTER_KEY, buf, len) == len;
+    delete [] buf;
+
+    return persisted;
+}
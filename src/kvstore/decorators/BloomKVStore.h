@@ -0,0 +1,126 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "../kvstore.h"
+
+constexpr size_t DEFAULT_BLOOM_EXPECTED_KEYS = 256;
+constexpr float DEFAULT_BLOOM_FALSE_POSITIVE_RATE = 0.01;
+constexpr size_t DEFAULT_BLOOM_MAX_BYTES = 512;
+
+// key under which the filter is saved in the underlying store
+constexpr char BLOOM_FILTER_KEY[] = "__kvbloom";
+
+/** BloomKVStore class
+ *
+ * Bloom filter that can be put in front of any KVStoreInterface, answering lookups of missing
+ * keys without reaching the underlying store. Every key written through this class is added
+ * to the filter, a lookup is forwarded to the underlying store only if the filter reports the
+ * key as possibly present.
+ *
+ * The filter is sized for expectedKeys and falsePositiveRate, within maxBytes, and it is saved
+ * in the underlying store by end(), to be loaded by the following begin(). end() fails, leaving
+ * the store open, while a transaction begun through this class is neither committed nor
+ * aborted. The saved copy is removed before the first write of a session, so that a filter missing some keys, because of
+ * a reset, is never loaded. When no filter can be loaded, begin() rebuilds it from the keys
+ * enumerated by forEach() of the underlying store. Backends that cannot enumerate their keys,
+ * e.g. UnoR4 and Nina, cannot be rebuilt: the application primes the filter with prime() and
+ * the keys it may have stored. Until a filter is loaded, rebuilt or primed, or the store is
+ * cleared, the filter is not primed and every lookup is forwarded. The saved filter is not
+ * reported by forEach(). Writers and readers wrap the ones of the underlying store
+ */
+class BloomKVStore: public KVStoreInterface {
+public:
+    struct Stats {
+        size_t filtered;        // lookups answered by the filter
+        size_t forwarded;       // lookups forwarded to the underlying store
+        size_t falsePositives;  // forwarded lookups of missing keys
+    };
+
+    BloomKVStore(KVStoreInterface& store, size_t expectedKeys=DEFAULT_BLOOM_EXPECTED_KEYS,
+        float falsePositiveRate=DEFAULT_BLOOM_FALSE_POSITIVE_RATE, size_t maxBytes=DEFAULT_BLOOM_MAX_BYTES);
+    ~BloomKVStore();
+
+    bool begin() override;
+    bool end() override;
+    bool clear() override;
+
+    typename KVStoreInterface::res_t remove(const key_t& key) override;
+    bool exists(const key_t& key) const override;
+    typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const override;
+    typename KVStoreInterface::res_t patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) override;
+    size_t getBytesLength(const key_t& key) const override;
+
+    size_t putMany(PutEntry entries[], size_t n) override;
+    using KVStoreInterface::removeMany;
+    size_t removeMany(const key_t keys[], size_t n) override;
+
+    res_t view(const key_t& key, ViewCallback cb, void* ctx=nullptr, Type t=PT_BLOB) override;
+    bool forEach(const char* prefix, KeyCallback cb, void* ctx=nullptr) override;
+
+    bool beginTransaction() override;
+    bool commit() override;
+    bool abort() override;
+
+    /**
+     * @brief prime the filter with the keys the application may have stored, for underlying
+     *        stores that cannot enumerate them. Keys missing from the list that are present
+     *        in the underlying store would be reported as missing
+     *
+     * @param[in]  keys             array of keys, missing ones are allowed
+     * @param[in]  n                the length of the array
+     *
+     * @returns true if the filter was primed, false if it could not be allocated
+     */
+    bool prime(const char* const keys[], size_t n);
+
+    inline bool isPrimed() const            { return primed; }
+    inline size_t filterBytes() const       { return (bits + 7) / 8; }
+    inline uint8_t hashCount() const        { return hashes; }
+    inline const Stats& getStats() const    { return stats; }
+    inline void resetStats()                { stats = Stats(); }
+
+protected:
+    res_t _put(const key_t& key, const uint8_t value[], size_t len, Type t) override;
+    res_t _get(const key_t& key, uint8_t value[], size_t len, Type t) override;
+
+    bool _openWriter(const key_t& key, size_t total, void*& state) override;
+    bool _write(void* state, const uint8_t data[], size_t len) override;
+    bool _closeWriter(void* state, bool commit) override;
+
+    bool _openReader(const key_t& key, size_t& total, void*& state) override;
+    size_t _read(void* state, size_t offset, uint8_t data[], size_t len) override;
+    void _closeReader(void* state) override;
+
+private:
+    // returns false if the key is surely missing
+    bool mayContain(const key_t& key) const;
+    void add(const key_t& key);
+    void account(bool found) const;
+    bool beforeWrite();
+    bool load();
+    bool save();
+    // fills the filter with the keys of the underlying store, if it can enumerate them
+    bool rebuild();
+
+    KVStoreInterface& store;
+
+    uint8_t* filter;
+    uint32_t bits;
+    uint8_t hashes;
+
+    bool primed;
+    bool persisted; // a copy of the filter may be saved in the underlying store
+    bool transaction; // a transaction was begun through the decorator and is still open
+
+    mutable Stats stats;
+};
@@ -0,0 +1,406 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "CachedKVStore.h"
+
+CachedKVStore::CachedKVStore(KVStoreInterface& store, size_t maxBytes, uint32_t maxAgeMs)
+: store(store), maxBytes(maxBytes), maxAgeMs(maxAgeMs),
+#ifdef ARDUINO
+clock([]() -> uint32_t { return millis(); }),
+#else
+clock(nullptr),
+#endif // ARDUINO
+head(nullptr), tail(nullptr), usedBytes(0), stats() {}
+
+CachedKVStore::~CachedKVStore() {
+    releaseAll();
+}
+
+bool CachedKVStore::begin() {
+    return store.begin();
+}
+
+bool CachedKVStore::end() {
+    bool res = flush();
+
+    return store.end() && res;
+}
+
+bool CachedKVStore::clear() {
+    releaseAll();
+
+    return store.clear();
+}
+
+typename KVStoreInterface::res_t CachedKVStore::remove(const key_t& key) {
+    if(!exists(key)) {
+        return 0;
+    }
+
+    Entry* e = find(key);
+    if(e == nullptr) {
+        e = insert(key);
+    } else {
+        stats.coalesced++;
+    }
+
+    if(e == nullptr) { // allocation failure, fall back to write through
+        stats.writes++;
+        return store.remove(key);
+    }
+
+    usedBytes -= footprint(e);
+    delete [] e->value;
+    e->value = nullptr;
+    e->len = 0;
+    e->removed = true;
+    usedBytes += footprint(e);
+
+    checkThresholds();
+
+    return 1;
+}
+
+bool CachedKVStore::exists(const key_t& key) const {
+    Entry* e = find(key);
+
+    return e != nullptr ? !e->removed : store.exists(key);
+}
+
+typename KVStoreInterface::res_t CachedKVStore::putBytes(const key_t& key, const uint8_t b[], size_t s) {
+    return _put(key, b, s, PT_BLOB);
+}
+
+typename KVStoreInterface::res_t CachedKVStore::getBytes(const key_t& key, uint8_t b[], size_t s) const {
+    Entry* e = find(key);
+
+    if(e == nullptr) {
+        return store.getBytes(key, b, s);
+    } else if(e->removed) {
+        return 0;
+    }
+
+    memcpy(b, e->value, s <= e->len ? s : e->len);
+
+    return e->len;
+}
+
+size_t CachedKVStore::getBytesLength(const key_t& key) const {
+    Entry* e = find(key);
+
+    if(e == nullptr) {
+        return store.getBytesLength(key);
+    }
+
+    return e->removed ? 0 : e->len;
+}
+
+typename KVStoreInterface::res_t CachedKVStore::patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) {
+    Entry* e = find(key);
+
+    if(e == nullptr) {
+        stats.writes++;
+        return store.patchBytes(key, offset, b, s);
+    } else if(e->removed || s == 0 || offset + s > e->len) {
+        return 0;
+    }
+
+    // the pending value is patched in place, keeping its type
+    memcpy(e->value + offset, b, s);
+    stats.coalesced++;
+
+    return s;
+}
+
+typename KVStoreInterface::res_t CachedKVStore::view(const key_t& key, ViewCallback cb, void* ctx, Type t) {
+    Entry* e = find(key);
+
+    if(e == nullptr) {
+        return store.view(key, cb, ctx, t);
+    } else if(e->removed) {
+        return 0;
+    }
+
+    cb(e->value, e->len, ctx);
+
+    return e->len;
+}
+
+bool CachedKVStore::forEach(const char* prefix, KeyCallback cb, void* ctx) {
+    return flush() && store.forEach(prefix, cb, ctx);
+}
+
+bool CachedKVStore::flush() {
+    size_t puts = 0, removes = 0;
+
+    for(Entry* e = head; e != nullptr; e = e->next) {
+        e->removed ? removes++ : puts++;
+    }
+
+    if(puts + removes == 0) {
+        return true;
+    }
+
+    PutEntry* putEntries = puts > 0 ? new PutEntry[puts] : nullptr;
+    key_t* removeKeys = removes > 0 ? new key_t[removes] : nullptr;
+
+    if((puts > 0 && putEntries == nullptr) || (removes > 0 && removeKeys == nullptr)) {
+        delete [] putEntries;
+        delete [] removeKeys;
+        return false;
+    }
+
+    size_t p = 0, r = 0;
+    for(Entry* e = head; e != nullptr; e = e->next) {
+        if(e->removed) {
+            removeKeys[r++] = e->key;
+        } else {
+            putEntries[p++] = PutEntry(e->key, e->value, e->len, e->type);
+        }
+    }
+
+    size_t written = puts > 0 ? store.putMany(putEntries, puts) : 0;
+    size_t removed = removes > 0 ? store.removeMany(removeKeys, removes) : 0;
+
+    stats.writes += puts + removes;
+    stats.flushes++;
+
+    // entries that failed to be written are kept in the cache, in order to be retried. Keys
+    // that were never written on the underlying store are not counted by removeMany(), they
+    // are looked up only if some removal failed
+    bool res = written == puts;
+    p = 0;
+    for(Entry* e = head; e != nullptr;) {
+        Entry* next = e->next;
+        bool done = e->removed ?
+            removed == removes || !store.exists(e->key) :
+            putEntries[p++].res > 0;
+
+        if(done) {
+            unlink(e);
+            release(e);
+        } else if(e->removed) {
+            res = false;
+        }
+        e = next;
+    }
+
+    delete [] putEntries;
+    delete [] removeKeys;
+
+    return res;
+}
+
+bool CachedKVStore::poll() {
+    if(maxAgeMs > 0 && clock != nullptr && head != nullptr && clock() - head->timestamp >= maxAgeMs) {
+        return flush();
+    }
+
+    return true;
+}
+
+typename KVStoreInterface::res_t CachedKVStore::_put(const key_t& key, const uint8_t value[], size_t len, Type t) {
+    if(key == nullptr || value == nullptr) {
+        return 0;
+    }
+
+    Entry* e = find(key);
+    size_t keyLen = strlen(key);
+
+    // values that do not fit in the cache are written through
+    if(sizeof(Entry) + keyLen + 1 + len + 1 > maxBytes) {
+        if(e != nullptr) { // the pending value is superseded by this one
+            unlink(e);
+            release(e);
+        }
+
+        PutEntry entry(key, value, len, t);
+        store.putMany(&entry, 1);
+        stats.writes++;
+
+        return entry.res;
+    }
+
+    uint8_t* buf = new uint8_t[len + 1];
+    if(buf == nullptr) {
+        return 0;
+    }
+    memcpy(buf, value, len);
+    buf[len] = '\0'; // strings are kept null terminated, as some backends expect them to be
+
+    if(e == nullptr) {
+        e = insert(key);
+
+        if(e == nullptr) {
+            delete [] buf;
+            return 0;
+        }
+    } else {
+        stats.coalesced++;
+    }
+
+    usedBytes -= footprint(e);
+    delete [] e->value;
+    e->value = buf;
+    e->len = len;
+    e->type = t;
+    e->removed = false;
+    usedBytes += footprint(e);
+
+    checkThresholds();
+
+    return len;
+}
+
+typename KVStoreInterface::res_t CachedKVStore::_get(const key_t& key, uint8_t value[], size_t len, Type t) {
+    Entry* e = find(key);
+
+    if(e == nullptr) {
+        GetEntry entry(key, value, len, t);
+        store.getMany(&entry, 1);
+
+        return entry.res;
+    } else if(e->removed) {
+        return 0;
+    }
+
+    if(t == PT_STR) {
+        if(len == 0) {
+            return 0;
+        }
+        size_t l = e->len < len - 1 ? e->len : len - 1;
+        memcpy(value, e->value, l);
+        value[l] = '\0';
+
+        return l;
+    }
+
+    memcpy(value, e->value, len <= e->len ? len : e->len);
+
+    return e->len;
+}
+
+bool CachedKVStore::_openWriter(const key_t& key, size_t total, void*& state) {
+    // pending values are written first, so that they do not replace the streamed one later
+    return flush() && _wrapWriter(store, key, total, state);
+}
+
+bool CachedKVStore::_write(void* state, const uint8_t data[], size_t len) {
+    return _writeWrapped(state, data, len);
+}
+
+bool CachedKVStore::_closeWriter(void* state, bool commit) {
+    return _closeWrappedWriter(state, commit);
+}
+
+bool CachedKVStore::_openReader(const key_t& key, size_t& total, void*& state) {
+    return flush() && _wrapReader(store, key, total, state);
+}
+
+size_t CachedKVStore::_read(void* state, size_t offset, uint8_t data[], size_t len) {
+    return _readWrapped(state, offset, data, len);
+}
+
+void CachedKVStore::_closeReader(void* state) {
+    _closeWrappedReader(state);
+}
+
+CachedKVStore::Entry* CachedKVStore::find(const key_t& key) const {
+    if(key == nullptr) {
+        return nullptr;
+    }
+
+    // the key is compared only when the hashes match
+    uint32_t hash = key.hash();
+    for(Entry* e = head; e != nullptr; e = e->next) {
+        if(e->hash == hash && strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+
+    return nullptr;
+}
+
+CachedKVStore::Entry* CachedKVStore::insert(const key_t& key) {
+    Entry* e = new Entry;
+    if(e == nullptr) {
+        return nullptr;
+    }
+
+    size_t keyLen = key.length();
+    e->key = new char[keyLen + 1];
+    if(e->key == nullptr) {
+        delete e;
+        return nullptr;
+    }
+    memcpy(e->key, key, keyLen + 1);
+
+    e->next = nullptr;
+    e->hash = key.hash();
+    e->value = nullptr;
+    e->len = 0;
+    e->type = PT_INVALID;
+    e->removed = false;
+    e->timestamp = clock != nullptr ? clock() : 0;
+
+    if(tail == nullptr) {
+        head = tail = e;
+    } else {
+        tail->next = e;
+        tail = e;
+    }
+
+    usedBytes += footprint(e);
+
+    return e;
+}
+
+void CachedKVStore::unlink(Entry* e) {
+    Entry* prev = nullptr;
+
+    for(Entry* it = head; it != nullptr && it != e; it = it->next) {
+        prev = it;
+    }
+
+    if(prev == nullptr) {
+        head = e->next;
+    } else {
+        prev->next = e->next;
+    }
+
+    if(tail == e) {
+        tail = prev;
+    }
+}
+
+void CachedKVStore::release(Entry* e) {
+    usedBytes -= footprint(e);
+
+    delete [] e->key;
+    delete [] e->value;
+    delete e;
+}
+
+void CachedKVStore::releaseAll() {
+    for(Entry* e = head; e != nullptr;) {
+        Entry* next = e->next;
+        release(e);
+        e = next;
+    }
+
+    head = tail = nullptr;
+}
+
+void CachedKVStore::checkThresholds() {
+    if(usedBytes > maxBytes) {
+        flush();
+    } else {
+        poll();
+    }
+}
@@ -0,0 +1,137 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "../kvstore.h"
+
+constexpr size_t DEFAULT_CACHE_MAX_BYTES = 512;
+
+/** CachedKVStore class
+ *
+ * Write-back cache that can be put in front of any KVStoreInterface. Written values are kept
+ * in RAM and are written to the underlying store only when flush() or end() are called,
+ * when the memory used by the cache exceeds maxBytes or when the oldest pending value
+ * is older than maxAgeMs. The age is checked by writes and by poll(), which has to be called
+ * periodically, e.g. from loop(), for values not followed by other writes to reach the
+ * underlying store in time. Consecutive writes to the same key are coalesced in a single
+ * write on the underlying store.
+ *
+ * The cache is not flushed on destruction, end() must be called in order not to lose
+ * pending writes. Opening a writer or a reader flushes the cache, they wrap the ones of the
+ * underlying store
+ */
+class CachedKVStore: public KVStoreInterface {
+public:
+    typedef uint32_t (*clock_f)();
+
+    struct Stats {
+        size_t writes;      // writes performed on the underlying store
+        size_t coalesced;   // writes absorbed by the cache
+        size_t flushes;
+    };
+
+    CachedKVStore(KVStoreInterface& store, size_t maxBytes=DEFAULT_CACHE_MAX_BYTES, uint32_t maxAgeMs=0);
+    ~CachedKVStore();
+
+    bool begin() override;
+    bool end() override;
+    bool clear() override;
+
+    typename KVStoreInterface::res_t remove(const key_t& key) override;
+    bool exists(const key_t& key) const override;
+    typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
+    using KVStoreInterface::getBytes;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
+    size_t getBytesLength(const key_t& key) const override;
+    typename KVStoreInterface::res_t patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) override;
+
+    res_t view(const key_t& key, ViewCallback cb, void* ctx=nullptr, Type t=PT_BLOB) override;
+
+    /**
+     * @brief enumerate the keys of the underlying store, pending values are flushed first
+     *        so that they are enumerated as well
+     *
+     * @returns true on correct execution, false if the flush failed or the underlying store
+     *          cannot enumerate its keys
+     */
+    bool forEach(const char* prefix, KeyCallback cb, void* ctx=nullptr) override;
+
+    /**
+     * @brief write all the pending values on the underlying store
+     *
+     * @returns true if all the pending values were written, false otherwise
+     */
+    bool flush();
+
+    /**
+     * @brief flush the cache if the oldest pending value is older than maxAgeMs
+     *
+     * @returns false if the flush failed, true otherwise
+     */
+    bool poll();
+
+    /**
+     * @brief set the function used to measure the age of pending values, by default
+     *        millis() is used on Arduino, while on other platforms age is not checked
+     *
+     * @param[in]  clock            function returning the time in milliseconds
+     */
+    inline void setClock(clock_f clock) { this->clock = clock; }
+
+    inline size_t pendingBytes() const  { return usedBytes; }
+    inline const Stats& getStats() const { return stats; }
+
+protected:
+    res_t _put(const key_t& key, const uint8_t value[], size_t len, Type t) override;
+    res_t _get(const key_t& key, uint8_t value[], size_t len, Type t) override;
+
+    bool _openWriter(const key_t& key, size_t total, void*& state) override;
+    bool _write(void* state, const uint8_t data[], size_t len) override;
+    bool _closeWriter(void* state, bool commit) override;
+
+    bool _openReader(const key_t& key, size_t& total, void*& state) override;
+    size_t _read(void* state, size_t offset, uint8_t data[], size_t len) override;
+    void _closeReader(void* state) override;
+
+private:
+    struct Entry {
+        Entry* next;
+        uint32_t hash;
+        char* key;
+        uint8_t* value;
+        size_t len;
+        Type type;
+        bool removed;
+        uint32_t timestamp;
+    };
+
+    Entry* find(const key_t& key) const;
+    Entry* insert(const key_t& key);
+    void unlink(Entry* e);
+    void release(Entry* e);
+    void releaseAll();
+    void checkThresholds();
+
+    static inline size_t footprint(const Entry* e) {
+        return sizeof(Entry) + strlen(e->key) + 1 + (e->value != nullptr ? e->len + 1 : 0);
+    }
+
+    KVStoreInterface& store;
+    const size_t maxBytes;
+    const uint32_t maxAgeMs;
+    clock_f clock;
+
+    // pending entries are kept in the order they were first modified, the head is the oldest one
+    Entry* head;
+    Entry* tail;
+    size_t usedBytes;
+
+    Stats stats;
+};
@@ -0,0 +1,216 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "KVStoreView.h"
+
+// keys of the namespace removed by a single removeMany() of clear()
+static constexpr size_t CLEAR_BATCH_KEYS = 16;
+static constexpr size_t CLEAR_BATCH_BYTES = 256;
+
+struct ClearBatch {
+    char buf[CLEAR_BATCH_BYTES];
+    KVStoreInterface::key_t keys[CLEAR_BATCH_KEYS];
+    size_t used;
+    size_t count;
+    bool full;      // the enumeration was stopped, more keys may follow
+};
+
+static bool collect(const char* key, KVStoreInterface::Type t, size_t len, void* ctx) {
+    (void) t;
+    (void) len;
+
+    ClearBatch* batch = (ClearBatch*)ctx;
+    size_t size = strlen(key) + 1;
+
+    if(batch->count == CLEAR_BATCH_KEYS || batch->used + size > sizeof(batch->buf)) {
+        batch->full = true;
+        return false;
+    }
+
+    memcpy(batch->buf + batch->used, key, size);
+    batch->keys[batch->count++] = batch->buf + batch->used;
+    batch->used += size;
+
+    return true;
+}
+
+KVStoreView::PrefixedKey::PrefixedKey(const KVStoreView& view, const char* k): key(nullptr) {
+    if(k == nullptr) {
+        return;
+    }
+
+    size_t len = strlen(k);
+    if(view.prefixLen + len > KVSTORE_VIEW_MAX_KEY_LEN) {
+        return;
+    }
+
+    memcpy(buf, view.prefix, view.prefixLen);
+    memcpy(buf + view.prefixLen, k, len + 1);
+    key = buf;
+}
+
+KVStoreView::KVStoreView(KVStoreInterface& store, const char* prefix)
+: store(store), prefix(prefix != nullptr ? prefix : ""), prefixLen(strlen(this->prefix)) {}
+
+bool KVStoreView::begin() {
+    return prefixLen < KVSTORE_VIEW_MAX_KEY_LEN;
+}
+
+bool KVStoreView::end() {
+    return true;
+}
+
+bool KVStoreView::clear() {
+    // keys cannot be removed during the enumeration, they are collected and removed in batches
+    ClearBatch batch;
+
+    do {
+        batch.used = 0;
+        batch.count = 0;
+        batch.full = false;
+
+        if(!store.forEach(prefix, collect, &batch) || (batch.full && batch.count == 0)) {
+            return false;
+        }
+
+        if(batch.count > 0 && store.removeMany(batch.keys, batch.count) != batch.count) {
+            return false;
+        }
+    } while(batch.full);
+
+    return true;
+}
+
+typename KVStoreInterface::res_t KVStoreView::remove(const key_t& key) {
+    PrefixedKey k(*this, key);
+
+    return k.key != nullptr ? store.remove(k.key) : 0;
+}
+
+bool KVStoreView::exists(const key_t& key) const {
+    PrefixedKey k(*this, key);
+
+    return k.key != nullptr && store.exists(k.key);
+}
+
+typename KVStoreInterface::res_t KVStoreView::putBytes(const key_t& key, const uint8_t b[], size_t s) {
+    PrefixedKey k(*this, key);
+
+    return k.key != nullptr ? store.putBytes(k.key, b, s) : 0;
+}
+
+typename KVStoreInterface::res_t KVStoreView::getBytes(const key_t& key, uint8_t b[], size_t s) const {
+    PrefixedKey k(*this, key);
+
+    return k.key != nullptr ? store.getBytes(k.key, b, s) : 0;
+}
+
+typename KVStoreInterface::res_t KVStoreView::getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const {
+    PrefixedKey k(*this, key);
+
+    return k.key != nullptr ? store.getBytes(k.key, offset, b, s) : 0;
+}
+
+typename KVStoreInterface::res_t KVStoreView::patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) {
+    PrefixedKey k(*this, key);
+
+    return k.key != nullptr ? store.patchBytes(k.key, offset, b, s) : 0;
+}
+
+size_t KVStoreView::getBytesLength(const key_t& key) const {
+    PrefixedKey k(*this, key);
+
+    return k.key != nullptr ? store.getBytesLength(k.key) : 0;
+}
+
+typename KVStoreInterface::res_t KVStoreView::view(const key_t& key, ViewCallback cb, void* ctx, Type t) {
+    PrefixedKey k(*this, key);
+
+    return k.key != nullptr ? store.view(k.key, cb, ctx, t) : 0;
+}
+
+bool KVStoreView::forEach(const char* prefix, KeyCallback cb, void* ctx) {
+    PrefixedKey k(*this, prefix != nullptr ? prefix : "");
+
+    struct Forward {
+        KeyCallback cb;
+        void* ctx;
+        size_t prefixLen;
+    } forward = { cb, ctx, prefixLen };
+
+    // keys are reported without the prefix of the view
+    auto strip = [](const char* key, Type t, size_t len, void* ctx) -> bool {
+        Forward* f = (Forward*)ctx;
+        return f->cb(key + f->prefixLen, t, len, f->ctx);
+    };
+
+    return cb != nullptr && k.key != nullptr && store.forEach(k.key, strip, &forward);
+}
+
+bool KVStoreView::beginTransaction() {
+    return store.beginTransaction();
+}
+
+bool KVStoreView::commit() {
+    return store.commit();
+}
+
+bool KVStoreView::abort() {
+    return store.abort();
+}
+
+typename KVStoreInterface::res_t KVStoreView::_put(const key_t& key, const uint8_t value[], size_t len, Type t) {
+    PrefixedKey k(*this, key);
+    if(k.key == nullptr) {
+        return 0;
+    }
+
+    PutEntry entry(k.key, value, len, t);
+    store.putMany(&entry, 1);
+
+    return entry.res;
+}
+
+typename KVStoreInterface::res_t KVStoreView::_get(const key_t& key, uint8_t value[], size_t len, Type t) {
+    PrefixedKey k(*this, key);
+    if(k.key == nullptr) {
+        return 0;
+    }
+
+    GetEntry entry(k.key, value, len, t);
+    store.getMany(&entry, 1);
+
+    return entry.res;
+}
+
+bool KVStoreView::_openWriter(const key_t& key, size_t total, void*& state) {
+    PrefixedKey k(*this, key);
+    return k.key != nullptr && _wrapWriter(store, k.key, total, state);
+}
+
+bool KVStoreView::_write(void* state, const uint8_t data[], size_t len) {
+    return _writeWrapped(state, data, len);
+}
+
+bool KVStoreView::_closeWriter(void* state, bool commit) {
+    return _closeWrappedWriter(state, commit);
+}
+
+bool KVStoreView::_openReader(const key_t& key, size_t& total, void*& state) {
+    PrefixedKey k(*this, key);
+    return k.key != nullptr && _wrapReader(store, k.key, total, state);
+}
+
+size_t KVStoreView::_read(void* state, size_t offset, uint8_t data[], size_t len) {
+    return _readWrapped(state, offset, data, len);
+}
+
+void KVStoreView::_closeReader(void* state) {
+    _closeWrappedReader(state);
+}
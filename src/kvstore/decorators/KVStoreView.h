@@ -0,0 +1,79 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "../kvstore.h"
+
+// longest key, prefix included, that a view can pass to the underlying store
+constexpr size_t KVSTORE_VIEW_MAX_KEY_LEN = 128;
+
+/** KVStoreView class
+ *
+ * Namespace over a KVStoreInterface shared by several modules. Every key is prefixed before
+ * reaching the underlying store, and clear() removes only the keys of the namespace.
+ * Prefixed keys are built on the stack. The prefix is not copied and must outlive the view.
+ * The underlying store still applies its own limits to prefixed keys, e.g. 15 characters on
+ * ESP32.
+ *
+ * The underlying store is shared, so its owner begins and ends it. begin() and end() of a
+ * view do not reach it. clear() and forEach() work only if the underlying store can
+ * enumerate its keys. Writers and readers opened on a view wrap the ones of the underlying store
+ */
+class KVStoreView: public KVStoreInterface {
+public:
+    KVStoreView(KVStoreInterface& store, const char* prefix);
+
+    bool begin() override;
+    bool end() override;
+    bool clear() override;
+
+    typename KVStoreInterface::res_t remove(const key_t& key) override;
+    bool exists(const key_t& key) const override;
+    typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const override;
+    typename KVStoreInterface::res_t patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) override;
+    size_t getBytesLength(const key_t& key) const override;
+
+    res_t view(const key_t& key, ViewCallback cb, void* ctx=nullptr, Type t=PT_BLOB) override;
+    bool forEach(const char* prefix, KeyCallback cb, void* ctx=nullptr) override;
+
+    bool beginTransaction() override;
+    bool commit() override;
+    bool abort() override;
+
+    inline const char* getPrefix() const    { return prefix; }
+
+protected:
+    res_t _put(const key_t& key, const uint8_t value[], size_t len, Type t) override;
+    res_t _get(const key_t& key, uint8_t value[], size_t len, Type t) override;
+
+    // writers and readers of the underlying store are wrapped, so that its native streaming is used
+    bool _openWriter(const key_t& key, size_t total, void*& state) override;
+    bool _write(void* state, const uint8_t data[], size_t len) override;
+    bool _closeWriter(void* state, bool commit) override;
+
+    bool _openReader(const key_t& key, size_t& total, void*& state) override;
+    size_t _read(void* state, size_t offset, uint8_t data[], size_t len) override;
+    void _closeReader(void* state) override;
+
+private:
+    // key of the underlying store, key is nullptr if it does not fit in buf
+    struct PrefixedKey {
+        PrefixedKey(const KVStoreView& view, const char* k);
+
+        char buf[KVSTORE_VIEW_MAX_KEY_LEN + 1];
+        const char* key;
+    };
+
+    KVStoreInterface& store;
+    const char* prefix;
+    size_t prefixLen;
+};
@@ -0,0 +1,395 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "ReadCacheKVStore.h"
+
+ReadCacheKVStore::ReadCacheKVStore(KVStoreInterface& store, size_t maxBytes)
+: store(store), maxBytes(maxBytes), head(nullptr), tail(nullptr), usedBytes(0), stats() {}
+
+ReadCacheKVStore::~ReadCacheKVStore() {
+    invalidate();
+}
+
+bool ReadCacheKVStore::begin() {
+    invalidate();
+
+    return store.begin();
+}
+
+bool ReadCacheKVStore::end() {
+    invalidate();
+
+    return store.end();
+}
+
+bool ReadCacheKVStore::clear() {
+    invalidate();
+
+    return store.clear();
+}
+
+typename KVStoreInterface::res_t ReadCacheKVStore::remove(const key_t& key) {
+    invalidate(key);
+
+    return store.remove(key);
+}
+
+bool ReadCacheKVStore::exists(const key_t& key) const {
+    Entry* e = find(key);
+
+    if(e != nullptr) {
+        stats.hits++;
+        touch(e);
+
+        return e->type != PT_INVALID;
+    }
+
+    stats.misses++;
+    bool res = store.exists(key);
+
+    if(!res) {
+        insert(key, nullptr, 0, PT_INVALID);
+    }
+
+    return res;
+}
+
+typename KVStoreInterface::res_t ReadCacheKVStore::putBytes(const key_t& key, const uint8_t b[], size_t s) {
+    invalidate(key);
+
+    return store.putBytes(key, b, s);
+}
+
+typename KVStoreInterface::res_t ReadCacheKVStore::getBytes(const key_t& key, uint8_t b[], size_t s) const {
+    Entry* e = find(key);
+
+    if(e != nullptr && (e->type == PT_BLOB || e->type == PT_INVALID)) {
+        stats.hits++;
+        touch(e);
+
+        if(e->type == PT_INVALID) {
+            return 0;
+        }
+
+        memcpy(b, e->value, s <= e->len ? s : e->len);
+        return e->len;
+    }
+
+    stats.misses++;
+    res_t res = store.getBytes(key, b, s);
+
+    if(res > 0 && (size_t)res <= s) {
+        insert(key, b, res, PT_BLOB);
+    }
+
+    return res;
+}
+
+size_t ReadCacheKVStore::getBytesLength(const key_t& key) const {
+    Entry* e = find(key);
+
+    if(e != nullptr) {
+        stats.hits++;
+        touch(e);
+
+        return e->len;
+    }
+
+    stats.misses++;
+
+    return store.getBytesLength(key);
+}
+
+typename KVStoreInterface::res_t ReadCacheKVStore::patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) {
+    invalidate(key);
+
+    return store.patchBytes(key, offset, b, s);
+}
+
+size_t ReadCacheKVStore::putMany(PutEntry entries[], size_t n) {
+    for(size_t i=0; i<n; i++) {
+        invalidate(entries[i].key);
+    }
+
+    return store.putMany(entries, n);
+}
+
+size_t ReadCacheKVStore::removeMany(const key_t keys[], size_t n) {
+    for(size_t i=0; i<n; i++) {
+        invalidate(keys[i]);
+    }
+
+    return store.removeMany(keys, n);
+}
+
+typename KVStoreInterface::res_t ReadCacheKVStore::view(const key_t& key, ViewCallback cb, void* ctx, Type t) {
+    Entry* e = find(key);
+
+    if(e != nullptr && (e->type == t || e->type == PT_INVALID)) {
+        stats.hits++;
+        touch(e);
+
+        if(e->type == PT_INVALID) {
+            return 0;
+        }
+
+        cb(e->value, e->len, ctx);
+        return e->len;
+    }
+
+    stats.misses++;
+
+    // the value provided by the underlying store is cached before being handed to the caller
+    struct Trampoline {
+        const ReadCacheKVStore* self;
+        const key_t& key;
+        Type t;
+        ViewCallback cb;
+        void* ctx;
+    } trampoline = { this, key, t, cb, ctx };
+
+    return store.view(key, [](const uint8_t value[], size_t len, void* ctx) {
+        Trampoline* tr = (Trampoline*)ctx;
+
+        tr->self->insert(tr->key, value, len, tr->t);
+        tr->cb(value, len, tr->ctx);
+    }, &trampoline, t);
+}
+
+bool ReadCacheKVStore::beginTransaction() {
+    return store.beginTransaction();
+}
+
+bool ReadCacheKVStore::forEach(const char* prefix, KeyCallback cb, void* ctx) {
+    // enumeration does not read values, there is nothing to cache
+    return store.forEach(prefix, cb, ctx);
+}
+
+bool ReadCacheKVStore::commit() {
+    // values read during the transaction were the committed ones
+    invalidate();
+
+    return store.commit();
+}
+
+bool ReadCacheKVStore::abort() {
+    return store.abort();
+}
+
+void ReadCacheKVStore::invalidate() {
+    for(Entry* e = head; e != nullptr;) {
+        Entry* next = e->next;
+        release(e);
+        e = next;
+    }
+
+    head = tail = nullptr;
+}
+
+typename KVStoreInterface::res_t ReadCacheKVStore::_put(const key_t& key, const uint8_t value[], size_t len, Type t) {
+    invalidate(key);
+
+    PutEntry entry(key, value, len, t);
+    store.putMany(&entry, 1);
+
+    return entry.res;
+}
+
+typename KVStoreInterface::res_t ReadCacheKVStore::_get(const key_t& key, uint8_t value[], size_t len, Type t) {
+    Entry* e = find(key);
+
+    if(e != nullptr && (e->type == t || e->type == PT_INVALID)) {
+        stats.hits++;
+        touch(e);
+
+        if(e->type == PT_INVALID) {
+            return 0;
+        } else if(t == PT_STR) {
+            if(len == 0) {
+                return 0;
+            }
+            size_t l = e->len < len - 1 ? e->len : len - 1;
+            memcpy(value, e->value, l);
+            value[l] = '\0';
+
+            return l;
+        }
+
+        memcpy(value, e->value, len <= e->len ? len : e->len);
+        return e->len;
+    }
+
+    stats.misses++;
+
+    GetEntry entry(key, value, len, t);
+    store.getMany(&entry, 1);
+
+    // values that did not fit the buffer are not cached, strings need room for the terminator
+    if(entry.res > 0 && (t == PT_STR ? (size_t)entry.res < len : (size_t)entry.res <= len)) {
+        insert(key, value, entry.res, t);
+    }
+
+    return entry.res;
+}
+
+bool ReadCacheKVStore::_openWriter(const key_t& key, size_t total, void*& state) {
+    invalidate(key);
+
+    return _wrapWriter(store, key, total, state);
+}
+
+bool ReadCacheKVStore::_write(void* state, const uint8_t data[], size_t len) {
+    return _writeWrapped(state, data, len);
+}
+
+bool ReadCacheKVStore::_closeWriter(void* state, bool commit) {
+    // the key is not known here, the value may have been cached while it was being written
+    bool res = _closeWrappedWriter(state, commit);
+    invalidate();
+
+    return res;
+}
+
+bool ReadCacheKVStore::_openReader(const key_t& key, size_t& total, void*& state) {
+    return _wrapReader(store, key, total, state);
+}
+
+size_t ReadCacheKVStore::_read(void* state, size_t offset, uint8_t data[], size_t len) {
+    return _readWrapped(state, offset, data, len);
+}
+
+void ReadCacheKVStore::_closeReader(void* state) {
+    _closeWrappedReader(state);
+}
+
+ReadCacheKVStore::Entry* ReadCacheKVStore::find(const key_t& key) const {
+    if(key == nullptr) {
+        return nullptr;
+    }
+
+    // the hash of the key is computed once, by KVKey
+    for(Entry* e = head; e != nullptr; e = e->next) {
+        if(e->hash == key.hash() && strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+
+    return nullptr;
+}
+
+void ReadCacheKVStore::insert(const key_t& key, const uint8_t value[], size_t len, Type t) const {
+    if(key == nullptr) {
+        return;
+    }
+
+    // a key has a single entry, whatever the type it was read with
+    drop(key);
+
+    size_t keyLen = key.length();
+    size_t size = sizeof(Entry) + keyLen + 1 + len;
+
+    if(size > maxBytes) {
+        return;
+    }
+
+    // evict the least recently used entries until the new one fits
+    while(tail != nullptr && usedBytes + size > maxBytes) {
+        Entry* e = tail;
+        unlink(e);
+        release(e);
+        stats.evictions++;
+    }
+
+    Entry* e = new Entry;
+    if(e == nullptr) {
+        return;
+    }
+    e->key = new char[keyLen + 1];
+    e->value = len > 0 ? new uint8_t[len] : nullptr;
+
+    if(e->key == nullptr || (len > 0 && e->value == nullptr)) {
+        delete [] e->key;
+        delete [] e->value;
+        delete e;
+        return;
+    }
+
+    memcpy(e->key, key, keyLen + 1);
+    if(len > 0) {
+        memcpy(e->value, value, len);
+    }
+    e->hash = key.hash();
+    e->len = len;
+    e->type = t;
+
+    e->prev = nullptr;
+    e->next = head;
+    if(head != nullptr) {
+        head->prev = e;
+    }
+    head = e;
+    if(tail == nullptr) {
+        tail = e;
+    }
+
+    usedBytes += footprint(e);
+}
+
+void ReadCacheKVStore::invalidate(const key_t& key) {
+    drop(key);
+}
+
+void ReadCacheKVStore::drop(const key_t& key) const {
+    for(Entry* e = find(key); e != nullptr; e = find(key)) {
+        unlink(e);
+        release(e);
+    }
+}
+
+void ReadCacheKVStore::unlink(Entry* e) const {
+    if(e->prev != nullptr) {
+        e->prev->next = e->next;
+    } else {
+        head = e->next;
+    }
+
+    if(e->next != nullptr) {
+        e->next->prev = e->prev;
+    } else {
+        tail = e->prev;
+    }
+}
+
+void ReadCacheKVStore::touch(Entry* e) const {
+    if(e == head) {
+        return;
+    }
+
+    // unlink
+    e->prev->next = e->next;
+    if(e->next != nullptr) {
+        e->next->prev = e->prev;
+    } else {
+        tail = e->prev;
+    }
+
+    // move in front
+    e->prev = nullptr;
+    e->next = head;
+    head->prev = e;
+    head = e;
+}
+
+void ReadCacheKVStore::release(Entry* e) const {
+    usedBytes -= footprint(e);
+
+    delete [] e->key;
+    delete [] e->value;
+    delete e;
+}
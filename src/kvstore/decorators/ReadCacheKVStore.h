@@ -0,0 +1,113 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "../kvstore.h"
+
+constexpr size_t DEFAULT_READ_CACHE_MAX_BYTES = 512;
+
+/** ReadCacheKVStore class
+ *
+ * Read-through cache that can be put in front of any KVStoreInterface. Values read from the
+ * underlying store are kept in RAM and the least recently used ones are evicted when the
+ * memory used exceeds maxBytes. Keys that were found missing by exists() are remembered as well,
+ * so that probing for them again does not reach the underlying store.
+ *
+ * Every write performed through this class invalidates the cached value of the key, writes
+ * performed directly on the underlying store are not seen by the cache. Writers and readers
+ * wrap the ones of the underlying store, closing a writer invalidates the whole cache
+ */
+class ReadCacheKVStore: public KVStoreInterface {
+public:
+    struct Stats {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+    };
+
+    ReadCacheKVStore(KVStoreInterface& store, size_t maxBytes=DEFAULT_READ_CACHE_MAX_BYTES);
+    ~ReadCacheKVStore();
+
+    bool begin() override;
+    bool end() override;
+    bool clear() override;
+
+    typename KVStoreInterface::res_t remove(const key_t& key) override;
+    bool exists(const key_t& key) const override;
+    typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
+    using KVStoreInterface::getBytes;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
+    size_t getBytesLength(const key_t& key) const override;
+    typename KVStoreInterface::res_t patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) override;
+
+    size_t putMany(PutEntry entries[], size_t n) override;
+    using KVStoreInterface::removeMany;
+    size_t removeMany(const key_t keys[], size_t n) override;
+
+    res_t view(const key_t& key, ViewCallback cb, void* ctx=nullptr, Type t=PT_BLOB) override;
+    bool forEach(const char* prefix, KeyCallback cb, void* ctx=nullptr) override;
+
+    bool beginTransaction() override;
+    bool commit() override;
+    bool abort() override;
+
+    /**
+     * @brief drop all the cached values
+     */
+    void invalidate();
+
+    inline size_t cachedBytes() const    { return usedBytes; }
+    inline const Stats& getStats() const { return stats; }
+    inline void resetStats()             { stats = Stats(); }
+
+protected:
+    res_t _put(const key_t& key, const uint8_t value[], size_t len, Type t) override;
+    res_t _get(const key_t& key, uint8_t value[], size_t len, Type t) override;
+
+    bool _openWriter(const key_t& key, size_t total, void*& state) override;
+    bool _write(void* state, const uint8_t data[], size_t len) override;
+    bool _closeWriter(void* state, bool commit) override;
+
+    bool _openReader(const key_t& key, size_t& total, void*& state) override;
+    size_t _read(void* state, size_t offset, uint8_t data[], size_t len) override;
+    void _closeReader(void* state) override;
+
+private:
+    struct Entry {
+        Entry* prev;
+        Entry* next;
+        uint32_t hash;
+        char* key;
+        uint8_t* value;
+        size_t len;
+        Type type;      // the kind of access that populated the entry, PT_INVALID for missing keys
+    };
+
+    Entry* find(const key_t& key) const;
+    void insert(const key_t& key, const uint8_t value[], size_t len, Type t) const;
+    void invalidate(const key_t& key);
+    void drop(const key_t& key) const;
+    void unlink(Entry* e) const;
+    void touch(Entry* e) const;
+    void release(Entry* e) const;
+
+    static inline size_t footprint(const Entry* e) {
+        return sizeof(Entry) + strlen(e->key) + 1 + e->len;
+    }
+
+    KVStoreInterface& store;
+    const size_t maxBytes;
+
+    // reads update the cache, hence these members are mutable
+    mutable Entry* head;  // most recently used
+    mutable Entry* tail;  // least recently used
+    mutable size_t usedBytes;
+    mutable Stats stats;
+};
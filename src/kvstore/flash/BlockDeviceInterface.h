@@ -0,0 +1,72 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/** BlockDeviceInterface class
+ *
+ * Interface for HW abstraction of a flash device, modelled after mbed BlockDevice.
+ * Memory must be erased, in blocks of getEraseSize() bytes, before being programmed,
+ * in chunks multiple of getProgramSize() bytes
+ */
+class BlockDeviceInterface {
+public:
+    typedef int res_t;
+
+    enum: res_t {
+        BD_OK           = 0,
+        BD_ERROR        = -1,
+        BD_ERROR_PARAM  = -2,
+        BD_ERROR_POWER  = -3,
+    };
+
+    virtual ~BlockDeviceInterface() {}
+
+    virtual res_t init() = 0;
+    virtual res_t deinit() = 0;
+
+    /**
+     * @brief read from the device
+     *
+     * @param[out] buf              destination buffer
+     * @param[in]  addr             address to read from
+     * @param[in]  size             number of bytes to read
+     *
+     * @returns BD_OK on correct execution, a negative error otherwise
+     */
+    virtual res_t read(void* buf, uint32_t addr, uint32_t size) = 0;
+
+    /**
+     * @brief program an erased area of the device
+     *
+     * @param[in]  buf              source buffer
+     * @param[in]  addr             address to program, aligned to getProgramSize()
+     * @param[in]  size             number of bytes to program, multiple of getProgramSize()
+     *
+     * @returns BD_OK on correct execution, a negative error otherwise
+     */
+    virtual res_t program(const void* buf, uint32_t addr, uint32_t size) = 0;
+
+    /**
+     * @brief erase blocks of the device
+     *
+     * @param[in]  addr             address to erase, aligned to getEraseSize()
+     * @param[in]  size             number of bytes to erase, multiple of getEraseSize()
+     *
+     * @returns BD_OK on correct execution, a negative error otherwise
+     */
+    virtual res_t erase(uint32_t addr, uint32_t size) = 0;
+
+    virtual uint32_t size() const = 0;
+    virtual uint32_t getEraseSize() const = 0;
+    virtual uint32_t getProgramSize() const = 0;
+    virtual uint8_t getEraseValue() const { return 0xFF; }
+};
@@ -0,0 +1,1407 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "FlashKVStore.h"
+#include "../utility/crc.h"
+#include <string.h>
+
+static constexpr uint32_t AREA_MAGIC = 0x4146564B;      // "KVFA"
+static constexpr uint32_t RECORD_MAGIC = 0x5246564B;    // "KVFR"
+static constexpr uint32_t CHECKPOINT_MAGIC = 0x4346564B;    // "KVFC"
+static constexpr uint16_t FORMAT_VERSION = 1;
+static constexpr uint8_t RECORD_REMOVED = 0x01;
+static constexpr uint8_t RECORD_CHECKPOINT = 0x02;     // the index, it has no key
+static constexpr uint8_t RECORD_TRAILER = 0x04;        // the crc of the value follows it
+static constexpr uint8_t RECORD_TRANSACTION = 0x08;    // the records of a transaction follow it, it has no key
+
+// patchBytes() copies the current value to the new record through a stack buffer of this size
+static constexpr size_t FLASH_PATCH_COPY_SIZE = 64;
+
+static constexpr uint32_t EMPTY_SLOT = 0xFFFFFFFF;
+static constexpr size_t NOT_FOUND = SIZE_MAX;
+static constexpr size_t INITIAL_CAPACITY = 16;
+static constexpr size_t PROGRAM_BUFFER_SIZE = 64;
+
+// steps performed for every budget when no clock is available
+static constexpr size_t UNTIMED_GC_STEPS = 8;
+
+struct AreaHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t generation;
+    uint32_t crc;       // of the fields above
+};
+
+static_assert(sizeof(AreaHeader) == 16, "AreaHeader must not be padded");
+
+// value of a checkpoint record, followed by the slots of the index holding a key
+struct Checkpoint {
+    uint32_t generation;
+    uint32_t garbage;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(Checkpoint) == 16, "Checkpoint must not be padded");
+
+// programmed at the end of the active area after a checkpoint record
+struct CheckpointSlot {
+    uint32_t magic;
+    uint32_t address;   // of the checkpoint record
+    uint32_t generation;
+    uint32_t crc;       // of the fields above
+};
+
+static_assert(sizeof(CheckpointSlot) == 16, "CheckpointSlot must not be padded");
+
+// value of a transaction marker record
+struct TransactionMarker {
+    uint32_t count;     // of the records that follow the marker
+    uint32_t size;      // of the records that follow the marker
+};
+
+static_assert(sizeof(TransactionMarker) == 8, "TransactionMarker must not be padded");
+
+FlashKVStore::FlashKVStore(BlockDeviceInterface& bd, size_t checkpointSlots)
+: bd(bd), mounted(false), area(0), headerSize(0), active(0), generation(0), tail(0), garbage(0),
+checkpointSlots(checkpointSlots), slotSize(0), phase(GC_IDLE), gcCursor(0), gcTail(0), gcStart(0), gcGarbage(0), gcBudgetUs(0), gcStartRatio(DEFAULT_GC_START_RATIO),
+#ifdef ARDUINO
+clock([]() -> uint32_t { return micros(); }),
+#else
+clock(nullptr),
+#endif // ARDUINO
+slots(nullptr), capacity(0), count(0), buf(nullptr), bufSize(0),
+streaming(false), streamCursor(), streamAddress(0), streamLen(0), streamCrc(0), streamKeyLen(0),
+transaction(false), stats() {
+    static_assert(sizeof(RecordHeader) == 16, "RecordHeader must not be padded");
+}
+
+bool FlashKVStore::begin() {
+    if(mounted || bd.init() != BlockDeviceInterface::BD_OK) {
+        return false;
+    }
+
+    uint32_t eraseSize = bd.getEraseSize();
+    uint32_t programSize = bd.getProgramSize();
+
+    if(eraseSize == 0 || programSize == 0 || bd.size() / eraseSize < 2) {
+        return false;
+    }
+
+    area = bd.size() / eraseSize / 2 * eraseSize;
+    headerSize = align(sizeof(AreaHeader), programSize);
+    slotSize = align(sizeof(CheckpointSlot), programSize);
+    bufSize = align(PROGRAM_BUFFER_SIZE, programSize);
+
+    if(headerSize + checkpointSlots * slotSize >= area) {
+        return false;
+    }
+
+    buf = new uint8_t[bufSize];
+
+    if(buf == nullptr || !mount()) {
+        end();
+        return false;
+    }
+
+    return true;
+}
+
+bool FlashKVStore::end() {
+    if(buf == nullptr) {
+        return false;
+    }
+
+    if(streaming) {
+        _closeWriter(this, false);
+    }
+
+    abort();
+
+    // a failed checkpoint only makes the next begin() slower
+    if(mounted) {
+        writeCheckpoint();
+    }
+
+    releaseIndex();
+
+    delete [] buf;
+    buf = nullptr;
+    mounted = false;
+
+    return bd.deinit() == BlockDeviceInterface::BD_OK;
+}
+
+bool FlashKVStore::clear() {
+    // collecting an empty index writes an empty area
+    return mounted && !streaming && !transaction && resetIndex() && gc();
+}
+
+typename KVStoreInterface::res_t FlashKVStore::remove(const key_t& key) {
+    if(!mounted || key == nullptr) {
+        return 0;
+    }
+
+    size_t keyLen = key.length();
+    uint32_t address;
+
+    if(transaction) {
+        bool removed;
+        bool found = journal.staged(key, removed) ? !removed : find(key) != NOT_FOUND;
+
+        return found && journal.remove(key) ? 1 : 0;
+    }
+
+    if(find(key) == NOT_FOUND ||
+            !writeRecord(key, keyLen, nullptr, 0, PT_INVALID, RECORD_REMOVED, address)) {
+        return 0;
+    }
+
+    apply(key, address, recordSize(keyLen, 0), true);
+    if(gcBudgetUs > 0) {
+        collect(gcBudgetUs);
+    }
+
+    return 1;
+}
+
+bool FlashKVStore::exists(const key_t& key) const {
+    if(!mounted || key == nullptr) {
+        return false;
+    }
+
+    return find(key) != NOT_FOUND;
+}
+
+typename KVStoreInterface::res_t FlashKVStore::putBytes(const key_t& key, const uint8_t b[], size_t s) {
+    return _put(key, b, s, PT_BLOB);
+}
+
+typename KVStoreInterface::res_t FlashKVStore::getBytes(const key_t& key, uint8_t b[], size_t s) const {
+    if(!mounted || key == nullptr) {
+        return 0;
+    }
+
+    RecordHeader header;
+    size_t i = find(key, &header);
+
+    if(i == NOT_FOUND) {
+        return 0;
+    }
+
+    size_t toRead = s <= header.len ? s : header.len;
+
+    if(toRead > 0 && bd.read(b, valueAddress(slots[i].address, header), toRead) != BlockDeviceInterface::BD_OK) {
+        return 0;
+    }
+
+    return header.len;
+}
+
+typename KVStoreInterface::res_t FlashKVStore::getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const {
+    if(!mounted || key == nullptr) {
+        return 0;
+    }
+
+    RecordHeader header;
+    size_t i = find(key, &header);
+
+    if(i == NOT_FOUND || offset >= header.len) {
+        return 0;
+    }
+
+    size_t toRead = s <= header.len - offset ? s : header.len - offset;
+
+    if(bd.read(b, valueAddress(slots[i].address, header) + offset, toRead) != BlockDeviceInterface::BD_OK) {
+        return 0;
+    }
+
+    return toRead;
+}
+
+typename KVStoreInterface::res_t FlashKVStore::patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) {
+    if(!mounted || key == nullptr) {
+        return 0;
+    }
+
+    RecordHeader header;
+
+    if(s == 0 || find(key, &header) == NOT_FOUND || offset + s > header.len ||
+            !startStream(key, header.len, (Type)header.type)) {
+        return 0;
+    }
+
+    // starting the record may have collected garbage, moving the current one
+    size_t i = find(key, &header);
+    uint32_t value = valueAddress(slots[i].address, header);
+
+    // the current value is copied a chunk at a time, it stays indexed until the new record is complete
+    uint8_t chunk[FLASH_PATCH_COPY_SIZE];
+    bool res = true;
+
+    for(size_t done=0; res && done < header.len;) {
+        if(done == offset) {
+            res = _write(this, b, s);
+            done += s;
+            continue;
+        }
+
+        size_t end = done < offset ? offset : header.len;
+        size_t n = end - done < sizeof(chunk) ? end - done : sizeof(chunk);
+
+        res = bd.read(chunk, value + done, n) == BlockDeviceInterface::BD_OK && _write(this, chunk, n);
+        done += n;
+    }
+
+    return _closeWriter(this, res) ? s : 0;
+}
+
+size_t FlashKVStore::getBytesLength(const key_t& key) const {
+    if(!mounted || key == nullptr) {
+        return 0;
+    }
+
+    RecordHeader header;
+
+    return find(key, &header) != NOT_FOUND ? header.len : 0;
+}
+
+typename KVStoreInterface::res_t FlashKVStore::view(const key_t& key, ViewCallback cb, void* ctx, Type t) {
+    (void) t;
+
+    if(!mounted || key == nullptr) {
+        return 0;
+    }
+
+    RecordHeader header;
+    size_t i = find(key, &header);
+
+    if(i == NOT_FOUND || header.len == 0) {
+        return 0;
+    }
+
+    uint8_t stackBuf[VIEW_BUFFER_SIZE];
+    uint8_t* value = header.len <= sizeof(stackBuf) ? stackBuf : new uint8_t[header.len];
+
+    if(value == nullptr) {
+        return 0;
+    }
+
+    res_t res = 0;
+    if(bd.read(value, valueAddress(slots[i].address, header), header.len) == BlockDeviceInterface::BD_OK) {
+        cb(value, header.len, ctx);
+        res = header.len;
+    }
+
+    if(value != stackBuf) {
+        delete [] value;
+    }
+
+    return res;
+}
+
+bool FlashKVStore::forEach(const char* prefix, KeyCallback cb, void* ctx) {
+    if(!mounted || cb == nullptr) {
+        return false;
+    }
+
+    if(prefix == nullptr) {
+        prefix = "";
+    }
+    size_t prefixLen = strlen(prefix);
+
+    // only the header and the key of the live records are read, values are never touched
+    for(size_t i=0; i<capacity; i++) {
+        if(slots[i].address == EMPTY_SLOT) {
+            continue;
+        }
+
+        RecordHeader header;
+        char key[FLASH_KVSTORE_MAX_KEY_LEN + 1];
+
+        if(!readHeader(slots[i].address, header) || header.keyLen > FLASH_KVSTORE_MAX_KEY_LEN) {
+            return false;
+        } else if(header.keyLen < prefixLen) {
+            continue;
+        }
+
+        if(bd.read(key, slots[i].address + sizeof(header), header.keyLen) != BlockDeviceInterface::BD_OK) {
+            return false;
+        }
+        key[header.keyLen] = '\0';
+
+        if(memcmp(key, prefix, prefixLen) == 0 && !cb(key, (Type)header.type, header.len, ctx)) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool FlashKVStore::beginTransaction() {
+    if(!mounted || streaming || transaction) {
+        return false;
+    }
+
+    transaction = true;
+
+    return true;
+}
+
+bool FlashKVStore::commit() {
+    if(!mounted || !transaction) {
+        return false;
+    }
+
+    transaction = false;
+    bool res = writeTransaction();
+    journal.clear();
+
+    if(res && gcBudgetUs > 0) {
+        collect(gcBudgetUs);
+    }
+
+    return res;
+}
+
+bool FlashKVStore::abort() {
+    if(!transaction) {
+        return false;
+    }
+
+    transaction = false;
+    journal.clear();
+
+    return true;
+}
+
+bool FlashKVStore::gc() {
+    if(buf == nullptr || slots == nullptr || streaming || (phase == GC_IDLE && !startGC())) {
+        return false;
+    }
+
+    while(phase != GC_IDLE) {
+        if(!stepGC()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FlashKVStore::setIncrementalGC(uint32_t budgetUs, float startRatio) {
+    gcBudgetUs = budgetUs;
+    gcStartRatio = startRatio;
+}
+
+bool FlashKVStore::maintenance(uint32_t budgetUs) {
+    if(!mounted || streaming) {
+        return phase != GC_IDLE;
+    }
+
+    collect(budgetUs);
+
+    return phase != GC_IDLE;
+}
+
+typename KVStoreInterface::res_t FlashKVStore::_put(const key_t& key, const uint8_t value[], size_t len, Type t) {
+    if(!mounted || key == nullptr || (value == nullptr && len > 0)) {
+        return 0;
+    }
+
+    size_t keyLen = key.length();
+    uint32_t address;
+
+    if(keyLen == 0 || keyLen > FLASH_KVSTORE_MAX_KEY_LEN) {
+        return 0;
+    } else if(transaction) {
+        return journal.put(key, value, len, t) ? len : 0;
+    }
+
+    if(!writeRecord(key, keyLen, value, len, t, 0, address) ||
+            !apply(key, address, recordSize(keyLen, len), false)) {
+        return 0;
+    }
+
+    if(gcBudgetUs > 0) {
+        collect(gcBudgetUs);
+    }
+
+    return len;
+}
+
+bool FlashKVStore::_openWriter(const key_t& key, size_t total, void*& state) {
+    if(key == nullptr || !startStream(key, total, PT_BLOB)) {
+        return false;
+    }
+
+    state = this;
+
+    return true;
+}
+
+bool FlashKVStore::startStream(const char* key, size_t total, Type t) {
+    if(!mounted || streaming || transaction || total > area) {
+        return false;
+    }
+
+    size_t keyLen = strlen(key);
+
+    if(keyLen == 0 || keyLen > FLASH_KVSTORE_MAX_KEY_LEN || !reserve(recordSize(keyLen, total, RECORD_TRAILER))) {
+        return false;
+    }
+
+    // the crc in the header covers the key only, the value is covered by the trailer
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.keyLen = keyLen;
+    header.type = t;
+    header.flags = RECORD_TRAILER;
+    header.len = total;
+
+    header.crc = kvstore_crc32((uint8_t*)&header + offsetof(RecordHeader, keyLen),
+        sizeof(header) - offsetof(RecordHeader, keyLen));
+    header.crc = kvstore_crc32(key, keyLen, header.crc);
+
+    streamCursor = { tail, 0 };
+    streamAddress = tail;
+    streamLen = total;
+    streamCrc = 0;
+    streamKeyLen = keyLen;
+    streaming = true;
+
+    if(!stage(streamCursor, &header, sizeof(header)) || !stage(streamCursor, key, keyLen)) {
+        _closeWriter(this, false);
+        return false;
+    }
+
+    return true;
+}
+
+bool FlashKVStore::_write(void* state, const uint8_t data[], size_t len) {
+    if(state != this || !streaming) {
+        return false;
+    }
+
+    streamCrc = kvstore_crc32(data, len, streamCrc);
+
+    return stage(streamCursor, data, len);
+}
+
+bool FlashKVStore::_closeWriter(void* state, bool commit) {
+    if(state != this || !streaming) {
+        return false;
+    }
+
+    streaming = false;
+    uint32_t size = recordSize(streamKeyLen, streamLen, RECORD_TRAILER);
+
+    if(commit && stage(streamCursor, &streamCrc, sizeof(streamCrc)) && finish(streamCursor)) {
+        char key[FLASH_KVSTORE_MAX_KEY_LEN];
+        tail += size;
+
+        // the key is read back from the record
+        if(bd.read(key, streamAddress + sizeof(RecordHeader), streamKeyLen) != BlockDeviceInterface::BD_OK ||
+                !apply(KVKey(key, streamKeyLen, hash(key, streamKeyLen)), streamAddress, size, false)) {
+            return false;
+        }
+
+        if(gcBudgetUs > 0) {
+            collect(gcBudgetUs);
+        }
+
+        return true;
+    }
+
+    // a partially programmed record makes the rest of the area unusable until collected
+    if(streamCursor.address > streamAddress && tail < limit()) {
+        garbage += limit() - tail;
+        tail = limit();
+    }
+
+    return false;
+}
+
+bool FlashKVStore::_openReader(const key_t& key, size_t& total, void*& state) {
+    size_t len = getBytesLength(key);
+
+    if(len == 0) {
+        return false;
+    }
+
+    // the record is looked up on every read, it may be moved by garbage collection
+    size_t keyLen = key.length();
+    char* copy = new char[keyLen + 1];
+
+    if(copy == nullptr) {
+        return false;
+    }
+
+    memcpy(copy, key, keyLen + 1);
+    total = len;
+    state = copy;
+
+    return true;
+}
+
+size_t FlashKVStore::_read(void* state, size_t offset, uint8_t data[], size_t len) {
+    return getBytes((const char*)state, offset, data, len);
+}
+
+void FlashKVStore::_closeReader(void* state) {
+    delete [] (char*)state;
+}
+
+bool FlashKVStore::mount() {
+    uint32_t first, second;
+    bool firstValid = readAreaHeader(0, first);
+    bool secondValid = readAreaHeader(area, second);
+
+    if(!firstValid && !secondValid) {
+        // blank device
+        if(bd.erase(0, area) != BlockDeviceInterface::BD_OK || !writeAreaHeader(0, 1)) {
+            return false;
+        }
+
+        active = 0;
+        generation = 1;
+    } else if(firstValid && (!secondValid || first > second)) {
+        active = 0;
+        generation = first;
+    } else {
+        active = area;
+        generation = second;
+    }
+
+    bool torn = false;
+    if(restore()) {
+        stats.restores++;
+    } else if(!scan(torn)) {
+        return false;
+    }
+
+    mounted = true;
+
+    // the space after a torn record is not erased, live records are moved to the other area
+    return !torn || gc();
+}
+
+bool FlashKVStore::scan(bool& torn) {
+    torn = false;
+    phase = GC_IDLE;
+
+    if(!resetIndex()) {
+        return false;
+    }
+
+    uint32_t address = active + headerSize;
+    uint32_t end = limit();
+    uint8_t key[FLASH_KVSTORE_MAX_KEY_LEN];
+    uint8_t erased = bd.getEraseValue();
+
+    while(address + sizeof(RecordHeader) <= end) {
+        RecordHeader header;
+        if(!readHeader(address, header)) {
+            return false;
+        }
+
+        bool blank = true;
+        for(size_t i=0; i<sizeof(header) && blank; i++) {
+            blank = ((uint8_t*)&header)[i] == erased;
+        }
+
+        if(blank) {
+            break;
+        }
+
+        bool valid;
+        if(!verify(address, end, header, key, valid)) {
+            return false;
+        } else if(!valid) {
+            torn = true;
+            break;
+        }
+
+        if(header.flags & RECORD_TRANSACTION) {
+            // the records of a transaction are applied only if all of them were programmed
+            if(!verifyTransaction(address, header, valid)) {
+                return false;
+            } else if(!valid) {
+                torn = true;
+                break;
+            }
+
+            garbage += recordSize(header);
+        } else if(header.flags & RECORD_CHECKPOINT) {
+            // superseded by the records that follow it
+            garbage += recordSize(header);
+        } else if(!apply(KVKey((const char*)key, header.keyLen, hash((const char*)key, header.keyLen)),
+                address, recordSize(header), header.flags & RECORD_REMOVED)) {
+            return false;
+        }
+
+        address += recordSize(header);
+    }
+
+    tail = address;
+
+    return true;
+}
+
+bool FlashKVStore::restore() {
+    size_t latest, free;
+    findCheckpointSlots(latest, free);
+
+    if(latest == NOT_FOUND) {
+        return false;
+    }
+
+    CheckpointSlot slot;
+    RecordHeader header;
+    Checkpoint checkpoint;
+
+    if(bd.read(&slot, slotAddress(latest), sizeof(slot)) != BlockDeviceInterface::BD_OK ||
+            slot.magic != CHECKPOINT_MAGIC || slot.generation != generation ||
+            slot.crc != kvstore_crc32(&slot, offsetof(CheckpointSlot, crc)) ||
+            slot.address < active + headerSize || slot.address + sizeof(header) > limit() ||
+            !readHeader(slot.address, header) || header.magic != RECORD_MAGIC ||
+            !(header.flags & RECORD_CHECKPOINT) || !parsable(header) ||
+            slot.address + recordSize(header) > limit() || header.len < sizeof(checkpoint)) {
+        return false;
+    }
+
+    // a record written after the checkpoint means that the store was not closed cleanly
+    uint32_t next = slot.address + recordSize(header);
+    if(next + sizeof(RecordHeader) <= limit() && !blank(next, sizeof(RecordHeader))) {
+        return false;
+    }
+
+    uint32_t address = valueAddress(slot.address, header);
+    if(bd.read(&checkpoint, address, sizeof(checkpoint)) != BlockDeviceInterface::BD_OK ||
+            checkpoint.generation != generation ||
+            header.len != sizeof(checkpoint) + checkpoint.count * sizeof(Slot)) {
+        return false;
+    }
+
+    uint32_t crc = kvstore_crc32((uint8_t*)&header + offsetof(RecordHeader, keyLen),
+        sizeof(header) - offsetof(RecordHeader, keyLen));
+    crc = kvstore_crc32(&checkpoint, sizeof(checkpoint), crc);
+
+    if(!resetIndex()) {
+        return false;
+    }
+
+    // slots are inserted while being read, the crc is checked once all of them are in
+    uint32_t end = address + header.len;
+    uint32_t chunkSize = bufSize / sizeof(Slot) * sizeof(Slot);
+    for(address += sizeof(checkpoint); address < end;) {
+        uint32_t chunk = end - address < chunkSize ? end - address : chunkSize;
+
+        if(bd.read(buf, address, chunk) != BlockDeviceInterface::BD_OK) {
+            return false;
+        }
+        crc = kvstore_crc32(buf, chunk, crc);
+
+        for(uint32_t i=0; i<chunk; i += sizeof(Slot)) {
+            Slot s;
+            memcpy(&s, buf + i, sizeof(s));
+
+            if(!insert(s.hash, s.address)) {
+                return false;
+            }
+        }
+        address += chunk;
+    }
+
+    if(crc != header.crc) {
+        return false;
+    }
+
+    phase = GC_IDLE;
+    tail = next;
+    garbage = checkpoint.garbage + recordSize(header);
+
+    return true;
+}
+
+bool FlashKVStore::writeCheckpoint() {
+    size_t latest, free;
+
+    if(checkpointSlots == 0 || phase != GC_IDLE || slots == nullptr) {
+        return false;
+    }
+
+    findCheckpointSlots(latest, free);
+
+    uint32_t len = sizeof(Checkpoint) + count * sizeof(Slot);
+    uint32_t size = recordSize(0, len);
+
+    if(free == NOT_FOUND || tail + size > limit()) {
+        return false;
+    }
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.keyLen = 0;
+    header.type = PT_INVALID;
+    header.flags = RECORD_CHECKPOINT;
+    header.len = len;
+
+    Checkpoint checkpoint;
+    checkpoint.generation = generation;
+    checkpoint.garbage = garbage;
+    checkpoint.count = count;
+    checkpoint.reserved = 0;
+
+    header.crc = kvstore_crc32((uint8_t*)&header + offsetof(RecordHeader, keyLen),
+        sizeof(header) - offsetof(RecordHeader, keyLen));
+    header.crc = kvstore_crc32(&checkpoint, sizeof(checkpoint), header.crc);
+    for(size_t i=0; i<capacity; i++) {
+        if(slots[i].address != EMPTY_SLOT) {
+            header.crc = kvstore_crc32(&slots[i], sizeof(Slot), header.crc);
+        }
+    }
+
+    Cursor c = { tail, 0 };
+    bool res = stage(c, &header, sizeof(header)) && stage(c, &checkpoint, sizeof(checkpoint));
+    for(size_t i=0; i<capacity && res; i++) {
+        if(slots[i].address != EMPTY_SLOT) {
+            res = stage(c, &slots[i], sizeof(Slot));
+        }
+    }
+
+    if(!res || !finish(c)) {
+        return false;
+    }
+
+    uint32_t address = tail;
+    tail += size;
+    garbage += size;
+
+    // the checkpoint becomes the latest one only once it is completely programmed
+    CheckpointSlot slot;
+    slot.magic = CHECKPOINT_MAGIC;
+    slot.address = address;
+    slot.generation = generation;
+    slot.crc = kvstore_crc32(&slot, offsetof(CheckpointSlot, crc));
+
+    memset(buf, bd.getEraseValue(), slotSize);
+    memcpy(buf, &slot, sizeof(slot));
+
+    return bd.program(buf, slotAddress(free), slotSize) == BlockDeviceInterface::BD_OK;
+}
+
+void FlashKVStore::findCheckpointSlots(size_t& latest, size_t& free) const {
+    latest = NOT_FOUND;
+    free = NOT_FOUND;
+
+    // slots are programmed in order, the first blank one ends the used ones
+    for(size_t i=0; i<checkpointSlots; i++) {
+        if(blank(slotAddress(i), sizeof(CheckpointSlot))) {
+            free = i;
+            break;
+        }
+        latest = i;
+    }
+}
+
+bool FlashKVStore::writeAreaHeader(uint32_t base, uint32_t generation) {
+    AreaHeader header;
+    header.magic = AREA_MAGIC;
+    header.version = FORMAT_VERSION;
+    header.reserved = 0;
+    header.generation = generation;
+    header.crc = kvstore_crc32(&header, offsetof(AreaHeader, crc));
+
+    memset(buf, bd.getEraseValue(), headerSize);
+    memcpy(buf, &header, sizeof(header));
+
+    return bd.program(buf, base, headerSize) == BlockDeviceInterface::BD_OK;
+}
+
+bool FlashKVStore::readAreaHeader(uint32_t base, uint32_t& generation) const {
+    AreaHeader header;
+
+    if(bd.read(&header, base, sizeof(header)) != BlockDeviceInterface::BD_OK ||
+            header.magic != AREA_MAGIC || header.version != FORMAT_VERSION ||
+            header.crc != kvstore_crc32(&header, offsetof(AreaHeader, crc))) {
+        return false;
+    }
+
+    generation = header.generation;
+
+    return true;
+}
+
+bool FlashKVStore::startGC() {
+    phase = GC_ERASE;
+    gcCursor = target();
+    gcTail = target() + headerSize;
+    gcGarbage = 0;
+
+    return true;
+}
+
+bool FlashKVStore::stepGC() {
+    bool res = true;
+
+    if(phase == GC_ERASE) {
+        // the block holding the header of the other area is erased first, invalidating it
+        res = bd.erase(gcCursor, bd.getEraseSize()) == BlockDeviceInterface::BD_OK;
+        gcCursor += bd.getEraseSize();
+
+        if(gcCursor == target() + area) {
+            phase = GC_COPY;
+            gcCursor = active + headerSize;
+            gcStart = tail;
+        }
+    } else if(phase == GC_COPY && gcCursor < tail) {
+        // records are copied in the order they were written, so that the other area
+        // can be scanned as if it were the active one
+        uint8_t record[sizeof(RecordHeader) + FLASH_KVSTORE_MAX_KEY_LEN];
+        RecordHeader header;
+
+        res = readHeader(gcCursor, header);
+        if(res && !parsable(header)) {
+            // what follows a failed write cannot be parsed and contains no live record
+            gcCursor = tail;
+            return true;
+        }
+
+        res = res && bd.read(record, gcCursor, sizeof(header) + header.keyLen) == BlockDeviceInterface::BD_OK;
+        const char* key = (const char*)record + sizeof(header);
+        uint32_t size = recordSize(header);
+
+        bool copied = false;
+        if(res && (header.flags & RECORD_TRANSACTION)) {
+            // the records of a transaction that failed to be programmed are followed by nothing live
+            bool complete;
+            res = verifyTransaction(gcCursor, header, complete);
+
+            if(res && !complete) {
+                gcCursor = tail;
+                return true;
+            }
+        } else if(res && (header.flags & RECORD_CHECKPOINT)) {
+            // the index is checkpointed again by end()
+            copied = false;
+        } else if(res && (header.flags & RECORD_REMOVED)) {
+            // a removal performed while copying may refer to a record that was already copied
+            copied = gcCursor >= gcStart;
+        } else if(res) {
+            size_t i = find(KVKey(key, header.keyLen, hash(key, header.keyLen)));
+            copied = i != NOT_FOUND && slots[i].address == gcCursor;
+
+            if(copied) {
+                slots[i].address = gcTail;
+            }
+        }
+
+        if(res && copied) {
+            res = gcTail + size <= limit(target()) && copy(gcCursor, gcTail, size);
+
+            if(header.flags & RECORD_REMOVED) {
+                gcGarbage += size;
+            }
+            gcTail += size;
+            stats.copiedBytes += size;
+        }
+
+        gcCursor += size;
+    } else if(phase == GC_COPY) {
+        // the header makes the other area valid, it is written only after all the records
+        res = writeAreaHeader(target(), generation + 1);
+
+        if(res) {
+            active = target();
+            generation++;
+            tail = gcTail;
+            garbage = gcGarbage;
+            phase = GC_IDLE;
+            stats.collections++;
+        }
+    }
+
+    if(!res) {
+        // the index may point to the other area, rebuild it from the active one
+        bool torn;
+        if(scan(torn) && torn && tail < limit()) {
+            // the rest of the area cannot be used until collected, as on mount()
+            garbage += limit() - tail;
+            tail = limit();
+        }
+    }
+
+    return res;
+}
+
+void FlashKVStore::runGC(uint32_t budgetUs) {
+    uint32_t start = clock != nullptr ? clock() : 0;
+    size_t steps = 0;
+
+    while(phase != GC_IDLE && stepGC()) {
+        steps++;
+
+        if(clock != nullptr ? clock() - start >= budgetUs : steps >= UNTIMED_GC_STEPS) {
+            break;
+        }
+    }
+}
+
+void FlashKVStore::collect(uint32_t budgetUs) {
+    // collecting starts while there is still space for the writes performed in the meantime
+    if(phase == GC_IDLE && usedBytes() >= area * gcStartRatio && garbage > 0) {
+        startGC();
+    }
+
+    runGC(budgetUs);
+}
+
+bool FlashKVStore::reserve(uint32_t size) {
+    if(size > limit(0) - headerSize) {
+        return false;
+    } else if(tail + size <= limit()) {
+        return true;
+    }
+
+    // the write has to wait for a complete collection
+    return (garbage > 0 || phase != GC_IDLE) && gc() && tail + size <= limit();
+}
+
+bool FlashKVStore::writeRecord(const char* key, size_t keyLen, const uint8_t value[], size_t len, Type t, uint8_t flags, uint32_t& address) {
+    uint32_t size = recordSize(keyLen, len);
+
+    // the program buffer is in use by a writer
+    if(streaming || !reserve(size)) {
+        return false;
+    }
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.keyLen = keyLen;
+    header.type = t;
+    header.flags = flags;
+    header.len = len;
+
+    header.crc = kvstore_crc32((uint8_t*)&header + offsetof(RecordHeader, keyLen),
+        sizeof(header) - offsetof(RecordHeader, keyLen));
+    header.crc = kvstore_crc32(key, keyLen, header.crc);
+    header.crc = kvstore_crc32(value, len, header.crc);
+
+    Cursor c = { tail, 0 };
+    address = tail;
+
+    if(!stage(c, &header, sizeof(header)) || !stage(c, key, keyLen) || !stage(c, value, len) || !finish(c)) {
+        // the record may be partially programmed, the rest of the area cannot be used until collected
+        if(tail < limit()) {
+            garbage += limit() - tail;
+            tail = limit();
+        }
+
+        return false;
+    }
+
+    tail += size;
+
+    return true;
+}
+
+bool FlashKVStore::writeTransaction() {
+    KVJournal::Entry e;
+    TransactionMarker marker = { (uint32_t)journal.entries(), 0 };
+
+    if(marker.count == 0) {
+        return true;
+    }
+
+    for(size_t offset = journal.next(0, e); offset != 0; offset = journal.next(offset, e)) {
+        marker.size += recordSize(e.keyLen, e.len);
+    }
+
+    // garbage can be collected only before the first record is programmed
+    uint32_t markerSize = recordSize(0, sizeof(marker));
+    uint32_t address;
+
+    if(!reserve(markerSize + marker.size) ||
+            !writeRecord("", 0, (const uint8_t*)&marker, sizeof(marker), PT_INVALID, RECORD_TRANSACTION, address)) {
+        return false;
+    }
+    garbage += markerSize;
+
+    uint32_t first = tail;
+    for(size_t offset = journal.next(0, e); offset != 0; offset = journal.next(offset, e)) {
+        if(!writeRecord(e.key, e.keyLen, e.value, e.len, e.type, e.removed ? RECORD_REMOVED : 0, address)) {
+            // the marker and the records programmed so far are discarded by begin()
+            if(tail < limit()) {
+                garbage += limit() - tail;
+                tail = limit();
+            }
+
+            return false;
+        }
+    }
+
+    // the index is updated once every record is programmed
+    bool res = true;
+    address = first;
+    for(size_t offset = journal.next(0, e); offset != 0; offset = journal.next(offset, e)) {
+        uint32_t size = recordSize(e.keyLen, e.len);
+
+        res = apply(KVKey(e.key, e.keyLen, hash(e.key, e.keyLen)), address, size, e.removed) && res;
+        address += size;
+    }
+
+    return res;
+}
+
+bool FlashKVStore::readHeader(uint32_t address, RecordHeader& header) const {
+    return bd.read(&header, address, sizeof(header)) == BlockDeviceInterface::BD_OK;
+}
+
+bool FlashKVStore::verify(uint32_t address, uint32_t end, const RecordHeader& header, uint8_t key[], bool& valid) {
+    valid = false;
+
+    if(!parsable(header) || address + recordSize(header) > end) {
+        return true;
+    }
+
+    uint32_t crc = kvstore_crc32((uint8_t*)&header + offsetof(RecordHeader, keyLen),
+        sizeof(header) - offsetof(RecordHeader, keyLen));
+
+    if(bd.read(key, address + sizeof(header), header.keyLen) != BlockDeviceInterface::BD_OK) {
+        return false;
+    }
+    crc = kvstore_crc32(key, header.keyLen, crc);
+
+    // the value is covered by the crc in the header, or by its own one stored after it
+    bool trailer = header.flags & RECORD_TRAILER;
+    uint32_t expected = header.crc;
+
+    if(trailer && crc != header.crc) {
+        return true;
+    } else if(trailer) {
+        crc = 0;
+    }
+
+    uint32_t value = valueAddress(address, header);
+    for(uint32_t done=0; done < header.len;) {
+        uint32_t chunk = header.len - done < bufSize ? header.len - done : bufSize;
+
+        if(bd.read(buf, value + done, chunk) != BlockDeviceInterface::BD_OK) {
+            return false;
+        }
+        crc = kvstore_crc32(buf, chunk, crc);
+        done += chunk;
+    }
+
+    if(trailer && bd.read(&expected, value + header.len, sizeof(expected)) != BlockDeviceInterface::BD_OK) {
+        return false;
+    }
+
+    valid = crc == expected;
+
+    return true;
+}
+
+bool FlashKVStore::verifyTransaction(uint32_t address, const RecordHeader& header, bool& valid) {
+    TransactionMarker marker;
+    valid = false;
+
+    if(header.len != sizeof(marker)) {
+        return true;
+    } else if(bd.read(&marker, valueAddress(address, header), sizeof(marker)) != BlockDeviceInterface::BD_OK) {
+        return false;
+    }
+
+    address += recordSize(header);
+    if(marker.size > limit() - address) {
+        return true;
+    }
+
+    uint8_t key[FLASH_KVSTORE_MAX_KEY_LEN];
+    uint32_t end = address + marker.size;
+    valid = true;
+
+    for(uint32_t i=0; i<marker.count && valid; i++) {
+        RecordHeader h;
+
+        if(!readHeader(address, h) || !verify(address, end, h, key, valid)) {
+            return false;
+        }
+
+        // a transaction holds plain puts and removals only
+        valid = valid && !(h.flags & (RECORD_CHECKPOINT | RECORD_TRAILER | RECORD_TRANSACTION));
+        address += recordSize(h);
+    }
+
+    valid = valid && address == end;
+
+    return true;
+}
+
+bool FlashKVStore::parsable(const RecordHeader& header) const {
+    bool keyless = header.flags & (RECORD_CHECKPOINT | RECORD_TRANSACTION);
+
+    return header.magic == RECORD_MAGIC && header.len <= area &&
+        (keyless ? header.keyLen == 0 : header.keyLen > 0 && header.keyLen <= FLASH_KVSTORE_MAX_KEY_LEN);
+}
+
+bool FlashKVStore::blank(uint32_t address, size_t len) const {
+    uint8_t data[sizeof(RecordHeader)];
+    uint8_t erased = bd.getEraseValue();
+
+    if(len > sizeof(data) || bd.read(data, address, len) != BlockDeviceInterface::BD_OK) {
+        return false;
+    }
+
+    for(size_t i=0; i<len; i++) {
+        if(data[i] != erased) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FlashKVStore::copy(uint32_t src, uint32_t dst, uint32_t len) {
+    for(uint32_t done=0; done < len;) {
+        uint32_t chunk = len - done < bufSize ? len - done : bufSize;
+
+        if(bd.read(buf, src + done, chunk) != BlockDeviceInterface::BD_OK ||
+                bd.program(buf, dst + done, chunk) != BlockDeviceInterface::BD_OK) {
+            return false;
+        }
+        done += chunk;
+    }
+
+    return true;
+}
+
+bool FlashKVStore::stage(Cursor& c, const void* data, size_t len) {
+    const uint8_t* src = (const uint8_t*)data;
+
+    while(len > 0) {
+        size_t chunk = len < bufSize - c.fill ? len : bufSize - c.fill;
+
+        memcpy(buf + c.fill, src, chunk);
+        c.fill += chunk;
+        src += chunk;
+        len -= chunk;
+
+        if(c.fill == bufSize) {
+            if(bd.program(buf, c.address, bufSize) != BlockDeviceInterface::BD_OK) {
+                return false;
+            }
+
+            c.address += bufSize;
+            c.fill = 0;
+        }
+    }
+
+    return true;
+}
+
+bool FlashKVStore::finish(Cursor& c) {
+    if(c.fill == 0) {
+        return true;
+    }
+
+    size_t len = align(c.fill, bd.getProgramSize());
+    memset(buf + c.fill, bd.getEraseValue(), len - c.fill);
+
+    if(bd.program(buf, c.address, len) != BlockDeviceInterface::BD_OK) {
+        return false;
+    }
+
+    c.address += len;
+    c.fill = 0;
+
+    return true;
+}
+
+uint32_t FlashKVStore::recordSize(size_t keyLen, size_t len, uint8_t flags) const {
+    size_t trailer = flags & RECORD_TRAILER ? sizeof(uint32_t) : 0;
+
+    return align(sizeof(RecordHeader) + keyLen + len + trailer, bd.getProgramSize());
+}
+
+uint32_t FlashKVStore::recordSize(const RecordHeader& header) const {
+    return recordSize(header.keyLen, header.len, header.flags);
+}
+
+uint32_t FlashKVStore::valueAddress(uint32_t address, const RecordHeader& header) const {
+    return address + sizeof(RecordHeader) + header.keyLen;
+}
+
+size_t FlashKVStore::find(const KVKey& key, RecordHeader* header) const {
+    size_t mask = capacity - 1;
+
+    for(size_t i = key.hash() & mask; slots[i].address != EMPTY_SLOT; i = (i + 1) & mask) {
+        if(slots[i].hash == key.hash() && matches(slots[i], key, key.length(), header)) {
+            return i;
+        }
+    }
+
+    return NOT_FOUND;
+}
+
+bool FlashKVStore::matches(const Slot& slot, const char* key, size_t keyLen, RecordHeader* header) const {
+    // hashes are equal, the key stored in the record is compared
+    uint8_t record[sizeof(RecordHeader) + FLASH_KVSTORE_MAX_KEY_LEN];
+
+    if(keyLen > FLASH_KVSTORE_MAX_KEY_LEN ||
+            bd.read(record, slot.address, sizeof(RecordHeader) + keyLen) != BlockDeviceInterface::BD_OK) {
+        return false;
+    }
+
+    RecordHeader h;
+    memcpy(&h, record, sizeof(h));
+
+    if(h.keyLen != keyLen || memcmp(record + sizeof(h), key, keyLen) != 0) {
+        return false;
+    }
+
+    if(header != nullptr) {
+        *header = h;
+    }
+
+    return true;
+}
+
+bool FlashKVStore::insert(uint32_t hash, uint32_t address) {
+    // the load factor is kept below 3/4
+    if((count + 1) * 4 > capacity * 3 && !grow()) {
+        return false;
+    }
+
+    size_t mask = capacity - 1;
+    size_t i = hash & mask;
+
+    while(slots[i].address != EMPTY_SLOT) {
+        i = (i + 1) & mask;
+    }
+
+    slots[i].hash = hash;
+    slots[i].address = address;
+    count++;
+
+    return true;
+}
+
+void FlashKVStore::erase(size_t i) {
+    // backward shift deletion, no tombstones are left in the table
+    size_t mask = capacity - 1;
+
+    for(size_t j = (i + 1) & mask; slots[j].address != EMPTY_SLOT; j = (j + 1) & mask) {
+        size_t ideal = slots[j].hash & mask;
+
+        // the entry in j can be moved to i only if its probe sequence goes through i
+        if((i <= j) ? (ideal <= i || ideal > j) : (ideal <= i && ideal > j)) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+
+    slots[i].address = EMPTY_SLOT;
+    count--;
+}
+
+bool FlashKVStore::grow() {
+    Slot* old = slots;
+    size_t oldCapacity = capacity;
+
+    slots = new Slot[capacity * 2];
+    if(slots == nullptr) {
+        slots = old;
+        return false;
+    }
+
+    capacity *= 2;
+    count = 0;
+    for(size_t i=0; i<capacity; i++) {
+        slots[i].address = EMPTY_SLOT;
+    }
+
+    // the hash is stored in the slot, there is no need to read keys from flash
+    for(size_t i=0; i<oldCapacity; i++) {
+        if(old[i].address != EMPTY_SLOT) {
+            insert(old[i].hash, old[i].address);
+        }
+    }
+
+    delete [] old;
+
+    return true;
+}
+
+bool FlashKVStore::apply(const KVKey& key, uint32_t address, uint32_t size, bool removed) {
+    RecordHeader header;
+    size_t i = find(key, &header);
+
+    if(i != NOT_FOUND) {
+        // the previous record may have already been copied to the other area
+        if(phase == GC_COPY && slots[i].address >= target() && slots[i].address < target() + area) {
+            gcGarbage += recordSize(header);
+        } else {
+            garbage += recordSize(header);
+        }
+
+        if(removed) {
+            erase(i);
+            garbage += size;
+        } else {
+            slots[i].address = address;
+        }
+
+        return true;
+    } else if(removed) {
+        garbage += size;
+
+        return true;
+    }
+
+    return insert(key.hash(), address);
+}
+
+bool FlashKVStore::resetIndex() {
+    releaseIndex();
+
+    slots = new Slot[INITIAL_CAPACITY];
+    if(slots == nullptr) {
+        return false;
+    }
+
+    capacity = INITIAL_CAPACITY;
+    for(size_t i=0; i<capacity; i++) {
+        slots[i].address = EMPTY_SLOT;
+    }
+
+    return true;
+}
+
+void FlashKVStore::releaseIndex() {
+    delete [] slots;
+    slots = nullptr;
+    capacity = 0;
+    count = 0;
+    garbage = 0;
+}
+
+uint32_t FlashKVStore::hash(const char* key, size_t len) {
+    // FNV-1a, as kvstore_hash(), so that keys from flash match the ones hashed by KVKey
+    uint32_t h = KVSTORE_HASH_SEED;
+
+    for(size_t i=0; i<len; i++) {
+        h ^= (uint8_t)key[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
@@ -0,0 +1,275 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "../kvstore.h"
+#include "BlockDeviceInterface.h"
+#include "../utility/journal.h"
+
+// maximum length of a key, excluding the null terminator
+constexpr size_t FLASH_KVSTORE_MAX_KEY_LEN = 128;
+
+// incremental garbage collection starts when this ratio of the active area is used
+constexpr float DEFAULT_GC_START_RATIO = 0.75;
+
+// clean restarts that can be served by an index checkpoint before the next garbage collection
+constexpr size_t DEFAULT_CHECKPOINT_SLOTS = 16;
+
+/** FlashKVStore class
+ *
+ * Log structured KVStore running on a raw flash device through BlockDeviceInterface.
+ * The device is split in two areas of the same size: values are appended as CRC protected
+ * records to the active area, while the hash of every key and the address of its latest
+ * record are kept in RAM, in an open addressing hash table using 8 bytes per slot.
+ *
+ * When the active area is full the live records are copied to the other area, whose header
+ * is written last, so that an interrupted garbage collection leaves the old area in use.
+ * A record that was being written when power was lost is discarded by begin()
+ *
+ * By default garbage collection is performed all at once, when a write does not fit in the
+ * active area. With incremental garbage collection it starts earlier, while there is still
+ * free space, and is carried out in bounded steps, erasing a block or copying a record each,
+ * after every write and in maintenance(). Records written meanwhile are appended to the old
+ * area and copied as well, so that it remains the valid one until the collection completes
+ *
+ * On a clean end() the index is appended to the active area as a checkpoint record, and its
+ * address is programmed in one of the checkpoint slots reserved at the end of the area.
+ * begin() restores the index from the latest checkpoint, in a time proportional to the number
+ * of keys, provided that nothing was written after it; otherwise, after a power loss, the whole
+ * area is scanned. Once the slots of the active area are used up, restarts that follow a write
+ * scan the area until the next garbage collection
+ *
+ * Values written with a Writer are programmed as they are written, with a CRC of the value
+ * after it, so that only the program buffer is used. One writer at a time can be open, other
+ * writes and garbage collection are rejected until it is closed. patchBytes() uses the same
+ * path, copying the current value from flash to the new record without holding it in RAM
+ *
+ * The writes of a transaction are staged in a KVJournal and programmed by commit() as a marker
+ * record, holding their count and size, followed by their records. Space for all of them is
+ * reserved upfront and the index is updated only once they are programmed; begin() applies the
+ * records that follow a marker only if all of them are complete. Writers and patchBytes() are
+ * rejected while a transaction is open
+ */
+class FlashKVStore: public KVStoreInterface {
+public:
+    typedef uint32_t (*clock_f)();
+
+    struct Stats {
+        size_t collections;     // garbage collections performed
+        uint64_t copiedBytes;   // bytes of live records copied by garbage collection
+        size_t restores;        // begin() calls that restored the index from a checkpoint
+    };
+
+    /**
+     * @param[in]  bd               the device, its content is owned by the store
+     * @param[in]  checkpointSlots  slots reserved at the end of each area, 0 disables index
+     *                              checkpoints, it must not change for a given device
+     */
+    FlashKVStore(BlockDeviceInterface& bd, size_t checkpointSlots=DEFAULT_CHECKPOINT_SLOTS);
+    ~FlashKVStore() { end(); }
+
+    bool begin() override;
+    bool end() override;
+    bool clear() override;
+
+    typename KVStoreInterface::res_t remove(const key_t& key) override;
+    bool exists(const key_t& key) const override;
+    typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const override;
+    typename KVStoreInterface::res_t patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) override;
+    size_t getBytesLength(const key_t& key) const override;
+
+    res_t view(const key_t& key, ViewCallback cb, void* ctx=nullptr, Type t=PT_BLOB) override;
+    bool forEach(const char* prefix, KeyCallback cb, void* ctx=nullptr) override;
+
+    bool beginTransaction() override;
+    bool commit() override;
+    bool abort() override;
+
+    /**
+     * @brief copy the live records to the other area, reclaiming the space used by
+     *        overwritten and removed values
+     *
+     * @returns true on correct execution false otherwise
+     */
+    bool gc();
+
+    /**
+     * @brief enable incremental garbage collection
+     *
+     * @param[in]  budgetUs         time spent collecting after every write, at least a step is
+     *                              performed, 0 disables incremental garbage collection
+     * @param[in]  startRatio       ratio of the active area that has to be used to start collecting
+     */
+    void setIncrementalGC(uint32_t budgetUs, float startRatio=DEFAULT_GC_START_RATIO);
+
+    /**
+     * @brief perform pending garbage collection work, it is meant to be called periodically
+     *        when incremental garbage collection is enabled
+     *
+     * @param[in]  budgetUs         time that can be spent collecting, at least a step is performed
+     *
+     * @returns true if there is still garbage collection work pending
+     */
+    bool maintenance(uint32_t budgetUs);
+
+    /**
+     * @brief set the function used to measure the time spent in garbage collection steps,
+     *        by default micros() is used on Arduino, while on other platforms a fixed number
+     *        of steps is performed for every budget
+     *
+     * @param[in]  clock            function returning the time in microseconds
+     */
+    inline void setClock(clock_f clock) { this->clock = clock; }
+
+    inline bool collecting() const          { return phase != GC_IDLE; }
+    inline size_t size() const              { return count; }
+    inline uint32_t areaSize() const        { return area; }
+    inline uint32_t usedBytes() const       { return tail - active; }
+    inline uint32_t freeBytes() const       { return tail < limit() ? limit() - tail : 0; }
+    inline uint32_t garbageBytes() const    { return garbage; }
+    inline size_t indexBytes() const        { return capacity * sizeof(Slot); }
+    inline const Stats& getStats() const    { return stats; }
+
+protected:
+    res_t _put(const key_t& key, const uint8_t value[], size_t len, Type t) override;
+
+    bool _openWriter(const key_t& key, size_t total, void*& state) override;
+    bool _write(void* state, const uint8_t data[], size_t len) override;
+    bool _closeWriter(void* state, bool commit) override;
+
+    bool _openReader(const key_t& key, size_t& total, void*& state) override;
+    size_t _read(void* state, size_t offset, uint8_t data[], size_t len) override;
+    void _closeReader(void* state) override;
+
+private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t address;       // of the latest record of the key
+    };
+
+    struct RecordHeader {
+        uint32_t magic;
+        uint32_t crc;           // of the fields below, the key and the value
+        uint16_t keyLen;
+        uint8_t type;
+        uint8_t flags;
+        uint32_t len;
+    };
+
+    enum Phase: uint8_t {
+        GC_IDLE,
+        GC_ERASE,       // erasing the blocks of the other area
+        GC_COPY,        // copying live records of the active area to the other one
+    };
+
+    // data staged in the program buffer, waiting to be programmed at address
+    struct Cursor {
+        uint32_t address;
+        size_t fill;
+    };
+
+    bool mount();
+    bool scan(bool& torn);
+    bool restore();
+    bool writeCheckpoint();
+    // the latest checkpoint slot programmed in the active area and the first free one
+    void findCheckpointSlots(size_t& latest, size_t& free) const;
+    inline uint32_t slotAddress(size_t i) const { return limit() + i * slotSize; }
+    bool writeAreaHeader(uint32_t base, uint32_t generation);
+    bool readAreaHeader(uint32_t base, uint32_t& generation) const;
+
+    bool startGC();
+    bool stepGC();
+    void runGC(uint32_t budgetUs);
+    void collect(uint32_t budgetUs);
+    inline uint32_t target() const { return active == 0 ? area : 0; }
+    // records end before the checkpoint slots
+    inline uint32_t limit(uint32_t base) const  { return base + area - checkpointSlots * slotSize; }
+    inline uint32_t limit() const               { return limit(active); }
+
+    bool reserve(uint32_t recordSize);
+    bool writeRecord(const char* key, size_t keyLen, const uint8_t value[], size_t len, Type t, uint8_t flags, uint32_t& address);
+    bool writeTransaction();
+    bool readHeader(uint32_t address, RecordHeader& header) const;
+    // checks that the record at address is complete, returns false only on read errors
+    bool verify(uint32_t address, uint32_t end, const RecordHeader& header, uint8_t key[], bool& valid);
+    // checks that all the records following a transaction marker are complete
+    bool verifyTransaction(uint32_t address, const RecordHeader& header, bool& valid);
+    bool parsable(const RecordHeader& header) const;
+    bool blank(uint32_t address, size_t len) const;
+    bool copy(uint32_t src, uint32_t dst, uint32_t len);
+    bool stage(Cursor& c, const void* data, size_t len);
+    bool finish(Cursor& c);
+
+    // starts a record written a chunk at a time with _write()
+    bool startStream(const char* key, size_t total, Type t);
+
+    uint32_t recordSize(size_t keyLen, size_t len, uint8_t flags=0) const;
+    uint32_t recordSize(const RecordHeader& header) const;
+    uint32_t valueAddress(uint32_t address, const RecordHeader& header) const;
+
+    // index
+    size_t find(const KVKey& key, RecordHeader* header=nullptr) const;
+    bool matches(const Slot& slot, const char* key, size_t keyLen, RecordHeader* header) const;
+    bool insert(uint32_t hash, uint32_t address);
+    void erase(size_t i);
+    bool grow();
+    bool apply(const KVKey& key, uint32_t address, uint32_t size, bool removed);
+    bool resetIndex();
+    void releaseIndex();
+
+    static uint32_t hash(const char* key, size_t len);
+    static inline uint32_t align(uint32_t v, uint32_t a) { return (v + a - 1) / a * a; }
+
+    BlockDeviceInterface& bd;
+    bool mounted;
+
+    uint32_t area;              // size of an area
+    uint32_t headerSize;        // of the area header, aligned to the program size
+    uint32_t active;            // base address of the active area
+    uint32_t generation;        // of the active area
+    uint32_t tail;              // address where the next record is appended
+    uint32_t garbage;           // bytes of overwritten and removed records in the active area
+
+    const size_t checkpointSlots;
+    uint32_t slotSize;          // of a checkpoint slot, aligned to the program size
+
+    Phase phase;
+    uint32_t gcCursor;          // next block to erase or record to copy
+    uint32_t gcTail;            // address where the next record is copied in the other area
+    uint32_t gcStart;           // tail of the active area when copying started
+    uint32_t gcGarbage;         // bytes of copied records that were overwritten afterwards
+    uint32_t gcBudgetUs;
+    float gcStartRatio;
+    clock_f clock;
+
+    Slot* slots;
+    size_t capacity;
+    size_t count;
+
+    uint8_t* buf;               // program and copy buffer, multiple of the program size
+    size_t bufSize;
+
+    // record being written by a Writer
+    bool streaming;
+    Cursor streamCursor;
+    uint32_t streamAddress;
+    uint32_t streamLen;
+    uint32_t streamCrc;         // of the value written so far
+    size_t streamKeyLen;
+
+    // writes staged by the open transaction
+    bool transaction;
+    KVJournal journal;
+
+    Stats stats;
+};
@@ -0,0 +1,181 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#if defined(HOST)
+#include "FlashSimulator.h"
+#include <string.h>
+
+constexpr FlashSimulator::Config FlashSimulator::QSPI;
+
+static constexpr uint64_t NO_POWER_CUT = UINT64_MAX;
+
+FlashSimulator::FlashSimulator(const Config& config)
+: config(config), stats(), powered(true), steps(0), cutAfter(NO_POWER_CUT) {
+    memory = new uint8_t[config.size];
+    eraseCounts = new uint32_t[config.size / config.eraseSize]();
+
+    memset(memory, getEraseValue(), config.size);
+}
+
+FlashSimulator::~FlashSimulator() {
+    delete [] memory;
+    delete [] eraseCounts;
+}
+
+typename FlashSimulator::res_t FlashSimulator::init() {
+    return powered ? BD_OK : BD_ERROR_POWER;
+}
+
+typename FlashSimulator::res_t FlashSimulator::deinit() {
+    return BD_OK;
+}
+
+typename FlashSimulator::res_t FlashSimulator::read(void* buf, uint32_t addr, uint32_t size) {
+    if(!powered) {
+        return BD_ERROR_POWER;
+    } else if(addr + size > config.size || addr + size < addr) {
+        return BD_ERROR_PARAM;
+    }
+
+    memcpy(buf, memory + addr, size);
+
+    stats.reads++;
+    stats.bytesRead += size;
+    stats.elapsedUs += config.readLatencyUs;
+
+    return BD_OK;
+}
+
+typename FlashSimulator::res_t FlashSimulator::program(const void* buf, uint32_t addr, uint32_t size) {
+    if(!powered) {
+        return BD_ERROR_POWER;
+    } else if(addr + size > config.size || addr + size < addr ||
+            addr % config.programSize != 0 || size % config.programSize != 0) {
+        return BD_ERROR_PARAM;
+    }
+
+    const uint8_t* src = (const uint8_t*)buf;
+    stats.programs++;
+
+    for(uint32_t unit = 0; unit < size; unit += config.programSize) {
+        bool complete = step();
+
+        // when power is lost in the middle of a program unit only half of it is programmed
+        uint32_t len = complete ? config.programSize : config.programSize / 2;
+
+        for(uint32_t i = 0; i < len; i++) {
+            uint8_t& cell = memory[addr + unit + i];
+
+            if((cell & src[unit + i]) != src[unit + i]) {
+                stats.programErrors++;
+            }
+
+            // NOR flash can only clear bits
+            cell &= src[unit + i];
+        }
+
+        stats.bytesProgrammed += len;
+        stats.elapsedUs += config.programLatencyUs;
+
+        if(!complete) {
+            return BD_ERROR_POWER;
+        }
+    }
+
+    return BD_OK;
+}
+
+typename FlashSimulator::res_t FlashSimulator::erase(uint32_t addr, uint32_t size) {
+    if(!powered) {
+        return BD_ERROR_POWER;
+    } else if(addr + size > config.size || addr + size < addr ||
+            addr % config.eraseSize != 0 || size % config.eraseSize != 0) {
+        return BD_ERROR_PARAM;
+    }
+
+    for(uint32_t block = addr; block < addr + size; block += config.eraseSize) {
+        bool complete = step();
+
+        // an interrupted erase leaves the block partially erased
+        memset(memory + block, getEraseValue(), complete ? config.eraseSize : config.eraseSize / 2);
+
+        eraseCounts[block / config.eraseSize]++;
+        stats.erases++;
+        stats.elapsedUs += config.eraseLatencyUs;
+
+        if(!complete) {
+            return BD_ERROR_POWER;
+        }
+    }
+
+    return BD_OK;
+}
+
+void FlashSimulator::powerCutAfter(uint64_t steps) {
+    cutAfter = this->steps + steps;
+}
+
+void FlashSimulator::powerOn() {
+    powered = true;
+    cutAfter = NO_POWER_CUT;
+}
+
+void FlashSimulator::resetStats() {
+    stats = Stats();
+}
+
+uint32_t FlashSimulator::getEraseCount(uint32_t block) const {
+    return block < config.size / config.eraseSize ? eraseCounts[block] : 0;
+}
+
+uint32_t FlashSimulator::getMaxEraseCount() const {
+    uint32_t max = 0;
+
+    for(uint32_t i = 0; i < config.size / config.eraseSize; i++) {
+        max = eraseCounts[i] > max ? eraseCounts[i] : max;
+    }
+
+    return max;
+}
+
+double FlashSimulator::getWriteAmplification(uint64_t userBytes) const {
+    return userBytes > 0 ? (double)stats.bytesProgrammed / userBytes : 0;
+}
+
+size_t FlashSimulator::getWearMap(char* out, size_t len) const {
+    static const char levels[] = " .:-=+*#%@";
+    static constexpr size_t LEVELS = sizeof(levels) - 1;
+
+    if(len == 0) {
+        return 0;
+    }
+
+    uint32_t max = getMaxEraseCount();
+    size_t blocks = config.size / config.eraseSize;
+    size_t n = blocks < len - 1 ? blocks : len - 1;
+
+    for(size_t i = 0; i < n; i++) {
+        out[i] = levels[max > 0 ? (uint64_t)eraseCounts[i] * (LEVELS - 1) / max : 0];
+    }
+    out[n] = '\0';
+
+    return n;
+}
+
+bool FlashSimulator::step() {
+    if(steps++ >= cutAfter) {
+        powered = false;
+        return false;
+    }
+
+    return true;
+}
+
+#endif // defined(HOST)
@@ -0,0 +1,123 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include "BlockDeviceInterface.h"
+
+/** FlashSimulator class
+ *
+ * Host side simulation of a NOR/QSPI flash device. Programming can only clear bits, as on
+ * real NOR devices, and every operation is accounted for: erases of every block, bytes read
+ * and programmed and the time the operations would take on the real device, according to
+ * the configured latencies. No real time is spent waiting.
+ *
+ * A power cut can be injected after an arbitrary number of program/erase steps: the step at
+ * which power is lost is performed only partially and every following operation fails
+ * until powerOn() is called
+ */
+class FlashSimulator: public BlockDeviceInterface {
+public:
+    struct Config {
+        uint32_t size;
+        uint32_t eraseSize;
+        uint32_t programSize;
+
+        // latencies in microseconds
+        uint32_t readLatencyUs;         // per operation
+        uint32_t programLatencyUs;      // per program unit
+        uint32_t eraseLatencyUs;        // per block
+    };
+
+    struct Stats {
+        uint64_t reads;
+        uint64_t bytesRead;
+        uint64_t programs;
+        uint64_t bytesProgrammed;
+        uint64_t erases;
+        uint64_t elapsedUs;             // simulated time spent in operations
+        uint64_t programErrors;         // attempts to program bits that were not erased
+    };
+
+    // default configuration resembling the KVStore partition on the QSPI flash of a Portenta H7
+    static constexpr Config QSPI = { 1024 * 1024, 4096, 1, 1, 2, 45000 };
+
+    FlashSimulator(const Config& config=QSPI);
+    ~FlashSimulator();
+
+    res_t init() override;
+    res_t deinit() override;
+    res_t read(void* buf, uint32_t addr, uint32_t size) override;
+    res_t program(const void* buf, uint32_t addr, uint32_t size) override;
+    res_t erase(uint32_t addr, uint32_t size) override;
+
+    uint32_t size() const override              { return config.size; }
+    uint32_t getEraseSize() const override      { return config.eraseSize; }
+    uint32_t getProgramSize() const override    { return config.programSize; }
+
+    /**
+     * @brief lose power after the specified number of program/erase steps, a program unit
+     *        or an erased block count as a step
+     *
+     * @param[in]  steps            steps that complete correctly, the following one is partially performed
+     */
+    void powerCutAfter(uint64_t steps);
+
+    /**
+     * @brief restore power after a power cut, the content of the device is preserved
+     */
+    void powerOn();
+
+    inline bool isPowered() const               { return powered; }
+    inline uint64_t getSteps() const            { return steps; }
+
+    inline const Stats& getStats() const        { return stats; }
+    void resetStats();
+
+    /**
+     * @brief get the number of times a block has been erased
+     *
+     * @param[in]  block            index of the block
+     */
+    uint32_t getEraseCount(uint32_t block) const;
+    uint32_t getMaxEraseCount() const;
+
+    /**
+     * @brief ratio between bytes programmed on the device and bytes written by the user
+     *
+     * @param[in]  userBytes        bytes written by the user of the device
+     */
+    double getWriteAmplification(uint64_t userBytes) const;
+
+    /**
+     * @brief render the erase count of every block as a printable, null terminated, string
+     *        with one character per block, ' ' being the least and '@' the most worn out
+     *
+     * @param[out] out              destination buffer
+     * @param[in]  len              length of the buffer, it should be at least blocks + 1
+     *
+     * @returns the number of blocks rendered
+     */
+    size_t getWearMap(char* out, size_t len) const;
+
+    // direct access to the content, for inspection in tests
+    inline const uint8_t* data() const          { return memory; }
+private:
+    // returns true if the step can be performed completely
+    bool step();
+
+    Config config;
+    uint8_t* memory;
+    uint32_t* eraseCounts;
+
+    Stats stats;
+
+    bool powered;
+    uint64_t steps;
+    uint64_t cutAfter;
+};
@@ -0,0 +1,60 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#if defined(ARDUINO_PORTENTA_H7_M7) || defined(ARDUINO_NICLA_VISION) \
+    || defined(ARDUINO_OPTA) || defined(ARDUINO_GIGA) || defined(ARDUINO_PORTENTA_C33)
+#include "BlockDeviceInterface.h"
+#include "MBRBlockDevice.h"
+
+/** MbedBlockDevice class
+ *
+ * Adapter exposing an mbed BlockDevice, like the QSPI flash or one of its MBR partitions,
+ * as a BlockDeviceInterface, in order to run FlashKVStore on it
+ */
+class MbedBlockDevice: public BlockDeviceInterface {
+public:
+#if defined(ARDUINO_PORTENTA_C33)
+    typedef ::BlockDevice device_t;
+#else
+    typedef mbed::BlockDevice device_t;
+#endif
+
+    MbedBlockDevice(device_t* bd): bd(bd) {}
+
+    res_t init() override       { return bd->init() == 0 ? BD_OK : BD_ERROR; }
+    res_t deinit() override     { return bd->deinit() == 0 ? BD_OK : BD_ERROR; }
+
+    res_t read(void* buf, uint32_t addr, uint32_t size) override {
+        return bd->read(buf, addr, size) == 0 ? BD_OK : BD_ERROR;
+    }
+
+    res_t program(const void* buf, uint32_t addr, uint32_t size) override {
+        return bd->program(buf, addr, size) == 0 ? BD_OK : BD_ERROR;
+    }
+
+    res_t erase(uint32_t addr, uint32_t size) override {
+        return bd->erase(addr, size) == 0 ? BD_OK : BD_ERROR;
+    }
+
+    uint32_t size() const override              { return bd->size(); }
+    uint32_t getEraseSize() const override      { return bd->get_erase_size(); }
+    uint32_t getProgramSize() const override    { return bd->get_program_size(); }
+
+    uint8_t getEraseValue() const override {
+        int value = bd->get_erase_value();
+
+        return value >= 0 ? value : 0xFF;
+    }
+private:
+    device_t* bd;
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#if defined(ARDUINO_UNOR4_WIFI)
+#include "ATPipeline.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+ATPipeline::ATPipeline(Stream& link, size_t depth, uint32_t timeoutMs)
+: link(link), timeoutMs(timeoutMs), pending(nullptr), depth(depth > 0 ? depth : 1), head(0), count(0), stats() {
+    pending = new Pending[this->depth];
+    if(pending == nullptr) {
+        this->depth = 0;
+    }
+}
+
+ATPipeline::~ATPipeline() {
+    drain();
+    delete [] pending;
+}
+
+bool ATPipeline::send(const char* prompt, bool sized, ResponseCallback cb, void* ctx,
+    const uint8_t payload[], size_t payloadLen, const char* fmt, ...) {
+    if(depth == 0) {
+        return false;
+    }
+
+    char cmd[AT_PIPELINE_MAX_COMMAND_LEN];
+    va_list va;
+    va_start(va, fmt);
+    int len = vsnprintf(cmd, sizeof(cmd), fmt, va);
+    va_end(va);
+
+    if(len < 0 || (size_t)len >= sizeof(cmd)) {
+        return false;
+    }
+
+    // the link is kept busy while the oldest response is read
+    if(count == depth) {
+        stats.stalls++;
+        if(!receive()) {
+            return false;
+        }
+    }
+
+    link.write((const uint8_t*)cmd, len);
+    if(payload != nullptr && payloadLen > 0) {
+        link.write(payload, payloadLen);
+    }
+
+    pending[(head + count) % depth] = { prompt, sized, cb, ctx };
+    count++;
+    stats.commands++;
+
+    return true;
+}
+
+bool ATPipeline::drain() {
+    while(count > 0) {
+        if(!receive()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ATPipeline::receive() {
+    const Pending& p = pending[head];
+    size_t promptLen = strlen(p.prompt);
+    size_t remaining = 0;
+    bool sized = p.sized;
+    uint32_t start = millis();
+
+    line.clear();
+    data.clear();
+
+    while(true) {
+        int c = readByte(start);
+
+        if(c < 0) {
+            // the link cannot be resynchronized, every command in flight failed
+            stats.timeouts++;
+            while(count > 0) {
+                complete(false);
+            }
+            return false;
+        }
+
+        if(remaining > 0) {
+            data.push_back(c);
+            remaining--;
+            continue;
+        }
+
+        line.push_back(c);
+
+        if(sized && c == '|' && line.size() > promptLen && line.compare(0, promptLen, p.prompt) == 0) {
+            remaining = strtoul(line.c_str() + promptLen, nullptr, 10);
+            sized = false;
+            line.clear();
+        } else if(line.size() >= 2 && line.compare(line.size() - 2, 2, "\r\n") == 0) {
+            line.resize(line.size() - 2);
+
+            if(line == "OK" || line == "ERROR") {
+                complete(line == "OK");
+                return true;
+            } else if(line.compare(0, promptLen, p.prompt) == 0) {
+                size_t pos = line.find_first_not_of(' ', promptLen);
+                if(pos != std::string::npos) {
+                    data.append(line, pos, std::string::npos);
+                }
+            }
+            line.clear();
+        }
+    }
+}
+
+void ATPipeline::complete(bool ok) {
+    Pending p = pending[head];
+    head = (head + 1) % depth;
+    count--;
+
+    if(p.cb != nullptr) {
+        p.cb(ok, (const uint8_t*)data.data(), ok ? data.size() : 0, p.ctx);
+    }
+    data.clear();
+}
+
+int ATPipeline::readByte(uint32_t start) {
+    while(link.available() == 0) {
+        if(millis() - start >= timeoutMs) {
+            return -1;
+        }
+    }
+
+    return link.read();
+}
+
+#endif // defined(ARDUINO_UNOR4_WIFI)
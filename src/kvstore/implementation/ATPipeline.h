@@ -0,0 +1,101 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <string>
+
+constexpr size_t DEFAULT_AT_PIPELINE_DEPTH = 4;
+constexpr uint32_t DEFAULT_AT_PIPELINE_TIMEOUT_MS = 10000;
+
+// the longest command line that can be sent, payloads are not included
+constexpr size_t AT_PIPELINE_MAX_COMMAND_LEN = 128;
+
+/** ATPipeline class
+ *
+ * Sends AT commands over a serial link without waiting for the response of a command
+ * before sending the next one, up to depth commands are in flight. Responses are matched
+ * to commands in the order they were sent, the bridge executes commands in order.
+ *
+ * A response is "<prompt> <data>\r\n" followed by "OK\r\n", or "ERROR\r\n" on failure.
+ * For sized commands the data is "<len>|<len bytes>", so that it may contain any byte
+ */
+class ATPipeline {
+public:
+    /**
+     * @brief callback called with the response of a command, the memory pointed by data is valid
+     *        only for the duration of the call
+     */
+    typedef void (*ResponseCallback)(bool ok, const uint8_t data[], size_t len, void* ctx);
+
+    struct Stats {
+        size_t commands;
+        size_t stalls;      // commands that had to wait for a previous response before being sent
+        size_t timeouts;
+    };
+
+    ATPipeline(Stream& link, size_t depth=DEFAULT_AT_PIPELINE_DEPTH, uint32_t timeoutMs=DEFAULT_AT_PIPELINE_TIMEOUT_MS);
+    ~ATPipeline();
+
+    /**
+     * @brief send a command, waiting for the oldest response if depth commands are in flight
+     *
+     * @param[in]  prompt           the prompt of the response, it must outlive the response
+     * @param[in]  sized            true if the data of the response is prefixed by its length
+     * @param[in]  cb               callback called with the response, may be nullptr
+     * @param[in]  ctx              user pointer passed to the callback
+     * @param[in]  payload          bytes sent right after the command line, may be nullptr
+     * @param[in]  payloadLen       the length of the payload
+     * @param[in]  fmt              printf format of the command line, followed by its arguments
+     *
+     * @returns true if the command was sent, false otherwise, cb is not called in that case
+     */
+    bool send(const char* prompt, bool sized, ResponseCallback cb, void* ctx,
+        const uint8_t payload[], size_t payloadLen, const char* fmt, ...);
+
+    /**
+     * @brief wait for the responses of all the commands in flight
+     *
+     * @returns false if the link timed out, the commands that were waiting are reported as failed
+     */
+    bool drain();
+
+    inline size_t inFlight() const          { return count; }
+    inline size_t getDepth() const          { return depth; }
+    inline const Stats& getStats() const    { return stats; }
+    inline void resetStats()                { stats = Stats(); }
+
+private:
+    struct Pending {
+        const char* prompt;
+        bool sized;
+        ResponseCallback cb;
+        void* ctx;
+    };
+
+    // reads the response of the oldest command in flight
+    bool receive();
+    void complete(bool ok);
+    int readByte(uint32_t start);
+
+    Stream& link;
+    const uint32_t timeoutMs;
+
+    // commands in flight, as a ring buffer
+    Pending* pending;
+    size_t depth;
+    size_t head;
+    size_t count;
+
+    std::string line;
+    std::string data;
+
+    Stats stats;
+};
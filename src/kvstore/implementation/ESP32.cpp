@@ -12,6 +12,44 @@
 #include "ESP32.h"
 #include "nvs.h"
 #include "nvs_flash.h"
+#include "esp_idf_version.h"
+
+#ifndef nvs_error
+#define nvs_error(e) esp_err_to_name(e)
+#endif // nvs_error
+
+static constexpr size_t UNKNOWN_LENGTH = (size_t)-1;
+
+static KVStoreInterface::Type typeOf(nvs_type_t type) {
+    switch(type) {
+    case NVS_TYPE_I8:   return KVStoreInterface::PT_I8;
+    case NVS_TYPE_U8:   return KVStoreInterface::PT_U8;
+    case NVS_TYPE_I16:  return KVStoreInterface::PT_I16;
+    case NVS_TYPE_U16:  return KVStoreInterface::PT_U16;
+    case NVS_TYPE_I32:  return KVStoreInterface::PT_I32;
+    case NVS_TYPE_U32:  return KVStoreInterface::PT_U32;
+    case NVS_TYPE_I64:  return KVStoreInterface::PT_I64;
+    case NVS_TYPE_U64:  return KVStoreInterface::PT_U64;
+    case NVS_TYPE_STR:  return KVStoreInterface::PT_STR;
+    case NVS_TYPE_BLOB: return KVStoreInterface::PT_BLOB;
+    default:            return KVStoreInterface::PT_INVALID;
+    }
+}
+
+static size_t lengthOf(KVStoreInterface::Type type) {
+    switch(type) {
+    case KVStoreInterface::PT_I8:
+    case KVStoreInterface::PT_U8:   return 1;
+    case KVStoreInterface::PT_I16:
+    case KVStoreInterface::PT_U16:  return 2;
+    case KVStoreInterface::PT_I32:
+    case KVStoreInterface::PT_U32:  return 4;
+    case KVStoreInterface::PT_I64:
+    case KVStoreInterface::PT_U64:  return 8;
+    case KVStoreInterface::PT_INVALID: return 0;
+    default:                        return UNKNOWN_LENGTH;
+    }
+}
 
 bool ESP32KVStore::begin(const char* name, bool readOnly, const char* partition_label) {
     if(_started){
@@ -34,6 +72,10 @@ bool ESP32KVStore::begin(const char* name, bool readOnly, const char* partition_
         return false;
     }
     _started = true;
+    if(!readOnly){
+        _replayJournal();
+    }
+    _buildIndex();
     return true;
 }
 
@@ -45,14 +87,19 @@ bool ESP32KVStore::end() {
     if(!_started){
         return false;
     }
+    abort();
+    bool res = commit();
     nvs_close(_handle);
     _started = false;
+    _index.clear();
+    _indexComplete = false;
+    _pending = 0;
 
-    return true;
+    return res;
 }
 
 bool ESP32KVStore::clear() {
-    if(!_started || _readOnly){
+    if(!_started || _readOnly || _transaction){
         return false;
     }
     esp_err_t err = nvs_erase_all(_handle);
@@ -60,45 +107,68 @@ bool ESP32KVStore::clear() {
         log_e("nvs_erase_all fail: %s", nvs_error(err));
         return false;
     }
-    err = nvs_commit(_handle);
-    if(err){
-        log_e("nvs_commit fail: %s", nvs_error(err));
-        return false;
-    }
-    return true;
+    _index.clear();
+    _indexComplete = true;
+    return _written(1);
 }
 
 typename KVStoreInterface::res_t ESP32KVStore::remove(const key_t& key) {
     if(!_started || !key || _readOnly){
         return false;
     }
+    Chunks chunks;
+    bool chunked = _findChunks(key, chunks);
+    if(_transaction){
+        if(chunked){
+            removeChunks(chunks);
+        }
+        bool removed;
+        if(_journal.staged(key, removed) ? removed : !exists(key)){
+            return 0;
+        }
+        return _journal.remove(key) ? 1 : 0;
+    }
+    // keys known to be missing are not erased in nvs
+    if(_lookup(key) == nullptr){
+        return 0;
+    }
     esp_err_t err = nvs_erase_key(_handle, key);
     if(err){
-        log_e("nvs_erase_key fail: %s %s", key, nvs_error(err));
+        log_e("nvs_erase_key fail: %s %s", key.c_str(), nvs_error(err));
         return false;
     }
-    err = nvs_commit(_handle);
-    if(err){
-        log_e("nvs_commit fail: %s %s", key, nvs_error(err));
-        return false;
+    _indexRemoved(key);
+    if(!_written(1)){
+        return 0;
     }
-    return true;
+    if(chunked){
+        removeChunks(chunks);
+    }
+    return 1;
 }
 
 typename KVStoreInterface::res_t ESP32KVStore::putBytes(const key_t& key, const uint8_t value[], size_t len) {
     if(!_started || !key || !value || !len || _readOnly){
         return 0;
     }
+    if(_transaction){
+        return _stage(key, value, len, PT_BLOB);
+    }
+    Chunks chunks;
+    bool chunked = _findChunks(key, chunks);
     esp_err_t err = nvs_set_blob(_handle, key, value, len);
     if(err){
-        log_e("nvs_set_blob fail: %s %s", key, nvs_error(err));
+        log_e("nvs_set_blob fail: %s %s", key.c_str(), nvs_error(err));
         return 0;
     }
-    err = nvs_commit(_handle);
-    if(err){
-        log_e("nvs_commit fail: %s %s", key, nvs_error(err));
+    _index[key] = { PT_BLOB, len };
+    if(!_written(1)){
         return 0;
     }
+    // the chunks of a streamed value are removed once it is replaced
+    if(chunked){
+        removeChunks(chunks);
+    }
     return len;
 }
 
@@ -108,72 +178,455 @@ typename KVStoreInterface::res_t ESP32KVStore::getBytes(const key_t& key, uint8_
         return len;
     }
     if(len > maxLen){
-        log_e("not enough space in buffer: %u < %u", maxLen, len);
+        log_e("not enough space in buffer: %u < %u", (unsigned)maxLen, (unsigned)len);
         return 0;
     }
     esp_err_t err = nvs_get_blob(_handle, key, buf, &len);
     if(err){
-        log_e("nvs_get_blob fail: %s %s", key, nvs_error(err));
+        log_e("nvs_get_blob fail: %s %s", key.c_str(), nvs_error(err));
         return 0;
     }
     return len;
 }
 
 size_t ESP32KVStore::getBytesLength(const key_t& key) const {
-    if(!_started || !key){
+    IndexEntry* entry = _lookup(key);
+    if(entry == nullptr){
         return 0;
     }
-    esp_err_t err = ESP_OK;
+    if(entry->len != UNKNOWN_LENGTH){
+        return entry->len;
+    }
 
-    int8_t mt1; uint8_t mt2; int16_t mt3; uint16_t mt4;
-    int32_t mt5; uint32_t mt6; int64_t mt7; uint64_t mt8;
     size_t len = 0;
-    if       ((err = nvs_get_i8(_handle, key, &mt1)) == ESP_OK)  { len = sizeof(mt1);
-    } else if((err = nvs_get_u8(_handle, key, &mt2)) == ESP_OK)  { len = sizeof(mt2);
-    } else if((err = nvs_get_i16(_handle, key, &mt3)) == ESP_OK) { len = sizeof(mt3);
-    } else if((err = nvs_get_u16(_handle, key, &mt4)) == ESP_OK) { len = sizeof(mt4);
-    } else if((err = nvs_get_i32(_handle, key, &mt5)) == ESP_OK) { len = sizeof(mt5);
-    } else if((err = nvs_get_u32(_handle, key, &mt6)) == ESP_OK) { len = sizeof(mt6);
-    } else if((err = nvs_get_i64(_handle, key, &mt7)) == ESP_OK) { len = sizeof(mt7);
-    } else if((err = nvs_get_u64(_handle, key, &mt8)) == ESP_OK) { len = sizeof(mt8);
-    } else if((err = nvs_get_str(_handle, key, NULL, &len)) == ESP_OK) {
-    } else if((err = nvs_get_blob(_handle, key, NULL, &len)) == ESP_OK) {}
+    esp_err_t err = entry->type == PT_STR ?
+        nvs_get_str(_handle, key, NULL, &len) :
+        nvs_get_blob(_handle, key, NULL, &len);
 
     if(err){
-        log_e("nvs_get_blob len fail: %s %s", key, nvs_error(err));
+        log_e("nvs_get_blob len fail: %s %s", key.c_str(), nvs_error(err));
         return 0;
     }
+    entry->len = len;
     return len;
 }
 
-
 bool ESP32KVStore::exists(const key_t& key) const {
     return getType(key) != PT_INVALID;
 }
 
 ESP32KVStore::Type ESP32KVStore::getType(const key_t& key) const {
+    IndexEntry* entry = _lookup(key);
+    return entry != nullptr ? entry->type : PT_INVALID;
+}
+
+bool ESP32KVStore::forEach(const char* prefix, KeyCallback cb, void* ctx) {
+    if(!_started || cb == nullptr){
+        return false;
+    }
+    if(prefix == nullptr){
+        prefix = "";
+    }
+    size_t prefixLen = strlen(prefix);
+
+    if(_indexComplete){
+        // the index mirrors nvs, only the length of strings and blobs never accessed is read
+        for(auto& el: _index){
+            const char* key = el.first.c_str();
+            if(el.second.type == PT_INVALID || strncmp(key, prefix, prefixLen) != 0 ||
+                    strcmp(key, ESP32_JOURNAL_KEY) == 0 || isChunkKey(key)){
+                continue;
+            }
+            if(!cb(key, el.second.type, getBytesLength(key), ctx)){
+                break;
+            }
+        }
+        return true;
+    }
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    nvs_iterator_t it = NULL;
+    esp_err_t err = nvs_entry_find_in_handle(_handle, NVS_TYPE_ANY, &it);
+    bool stopped = false;
+
+    while(err == ESP_OK && !stopped){
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+
+        if(strncmp(info.key, prefix, prefixLen) == 0 && strcmp(info.key, ESP32_JOURNAL_KEY) != 0 &&
+                !isChunkKey(info.key)){
+            Type t = typeOf(info.type);
+            size_t len = lengthOf(t);
+            if(len == UNKNOWN_LENGTH){
+                len = 0;
+                if(t == PT_STR){
+                    nvs_get_str(_handle, info.key, NULL, &len);
+                } else {
+                    nvs_get_blob(_handle, info.key, NULL, &len);
+                }
+            }
+            stopped = !cb(info.key, t, len, ctx);
+        }
+
+        if(!stopped){
+            err = nvs_entry_next(&it);
+        }
+    }
+    nvs_release_iterator(it);
+
+    return stopped || err == ESP_ERR_NVS_NOT_FOUND;
+#else
+    // keys cannot be listed before ESP-IDF 5
+    return false;
+#endif // ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+}
+
+ESP32KVStore::IndexEntry* ESP32KVStore::_cached(const key_t& key) const {
+    auto it = _index.find(key);
+    if(it == _index.end()){
+        return nullptr;
+    }
+    return &it->second;
+}
+
+ESP32KVStore::IndexEntry* ESP32KVStore::_lookup(const key_t& key) const {
     if(!_started || !key || strlen(key)>15){
-        return PT_INVALID;
+        return nullptr;
     }
-    int8_t mt1; uint8_t mt2; int16_t mt3; uint16_t mt4;
-    int32_t mt5; uint32_t mt6; int64_t mt7; uint64_t mt8;
-    size_t len = 0;
-    if(nvs_get_i8(_handle, key, &mt1) == ESP_OK) return PT_I8;
-    if(nvs_get_u8(_handle, key, &mt2) == ESP_OK) return PT_U8;
-    if(nvs_get_i16(_handle, key, &mt3) == ESP_OK) return PT_I16;
-    if(nvs_get_u16(_handle, key, &mt4) == ESP_OK) return PT_U16;
-    if(nvs_get_i32(_handle, key, &mt5) == ESP_OK) return PT_I32;
-    if(nvs_get_u32(_handle, key, &mt6) == ESP_OK) return PT_U32;
-    if(nvs_get_i64(_handle, key, &mt7) == ESP_OK) return PT_I64;
-    if(nvs_get_u64(_handle, key, &mt8) == ESP_OK) return PT_U64;
-    if(nvs_get_str(_handle, key, NULL, &len) == ESP_OK) return PT_STR;
-    if(nvs_get_blob(_handle, key, NULL, &len) == ESP_OK) return PT_BLOB;
-    return PT_INVALID;
+
+    IndexEntry* entry = _cached(key);
+    if(entry == nullptr && !_indexComplete){
+        // the key was never accessed, its type is found by probing every type
+        int8_t mt1; uint8_t mt2; int16_t mt3; uint16_t mt4;
+        int32_t mt5; uint32_t mt6; int64_t mt7; uint64_t mt8;
+        size_t len = 0;
+        Type t = PT_INVALID;
+        if       (nvs_get_i8(_handle, key, &mt1) == ESP_OK)  { t = PT_I8;
+        } else if(nvs_get_u8(_handle, key, &mt2) == ESP_OK)  { t = PT_U8;
+        } else if(nvs_get_i16(_handle, key, &mt3) == ESP_OK) { t = PT_I16;
+        } else if(nvs_get_u16(_handle, key, &mt4) == ESP_OK) { t = PT_U16;
+        } else if(nvs_get_i32(_handle, key, &mt5) == ESP_OK) { t = PT_I32;
+        } else if(nvs_get_u32(_handle, key, &mt6) == ESP_OK) { t = PT_U32;
+        } else if(nvs_get_i64(_handle, key, &mt7) == ESP_OK) { t = PT_I64;
+        } else if(nvs_get_u64(_handle, key, &mt8) == ESP_OK) { t = PT_U64;
+        } else if(nvs_get_str(_handle, key, NULL, &len) == ESP_OK) { t = PT_STR;
+        } else if(nvs_get_blob(_handle, key, NULL, &len) == ESP_OK) { t = PT_BLOB; }
+
+        // missing keys are cached as well, so that they are probed only once
+        entry = &(_index[key] = { t, t == PT_STR || t == PT_BLOB ? len : lengthOf(t) });
+    }
+
+    if(entry == nullptr || entry->type == PT_INVALID){
+        return nullptr;
+    }
+    return entry;
+}
+
+bool ESP32KVStore::_findChunks(const key_t& key, Chunks& chunks) const {
+    // only blobs are looked up further, the type comes from the index
+    IndexEntry* entry = isChunkKey(key) ? nullptr : _lookup(key);
+
+    return entry != nullptr && entry->type == PT_BLOB && findChunks(key, PT_BLOB, getBytesLength(key), chunks);
 }
 
+void ESP32KVStore::_indexRemoved(const key_t& key) {
+    if(_indexComplete){
+        _index.erase(key);
+    } else {
+        _index[key] = { PT_INVALID, 0 };
+    }
+}
+
+void ESP32KVStore::_buildIndex() {
+    _index.clear();
+    _indexComplete = false;
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    nvs_iterator_t it = NULL;
+    esp_err_t err = nvs_entry_find_in_handle(_handle, NVS_TYPE_ANY, &it);
 
+    while(err == ESP_OK){
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+
+        Type t = typeOf(info.type);
+        _index[info.key] = { t, lengthOf(t) };
+
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+
+    // on failure the index is filled on first access of each key
+    _indexComplete = err == ESP_ERR_NVS_NOT_FOUND;
+    if(!_indexComplete){
+        _index.clear();
+    }
+#endif // ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+}
 
 typename KVStoreInterface::res_t ESP32KVStore::_put(
+    const key_t& key, const uint8_t value[], size_t len, KVStoreInterface::Type t) {
+    if(_transaction) {
+        return _stage(key, value, len, t);
+    }
+
+    Chunks chunks;
+    bool chunked = _findChunks(key, chunks);
+
+    if(_set(key, value, len, t) == 0) {
+        return 0;
+    }
+
+    if(!_written(1)){
+        return 0;
+    }
+
+    if(chunked) {
+        removeChunks(chunks);
+    }
+
+    return len;
+}
+
+size_t ESP32KVStore::putMany(PutEntry entries[], size_t n) {
+    size_t count = 0;
+
+    if(_transaction) {
+        return KVStoreInterface::putMany(entries, n);
+    }
+
+    for(size_t i=0; i<n; i++) {
+        Chunks chunks;
+        bool chunked = _findChunks(entries[i].key, chunks);
+        entries[i].res = _set(entries[i].key, entries[i].value, entries[i].len, entries[i].type);
+
+        if(entries[i].res > 0) {
+            count++;
+        }
+
+        // rare, the removal commits the writes of the batch performed so far
+        if(entries[i].res > 0 && chunked) {
+            removeChunks(chunks);
+        }
+    }
+
+    // a single commit for the whole batch
+    if(!_written(count)) {
+        for(size_t i=0; i<n; i++) {
+            entries[i].res = 0;
+        }
+        return 0;
+    }
+
+    return count;
+}
+
+size_t ESP32KVStore::removeMany(const key_t keys[], size_t n) {
+    if(!_started || _readOnly){
+        return 0;
+    }
+    if(_transaction){
+        return KVStoreInterface::removeMany(keys, n);
+    }
+    size_t count = 0;
+
+    for(size_t i=0; i<n; i++) {
+        if(!keys[i] || _lookup(keys[i]) == nullptr) {
+            continue;
+        }
+        Chunks chunks;
+        bool chunked = _findChunks(keys[i], chunks);
+        esp_err_t err = nvs_erase_key(_handle, keys[i]);
+        if(err){
+            log_e("nvs_erase_key fail: %s %s", keys[i].c_str(), nvs_error(err));
+            continue;
+        }
+        _indexRemoved(keys[i]);
+        count++;
+
+        if(chunked) {
+            removeChunks(chunks);
+        }
+    }
+
+    if(!_written(count)) {
+        return 0;
+    }
+
+    return count;
+}
+
+void ESP32KVStore::setCommitPolicy(CommitPolicy policy, uint32_t param) {
+    _policy = policy;
+    _policyParam = param;
+}
+
+bool ESP32KVStore::beginTransaction() {
+    if(!_started || _readOnly || _transaction){
+        return false;
+    }
+    _transaction = true;
+    return true;
+}
+
+bool ESP32KVStore::commit() {
+    return _transaction ? _commitTransaction() : _commitPending();
+}
+
+bool ESP32KVStore::abort() {
+    if(!_transaction){
+        return false;
+    }
+    _transaction = false;
+    _journal.clear();
+    return true;
+}
+
+bool ESP32KVStore::_commitTransaction() {
+    _transaction = false;
+
+    // a single write is atomic by itself, it needs no journal
+    size_t len = 0;
+    const uint8_t* image = _journal.image(len);
+    bool journaled = _journal.entries() > 1;
+
+    if(journaled){
+        esp_err_t err = nvs_set_blob(_handle, ESP32_JOURNAL_KEY, image, len);
+        if(err){
+            log_e("nvs_set_blob journal fail: %s", nvs_error(err));
+            _journal.clear();
+            return false;
+        }
+
+        // the journal has to be durable before any of its writes is performed
+        _pending++;
+        if(!_commitPending()){
+            _journal.clear();
+            return false;
+        }
+    }
+
+    // if applying fails the journal is left in nvs, to be completed by the next begin()
+    bool res = _applyJournal(_journal);
+    if(res && journaled){
+        esp_err_t err = nvs_erase_key(_handle, ESP32_JOURNAL_KEY);
+        if(err){
+            log_e("nvs_erase_key journal fail: %s", nvs_error(err));
+            res = false;
+        }
+    }
+
+    _pending += _journal.entries() + (journaled ? 1 : 0);
+    _journal.clear();
+
+    return _commitPending() && res;
+}
+
+bool ESP32KVStore::_applyJournal(const KVJournal& journal) {
+    KVJournal::Entry e;
+    bool res = true;
+
+    for(size_t offset = journal.next(0, e); offset != 0 && res; offset = journal.next(offset, e)) {
+        if(!e.removed){
+            res = _set(e.key, e.value, e.len, e.type) > 0;
+            continue;
+        }
+
+        // the key may have been removed before a reset interrupted the transaction
+        esp_err_t err = nvs_erase_key(_handle, e.key);
+        if(err && err != ESP_ERR_NVS_NOT_FOUND){
+            log_e("nvs_erase_key fail: %s %s", e.key, nvs_error(err));
+            res = false;
+        }
+        _indexRemoved(e.key);
+    }
+
+    return res;
+}
+
+bool ESP32KVStore::_replayJournal() {
+    size_t len = 0;
+    if(nvs_get_blob(_handle, ESP32_JOURNAL_KEY, NULL, &len) != ESP_OK){
+        return true;
+    }
+
+    uint8_t* image = new uint8_t[len];
+    if(image == nullptr){
+        return false;
+    }
+
+    // a journal that was not completely saved belongs to a transaction that was never applied
+    KVJournal journal(len);
+    bool res = nvs_get_blob(_handle, ESP32_JOURNAL_KEY, image, &len) == ESP_OK && journal.load(image, len);
+    delete [] image;
+
+    if(res && !_applyJournal(journal)){
+        return false;
+    }
+
+    esp_err_t err = nvs_erase_key(_handle, ESP32_JOURNAL_KEY);
+    if(err){
+        log_e("nvs_erase_key journal fail: %s", nvs_error(err));
+        return false;
+    }
+    _pending++;
+
+    return _commitPending();
+}
+
+typename KVStoreInterface::res_t ESP32KVStore::_stage(
+    const key_t& key, const uint8_t value[], size_t len, KVStoreInterface::Type t) {
+    if(!_started || !key || strlen(key) > 15 || t == PT_INVALID || _readOnly){
+        return 0;
+    }
+
+    if(!_journal.put(key, value, len, t)){
+        log_e("journal full: %s", key.c_str());
+        return 0;
+    }
+
+    return len;
+}
+
+bool ESP32KVStore::_commitPending() {
+    if(!_started){
+        return false;
+    }
+    if(_pending == 0){
+        return true;
+    }
+    esp_err_t err = nvs_commit(_handle);
+    if(err){
+        log_e("nvs_commit fail: %s", nvs_error(err));
+        return false;
+    }
+    _pending = 0;
+    return true;
+}
+
+bool ESP32KVStore::_written(size_t writes) {
+    if(writes == 0){
+        return true;
+    }
+    if(_pending == 0){
+        _pendingSince = _clock != nullptr ? _clock() : 0;
+    }
+    _pending += writes;
+
+    switch(_policy) {
+    case COMMIT_EXPLICIT:
+        return true;
+    case COMMIT_EVERY_N:
+        return _pending < _policyParam || _commitPending();
+    case COMMIT_WINDOW:
+        return _clock == nullptr || _clock() - _pendingSince < _policyParam || _commitPending();
+    case COMMIT_IMMEDIATE:
+    default:
+        return _commitPending();
+    }
+}
+
+typename KVStoreInterface::res_t ESP32KVStore::_set(
     const key_t& key, const uint8_t value[], size_t len, KVStoreInterface::Type t) {
     if(!_started || !key || _readOnly){
         return 0;
@@ -224,24 +677,32 @@ typename KVStoreInterface::res_t ESP32KVStore::_put(
     }
 
     if(err){
-        log_e("nvs_set_ fail: %s %s", key, nvs_error(err)); // TODO put type
+        log_e("nvs_set_ fail: %s %s", key.c_str(), nvs_error(err)); // TODO put type
         return 0;
     }
 
-    err = nvs_commit(_handle);
-    if(err){
-        log_e("nvs_commit fail: %s %s", key, nvs_error(err));
-        return 0;
-    }
+    // floats and doubles are stored as integers of the same size
+    Type stored = t == PT_FLOAT ? PT_U32 : (t == PT_DOUBLE ? PT_U64 : t);
+    _index[key] = { stored, t == PT_STR ? strlen((const char*)value) + 1 : (t == PT_BLOB ? len : lengthOf(stored)) };
 
     return len;
 }
 
+ESP32KVStore::Type ESP32KVStore::_typeOf(const key_t& key) const {
+    return getType(key);
+}
+
 typename KVStoreInterface::res_t ESP32KVStore::_get(const key_t& key, uint8_t value[], size_t len, Type t) {
     if(!_started || !key){
         return 0;
     }
 
+    // keys known to be missing are not looked up in nvs
+    IndexEntry* entry = _cached(key);
+    if((entry != nullptr && entry->type == PT_INVALID) || (entry == nullptr && _indexComplete)){
+        return 0;
+    }
+
     esp_err_t err;
     switch(t) {
     case PT_I8:
@@ -283,11 +744,14 @@ typename KVStoreInterface::res_t ESP32KVStore::_get(const key_t& key, uint8_t va
     case PT_INVALID:
     default:
         log_e("nvs_get fail: invalid type");
-        break;
+        return 0;
     }
 
-    if(err){
-        log_e("nvs_get_ fail: %s %s", key, nvs_error(err)); // TODO put type
+    if(err == ESP_ERR_NVS_NOT_FOUND){
+        // missing keys are not an error, typed gets do not check for existence beforehand
+        return 0;
+    } else if(err){
+        log_e("nvs_get_ fail: %s %s", key.c_str(), nvs_error(err)); // TODO put type
         return 0;
     }
 
@@ -10,16 +10,48 @@
 #pragma once
 
 #include "../kvstore.h"
+#include "../utility/journal.h"
+#include "../utility/index.h"
 #include <Arduino.h>
-#include <string>
 
 using namespace std;
 
 constexpr char DEFAULT_KVSTORE_NAME[] = "arduino";
 
+// key under which the journal of a transaction being committed is saved
+constexpr char ESP32_JOURNAL_KEY[] = "__kvjournal";
+
+/** ESP32KVStore class
+ *
+ * KVStoreInterface backed by the nvs of the ESP32. The type and length of the stored keys
+ * are kept in a RAM index, so that exists(), getType() and getBytesLength() do not need to
+ * probe nvs for every possible type. With ESP-IDF 5 or later the index is filled at begin()
+ * by iterating the namespace, otherwise keys are added to it on first access. The index
+ * assumes that the namespace is not modified by other handles while the store is open.
+ *
+ * By default every write is committed as soon as it is performed, setCommitPolicy() allows
+ * to group writes in fewer commits. Writes that are not committed are readable, but they
+ * may be lost on reset; end() always commits them
+ *
+ * The writes of a transaction are staged in a KVJournal, which commit() saves as a single blob
+ * and commits before applying them, then erases with a second nvs_commit. A transaction of a
+ * single write needs no journal and one nvs_commit. begin() completes a transaction whose
+ * journal is found, so that its writes are applied either all or none
+ */
 class ESP32KVStore: public KVStoreInterface {
 public:
-    ESP32KVStore(): name(DEFAULT_KVSTORE_NAME) {}
+    typedef uint32_t (*clock_f)();
+
+    enum CommitPolicy {
+        COMMIT_IMMEDIATE,   // every write is committed
+        COMMIT_EXPLICIT,    // writes are committed by commit() and end()
+        COMMIT_EVERY_N,     // writes are committed every param writes
+        COMMIT_WINDOW,      // writes are committed by the first write param ms after the oldest pending one
+    };
+
+    ESP32KVStore(): name(DEFAULT_KVSTORE_NAME), _handle(0), _started(false), _readOnly(false), _indexComplete(false),
+        _policy(COMMIT_IMMEDIATE), _policyParam(0), _pending(0), _pendingSince(0), _clock([]() -> uint32_t { return millis(); }),
+        _transaction(false) {}
 
     bool begin() override;
     bool begin(const char* name, bool readOnly=false, const char* partitionLabel=nullptr);
@@ -29,17 +61,92 @@ public:
     typename KVStoreInterface::res_t remove(const key_t& key) override;
     bool exists(const key_t& key) const override;
     typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
+    using KVStoreInterface::getBytes;
     typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
     size_t getBytesLength(const key_t& key) const override;
 
+    size_t putMany(PutEntry entries[], size_t n) override;
+    using KVStoreInterface::removeMany;
+    size_t removeMany(const key_t keys[], size_t n) override;
+
     Type getType(const key_t& key) const;
 
+    bool forEach(const char* prefix, KeyCallback cb, void* ctx=nullptr) override;
+
+    bool beginTransaction() override;
+    bool abort() override;
+
+    /**
+     * @brief set when writes are committed to nvs
+     *
+     * @param[in]  policy           the commit policy
+     * @param[in]  param            the number of writes for COMMIT_EVERY_N, the window in ms
+     *                              for COMMIT_WINDOW, unused otherwise
+     */
+    void setCommitPolicy(CommitPolicy policy, uint32_t param=0);
+
+    /**
+     * @brief commit the open transaction, or the pending writes if there is none, to nvs
+     *
+     * @returns true if there were no pending writes or they were committed, false otherwise
+     */
+    bool commit() override;
+
+    /**
+     * @brief set the function used to measure the commit window, millis() by default
+     *
+     * @param[in]  clock            function returning the time in milliseconds
+     */
+    inline void setClock(clock_f clock) { _clock = clock; }
+
+    inline size_t pendingWrites() const { return _pending; }
+
 protected:
     res_t _put(const key_t& key, const uint8_t value[], size_t len, Type t);
     res_t _get(const key_t& key, uint8_t value[], size_t len, Type t);
+    Type _typeOf(const key_t& key) const;
 private:
+    struct IndexEntry {
+        Type type;      // PT_INVALID for keys known to be missing
+        size_t len;     // the length of strings and blobs is read on first use
+    };
+
+    // sets the value in nvs without committing it
+    res_t _set(const key_t& key, const uint8_t value[], size_t len, Type t);
+    // stages the value in the journal of the open transaction
+    res_t _stage(const key_t& key, const uint8_t value[], size_t len, Type t);
+    // accounts writes performed in nvs, committing them according to the policy
+    bool _written(size_t writes);
+    bool _commitPending();
+    bool _commitTransaction();
+    // performs the writes of a journal in nvs without committing them
+    bool _applyJournal(const KVJournal& journal);
+    // completes the transaction whose journal was saved before a reset
+    bool _replayJournal();
+
+    // returns the index entry of a key, probing nvs if the key was never accessed
+    IndexEntry* _lookup(const key_t& key) const;
+    // returns the index entry of a key, without accessing nvs
+    IndexEntry* _cached(const key_t& key) const;
+    // finds the chunks of a streamed value, looking up only the keys indexed as blobs
+    bool _findChunks(const key_t& key, Chunks& chunks) const;
+    void _indexRemoved(const key_t& key);
+    void _buildIndex();
+
     const char* name;
     uint32_t _handle;
     bool _started;
     bool _readOnly;
+
+    mutable KVIndex<IndexEntry> _index;
+    bool _indexComplete; // keys missing from the index are missing from nvs
+
+    CommitPolicy _policy;
+    uint32_t _policyParam;
+    size_t _pending;
+    uint32_t _pendingSince;
+    clock_f _clock;
+
+    bool _transaction;
+    KVJournal _journal;
 };
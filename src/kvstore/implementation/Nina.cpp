@@ -11,52 +11,204 @@
 #if defined(ARDUINO_ARCH_SAMD) || defined(ARDUINO_NANO_RP2040_CONNECT)
 
 #include "Nina.h"
+#include "../utility/crc.h"
+
+static constexpr size_t UNKNOWN_LENGTH = (size_t)-1;
 
 bool NinaKVStore::begin(const char* name, bool readOnly, const char* partitionLabel) {
+    if(started || deferred) {
+        return false;
+    }
+
+    this->name = name;
+    this->readOnly = readOnly;
+    this->partitionLabel = partitionLabel;
+
+    if(lazy) {
+        deferred = true;
+        return true;
+    }
+
+    return init();
+}
+
+bool NinaKVStore::begin() {
+    return begin(name);
+}
+
+bool NinaKVStore::warmup() {
+    return ready();
+}
+
+bool NinaKVStore::ready() const {
+    if(deferred) {
+        deferred = false;
+        init();
+    }
+
+    return started;
+}
+
+bool NinaKVStore::init() const {
+    profile.start();
+
     WiFiDrv::wifiDriverInit();
+    profile.phase("driver");
 
     String fv = WiFi.firmwareVersion();
+    profile.phase("firmware");
+
     if (fv < "3.0.0") {
         Serial.println("KVStore is not supported on Nina chip for versions older than 3.0.0");
 
         return false;
     }
 
-    return WiFiDrv::prefBegin(name, readOnly, partitionLabel);
-}
+    started = WiFiDrv::prefBegin(name, readOnly, partitionLabel);
+    profile.phase("prefs");
 
-bool NinaKVStore::begin() {
-    return begin(DEFAULT_KVSTORE_NAME);
+    return started;
 }
 
 bool NinaKVStore::end() {
+    deferred = false;
+    indexSize = 0;
+
+    if(!started) {
+        return false;
+    }
+
     WiFiDrv::prefEnd();
+    started = false;
     return true;
 }
 
 bool NinaKVStore::clear() {
+    if(!ready()) {
+        return false;
+    }
+
+    indexSize = 0;
     return WiFiDrv::prefClear();
 }
 
 typename KVStoreInterface::res_t NinaKVStore::remove(const key_t& key) {
-    return WiFiDrv::prefRemove(key);
+    if(!ready()) {
+        return 0;
+    }
+
+    Chunks chunks;
+    bool chunked = streamedChunks(key, chunks, true);
+    res_t res = WiFiDrv::prefRemove(key);
+    forget(key);
+
+    if(res > 0 && chunked) {
+        removeChunks(chunks);
+    }
+    return res;
 }
 
 typename KVStoreInterface::res_t NinaKVStore::putBytes(const key_t& key, const uint8_t value[], size_t len) {
-    return WiFiDrv::prefPut(key, static_cast<PreferenceType>(PT_BLOB), value, len);
+    return _put(key, value, len, PT_BLOB);
 }
 
 typename KVStoreInterface::res_t NinaKVStore::getBytes(const key_t& key, uint8_t buf[], size_t maxLen) const {
+    if(!ready()) {
+        return 0;
+    }
+
     return WiFiDrv::prefGet(key, static_cast<PreferenceType>(PT_BLOB), buf, maxLen);
 }
 
 size_t NinaKVStore::getBytesLength(const key_t& key) const {
-    auto len = WiFiDrv::prefLen(key);
-    return WiFiDrv::prefGetType(key) == PT_STR ? len-1 : len;
+    if(!ready()) {
+        return 0;
+    }
+
+    IndexEntry e = lookup(key, true);
+    if(e.type == PT_INVALID) {
+        return 0;
+    }
+
+    return e.type == PT_STR ? e.len-1 : e.len;
 }
 
 bool NinaKVStore::exists(const key_t& key) const {
-    return WiFiDrv::prefGetType(key) != PT_INVALID;
+    return ready() && lookup(key, false).type != PT_INVALID;
+}
+
+NinaKVStore::IndexEntry NinaKVStore::lookup(const key_t& key, bool needLen) const {
+    if(key == nullptr) {
+        return { PT_INVALID, 0 };
+    }
+
+    IndexSlot* slot = find(key);
+    if(slot != nullptr && (!needLen || slot->entry.len != UNKNOWN_LENGTH)) {
+        return slot->entry;
+    }
+
+    // the type is needed anyway, the length is read only for existing keys
+    Type type = slot != nullptr ? slot->entry.type : static_cast<Type>(WiFiDrv::prefGetType(key));
+    size_t len = type == PT_INVALID ? 0 : (needLen ? WiFiDrv::prefLen(key) : UNKNOWN_LENGTH);
+
+    remember(key, type, len);
+
+    return { type, len };
+}
+
+void NinaKVStore::remember(const key_t& key, Type type, size_t len) const {
+    if(key == nullptr) {
+        return;
+    } else if(type == PT_INVALID) {
+        forget(key);
+        return;
+    }
+
+    IndexSlot* slot = find(key);
+
+    if(slot != nullptr) {
+        slot->entry = { type, len };
+    } else if(index != nullptr && indexSize < indexMaxKeys && key.length() <= UINT16_MAX) {
+        index[indexSize++] = {
+            key.hash(), kvstore_crc32(key.c_str(), key.length()), (uint16_t)key.length(), { type, len } };
+    }
+}
+
+void NinaKVStore::forget(const key_t& key) const {
+    IndexSlot* slot = find(key);
+
+    // the last entry takes the place of the forgotten one
+    if(slot != nullptr) {
+        *slot = index[--indexSize];
+    }
+}
+
+bool NinaKVStore::streamedChunks(const key_t& key, Chunks& chunks, bool probe) const {
+    IndexSlot* slot = find(key);
+
+    if(slot != nullptr) {
+        size_t len = slot->entry.len != UNKNOWN_LENGTH ? slot->entry.len : STREAM_MANIFEST_SIZE;
+        return slot->entry.type == PT_BLOB && findChunks(key, PT_BLOB, len, chunks);
+    }
+
+    // a single read, it fails for values that are not blobs of the size of a manifest
+    return probe && findChunks(key, PT_BLOB, STREAM_MANIFEST_SIZE, chunks);
+}
+
+NinaKVStore::IndexSlot* NinaKVStore::find(const key_t& key) const {
+    if(key == nullptr) {
+        return nullptr;
+    }
+
+    uint32_t hash = key.hash();
+    for(size_t i=0; i<indexSize; i++) {
+        if(index[i].hash == hash && index[i].keyLen == key.length() &&
+            index[i].crc == kvstore_crc32(key.c_str(), key.length())) {
+            return &index[i];
+        }
+    }
+
+    return nullptr;
 }
 
 typename KVStoreInterface::res_t NinaKVStore::_put(
@@ -65,10 +217,33 @@ typename KVStoreInterface::res_t NinaKVStore::_put(
         t = PT_BLOB;
     }
 
+    if(!ready()) {
+        return 0;
+    }
+
     if(t == PT_STR) {
         len++; // For strings we also send the \0
     }
-    return WiFiDrv::prefPut(key, static_cast<PreferenceType>(t), value, len);
+
+    Chunks chunks;
+    bool chunked = streamedChunks(key, chunks, false);
+
+    size_t res = WiFiDrv::prefPut(key, static_cast<PreferenceType>(t), value, len);
+    if(res > 0) {
+        remember(key, t, res);
+    } else {
+        forget(key);
+    }
+
+    // the chunks of a streamed value are removed once it is replaced
+    if(res > 0 && chunked) {
+        removeChunks(chunks);
+    }
+    return res;
+}
+
+KVStoreInterface::Type NinaKVStore::_typeOf(const key_t& key) const {
+    return ready() ? lookup(key, false).type : PT_INVALID;
 }
 
 typename KVStoreInterface::res_t NinaKVStore::_get(const key_t& key, uint8_t value[], size_t len, Type t) {
@@ -76,9 +251,13 @@ typename KVStoreInterface::res_t NinaKVStore::_get(const key_t& key, uint8_t val
         t = PT_BLOB;
     }
 
+    if(!ready()) {
+        return 0;
+    }
+
     size_t res = WiFiDrv::prefGet(key, static_cast<PreferenceType>(t), value, len);
 
-    if(t == PT_STR) {
+    if(t == PT_STR && res < len) {
         value[res] = '\0';
     }
 
@@ -10,30 +10,113 @@
 #pragma once
 
 #include "../kvstore.h"
+#include "../utility/initprofile.h"
 
 #include <WiFi.h>
+#include <string>
 
 using namespace std;
 
 const char DEFAULT_KVSTORE_NAME[] = "arduino";
 
+// number of keys whose type and length are remembered, RAM is scarce on NINA boards
+constexpr size_t DEFAULT_NINA_INDEX_MAX_KEYS = 32;
+
+/** NinaKVStore class
+ *
+ * KVStoreInterface backed by the preferences of the NINA module, every WiFiDrv call is a SPI
+ * transaction with the module. The type and length of the existing keys that were written or
+ * looked up are remembered, up to indexMaxKeys of them, so that exists() and getBytesLength()
+ * do not need a transaction for them. Missing keys are always confirmed by the module.
+ * The index is an array of indexMaxKeys entries allocated by the constructor, keys are not
+ * copied but identified by their length and by two independent hashes. The index assumes
+ * that the preferences are not modified by others while the store is open.
+ *
+ * Bringing up the NINA driver takes a while, with lazy init enabled begin() returns
+ * immediately and the initialization is performed by warmup() or by the first access to
+ * the store. The duration of each phase of the last initialization is reported by
+ * getInitProfile()
+ */
 class NinaKVStore: public KVStoreInterface {
 public:
-    NinaKVStore(const char* name=DEFAULT_KVSTORE_NAME): name(name) {}
+    NinaKVStore(const char* name=DEFAULT_KVSTORE_NAME, size_t indexMaxKeys=DEFAULT_NINA_INDEX_MAX_KEYS)
+    : name(name), readOnly(false), partitionLabel(nullptr), lazy(false), deferred(false), started(false),
+        profile([]() -> uint32_t { return micros(); }), indexMaxKeys(indexMaxKeys),
+        index(new IndexSlot[indexMaxKeys]), indexSize(0) {}
+    ~NinaKVStore() { delete [] index; }
     bool begin() override;
+    /**
+     * @brief open the preferences, with lazy init the strings passed must outlive the store
+     */
     bool begin(const char* name, bool readOnly=false, const char* partitionLabel=nullptr);
     bool end() override;
     bool clear() override;
 
+    /**
+     * @brief defer the initialization performed by begin() to warmup() or to the first access,
+     *        it must be called before begin()
+     */
+    inline void setLazyInit(bool lazy)                  { this->lazy = lazy; }
+
+    /**
+     * @brief perform the initialization deferred by begin(), if any
+     *
+     * @returns true if the store is initialized, false if the initialization failed
+     */
+    bool warmup();
+
+    inline const InitProfile& getInitProfile() const    { return profile; }
+
     typename KVStoreInterface::res_t remove(const key_t& key) override;
     bool exists(const key_t& key) const override;
     typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
+    using KVStoreInterface::getBytes;
     typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
     size_t getBytesLength(const key_t& key) const override;
 
 protected:
     res_t _put(const key_t& key, const uint8_t value[], size_t len, Type t) override;
     res_t _get(const key_t& key, uint8_t value[], size_t len, Type t) override;
+    Type _typeOf(const key_t& key) const override;
 private:
+    struct IndexEntry {
+        Type type;      // PT_INVALID for missing keys
+        size_t len;     // the stored length, strings include the terminator
+    };
+
+    // the key is confirmed by its length and crc when the hash matches
+    struct IndexSlot {
+        uint32_t hash;
+        uint32_t crc;
+        uint16_t keyLen;
+        IndexEntry entry;
+    };
+
+    // returns the index entry of a key, performing the transactions needed to fill it
+    IndexEntry lookup(const key_t& key, bool needLen) const;
+    // missing keys are forgotten, so that they are confirmed by the module
+    void remember(const key_t& key, Type type, size_t len) const;
+    void forget(const key_t& key) const;
+    IndexSlot* find(const key_t& key) const;
+    // finds the chunks of a streamed value from the index, probe reads the keys missing from it
+    bool streamedChunks(const key_t& key, Chunks& chunks, bool probe) const;
+
+    bool init() const;
+
+    // true if the store is initialized, initializing it if it was deferred
+    bool ready() const;
+
     const char* name;
+    bool readOnly;
+    const char* partitionLabel;
+
+    // the initialization can be deferred to the first access, even a read
+    bool lazy;
+    mutable bool deferred;
+    mutable bool started;
+    mutable InitProfile profile;
+
+    const size_t indexMaxKeys;
+    IndexSlot* index;           // nullptr if it could not be allocated
+    mutable size_t indexSize;
 };
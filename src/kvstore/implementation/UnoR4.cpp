@@ -11,6 +11,64 @@
 #if defined(ARDUINO_UNOR4_WIFI)
 #include "UnoR4.h"
 
+// integers up to 32 bits can be sent as decimal text, sprintf does not support 64 bits on unor4
+static bool isTextType(KVStoreInterface::Type t) {
+    return t == KVStoreInterface::PT_I8 || t == KVStoreInterface::PT_U8 ||
+        t == KVStoreInterface::PT_I16 || t == KVStoreInterface::PT_U16 ||
+        t == KVStoreInterface::PT_I32 || t == KVStoreInterface::PT_U32;
+}
+
+static size_t widthOf(KVStoreInterface::Type t) {
+    switch(t) {
+    case KVStoreInterface::PT_I8:
+    case KVStoreInterface::PT_U8:   return 1;
+    case KVStoreInterface::PT_I16:
+    case KVStoreInterface::PT_U16:  return 2;
+    default:                        return 4;
+    }
+}
+
+static void toText(KVStoreInterface::Type t, const uint8_t value[], char buf[], size_t len) {
+    int8_t i8; int16_t i16; int32_t i32; uint32_t u32 = 0;
+
+    switch(t) {
+    case KVStoreInterface::PT_I8:   memcpy(&i8, value, sizeof(i8));     snprintf(buf, len, "%d", i8);   break;
+    case KVStoreInterface::PT_I16:  memcpy(&i16, value, sizeof(i16));   snprintf(buf, len, "%d", i16);  break;
+    case KVStoreInterface::PT_I32:  memcpy(&i32, value, sizeof(i32));   snprintf(buf, len, "%ld", (long)i32); break;
+    default:                        memcpy(&u32, value, widthOf(t));    snprintf(buf, len, "%lu", (unsigned long)u32); break;
+    }
+}
+
+// responses are not null terminated
+static long long parseInteger(const uint8_t data[], size_t len) {
+    char buf[24];
+    len = len < sizeof(buf) - 1 ? len : sizeof(buf) - 1;
+    memcpy(buf, data, len);
+    buf[len] = '\0';
+
+    return strtoll(buf, nullptr, 10);
+}
+
+Unor4KVStore::~Unor4KVStore() {
+    delete pipeline;
+}
+
+bool Unor4KVStore::setPipelineDepth(size_t depth, Stream& link) {
+    delete pipeline;
+    pipeline = nullptr;
+
+    if(depth > 0) {
+        pipeline = new ATPipeline(link, depth);
+        if(pipeline == nullptr || pipeline->getDepth() == 0) {
+            delete pipeline;
+            pipeline = nullptr;
+            return false;
+        }
+    }
+
+    return true;
+}
+
 bool Unor4KVStore::begin(const char* name, bool readOnly, const char* partitionLabel) {
     this->name = name;
     string res = "";
@@ -30,7 +88,7 @@ bool Unor4KVStore::begin() {
 
 bool Unor4KVStore::end() {
     string res = "";
-    modem.write(string(PROMPT(_PREF_END)), res, "%s", CMD(_PREF_END));
+    return modem.write(string(PROMPT(_PREF_END)), res, "%s", CMD(_PREF_END));
 }
 
 bool Unor4KVStore::clear() {
@@ -44,7 +102,8 @@ bool Unor4KVStore::clear() {
 typename KVStoreInterface::res_t Unor4KVStore::remove(const key_t& key) {
     string res = "";
     if (key != nullptr && strlen(key) > 0) {
-        if (modem.write(string(PROMPT(_PREF_REMOVE)), res, "%s%s\r\n", CMD_WRITE(_PREF_REMOVE), key)) {
+        removeChunks(key);
+        if (modem.write(string(PROMPT(_PREF_REMOVE)), res, "%s%s\r\n", CMD_WRITE(_PREF_REMOVE), key.c_str())) {
             return (atoi(res.c_str()) != 0) ? true : false;
         }
     }
@@ -54,7 +113,7 @@ typename KVStoreInterface::res_t Unor4KVStore::remove(const key_t& key) {
 typename KVStoreInterface::res_t Unor4KVStore::putBytes(const key_t& key, const uint8_t value[], size_t len) {
     string res = "";
     if ( key != nullptr && strlen(key) > 0 && value != nullptr && len > 0) {
-        modem.write_nowait(string(PROMPT(_PREF_PUT)), res, "%s%s,%d,%d\r\n", CMD_WRITE(_PREF_PUT), key, PT_BLOB, len);
+        modem.write_nowait(string(PROMPT(_PREF_PUT)), res, "%s%s,%d,%d\r\n", CMD_WRITE(_PREF_PUT), key.c_str(), PT_BLOB, len);
         if(modem.passthrough((uint8_t *)value, len)) {
             return len;
         }
@@ -63,15 +122,11 @@ typename KVStoreInterface::res_t Unor4KVStore::putBytes(const key_t& key, const
 }
 
 typename KVStoreInterface::res_t Unor4KVStore::getBytes(const key_t& key, uint8_t buf[], size_t maxLen) const {
-    size_t len = getBytesLength(key);
     string res = "";
-    if (key != nullptr && strlen(key) > 0 && buf != nullptr && len > 0) {
-        modem.read_using_size();
-        if (modem.write(string(PROMPT(_PREF_GET)), res, "%s%s,%d\r\n", CMD_WRITE(_PREF_GET), key, PT_BLOB)) {
-            if (res.size() >= len && len <= maxLen) {
-                memcpy(buf, (uint8_t*)&res[0], len);
-                return len;
-            }
+    if (buf != nullptr && fetch(key, PT_BLOB, res)) {
+        if (res.size() > 0 && res.size() <= maxLen) {
+            memcpy(buf, (uint8_t*)&res[0], res.size());
+            return res.size();
         }
     }
     return 0;
@@ -80,7 +135,7 @@ typename KVStoreInterface::res_t Unor4KVStore::getBytes(const key_t& key, uint8_
 size_t Unor4KVStore::getBytesLength(const key_t& key) const {
     string res = "";
     if (key != nullptr && strlen(key) > 0) {
-        if (modem.write(string(PROMPT(_PREF_LEN)), res, "%s%s\r\n", CMD_WRITE(_PREF_LEN), key)) {
+        if (modem.write(string(PROMPT(_PREF_LEN)), res, "%s%s\r\n", CMD_WRITE(_PREF_LEN), key.c_str())) {
             return atoi(res.c_str());
         }
     }
@@ -89,126 +144,105 @@ size_t Unor4KVStore::getBytesLength(const key_t& key) const {
 
 
 bool Unor4KVStore::exists(const key_t& key) const {
-    string res = "";
-    if (key != nullptr && strlen(key) > 0) {
-        if (modem.write(string(PROMPT(_PREF_TYPE)), res, "%s%s\r\n", CMD_WRITE(_PREF_TYPE), key)) {
-            return static_cast<Type>(atoi(res.c_str())) != PT_INVALID;
-        }
-    }
-    return false;
+    return _typeOf(key) != PT_INVALID;
 }
 
 typename KVStoreInterface::res_t Unor4KVStore::_put(
     const key_t& key, const uint8_t value[], size_t len, KVStoreInterface::Type t) {
 
-    if (key == nullptr || strlen(key) == 0) {
+    if (key == nullptr || strlen(key) == 0 || value == nullptr) {
         return 0;
     }
     string res = "";
-    string format = "%s%s,%d,%hu\r\n";
-
-    switch(t) {
-    case PT_I8:     format = "%s%s,%d,%hd\r\n"; break;
-    case PT_U8:     format = "%s%s,%d,%hu\r\n"; break;
-    case PT_I16:    format = "%s%s,%d,%hd\r\n"; break;
-    case PT_U16:    format = "%s%s,%d,%hu\r\n"; break;
-    case PT_I32:    format = "%s%s,%d,%d\r\n";  break;
-    case PT_U32:    format = "%s%s,%d,%u\r\n";  break;
-    }
-
-    uint32_t tmp = 0;
-    if( t == PT_I8 || t == PT_U8 || t == PT_I16 || t == PT_U16 ||
-        t == PT_I32 || t == PT_U32) {
-        memcpy(&tmp, value, len);
-    }
 
     switch(t) {
-    case PT_I8:
-    case PT_U8:
-    case PT_I16:
-    case PT_U16:
-    case PT_I32:
-    case PT_U32:
-        // sprintf doesn't support 64 bits on unor4
-        if (modem.write(string(PROMPT(_PREF_PUT)), res, format.c_str(), CMD_WRITE(_PREF_PUT), key, t, tmp)) {
-            return atoi(res.c_str());
-        }
-        break;
-    case PT_I64:
-    case PT_U64:
-    case PT_FLOAT:
-    case PT_DOUBLE:
-        return putBytes(key, value, len);
     case PT_STR:
-        modem.write_nowait(string(PROMPT(_PREF_PUT)), res, "%s%s,%d,%d\r\n", CMD_WRITE(_PREF_PUT), key, t, len);
+        modem.write_nowait(string(PROMPT(_PREF_PUT)), res, "%s%s,%d,%u\r\n", CMD_WRITE(_PREF_PUT), key.c_str(), t, (unsigned)len);
         if(modem.passthrough(value, len)) {
             return len;
         }
         break;
-    case PT_BLOB:
-        return putBytes(key, value, len);
-        break;
     case PT_INVALID:
-    default:
         break;
+    default:
+        if (!binaryNumbers && isTextType(t)) {
+            char text[12];
+            toText(t, value, text, sizeof(text));
+            if (modem.write(string(PROMPT(_PREF_PUT)), res, "%s%s,%d,%s\r\n", CMD_WRITE(_PREF_PUT), key.c_str(), t, text)) {
+                return atoi(res.c_str());
+            }
+            break;
+        }
+
+        // numbers are sent as they are in memory, like blobs
+        return putBytes(key, value, len);
     }
 
     return 0;
 }
 
+KVStoreInterface::Type Unor4KVStore::_typeOf(const key_t& key) const {
+    string res = "";
+    if (key != nullptr && strlen(key) > 0) {
+        if (modem.write(string(PROMPT(_PREF_TYPE)), res, "%s%s\r\n", CMD_WRITE(_PREF_TYPE), key.c_str())) {
+            return static_cast<Type>(atoi(res.c_str()));
+        }
+    }
+    return PT_INVALID;
+}
+
 typename KVStoreInterface::res_t Unor4KVStore::_get(const key_t& key, uint8_t value[], size_t len, Type t) {
 
-    if (key == nullptr || strlen(key) == 0) {
+    if (key == nullptr || strlen(key) == 0 || value == nullptr) {
         return 0;
     }
     string res = "";
-    string format = "%s%s,%d,%u\r\n";
-
-    switch(t) {
-    case PT_I8:     format = "%hd"; break;
-    case PT_U8:     format = "%hu"; break;
-    case PT_I16:    format = "%hd"; break;
-    case PT_U16:    format = "%hu"; break;
-    case PT_I32:    format = "%d";  break;
-    case PT_U32:    format = "%u";  break;
-    }
 
     switch(t) {
-    case PT_I8:
-    case PT_U8:
-    case PT_I16:
-    case PT_U16:
-    case PT_I32:
-    case PT_U32:
-        if (modem.write(string(PROMPT(_PREF_GET)), res, "%s%s,%d,%u\r\n", CMD_WRITE(_PREF_GET), key, t)) {
-            sscanf(res.c_str(), format.c_str(), value);
-
-            return len;
-        }
-        break;
-    case PT_I64:
-    case PT_U64:
-    case PT_FLOAT:
-    case PT_DOUBLE:
-        return getBytes(key, value, len);
     case PT_STR:
         return getString(key, (char*)value, len);
-        break;
     case PT_BLOB:
         return getBytes(key, value, len);
-        break;
     case PT_INVALID:
+        return 0;
     default:
         break;
     }
+
+    if (binaryNumbers) {
+        if (fetch(key, PT_BLOB, res) && res.size() == len) {
+            memcpy(value, &res[0], len);
+            return len;
+        }
+
+        // integers written as text by previous versions are still readable, a missing
+        // key costs one more exchange
+        if (!isTextType(t)) {
+            return 0;
+        }
+    } else if (!isTextType(t)) {
+        return getBytes(key, value, len);
+    }
+
+    // the bridge answers a text read of a missing key with 0, the type tells them apart
+    if (_typeOf(key) != t) {
+        return 0;
+    }
+
+    if (modem.write(string(PROMPT(_PREF_GET)), res, "%s%s,%d\r\n", CMD_WRITE(_PREF_GET), key.c_str(), t)) {
+        // the low bytes are the value, for both signed and unsigned types
+        uint32_t n = (uint32_t)parseInteger((const uint8_t*)res.data(), res.size());
+        memcpy(value, &n, widthOf(t));
+        return len;
+    }
+
     return 0;
 }
 
 size_t Unor4KVStore::getString(const key_t& key, char value[], size_t maxLen) {
     string res;
-    if (key != nullptr && strlen(key) > 0) {
-        modem.read_using_size();
-        if (modem.write(string(PROMPT(_PREF_GET)), res, "%s%s,%d,%s\r\n", CMD_WRITE(_PREF_GET), key, PT_STR, res)) {
+    if (value != nullptr && maxLen > 0) {
+        if (fetch(key, PT_STR, res)) {
             res.push_back('\0');
 
             if(res.length() > maxLen-1) {
@@ -222,16 +256,230 @@ size_t Unor4KVStore::getString(const key_t& key, char value[], size_t maxLen) {
     return 0;
 }
 
+typename KVStoreInterface::res_t Unor4KVStore::view(const key_t& key, ViewCallback cb, void* ctx, Type t) {
+    string res;
+    if (!fetch(key, t == PT_STR ? PT_STR : PT_BLOB, res) || res.size() == 0) {
+        return 0;
+    }
+
+    cb((const uint8_t*)res.data(), res.size(), ctx);
+    return res.size();
+}
+
+bool Unor4KVStore::fetch(const key_t& key, Type t, string& res) const {
+    if (key == nullptr || strlen(key) == 0) {
+        return false;
+    }
+
+    // the length of the value is the prefix of the sized response, a missing value is empty
+    modem.read_using_size();
+    if (t == PT_STR) {
+        return modem.write(string(PROMPT(_PREF_GET)), res, "%s%s,%d,%s\r\n", CMD_WRITE(_PREF_GET), key.c_str(), PT_STR, "");
+    }
+    return modem.write(string(PROMPT(_PREF_GET)), res, "%s%s,%d\r\n", CMD_WRITE(_PREF_GET), key.c_str(), t);
+}
+
+#ifdef ARDUINO
 String Unor4KVStore::getString(const key_t& key, const String defaultValue) {
     string res = defaultValue.c_str();;
     if (key != nullptr && strlen(key) > 0) {
         modem.read_using_size();
-        if (modem.write(string(PROMPT(_PREF_GET)), res, "%s%s,%d,%s\r\n", CMD_WRITE(_PREF_GET), key, PT_STR, defaultValue.c_str())) {
+        if (modem.write(string(PROMPT(_PREF_GET)), res, "%s%s,%d,%s\r\n", CMD_WRITE(_PREF_GET), key.c_str(), PT_STR, defaultValue.c_str())) {
 
             return String(res.c_str());
         }
     }
     return String(res.c_str());
 }
+#endif // ARDUINO
+
+static void putDone(bool ok, const uint8_t data[], size_t len, void* ctx) {
+    KVStoreInterface::PutEntry* entry = (KVStoreInterface::PutEntry*)ctx;
+    entry->res = ok ? parseInteger(data, len) : 0;
+}
+
+static void getDone(bool ok, const uint8_t data[], size_t len, void* ctx) {
+    KVStoreInterface::GetEntry* entry = (KVStoreInterface::GetEntry*)ctx;
+    entry->res = 0;
+
+    if(!ok) {
+        return;
+    }
+
+    if(entry->type == KVStoreInterface::PT_STR) {
+        // the terminator is not sent, a missing string is received as empty
+        if(len > 0 && len < entry->len) {
+            memcpy(entry->value, data, len);
+            entry->value[len] = '\0';
+            entry->res = len + 1;
+        }
+    } else if(len > 0 && (len == entry->len || (entry->type == KVStoreInterface::PT_BLOB && len < entry->len))) {
+        memcpy(entry->value, data, len);
+        entry->res = len;
+    }
+}
+
+static void getTextDone(bool ok, const uint8_t data[], size_t len, void* ctx) {
+    KVStoreInterface::GetEntry* entry = (KVStoreInterface::GetEntry*)ctx;
+    entry->res = 0;
+
+    if(ok) {
+        // the low bytes are the value, for both signed and unsigned types
+        uint32_t value = (uint32_t)parseInteger(data, len);
+        memcpy(entry->value, &value, widthOf(entry->type));
+        entry->res = entry->len;
+    }
+}
+
+// marks the entries whose value is stored as text, res is -1 for them
+static void typeDone(bool ok, const uint8_t data[], size_t len, void* ctx) {
+    KVStoreInterface::GetEntry* entry = (KVStoreInterface::GetEntry*)ctx;
+    entry->res = ok && parseInteger(data, len) == entry->type ? -1 : 0;
+}
+
+// the responses of remove and of length queries hold an integer
+static void integerDone(bool ok, const uint8_t data[], size_t len, void* ctx) {
+    *(KVStoreInterface::res_t*)ctx = ok ? parseInteger(data, len) : 0;
+}
+
+size_t Unor4KVStore::putMany(PutEntry entries[], size_t n) {
+    if(pipeline == nullptr) {
+        return KVStoreInterface::putMany(entries, n);
+    }
+
+    for(size_t i=0; i<n; i++) {
+        PutEntry& e = entries[i];
+        e.res = 0;
+
+        if(e.key == nullptr || strlen(e.key) == 0 || e.value == nullptr || e.len == 0) {
+            continue;
+        }
+
+        if(!binaryNumbers && isTextType(e.type)) {
+            char text[12];
+            toText(e.type, e.value, text, sizeof(text));
+            pipeline->send(PROMPT(_PREF_PUT), false, putDone, &e, nullptr, 0,
+                "%s%s,%d,%s\r\n", CMD_WRITE(_PREF_PUT), e.key.c_str(), e.type, text);
+        } else if(e.type != PT_INVALID) {
+            // numbers are sent as blobs, like in _put()
+            Type t = e.type == PT_STR ? PT_STR : PT_BLOB;
+            pipeline->send(PROMPT(_PREF_PUT), false, putDone, &e, e.value, e.len,
+                "%s%s,%d,%u\r\n", CMD_WRITE(_PREF_PUT), e.key.c_str(), t, (unsigned)e.len);
+        }
+    }
+    pipeline->drain();
+
+    size_t count = 0;
+    for(size_t i=0; i<n; i++) {
+        if(entries[i].res > 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+size_t Unor4KVStore::getMany(GetEntry entries[], size_t n) {
+    if(pipeline == nullptr) {
+        return KVStoreInterface::getMany(entries, n);
+    }
+
+    for(size_t i=0; i<n; i++) {
+        GetEntry& e = entries[i];
+        e.res = 0;
+
+        if(e.key == nullptr || strlen(e.key) == 0 || e.value == nullptr || e.len == 0) {
+            continue;
+        }
+
+        if(!binaryNumbers && isTextType(e.type)) {
+            continue; // read after their type, below
+        } else if(e.type == PT_STR) {
+            pipeline->send(PROMPT(_PREF_GET), true, getDone, &e, nullptr, 0,
+                "%s%s,%d,\r\n", CMD_WRITE(_PREF_GET), e.key.c_str(), PT_STR);
+        } else if(e.type != PT_INVALID) {
+            // the length of the value comes with the response, no need for _PREF_LEN
+            pipeline->send(PROMPT(_PREF_GET), true, getDone, &e, nullptr, 0,
+                "%s%s,%d\r\n", CMD_WRITE(_PREF_GET), e.key.c_str(), PT_BLOB);
+        }
+    }
+    pipeline->drain();
+
+    // integers written as text, the types are queried first since the bridge answers a
+    // missing key with 0, like in _get()
+    for(size_t i=0; i<n; i++) {
+        GetEntry& e = entries[i];
+        if(e.res == 0 && isTextType(e.type) && e.key != nullptr && strlen(e.key) > 0 && e.value != nullptr && e.len > 0) {
+            pipeline->send(PROMPT(_PREF_TYPE), false, typeDone, &e, nullptr, 0,
+                "%s%s\r\n", CMD_WRITE(_PREF_TYPE), e.key.c_str());
+        }
+    }
+    pipeline->drain();
+
+    for(size_t i=0; i<n; i++) {
+        GetEntry& e = entries[i];
+        if(e.res == -1) {
+            e.res = 0;
+            pipeline->send(PROMPT(_PREF_GET), false, getTextDone, &e, nullptr, 0,
+                "%s%s,%d\r\n", CMD_WRITE(_PREF_GET), e.key.c_str(), e.type);
+        }
+    }
+    pipeline->drain();
+
+    size_t count = 0;
+    for(size_t i=0; i<n; i++) {
+        if(entries[i].res > 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+size_t Unor4KVStore::removeMany(const key_t keys[], size_t n) {
+    if(pipeline == nullptr) {
+        return KVStoreInterface::removeMany(keys, n);
+    }
+
+    res_t* res = new res_t[n]();
+    if(res == nullptr) {
+        return 0;
+    }
+
+    // the lengths are queried in a batch, only the keys that may hold a manifest are read
+    for(size_t i=0; i<n; i++) {
+        if(keys[i] != nullptr && strlen(keys[i]) > 0) {
+            pipeline->send(PROMPT(_PREF_LEN), false, integerDone, &res[i], nullptr, 0,
+                "%s%s\r\n", CMD_WRITE(_PREF_LEN), keys[i].c_str());
+        }
+    }
+    pipeline->drain();
+
+    for(size_t i=0; i<n; i++) {
+        Chunks chunks;
+        if(findChunks(keys[i], PT_BLOB, res[i] > 0 ? res[i] : 0, chunks)) {
+            removeChunks(chunks);
+        }
+        res[i] = 0;
+    }
+
+    for(size_t i=0; i<n; i++) {
+        if(keys[i] != nullptr && strlen(keys[i]) > 0) {
+            pipeline->send(PROMPT(_PREF_REMOVE), false, integerDone, &res[i], nullptr, 0,
+                "%s%s\r\n", CMD_WRITE(_PREF_REMOVE), keys[i].c_str());
+        }
+    }
+    pipeline->drain();
+
+    size_t count = 0;
+    for(size_t i=0; i<n; i++) {
+        if(res[i] > 0) {
+            count++;
+        }
+    }
+    delete [] res;
+
+    return count;
+}
 
 #endif // defined(ARDUINO_UNOR4_WIFI)
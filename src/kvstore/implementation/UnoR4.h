@@ -13,14 +13,26 @@
 #include <Arduino.h>
 #include <Modem.h>
 #include <string>
+#include "ATPipeline.h"
 
 using namespace std;
 
 constexpr char DEFAULT_KVSTORE_NAME[] = "arduino";
 
+/** Unor4KVStore class
+ *
+ * KVStoreInterface backed by the preferences of the ESP32-S3 bridge of the UNO R4 WiFi, every
+ * operation is an AT command exchanged with the bridge through the modem. Reads take a single
+ * exchange, the length of a value comes with it in the sized response. By default integers are
+ * sent as text, like previous versions did, sending them in binary is opt-in, see
+ * setBinaryNumbers(). When pipelining is
+ * enabled putMany(), getMany() and removeMany() keep several commands in flight, instead of
+ * waiting for each response before sending the next command
+ */
 class Unor4KVStore: public KVStoreInterface {
 public:
-    Unor4KVStore(): name(DEFAULT_KVSTORE_NAME) {}
+    Unor4KVStore(): name(DEFAULT_KVSTORE_NAME), pipeline(nullptr), binaryNumbers(false) {}
+    ~Unor4KVStore();
 
     bool begin() override;
     bool begin(const char* name, bool readOnly=false, const char* partitionLabel=nullptr);
@@ -30,15 +42,53 @@ public:
     typename KVStoreInterface::res_t remove(const key_t& key) override;
     bool exists(const key_t& key) const override;
     typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
+    using KVStoreInterface::getBytes;
     typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
     size_t getBytesLength(const key_t& key) const override;
 
+    size_t putMany(PutEntry entries[], size_t n) override;
+    size_t getMany(GetEntry entries[], size_t n) override;
+    using KVStoreInterface::removeMany;
+    size_t removeMany(const key_t keys[], size_t n) override;
+
     size_t getString(const key_t& key, char value[], size_t maxLen) override;
+    res_t view(const key_t& key, ViewCallback cb, void* ctx=nullptr, Type t=PT_BLOB) override;
+#ifdef ARDUINO
     String getString(const key_t& key, const String defaultValue = String()) override;
+#endif // ARDUINO
+
+    /**
+     * @brief keep up to depth commands in flight in putMany(), getMany() and removeMany()
+     *
+     * @param[in]  depth            the number of commands in flight, 0 disables pipelining
+     * @param[in]  link             the serial port connected to the bridge
+     *
+     * @returns true if pipelining was configured, false otherwise
+     */
+    bool setPipelineDepth(size_t depth, Stream& link=Serial2);
+
+    inline const ATPipeline* getPipeline() const { return pipeline; }
+
+    /**
+     * @brief choose how numbers are sent to the bridge. By default integers up to 32 bits are
+     *        sent as decimal text, like previous versions did, while 64 bit integers, float and
+     *        double are always binary. When enabled, numbers are sent in binary as blobs of their
+     *        size: integers written as text are still readable, but values written in binary
+     *        are stored as blobs, which previous versions of a firmware cannot read as numbers
+     *
+     * @param[in]  enable           true to send numbers in binary
+     */
+    inline void setBinaryNumbers(bool enable) { binaryNumbers = enable; }
 
 protected:
     res_t _put(const key_t& key, const uint8_t value[], size_t len, Type t) override;
     res_t _get(const key_t& key, uint8_t value[], size_t len, Type t) override;
+    Type _typeOf(const key_t& key) const override;
 private:
+    // reads a value with a single _PREF_GET exchange
+    bool fetch(const key_t& key, Type t, string& res) const;
+
     const char* name;
+    ATPipeline* pipeline;
+    bool binaryNumbers;
 };
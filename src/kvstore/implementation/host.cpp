@@ -0,0 +1,798 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#if defined(HOST)
+#include "host.h"
+#include "../utility/crc.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr uint32_t RECORD_MAGIC = 0x524C564B; // "KVLR"
+static constexpr uint8_t RECORD_REMOVED = 0x01;
+static constexpr uint8_t RECORD_TRANSACTION = 0x02;    // the records of a transaction follow it, it has no key
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t crc;       // of the fields below, the key and the value
+    uint16_t keyLen;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t len;
+};
+
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader must not be padded");
+
+// value of a transaction marker record
+struct TransactionMarker {
+    uint32_t count;     // of the records that follow the marker
+    uint32_t size;      // of the records that follow the marker
+};
+
+static_assert(sizeof(TransactionMarker) == 8, "TransactionMarker must not be padded");
+
+// the crc covers the header starting from keyLen
+static constexpr size_t CRC_HEADER_OFFSET = offsetof(RecordHeader, keyLen);
+
+// fills the header of the record of the open writer, returns the part covered by the crc
+static inline const uint8_t* fillStreamHeader(RecordHeader& header, size_t keyLen, size_t len) {
+    header.magic = RECORD_MAGIC;
+    header.keyLen = keyLen;
+    header.type = KVStoreInterface::PT_BLOB;
+    header.flags = 0;
+    header.len = len;
+
+    return (const uint8_t*)&header + CRC_HEADER_OFFSET;
+}
+
+// returns the size of the record at offset, 0 if it is not complete
+static uint64_t checkRecord(const uint8_t* file, uint64_t offset, uint64_t size, RecordHeader& header) {
+    if(offset + sizeof(RecordHeader) > size) {
+        return 0;
+    }
+
+    memcpy(&header, file + offset, sizeof(header));
+
+    uint64_t recordSize = sizeof(header) + header.keyLen + header.len;
+    if(header.magic != RECORD_MAGIC || offset + recordSize > size) {
+        return 0;
+    }
+
+    uint32_t crc = kvstore_crc32((const uint8_t*)&header + CRC_HEADER_OFFSET, sizeof(header) - CRC_HEADER_OFFSET);
+    crc = kvstore_crc32(file + offset + sizeof(header), header.keyLen + header.len, crc);
+
+    return crc == header.crc ? recordSize : 0;
+}
+
+// returns true if all the records following a transaction marker are complete
+static bool checkTransaction(const uint8_t* file, uint64_t offset, uint64_t size, const RecordHeader& header) {
+    TransactionMarker marker;
+
+    if(header.len != sizeof(marker)) {
+        return false;
+    }
+
+    memcpy(&marker, file + offset + sizeof(header), sizeof(marker));
+    offset += sizeof(header) + sizeof(marker);
+
+    uint64_t end = offset + marker.size;
+    if(end > size) {
+        return false;
+    }
+
+    for(uint32_t i=0; i<marker.count; i++) {
+        RecordHeader h;
+        uint64_t recordSize = checkRecord(file, offset, end, h);
+
+        if(recordSize == 0 || (h.flags & RECORD_TRANSACTION)) {
+            return false;
+        }
+        offset += recordSize;
+    }
+
+    return offset == end;
+}
+
+FileKVStore::FileKVStore(const char* path)
+: path(path), fd(-1), syncWrites(false), tail(0), garbage(0),
+compactionRatio(DEFAULT_COMPACTION_RATIO), compactionMinBytes(DEFAULT_COMPACTION_MIN_BYTES),
+streaming(false), streamLen(0), streamWritten(0), streamCrc(0), transaction(false),
+mapping(nullptr), mappingSize(0) {}
+
+bool FileKVStore::begin() {
+    return begin(path.c_str(), syncWrites);
+}
+
+bool FileKVStore::begin(const char* path, bool sync) {
+    if(fd >= 0) {
+        return false;
+    }
+
+    this->path = path;
+    this->syncWrites = sync;
+
+    if(!open() || !scan()) {
+        close();
+        return false;
+    }
+
+    maybeCompact();
+
+    return true;
+}
+
+bool FileKVStore::end() {
+    if(fd < 0) {
+        return false;
+    }
+
+    if(streaming) {
+        _closeWriter(this, false);
+    }
+
+    abort();
+    close();
+    index.clear();
+
+    return true;
+}
+
+bool FileKVStore::clear() {
+    if(fd < 0 || streaming || transaction) {
+        return false;
+    }
+
+    unmap();
+    if(ftruncate(fd, 0) != 0) {
+        return false;
+    }
+
+    index.clear();
+    tail = 0;
+    garbage = 0;
+
+    return sync();
+}
+
+typename KVStoreInterface::res_t FileKVStore::remove(const key_t& key) {
+    bool removed;
+
+    if(fd < 0 || key == nullptr) {
+        return 0;
+    } else if(transaction) {
+        bool found = journal.staged(key, removed) ? !removed : exists(key);
+
+        return found && journal.remove(key) ? 1 : 0;
+    } else if(!exists(key)) {
+        return 0;
+    }
+
+    std::string buf;
+    size_t recordSize = encode(buf, key, nullptr, 0, PT_INVALID, RECORD_REMOVED);
+
+    if(!append((const uint8_t*)buf.data(), buf.size()) || !sync()) {
+        return 0;
+    }
+
+    apply(key.c_str(), tail - recordSize, 0, recordSize, PT_INVALID, true);
+    maybeCompact();
+
+    return 1;
+}
+
+bool FileKVStore::exists(const key_t& key) const {
+    return key != nullptr && index.find(key) != index.end();
+}
+
+typename KVStoreInterface::res_t FileKVStore::putBytes(const key_t& key, const uint8_t b[], size_t s) {
+    return _put(key, b, s, PT_BLOB);
+}
+
+typename KVStoreInterface::res_t FileKVStore::getBytes(const key_t& key, uint8_t b[], size_t s) const {
+    if(fd < 0 || key == nullptr) {
+        return 0;
+    }
+
+    auto it = index.find(key);
+    if(it == index.end()) {
+        return 0;
+    }
+
+    const Location& loc = it->second;
+    size_t toRead = s <= loc.len ? s : loc.len;
+    uint64_t valueOffset = loc.offset + loc.recordSize - loc.len;
+
+    if(toRead > 0 && pread(fd, b, toRead, valueOffset) != (ssize_t)toRead) {
+        return 0;
+    }
+
+    return loc.len;
+}
+
+typename KVStoreInterface::res_t FileKVStore::getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const {
+    if(fd < 0 || key == nullptr) {
+        return 0;
+    }
+
+    auto it = index.find(key);
+    if(it == index.end() || offset >= it->second.len) {
+        return 0;
+    }
+
+    const Location& loc = it->second;
+    size_t toRead = s <= loc.len - offset ? s : loc.len - offset;
+    uint64_t valueOffset = loc.offset + loc.recordSize - loc.len;
+
+    if(pread(fd, b, toRead, valueOffset + offset) != (ssize_t)toRead) {
+        return 0;
+    }
+
+    return toRead;
+}
+
+size_t FileKVStore::getBytesLength(const key_t& key) const {
+    if(key == nullptr) {
+        return 0;
+    }
+
+    auto it = index.find(key);
+
+    return it != index.end() ? it->second.len : 0;
+}
+
+size_t FileKVStore::putMany(PutEntry entries[], size_t n) {
+    if(fd < 0) {
+        return 0;
+    }
+
+    // the values are staged by the open transaction, or appended with a single write
+    std::string buf;
+    size_t staged = 0;
+    for(size_t i=0; i<n; i++) {
+        entries[i].res = 0;
+
+        if(entries[i].key == nullptr || entries[i].value == nullptr) {
+            continue;
+        } else if(!transaction) {
+            encode(buf, entries[i].key, entries[i].value, entries[i].len, entries[i].type, 0);
+        } else if(journal.put(entries[i].key, entries[i].value, entries[i].len, entries[i].type)) {
+            entries[i].res = entries[i].len;
+            staged++;
+        }
+    }
+
+    if(transaction) {
+        return staged;
+    }
+
+    uint64_t offset = tail;
+    if(!append((const uint8_t*)buf.data(), buf.size()) || !sync()) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for(size_t i=0; i<n; i++) {
+        if(entries[i].key == nullptr || entries[i].value == nullptr) {
+            continue;
+        }
+
+        size_t recordSize = sizeof(RecordHeader) + strlen(entries[i].key) + entries[i].len;
+        apply(entries[i].key.c_str(), offset, entries[i].len, recordSize, entries[i].type, false);
+        offset += recordSize;
+
+        entries[i].res = entries[i].len;
+        count++;
+    }
+
+    maybeCompact();
+
+    return count;
+}
+
+size_t FileKVStore::removeMany(const key_t keys[], size_t n) {
+    if(fd < 0) {
+        return 0;
+    } else if(transaction) {
+        return KVStoreInterface::removeMany(keys, n);
+    }
+
+    std::string buf;
+    for(size_t i=0; i<n; i++) {
+        if(exists(keys[i])) {
+            encode(buf, keys[i], nullptr, 0, PT_INVALID, RECORD_REMOVED);
+        }
+    }
+
+    uint64_t offset = tail;
+    if(!append((const uint8_t*)buf.data(), buf.size()) || !sync()) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for(size_t i=0; i<n; i++) {
+        if(exists(keys[i])) {
+            size_t recordSize = sizeof(RecordHeader) + strlen(keys[i]);
+            apply(keys[i].c_str(), offset, 0, recordSize, PT_INVALID, true);
+            offset += recordSize;
+            count++;
+        }
+    }
+
+    maybeCompact();
+
+    return count;
+}
+
+typename KVStoreInterface::res_t FileKVStore::view(const key_t& key, ViewCallback cb, void* ctx, Type t) {
+    (void) t;
+
+    if(fd < 0 || key == nullptr) {
+        return 0;
+    }
+
+    auto it = index.find(key);
+    if(it == index.end()) {
+        return 0;
+    }
+
+    const Location& loc = it->second;
+    const uint8_t* value = map(loc.offset + loc.recordSize - loc.len, loc.len);
+
+    if(value == nullptr) {
+        return 0;
+    }
+
+    cb(value, loc.len, ctx);
+
+    return loc.len;
+}
+
+bool FileKVStore::forEach(const char* prefix, KeyCallback cb, void* ctx) {
+    if(fd < 0 || cb == nullptr) {
+        return false;
+    }
+
+    if(prefix == nullptr) {
+        prefix = "";
+    }
+    size_t prefixLen = strlen(prefix);
+
+    // the index already holds type and length, the file is not read
+    for(auto& el: index) {
+        if(strncmp(el.first.c_str(), prefix, prefixLen) == 0 &&
+                !cb(el.first.c_str(), el.second.type, el.second.len, ctx)) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool FileKVStore::beginTransaction() {
+    if(fd < 0 || streaming || transaction) {
+        return false;
+    }
+
+    transaction = true;
+
+    return true;
+}
+
+bool FileKVStore::commit() {
+    if(fd < 0 || !transaction) {
+        return false;
+    }
+
+    transaction = false;
+    if(journal.entries() == 0) {
+        return true;
+    }
+
+    KVJournal::Entry e;
+    std::string records;
+    for(size_t offset = journal.next(0, e); offset != 0; offset = journal.next(offset, e)) {
+        encode(records, e.key, e.value, e.len, e.type, e.removed ? RECORD_REMOVED : 0);
+    }
+
+    // the marker and the records are appended with a single write and synced once
+    TransactionMarker marker = { (uint32_t)journal.entries(), (uint32_t)records.size() };
+    std::string buf;
+    size_t markerSize = encode(buf, "", (const uint8_t*)&marker, sizeof(marker), PT_INVALID, RECORD_TRANSACTION);
+    buf.append(records);
+
+    uint64_t address = tail + markerSize;
+    if(records.size() > UINT32_MAX || !append((const uint8_t*)buf.data(), buf.size()) || !sync()) {
+        abort();
+        return false;
+    }
+
+    garbage += markerSize;
+
+    // the index is updated once every record is written
+    for(size_t offset = journal.next(0, e); offset != 0; offset = journal.next(offset, e)) {
+        size_t recordSize = sizeof(RecordHeader) + e.keyLen + e.len;
+
+        apply(std::string(e.key, e.keyLen), address, e.len, recordSize, e.type, e.removed);
+        address += recordSize;
+    }
+
+    abort();
+    maybeCompact();
+
+    return true;
+}
+
+bool FileKVStore::abort() {
+    bool res = transaction;
+
+    transaction = false;
+    journal.clear();
+
+    return res;
+}
+
+bool FileKVStore::compact() {
+    if(fd < 0 || streaming) {
+        return false;
+    }
+
+    std::string tmpPath = path + ".compact";
+    int tmp = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if(tmp < 0) {
+        return false;
+    }
+
+    // live records are copied as they are, since their content does not depend on their position
+    std::string buf;
+    uint64_t offset = 0;
+    KVIndex<Location> compacted;
+    compacted.reserve(index.size());
+
+    for(auto& el: index) {
+        const uint8_t* record = map(el.second.offset, el.second.recordSize);
+
+        if(record == nullptr) {
+            ::close(tmp);
+            ::unlink(tmpPath.c_str());
+            return false;
+        }
+
+        buf.append((const char*)record, el.second.recordSize);
+
+        Location loc = el.second;
+        loc.offset = offset;
+        offset += loc.recordSize;
+        compacted.emplace(el.first, loc);
+
+        if(buf.size() >= 64 * 1024) {
+            if(write(tmp, buf.data(), buf.size()) != (ssize_t)buf.size()) {
+                ::close(tmp);
+                ::unlink(tmpPath.c_str());
+                return false;
+            }
+            buf.clear();
+        }
+    }
+
+    if((buf.size() > 0 && write(tmp, buf.data(), buf.size()) != (ssize_t)buf.size()) || fsync(tmp) != 0) {
+        ::close(tmp);
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+
+    // the new file atomically replaces the old one
+    if(rename(tmpPath.c_str(), path.c_str()) != 0) {
+        ::close(tmp);
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+
+    close();
+    fd = tmp;
+    index.swap(compacted);
+    tail = offset;
+    garbage = 0;
+
+    return true;
+}
+
+void FileKVStore::setCompactionThreshold(float ratio, size_t minBytes) {
+    compactionRatio = ratio;
+    compactionMinBytes = minBytes;
+}
+
+KVStoreInterface::Type FileKVStore::_typeOf(const key_t& key) const {
+    if(key == nullptr) {
+        return PT_INVALID;
+    }
+
+    auto it = index.find(key);
+
+    return it != index.end() ? it->second.type : PT_INVALID;
+}
+
+typename KVStoreInterface::res_t FileKVStore::_put(const key_t& key, const uint8_t value[], size_t len, Type t) {
+    PutEntry entry(key, value, len, t);
+    putMany(&entry, 1);
+
+    return entry.res;
+}
+
+bool FileKVStore::_openWriter(const key_t& key, size_t total, void*& state) {
+    if(fd < 0 || streaming || transaction || key == nullptr || strlen(key) == 0 || total > UINT32_MAX) {
+        return false;
+    }
+
+    // a blank header marks the end of the log until the record is complete
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    std::string buf((const char*)&header, sizeof(header));
+    buf.append(key);
+
+    if(pwrite(fd, buf.data(), buf.size(), tail) != (ssize_t)buf.size()) {
+        int ignored = ftruncate(fd, tail);
+        (void) ignored;
+
+        return false;
+    }
+
+    streaming = true;
+    streamKey = key;
+    streamLen = total;
+    streamWritten = 0;
+    streamCrc = kvstore_crc32(fillStreamHeader(header, streamKey.size(), streamLen), sizeof(header) - CRC_HEADER_OFFSET);
+    streamCrc = kvstore_crc32(key, streamKey.size(), streamCrc);
+    state = this;
+
+    return true;
+}
+
+bool FileKVStore::_write(void* state, const uint8_t data[], size_t len) {
+    if(state != this || !streaming) {
+        return false;
+    }
+
+    uint64_t offset = tail + sizeof(RecordHeader) + streamKey.size() + streamWritten;
+
+    for(size_t written=0; written < len;) {
+        ssize_t res = pwrite(fd, data + written, len - written, offset + written);
+
+        if(res <= 0) {
+            return false;
+        }
+        written += res;
+    }
+
+    streamCrc = kvstore_crc32(data, len, streamCrc);
+    streamWritten += len;
+
+    return true;
+}
+
+bool FileKVStore::_closeWriter(void* state, bool commit) {
+    if(state != this || !streaming) {
+        return false;
+    }
+
+    streaming = false;
+
+    if(commit && streamWritten == streamLen) {
+        // the crc was computed as the value was written
+        RecordHeader header;
+        fillStreamHeader(header, streamKey.size(), streamLen);
+        header.crc = streamCrc;
+        size_t recordSize = sizeof(header) + streamKey.size() + streamLen;
+
+        if(pwrite(fd, &header, sizeof(header), tail) == (ssize_t)sizeof(header) && sync()) {
+            tail += recordSize;
+            apply(streamKey, tail - recordSize, streamLen, recordSize, PT_BLOB, false);
+            maybeCompact();
+
+            return true;
+        }
+    }
+
+    int ignored = ftruncate(fd, tail);
+    (void) ignored;
+
+    return false;
+}
+
+bool FileKVStore::_openReader(const key_t& key, size_t& total, void*& state) {
+    if(fd < 0 || key == nullptr || index.find(key) == index.end()) {
+        return false;
+    }
+
+    // the record is looked up on every read, it may be moved by compaction
+    state = new std::string(key);
+    total = index[key].len;
+
+    return true;
+}
+
+size_t FileKVStore::_read(void* state, size_t offset, uint8_t data[], size_t len) {
+    return getBytes(((std::string*)state)->c_str(), offset, data, len);
+}
+
+void FileKVStore::_closeReader(void* state) {
+    delete (std::string*)state;
+}
+
+bool FileKVStore::open() {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+
+    return fd >= 0;
+}
+
+void FileKVStore::close() {
+    unmap();
+
+    if(fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool FileKVStore::scan() {
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        return false;
+    }
+
+    index.clear();
+    tail = 0;
+    garbage = 0;
+
+    uint64_t size = st.st_size;
+    const uint8_t* file = size > 0 ? map(0, size) : nullptr;
+
+    while(file != nullptr && tail + sizeof(RecordHeader) <= size) {
+        RecordHeader header;
+        uint64_t recordSize = checkRecord(file, tail, size, header);
+
+        if(recordSize == 0) {
+            break;
+        } else if(header.flags & RECORD_TRANSACTION) {
+            // the records of a transaction are applied only if all of them were written
+            if(!checkTransaction(file, tail, size, header)) {
+                break;
+            }
+
+            garbage += recordSize;
+            tail += recordSize;
+            continue;
+        }
+
+        std::string key((const char*)file + tail + sizeof(header), header.keyLen);
+        apply(key, tail, header.len, recordSize, (Type)header.type, header.flags & RECORD_REMOVED);
+        tail += recordSize;
+    }
+
+    // anything after the last valid record is the result of an interrupted write
+    if(tail < size) {
+        unmap();
+
+        if(ftruncate(fd, tail) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FileKVStore::append(const uint8_t* buf, size_t len) {
+    size_t written = 0;
+
+    // the end of the file belongs to the open writer
+    if(streaming) {
+        return false;
+    }
+
+    while(written < len) {
+        ssize_t res = pwrite(fd, buf + written, len - written, tail + written);
+
+        if(res <= 0) {
+            // drop the partially written record, if this fails it is discarded by the next scan anyway
+            int ignored = ftruncate(fd, tail);
+            (void) ignored;
+
+            return false;
+        }
+        written += res;
+    }
+
+    tail += len;
+
+    return true;
+}
+
+size_t FileKVStore::encode(std::string& buf, const char* key, const uint8_t value[], size_t len, Type t, uint8_t flags) {
+    RecordHeader header;
+    size_t keyLen = strlen(key);
+
+    header.magic = RECORD_MAGIC;
+    header.keyLen = keyLen;
+    header.type = t;
+    header.flags = flags;
+    header.len = len;
+
+    header.crc = kvstore_crc32((const uint8_t*)&header + CRC_HEADER_OFFSET, sizeof(header) - CRC_HEADER_OFFSET);
+    header.crc = kvstore_crc32(key, keyLen, header.crc);
+    header.crc = kvstore_crc32(value, len, header.crc);
+
+    buf.append((const char*)&header, sizeof(header));
+    buf.append(key, keyLen);
+    buf.append((const char*)value, len);
+
+    return sizeof(header) + keyLen + len;
+}
+
+void FileKVStore::apply(const std::string& key, uint64_t offset, size_t len, size_t recordSize, Type t, bool removed) {
+    auto it = index.find(key);
+
+    if(it != index.end()) {
+        garbage += it->second.recordSize;
+
+        if(removed) {
+            index.erase(it);
+        }
+    }
+
+    if(removed) {
+        // tombstones are garbage as soon as they are written
+        garbage += recordSize;
+    } else {
+        Location loc = { offset, (uint32_t)len, (uint32_t)recordSize, t };
+        index[key] = loc;
+    }
+}
+
+bool FileKVStore::sync() {
+    return !syncWrites || fdatasync(fd) == 0;
+}
+
+void FileKVStore::maybeCompact() {
+    if(compactionRatio > 0 && garbage >= compactionMinBytes && garbage >= tail * compactionRatio) {
+        compact();
+    }
+}
+
+const uint8_t* FileKVStore::map(uint64_t offset, size_t len) const {
+    if(offset + len == 0) {
+        return nullptr;
+    } else if(offset + len > mappingSize) {
+        unmap();
+
+        // the whole file is mapped, the mapping is extended when the file grows
+        void* res = mmap(nullptr, tail > offset + len ? tail : offset + len, PROT_READ, MAP_SHARED, fd, 0);
+
+        if(res == MAP_FAILED) {
+            return nullptr;
+        }
+
+        mapping = (uint8_t*)res;
+        mappingSize = tail > offset + len ? tail : offset + len;
+    }
+
+    return mapping + offset;
+}
+
+void FileKVStore::unmap() const {
+    if(mapping != nullptr) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+}
+
+#endif // defined(HOST)
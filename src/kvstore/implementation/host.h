@@ -0,0 +1,140 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "../kvstore.h"
+#include "../utility/index.h"
+#include "../utility/journal.h"
+#include <string>
+
+constexpr char DEFAULT_KVSTORE_PATH[] = "kvstore.log";
+
+// compaction is performed when garbage is more than this ratio of the file and at least DEFAULT_COMPACTION_MIN_BYTES
+constexpr float DEFAULT_COMPACTION_RATIO = 0.5;
+constexpr size_t DEFAULT_COMPACTION_MIN_BYTES = 1024 * 1024;
+
+/** FileKVStore class
+ *
+ * KVStore for host builds, values are appended to a log file, each record being protected by a CRC.
+ * An index of the position of every value in the file is kept in RAM and is rebuilt by scanning
+ * the file in begin(). A torn record at the end of the file, caused by a crash, is discarded.
+ * Space used by overwritten and removed values is reclaimed by compact(), which is called
+ * automatically when garbage exceeds the configured thresholds
+ *
+ * A Writer writes its value straight to the end of the file, the header of the record is written
+ * when it is closed. Other writes, clear() and compact() fail while a writer is open
+ *
+ * The writes of a transaction are staged in a KVJournal, commit() encodes them as records and
+ * appends them with a single write and a single sync, after a marker record holding their count
+ * and size. scan() applies the records that follow a marker only if all of them are complete,
+ * otherwise the file is truncated at the marker
+ */
+class FileKVStore: public KVStoreInterface {
+public:
+    FileKVStore(const char* path=DEFAULT_KVSTORE_PATH);
+    ~FileKVStore() { end(); }
+
+    bool begin() override;
+    bool begin(const char* path, bool sync=false);
+    bool end() override;
+    bool clear() override;
+
+    typename KVStoreInterface::res_t remove(const key_t& key) override;
+    bool exists(const key_t& key) const override;
+    typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const override;
+    size_t getBytesLength(const key_t& key) const override;
+
+    size_t putMany(PutEntry entries[], size_t n) override;
+    using KVStoreInterface::removeMany;
+    size_t removeMany(const key_t keys[], size_t n) override;
+    res_t view(const key_t& key, ViewCallback cb, void* ctx=nullptr, Type t=PT_BLOB) override;
+    bool forEach(const char* prefix, KeyCallback cb, void* ctx=nullptr) override;
+
+    bool beginTransaction() override;
+    bool commit() override;
+    bool abort() override;
+
+    /**
+     * @brief rewrite the log file keeping only live values
+     *
+     * @returns true on correct execution false otherwise
+     */
+    bool compact();
+
+    /**
+     * @brief configure when compaction is automatically performed
+     *
+     * @param[in]  ratio            ratio of garbage over the size of the file, 0 disables it
+     * @param[in]  minBytes         minimum amount of garbage
+     */
+    void setCompactionThreshold(float ratio, size_t minBytes=DEFAULT_COMPACTION_MIN_BYTES);
+
+    inline size_t size() const         { return index.size(); }
+    inline uint64_t fileSize() const   { return tail; }
+    inline uint64_t garbageSize() const { return garbage; }
+
+protected:
+    res_t _put(const key_t& key, const uint8_t value[], size_t len, Type t) override;
+    Type _typeOf(const key_t& key) const override;
+
+    bool _openWriter(const key_t& key, size_t total, void*& state) override;
+    bool _write(void* state, const uint8_t data[], size_t len) override;
+    bool _closeWriter(void* state, bool commit) override;
+
+    bool _openReader(const key_t& key, size_t& total, void*& state) override;
+    size_t _read(void* state, size_t offset, uint8_t data[], size_t len) override;
+    void _closeReader(void* state) override;
+private:
+    struct Location {
+        uint64_t offset;  // of the record header
+        uint32_t len;     // of the value
+        uint32_t recordSize;
+        Type type;
+    };
+
+    bool open();
+    void close();
+    bool scan();
+    bool append(const uint8_t* buf, size_t len);
+    size_t encode(std::string& buf, const char* key, const uint8_t value[], size_t len, Type t, uint8_t flags);
+    void apply(const std::string& key, uint64_t offset, size_t len, size_t recordSize, Type t, bool removed);
+    bool sync();
+    void maybeCompact();
+    const uint8_t* map(uint64_t offset, size_t len) const;
+    void unmap() const;
+
+    std::string path;
+    int fd;
+    bool syncWrites;
+
+    KVIndex<Location> index;
+    uint64_t tail;
+    uint64_t garbage;
+
+    float compactionRatio;
+    size_t compactionMinBytes;
+
+    // record being written by a Writer at the end of the file
+    bool streaming;
+    std::string streamKey;
+    uint32_t streamLen;
+    uint32_t streamWritten;
+    uint32_t streamCrc;
+
+    // writes staged by the open transaction
+    bool transaction;
+    KVJournal journal;
+
+    // read-only mapping of the file used by view()
+    mutable uint8_t* mapping;
+    mutable size_t mappingSize;
+};
@@ -11,13 +11,15 @@
 #if defined(ARDUINO_PORTENTA_C33)
 #include "portentac33.h"
 
-PortentaC33KVStore::PortentaC33KVStore(): kvstore(nullptr), bd(nullptr) {}
+PortentaC33KVStore::PortentaC33KVStore(): bd(nullptr), kvstore(nullptr) {}
 
 bool PortentaC33KVStore::begin() {
     return begin(false);
 }
 
 bool PortentaC33KVStore::begin(bool reformat, mbed::KVStore* store) {
+    (void) reformat; // the partitions of the QSPI flash are not checked yet
+
     // bd gets allocated if a kvstore is not provided as parameter here
     // if either one of bd or kvstore is different from NULL it means that the kvstore
     // had already been called begin on
@@ -28,7 +30,7 @@ bool PortentaC33KVStore::begin(bool reformat, mbed::KVStore* store) {
     if(store != nullptr) {
         kvstore = store;
     } else {
-        auto bd = new MBRBlockDevice(BlockDevice::get_default_instance(), 3);
+        bd = new MBRBlockDevice(BlockDevice::get_default_instance(), 3);
 
         kvstore = new TDBStore(bd);
     }
@@ -83,6 +85,16 @@ typename KVStoreInterface::res_t PortentaC33KVStore::getBytes(const key_t& key,
     return fromMbedErrors(res, actual_size);
 }
 
+typename KVStoreInterface::res_t PortentaC33KVStore::getBytes(const key_t& key, size_t offset, uint8_t buf[], size_t len) const {
+    size_t actual_size = 0;
+
+    if(kvstore == nullptr || kvstore->get(key, buf, len, &actual_size, offset) != KVSTORE_SUCCESS) {
+        return 0;
+    }
+
+    return actual_size;
+}
+
 size_t PortentaC33KVStore::getBytesLength(const key_t& key) const {
     if(kvstore == nullptr) {
         return 0;
@@ -94,7 +106,116 @@ size_t PortentaC33KVStore::getBytesLength(const key_t& key) const {
     return res == KVSTORE_SUCCESS ? info.size : 0;
 }
 
+bool PortentaC33KVStore::forEach(const char* prefix, KeyCallback cb, void* ctx) {
+    mbed::KVStore::iterator_t it;
+
+    if(kvstore == nullptr || cb == nullptr || kvstore->iterator_open(&it, prefix) != KVSTORE_SUCCESS) {
+        return false;
+    }
+
+    // the store does not keep the type of values, only their size is read
+    char key[mbed::KVStore::MAX_KEY_SIZE];
+    int res;
+    while((res = kvstore->iterator_next(it, key, sizeof(key))) == KVSTORE_SUCCESS) {
+        mbed::KVStore::info_t info;
+
+        if(kvstore->get_info(key, &info) == KVSTORE_SUCCESS && !cb(key, PT_BLOB, info.size, ctx)) {
+            break;
+        }
+    }
+    kvstore->iterator_close(it);
+
+    return res == KVSTORE_SUCCESS || res == KVSTORE_ERROR_ITEM_NOT_FOUND;
+}
+
 bool PortentaC33KVStore::exists(const key_t& key) const {
     return getBytesLength(key) > 0;
 }
+
+// TDBStore cannot cancel a set, finalizing an incomplete value discards it: the last byte
+// of the value is held back until the writer is closed, so that aborting it is always possible
+struct IncrementalSet {
+    mbed::KVStore::set_handle_t handle;
+    uint8_t last;
+    bool held;
+};
+
+bool PortentaC33KVStore::_openWriter(const key_t& key, size_t total, void*& state) {
+    if(kvstore == nullptr || total == 0) {
+        return false;
+    }
+
+    IncrementalSet* set = new IncrementalSet();
+
+    if(set == nullptr) {
+        return false;
+    } else if(kvstore->set_start(&set->handle, key, total, 0) != KVSTORE_SUCCESS) {
+        delete set;
+        return false;
+    }
+
+    set->held = false;
+    state = set;
+
+    return true;
+}
+
+bool PortentaC33KVStore::_write(void* state, const uint8_t data[], size_t len) {
+    IncrementalSet* set = (IncrementalSet*)state;
+
+    if(kvstore == nullptr || len == 0) {
+        return kvstore != nullptr;
+    } else if(set->held && kvstore->set_add_data(set->handle, &set->last, 1) != KVSTORE_SUCCESS) {
+        return false;
+    } else if(len > 1 && kvstore->set_add_data(set->handle, data, len - 1) != KVSTORE_SUCCESS) {
+        return false;
+    }
+
+    set->last = data[len - 1];
+    set->held = true;
+
+    return true;
+}
+
+bool PortentaC33KVStore::_closeWriter(void* state, bool commit) {
+    IncrementalSet* set = (IncrementalSet*)state;
+    bool res = false;
+
+    if(kvstore != nullptr) {
+        commit = commit && set->held && kvstore->set_add_data(set->handle, &set->last, 1) == KVSTORE_SUCCESS;
+        res = kvstore->set_finalize(set->handle) == KVSTORE_SUCCESS && commit;
+    }
+
+    delete set;
+
+    return res;
+}
+
+bool PortentaC33KVStore::_openReader(const key_t& key, size_t& total, void*& state) {
+    total = getBytesLength(key);
+
+    if(total == 0) {
+        return false;
+    }
+
+    size_t len = strlen(key);
+    char* copy = new char[len + 1];
+
+    if(copy == nullptr) {
+        return false;
+    }
+
+    memcpy(copy, key, len + 1);
+    state = copy;
+
+    return true;
+}
+
+size_t PortentaC33KVStore::_read(void* state, size_t offset, uint8_t data[], size_t len) {
+    return getBytes((const char*)state, offset, data, len);
+}
+
+void PortentaC33KVStore::_closeReader(void* state) {
+    delete [] (char*)state;
+}
 #endif // defined(ARDUINO_PORTENTA_C33)
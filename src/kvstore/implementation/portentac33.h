@@ -29,8 +29,19 @@ public:
     typename KVStoreInterface::res_t remove(const key_t& key) override;
     bool exists(const key_t& key) const override;
     typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
+    using KVStoreInterface::getBytes;
     typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const override;
     size_t getBytesLength(const key_t& key) const override;
+    bool forEach(const char* prefix, KeyCallback cb, void* ctx=nullptr) override;
+protected:
+    bool _openWriter(const key_t& key, size_t total, void*& state) override;
+    bool _write(void* state, const uint8_t data[], size_t len) override;
+    bool _closeWriter(void* state, bool commit) override;
+
+    bool _openReader(const key_t& key, size_t& total, void*& state) override;
+    size_t _read(void* state, size_t offset, uint8_t data[], size_t len) override;
+    void _closeReader(void* state) override;
 private:
     MBRBlockDevice* bd;
     mbed::KVStore* kvstore;
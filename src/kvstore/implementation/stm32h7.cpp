@@ -13,7 +13,9 @@
 #include "stm32h7.h"
 
 
-STM32H7KVStore::STM32H7KVStore(): kvstore(nullptr), bd(nullptr) {}
+STM32H7KVStore::STM32H7KVStore()
+: bd(nullptr), kvstore(nullptr), lazy(false), deferred(false), reformat(false),
+    profile([]() -> uint32_t { return micros(); }) {}
 
 bool STM32H7KVStore::begin() {
     return begin(false);
@@ -23,25 +25,62 @@ bool STM32H7KVStore::begin(bool reformat, mbed::KVStore* store) {
     // bd gets allocated if a kvstore is not provided as parameter here
     // if either one of bd or kvstore is different from NULL it means that the kvstore
     // had already been called begin on
-    if(bd != nullptr || kvstore != nullptr) {
+    if(bd != nullptr || kvstore != nullptr || deferred) {
         return false;
     }
 
-    if(store != nullptr) {
-        kvstore = store;
-    } else {
+    kvstore = store;
+    this->reformat = reformat;
+
+    if(lazy) {
+        deferred = true;
+        return true;
+    }
+
+    return init();
+}
+
+bool STM32H7KVStore::warmup() {
+    if(deferred) {
+        deferred = false;
+        return init();
+    }
+
+    return kvstore != nullptr;
+}
+
+mbed::KVStore* STM32H7KVStore::ready() const {
+    if(deferred) {
+        deferred = false;
+        init();
+    }
+
+    return kvstore;
+}
+
+bool STM32H7KVStore::init() const {
+    profile.start();
+
+    if(kvstore == nullptr) {
         auto root = mbed::BlockDevice::get_default_instance();
 
         if (root->init() != QSPIF_BD_ERROR_OK) {
             Serial.println(F("Error: QSPI init failure."));
             return false;
         }
+        profile.phase("qspi");
 
         bd = new mbed::MBRBlockDevice(root, 3);
+        if(bd == nullptr) {
+            return false;
+        }
+
         int res = bd->init();
         if (res != QSPIF_BD_ERROR_OK && !reformat) {
             Serial.println(F("Error: QSPI is not properly formatted, "
                 "run QSPIformat.ino or set reformat to true"));
+            delete bd;
+            bd = nullptr;
             return false;
         } else if (res != QSPIF_BD_ERROR_OK && reformat) {
             Serial.println(F("Error: QSPI is not properly formatted, "
@@ -57,16 +96,32 @@ bool STM32H7KVStore::begin(bool reformat, mbed::KVStore* store) {
             mbed::MBRBlockDevice::partition(root, 2, 0x0B, 1024 * 1024, 13 * 1024 * 1024);
             mbed::MBRBlockDevice::partition(root, 3, 0x0B, 13 * 1024 * 1024, 14 * 1024 * 1024);
         }
+        profile.phase("mbr");
 
         kvstore = new mbed::TDBStore(bd);
+        if(kvstore == nullptr) {
+            delete bd;
+            bd = nullptr;
+            return false;
+        }
     }
 
-    return kvstore->init() == MBED_SUCCESS;
+    bool res = kvstore->init() == MBED_SUCCESS;
+    profile.phase("tdbstore");
+
+    return res;
 }
 
 bool STM32H7KVStore::end() {
     bool res = false;
 
+    // begin() deferred the initialization and nothing accessed the store
+    if(deferred) {
+        deferred = false;
+        kvstore = nullptr;
+        return true;
+    }
+
     if(kvstore != nullptr && bd == nullptr) {
         res = kvstore->deinit() == MBED_SUCCESS;
         kvstore = nullptr;
@@ -89,41 +144,169 @@ static inline typename KVStoreInterface::res_t fromMbedErrors(int error, T res=1
 }
 
 bool STM32H7KVStore::clear() {
-    return kvstore != nullptr ? kvstore->reset() == MBED_SUCCESS : false;
+    auto store = ready();
+    return store != nullptr ? store->reset() == MBED_SUCCESS : false;
 }
 
 typename KVStoreInterface::res_t STM32H7KVStore::remove(const key_t& key) {
-    return kvstore != nullptr ? fromMbedErrors(kvstore->remove(key)) : -1;
+    auto store = ready();
+    return store != nullptr ? fromMbedErrors(store->remove(key)) : -1;
 }
 
 typename KVStoreInterface::res_t STM32H7KVStore::putBytes(const key_t& key, const uint8_t buf[], size_t len) {
-    return kvstore != nullptr ? fromMbedErrors(kvstore->set(key, buf, len, 0), len) : -1; // TODO flags
+    auto store = ready();
+    return store != nullptr ? fromMbedErrors(store->set(key, buf, len, 0), len) : -1; // TODO flags
 }
 
 typename KVStoreInterface::res_t STM32H7KVStore::getBytes(const key_t& key, uint8_t buf[], size_t maxLen) const {
-    if(kvstore == nullptr) {
+    auto store = ready();
+    if(store == nullptr) {
         return -1;
     }
 
     size_t actual_size = maxLen;
-    auto res = kvstore->get(key, buf, maxLen, &actual_size);
+    auto res = store->get(key, buf, maxLen, &actual_size);
 
     return fromMbedErrors(res, actual_size);
 }
 
+typename KVStoreInterface::res_t STM32H7KVStore::getBytes(const key_t& key, size_t offset, uint8_t buf[], size_t len) const {
+    auto store = ready();
+    size_t actual_size = 0;
+
+    if(store == nullptr || store->get(key, buf, len, &actual_size, offset) != MBED_SUCCESS) {
+        return 0;
+    }
+
+    return actual_size;
+}
+
 size_t STM32H7KVStore::getBytesLength(const key_t& key) const {
-    if(kvstore == nullptr) {
+    auto store = ready();
+    if(store == nullptr) {
         return 0;
     }
 
     mbed::KVStore::info_t info;
-    auto res = kvstore->get_info(key, &info);
+    auto res = store->get_info(key, &info);
 
     return res == MBED_SUCCESS ? info.size : 0;
 }
 
+bool STM32H7KVStore::forEach(const char* prefix, KeyCallback cb, void* ctx) {
+    auto store = ready();
+    mbed::KVStore::iterator_t it;
+
+    if(store == nullptr || cb == nullptr || store->iterator_open(&it, prefix) != MBED_SUCCESS) {
+        return false;
+    }
+
+    // the store does not keep the type of values, only their size is read
+    char key[mbed::KVStore::MAX_KEY_SIZE];
+    int res;
+    while((res = store->iterator_next(it, key, sizeof(key))) == MBED_SUCCESS) {
+        mbed::KVStore::info_t info;
+
+        if(store->get_info(key, &info) == MBED_SUCCESS && !cb(key, PT_BLOB, info.size, ctx)) {
+            break;
+        }
+    }
+    store->iterator_close(it);
+
+    return res == MBED_SUCCESS || res == MBED_ERROR_ITEM_NOT_FOUND;
+}
+
 bool STM32H7KVStore::exists(const key_t& key) const {
     return getBytesLength(key) > 0;
 }
 
+// TDBStore cannot cancel a set, finalizing an incomplete value discards it: the last byte
+// of the value is held back until the writer is closed, so that aborting it is always possible
+struct IncrementalSet {
+    mbed::KVStore::set_handle_t handle;
+    uint8_t last;
+    bool held;
+};
+
+bool STM32H7KVStore::_openWriter(const key_t& key, size_t total, void*& state) {
+    auto store = ready();
+
+    if(store == nullptr || total == 0) {
+        return false;
+    }
+
+    IncrementalSet* set = new IncrementalSet();
+
+    if(set == nullptr) {
+        return false;
+    } else if(store->set_start(&set->handle, key, total, 0) != MBED_SUCCESS) {
+        delete set;
+        return false;
+    }
+
+    set->held = false;
+    state = set;
+
+    return true;
+}
+
+bool STM32H7KVStore::_write(void* state, const uint8_t data[], size_t len) {
+    IncrementalSet* set = (IncrementalSet*)state;
+
+    if(kvstore == nullptr || len == 0) {
+        return kvstore != nullptr;
+    } else if(set->held && kvstore->set_add_data(set->handle, &set->last, 1) != MBED_SUCCESS) {
+        return false;
+    } else if(len > 1 && kvstore->set_add_data(set->handle, data, len - 1) != MBED_SUCCESS) {
+        return false;
+    }
+
+    set->last = data[len - 1];
+    set->held = true;
+
+    return true;
+}
+
+bool STM32H7KVStore::_closeWriter(void* state, bool commit) {
+    IncrementalSet* set = (IncrementalSet*)state;
+    bool res = false;
+
+    if(kvstore != nullptr) {
+        commit = commit && set->held && kvstore->set_add_data(set->handle, &set->last, 1) == MBED_SUCCESS;
+        res = kvstore->set_finalize(set->handle) == MBED_SUCCESS && commit;
+    }
+
+    delete set;
+
+    return res;
+}
+
+bool STM32H7KVStore::_openReader(const key_t& key, size_t& total, void*& state) {
+    total = getBytesLength(key);
+
+    if(total == 0) {
+        return false;
+    }
+
+    size_t len = strlen(key);
+    char* copy = new char[len + 1];
+
+    if(copy == nullptr) {
+        return false;
+    }
+
+    memcpy(copy, key, len + 1);
+    state = copy;
+
+    return true;
+}
+
+size_t STM32H7KVStore::_read(void* state, size_t offset, uint8_t data[], size_t len) {
+    return getBytes((const char*)state, offset, data, len);
+}
+
+void STM32H7KVStore::_closeReader(void* state) {
+    delete [] (char*)state;
+}
+
 #endif // defined(ARDUINO_PORTENTA_H7_M7) || defined(ARDUINO_NICLA_VISION) || defined(ARDUINO_OPTA) || defined(ARDUINO_GIGA)
@@ -8,12 +8,25 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 #pragma once
+#include <Arduino.h>
 #include "../kvstore.h"
+#include "../utility/initprofile.h"
 #include <KVStore.h>
 #include <TDBStore.h>
 #include "QSPIFBlockDevice.h"
 #include "MBRBlockDevice.h"
 
+/** STM32H7KVStore class
+ *
+ * KVStoreInterface backed by a TDBStore on the third MBR partition of the QSPI flash.
+ * Initializing it takes a while, TDBStore scans the whole partition, with lazy init
+ * enabled begin() returns immediately and the initialization is performed by warmup()
+ * or by the first access to the store. The duration of each phase of the last
+ * initialization is reported by getInitProfile()
+ *
+ * Writers use the incremental set of TDBStore, a single writer can be open at a time and
+ * values of size 0 cannot be streamed
+ */
 class STM32H7KVStore: public KVStoreInterface {
 public:
     STM32H7KVStore();
@@ -24,12 +37,49 @@ public:
     bool end() override;
     bool clear() override;
 
+    /**
+     * @brief defer the initialization performed by begin() to warmup() or to the first access,
+     *        it must be called before begin()
+     */
+    inline void setLazyInit(bool lazy)                  { this->lazy = lazy; }
+
+    /**
+     * @brief perform the initialization deferred by begin(), if any
+     *
+     * @returns true if the store is initialized, false if the initialization failed
+     */
+    bool warmup();
+
+    inline const InitProfile& getInitProfile() const    { return profile; }
+
     typename KVStoreInterface::res_t remove(const key_t& key) override;
     bool exists(const key_t& key) const override;
     typename KVStoreInterface::res_t putBytes(const key_t& key, const uint8_t b[], size_t s) override;
     typename KVStoreInterface::res_t getBytes(const key_t& key, uint8_t b[], size_t s) const override;
+    typename KVStoreInterface::res_t getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const override;
     size_t getBytesLength(const key_t& key) const override;
+    bool forEach(const char* prefix, KeyCallback cb, void* ctx=nullptr) override;
+
+protected:
+    bool _openWriter(const key_t& key, size_t total, void*& state) override;
+    bool _write(void* state, const uint8_t data[], size_t len) override;
+    bool _closeWriter(void* state, bool commit) override;
+
+    bool _openReader(const key_t& key, size_t& total, void*& state) override;
+    size_t _read(void* state, size_t offset, uint8_t data[], size_t len) override;
+    void _closeReader(void* state) override;
 private:
-    mbed::MBRBlockDevice* bd;
-    mbed::KVStore* kvstore;
+    bool init() const;
+
+    // the initialized store, initializing it if it was deferred, nullptr on failure
+    mbed::KVStore* ready() const;
+
+    // created by the initialization, which can be deferred to the first access, even a read
+    mutable mbed::MBRBlockDevice* bd;
+    mutable mbed::KVStore* kvstore;
+
+    bool lazy;
+    mutable bool deferred;
+    bool reformat;
+    mutable InitProfile profile;
 };
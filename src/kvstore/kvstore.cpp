@@ -8,11 +8,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 #include "kvstore.h"
-
-template<typename T>
-typename KVStoreInterface::res_t KVStoreInterface::put(const key_t& key, T value) {
-    return _put(key, (uint8_t*)&value, sizeof(value), getType(value));
-}
+#include <stdio.h>
 
 template<>
 typename KVStoreInterface::res_t KVStoreInterface::put<const char*>(const key_t& key, const char* value) {
@@ -26,18 +22,13 @@ typename KVStoreInterface::res_t KVStoreInterface::put<String>(const key_t& key,
 }
 #endif // ARDUINO
 
-template<typename T> // TODO this could be called when class is const
-KVStoreInterface::reference<T> KVStoreInterface::get(const key_t& key, const T def) {
-    if(exists(key)) {
-        T t;
-        auto res = _get(key, (uint8_t*)&t, sizeof(t), getType(t));
-
-        if(res > 0) {
-            return KVStoreInterface::reference<T>(key, t, *this);
-        }
-    }
+// typed getters perform a single lookup on the store and fall back to the default value
+template<typename T>
+static inline T getOrDefault(KVStoreInterface& store, const KVStoreInterface::key_t& key, const T defaultValue) {
+    T t = defaultValue;
+    store.tryGet(key, t);
 
-    return KVStoreInterface::reference<T>(key, def, *this);
+    return t;
 }
 
 size_t   KVStoreInterface::putChar(const key_t& key, const int8_t value)             { return put(key, value); }
@@ -60,36 +51,311 @@ size_t   KVStoreInterface::putString(const key_t& key, const String value)
 #endif // ARDUINO
 
 
-int8_t   KVStoreInterface::getChar(const key_t& key, const int8_t defaultValue)      { return get(key, defaultValue); }
-uint8_t  KVStoreInterface::getUChar(const key_t& key, const uint8_t defaultValue)    { return get(key, defaultValue); }
-int16_t  KVStoreInterface::getShort(const key_t& key, const int16_t defaultValue)    { return get(key, defaultValue); }
-uint16_t KVStoreInterface::getUShort(const key_t& key, const uint16_t defaultValue)  { return get(key, defaultValue); }
-int32_t  KVStoreInterface::getInt(const key_t& key, const int32_t defaultValue)      { return get(key, defaultValue); }
-uint32_t KVStoreInterface::getUInt(const key_t& key, const uint32_t defaultValue)    { return get(key, defaultValue); }
-int32_t  KVStoreInterface::getLong(const key_t& key, const int32_t defaultValue)     { return get(key, defaultValue); }
-uint32_t KVStoreInterface::getULong(const key_t& key, const uint32_t defaultValue)   { return get(key, defaultValue); }
-int64_t  KVStoreInterface::getLong64(const key_t& key, const int64_t defaultValue)   { return get(key, defaultValue); }
-uint64_t KVStoreInterface::getULong64(const key_t& key, const uint64_t defaultValue) { return get(key, defaultValue); }
-float    KVStoreInterface::getFloat(const key_t& key, const float defaultValue)      { return get(key, defaultValue); }
-double   KVStoreInterface::getDouble(const key_t& key, const double defaultValue)    { return get(key, defaultValue); }
-bool     KVStoreInterface::getBool(const key_t& key, const bool defaultValue)        { return get(key, defaultValue); }
+int8_t   KVStoreInterface::getChar(const key_t& key, const int8_t defaultValue)      { return getOrDefault(*this, key, defaultValue); }
+uint8_t  KVStoreInterface::getUChar(const key_t& key, const uint8_t defaultValue)    { return getOrDefault(*this, key, defaultValue); }
+int16_t  KVStoreInterface::getShort(const key_t& key, const int16_t defaultValue)    { return getOrDefault(*this, key, defaultValue); }
+uint16_t KVStoreInterface::getUShort(const key_t& key, const uint16_t defaultValue)  { return getOrDefault(*this, key, defaultValue); }
+int32_t  KVStoreInterface::getInt(const key_t& key, const int32_t defaultValue)      { return getOrDefault(*this, key, defaultValue); }
+uint32_t KVStoreInterface::getUInt(const key_t& key, const uint32_t defaultValue)    { return getOrDefault(*this, key, defaultValue); }
+int32_t  KVStoreInterface::getLong(const key_t& key, const int32_t defaultValue)     { return getOrDefault(*this, key, defaultValue); }
+uint32_t KVStoreInterface::getULong(const key_t& key, const uint32_t defaultValue)   { return getOrDefault(*this, key, defaultValue); }
+int64_t  KVStoreInterface::getLong64(const key_t& key, const int64_t defaultValue)   { return getOrDefault(*this, key, defaultValue); }
+uint64_t KVStoreInterface::getULong64(const key_t& key, const uint64_t defaultValue) { return getOrDefault(*this, key, defaultValue); }
+float    KVStoreInterface::getFloat(const key_t& key, const float defaultValue)      { return getOrDefault(*this, key, defaultValue); }
+double   KVStoreInterface::getDouble(const key_t& key, const double defaultValue)    { return getOrDefault(*this, key, defaultValue); }
+bool     KVStoreInterface::getBool(const key_t& key, const bool defaultValue)        { return getOrDefault(*this, key, defaultValue); }
 size_t   KVStoreInterface::getString(const key_t& key, char* value, size_t maxLen)   { return _get(key, (uint8_t*)value, maxLen, PT_STR); }
 
 #ifdef ARDUINO
 String KVStoreInterface::getString(const key_t& key, const String defaultValue) {
+    String res;
+
+    auto copy = [](const uint8_t value[], size_t len, void* ctx) {
+        ((String*)ctx)->concat((const char*)value, len);
+    };
+
+    return view(key, copy, &res, PT_STR) > 0 ? res : defaultValue;
+}
+#endif // ARDUINO
+
+size_t KVStoreInterface::putMany(PutEntry entries[], size_t n) {
+    size_t count = 0;
+
+    for(size_t i=0; i<n; i++) {
+        entries[i].res = _put(entries[i].key, entries[i].value, entries[i].len, entries[i].type);
+
+        if(entries[i].res > 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+size_t KVStoreInterface::getMany(GetEntry entries[], size_t n) {
+    size_t count = 0;
+
+    for(size_t i=0; i<n; i++) {
+        entries[i].res = _get(entries[i].key, entries[i].value, entries[i].len, entries[i].type);
+
+        if(entries[i].res > 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+size_t KVStoreInterface::removeMany(const key_t keys[], size_t n) {
+    size_t count = 0;
+
+    for(size_t i=0; i<n; i++) {
+        if(remove(keys[i]) > 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+// keys converted on the stack by removeMany() of plain strings
+static constexpr size_t KEY_BATCH_SIZE = 16;
+
+size_t KVStoreInterface::removeMany(const char* const keys[], size_t n) {
+    key_t batch[KEY_BATCH_SIZE];
+    size_t count = 0;
+
+    for(size_t i=0; i<n; i+=KEY_BATCH_SIZE) {
+        size_t len = n - i < KEY_BATCH_SIZE ? n - i : KEY_BATCH_SIZE;
+
+        for(size_t j=0; j<len; j++) {
+            batch[j] = key_t(keys[i + j]);
+        }
+        count += removeMany(batch, len);
+    }
+
+    return count;
+}
+
+typename KVStoreInterface::res_t KVStoreInterface::view(const key_t& key, ViewCallback cb, void* ctx, Type t) {
     size_t len = getBytesLength(key);
-    char *str = new char[len+1];
 
-    getString(key, str, len+1);
-    str[len] = '\0';
+    if(len == 0) {
+        return 0;
+    }
+
+    // one more byte for the null terminator of strings
+    uint8_t stackBuf[VIEW_BUFFER_SIZE];
+    uint8_t* buf = len + 1 <= sizeof(stackBuf) ? stackBuf : new uint8_t[len + 1];
+
+    if(buf == nullptr) {
+        return 0;
+    }
+
+    res_t res = _get(key, buf, t == PT_STR ? len + 1 : len, t);
+
+    if(res > 0) {
+        cb(buf, res, ctx);
+    }
 
-    String res(str);
-    delete str;
-    str = nullptr;
+    if(buf != stackBuf) {
+        delete [] buf;
+    }
 
     return res;
 }
-#endif // ARDUINO
+
+typename KVStoreInterface::res_t KVStoreInterface::getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const {
+    size_t len = getBytesLength(key);
+
+    if(offset >= len) {
+        return 0;
+    }
+
+    uint8_t stackBuf[VIEW_BUFFER_SIZE];
+    uint8_t* buf = len <= sizeof(stackBuf) ? stackBuf : new uint8_t[len];
+
+    if(buf == nullptr) {
+        return 0;
+    }
+
+    res_t res = getBytes(key, buf, len) == (res_t)len ? (len - offset < s ? len - offset : s) : 0;
+    memcpy(b, buf + offset, res);
+
+    if(buf != stackBuf) {
+        delete [] buf;
+    }
+
+    return res;
+}
+
+typename KVStoreInterface::res_t KVStoreInterface::patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s) {
+    size_t len = getBytesLength(key);
+
+    if(s == 0 || offset + s > len || _typeOf(key) != PT_BLOB) {
+        return 0;
+    }
+
+    uint8_t stackBuf[VIEW_BUFFER_SIZE];
+    uint8_t* buf = len <= sizeof(stackBuf) ? stackBuf : new uint8_t[len];
+
+    if(buf == nullptr) {
+        return 0;
+    }
+
+    res_t res = 0;
+
+    if(getBytes(key, buf, len) == (res_t)len) {
+        memcpy(buf + offset, b, s);
+        res = putBytes(key, buf, len) == (res_t)len ? s : 0;
+    }
+
+    if(buf != stackBuf) {
+        delete [] buf;
+    }
+
+    return res;
+}
+
+bool KVStoreInterface::forEach(const char* prefix, KeyCallback cb, void* ctx) {
+    (void) prefix;
+    (void) cb;
+    (void) ctx;
+
+    return false;
+}
+
+bool KVStoreInterface::beginTransaction() {
+    return false;
+}
+
+bool KVStoreInterface::commit() {
+    return false;
+}
+
+bool KVStoreInterface::abort() {
+    return false;
+}
+
+// odr-used constants need a definition up to C++14
+constexpr size_t KVStoreInterface::STREAM_CHUNK_SIZE;
+constexpr size_t KVStoreInterface::STREAM_MANIFEST_SIZE;
+
+KVStoreInterface::Writer KVStoreInterface::openWriter(const key_t& key, size_t totalSize) {
+    void* state = nullptr;
+
+    if(!_openWriter(key, totalSize, state)) {
+        return Writer();
+    }
+
+    return Writer(this, state, totalSize);
+}
+
+KVStoreInterface::Reader KVStoreInterface::openReader(const key_t& key) {
+    void* state = nullptr;
+    size_t total = 0;
+
+    if(!_openReader(key, total, state)) {
+        return Reader();
+    }
+
+    return Reader(this, state, total);
+}
+
+KVStoreInterface::Writer& KVStoreInterface::Writer::operator=(Writer&& w) {
+    if(this != &w) {
+        abort();
+
+        store = w.store;
+        state = w.state;
+        total = w.total;
+        offset = w.offset;
+        w.store = nullptr;
+    }
+
+    return *this;
+}
+
+size_t KVStoreInterface::Writer::write(const uint8_t data[], size_t len) {
+    if(store == nullptr) {
+        return 0;
+    }
+
+    len = len < total - offset ? len : total - offset;
+
+    if(len == 0) {
+        return 0;
+    } else if(!store->_write(state, data, len)) {
+        abort();
+        return 0;
+    }
+
+    offset += len;
+
+    return len;
+}
+
+bool KVStoreInterface::Writer::close() {
+    if(store == nullptr) {
+        return false;
+    }
+
+    bool commit = offset == total;
+    bool res = store->_closeWriter(state, commit);
+    store = nullptr;
+
+    return res && commit;
+}
+
+void KVStoreInterface::Writer::abort() {
+    if(store != nullptr) {
+        store->_closeWriter(state, false);
+        store = nullptr;
+    }
+}
+
+KVStoreInterface::Reader& KVStoreInterface::Reader::operator=(Reader&& r) {
+    if(this != &r) {
+        close();
+
+        store = r.store;
+        state = r.state;
+        total = r.total;
+        offset = r.offset;
+        r.store = nullptr;
+    }
+
+    return *this;
+}
+
+size_t KVStoreInterface::Reader::read(uint8_t data[], size_t len) {
+    if(store == nullptr) {
+        return 0;
+    }
+
+    len = len < total - offset ? len : total - offset;
+    size_t res = len > 0 ? store->_read(state, offset, data, len) : 0;
+    offset += res;
+
+    return res;
+}
+
+bool KVStoreInterface::Reader::seek(size_t offset) {
+    if(store == nullptr || offset > total) {
+        return false;
+    }
+
+    this->offset = offset;
+
+    return true;
+}
+
+void KVStoreInterface::Reader::close() {
+    if(store != nullptr) {
+        store->_closeReader(state);
+        store = nullptr;
+    }
+}
 
 typename KVStoreInterface::res_t KVStoreInterface::_put(const key_t& key, const uint8_t value[], size_t len, Type t) {
     (void) t;
@@ -97,20 +363,438 @@ typename KVStoreInterface::res_t KVStoreInterface::_put(const key_t& key, const
     return putBytes(key, value, len);
 }
 
+typename KVStoreInterface::Type KVStoreInterface::_typeOf(const key_t& key) const {
+    (void) key;
+
+    return PT_BLOB;
+}
+
 typename KVStoreInterface::res_t KVStoreInterface::_get(const key_t& key, uint8_t value[], size_t len, Type t) {
-    (void) t;
+    // the existence of the key is not checked beforehand, a missing key is reported by getBytes
+    res_t res=0;
+    if(t == PT_STR) {
+        if(len == 0) {
+            return 0;
+        }
 
-    if(exists(key)) {
-        res_t res=0;
-        if(t == PT_STR) {
-            res = getBytes(key, value, len-1);
-            value[res] = '\0';
-        } else {
-            res = getBytes(key, value, len);
+        res = getBytes(key, value, len-1);
+        if(res > 0) {
+            value[(size_t)res < len-1 ? res : len-1] = '\0';
         }
+    } else {
+        res = getBytes(key, value, len);
+    }
 
-        return res;
+    return res;
+}
+
+bool KVStoreInterface::migrate(const key_t& key, const uint8_t record[], size_t len, res_t res, MigrateCallback cb, void* out) {
+    KVSchemaHeader header;
+    uint8_t* buf = nullptr;
+    size_t size = res > 0 ? res : 0;
+    bool complete = size >= sizeof(header) && size <= len;
+
+    if(complete) {
+        memcpy(&header, record, sizeof(header));
+        complete = sizeof(header) + header.size <= size;
+    }
+
+    // the record is larger than the current layout, depending on the backend it was truncated,
+    // e.g. mbed, or not read at all, e.g. ESP32. A missing key is reported by getBytesLength()
+    if(!complete) {
+        size = getBytesLength(key);
+        if(size < sizeof(header)) {
+            return false;
+        }
+
+        buf = new uint8_t[size];
+        if(buf == nullptr) {
+            return false;
+        } else if(_get(key, buf, size, PT_BLOB) != (res_t)size) {
+            delete [] buf;
+            return false;
+        }
+
+        record = buf;
+        memcpy(&header, record, sizeof(header));
+    }
+
+    bool migrated = sizeof(header) + header.size == size &&
+        cb(header.version, record + sizeof(header), header.size, out);
+    delete [] buf;
+
+    return migrated;
+}
+
+/*
+ * Default implementation of Writer and Reader: the value is split in chunks stored under
+ * derived keys, the manifest stored under the key is written last. The chunks of a new value
+ * use the generation that is not used by the current one, so that the current value is
+ * readable until the manifest is replaced
+ */
+static constexpr uint32_t CHUNK_MANIFEST_MAGIC = 0x4D43564B;   // "KVCM"
+
+// chunks are stored under "#<id of the value><generation><index>", the id takes 8 hex digits
+// and the index up to 5, so that names fit in the 15 characters allowed by ESP32 and UnoR4
+static constexpr size_t CHUNK_NAME_SIZE = 16;
+static constexpr uint32_t CHUNK_MAX_COUNT = 0x100000;
+
+// ids already used by the chunks of other values are skipped, up to this number of times
+static constexpr uint32_t CHUNK_ID_ATTEMPTS = 8;
+
+struct ChunkManifest {
+    uint32_t magic;
+    uint32_t total;
+    uint32_t id;            // derived from the hash of the key, unique among the stored values
+    uint16_t chunkSize;
+    uint8_t generation;     // 'a' or 'b'
+    uint8_t reserved;
+};
+
+static_assert(sizeof(ChunkManifest) == KVStoreInterface::STREAM_MANIFEST_SIZE, "ChunkManifest must not be padded");
+static_assert(KVStoreInterface::STREAM_CHUNK_SIZE <= UINT16_MAX, "the chunk size must fit the manifest");
+
+struct ChunkedValue {
+    char* key;
+    char chunk[CHUNK_NAME_SIZE];
+    ChunkManifest manifest;
+    size_t chunkSize;       // of the manifest, or the size of a value read all at once
+    bool chunked;           // false for values that were not written by a writer, read all at once
+    uint8_t previousGeneration;
+    uint32_t previousChunks;
+    uint8_t* buf;
+    size_t fill;
+    uint32_t index;         // of the next chunk written, or of the chunk held in buf
+};
+
+static constexpr uint32_t NO_CHUNK = UINT32_MAX;
+
+static inline uint32_t chunksOf(const ChunkManifest& m) {
+    return (m.total + m.chunkSize - 1) / m.chunkSize;
+}
+
+static const char* chunkName(char name[CHUNK_NAME_SIZE], uint32_t id, uint8_t generation, uint32_t index) {
+    snprintf(name, CHUNK_NAME_SIZE, "#%08x%c%x", (unsigned)id, generation, (unsigned)index);
+    return name;
+}
+
+static const char* chunkName(ChunkedValue* v, uint8_t generation, uint32_t index) {
+    return chunkName(v->chunk, v->manifest.id, generation, index);
+}
+
+// the first chunk of every generation of a value with some content exists
+static bool chunkIdUsed(const KVStoreInterface& store, uint32_t id) {
+    char name[CHUNK_NAME_SIZE];
+
+    return store.exists(chunkName(name, id, 'a', 0)) || store.exists(chunkName(name, id, 'b', 0));
+}
+
+static inline bool isManifest(const ChunkManifest& m) {
+    return m.magic == CHUNK_MANIFEST_MAGIC && m.chunkSize > 0 && (m.generation == 'a' || m.generation == 'b');
+}
+
+static bool readManifest(const KVStoreInterface& store, const char* key, ChunkManifest& m) {
+    return store.getBytesLength(key) == sizeof(m) &&
+        store.getBytes(key, (uint8_t*)&m, sizeof(m)) == (KVStoreInterface::res_t)sizeof(m) && isManifest(m);
+}
+
+static ChunkedValue* newChunkedValue(const char* key) {
+    ChunkedValue* v = new ChunkedValue();
+    if(v == nullptr) {
+        return nullptr;
+    }
+
+    size_t len = strlen(key);
+    v->key = new char[len + 1];
+
+    if(v->key == nullptr) {
+        delete v;
+        return nullptr;
+    }
+    memcpy(v->key, key, len + 1);
+
+    v->buf = nullptr;
+    v->fill = 0;
+    v->index = 0;
+
+    return v;
+}
+
+static void deleteChunkedValue(ChunkedValue* v) {
+    delete [] v->buf;
+    delete [] v->key;
+    delete v;
+}
+
+bool KVStoreInterface::_openWriter(const key_t& key, size_t total, void*& state) {
+    if(key == nullptr || total > (uint64_t)CHUNK_MAX_COUNT * STREAM_CHUNK_SIZE) {
+        return false;
+    }
+
+    ChunkedValue* v = newChunkedValue(key);
+    if(v == nullptr) {
+        return false;
+    }
+
+    ChunkManifest previous;
+    bool replacing = readManifest(*this, key, previous);
+
+    // a value that is replaced keeps its id, the chunks of the other generation are free
+    uint32_t id = replacing ? previous.id : key.hash();
+    for(uint32_t i=0; !replacing && total > 0 && chunkIdUsed(*this, id); i++) {
+        if(i == CHUNK_ID_ATTEMPTS) {
+            deleteChunkedValue(v);
+            return false;
+        }
+        id = kvstore_hash(key, key.length(), id);
+    }
+
+    v->manifest = { CHUNK_MANIFEST_MAGIC, (uint32_t)total, id, STREAM_CHUNK_SIZE,
+        (uint8_t)(replacing && previous.generation == 'a' ? 'b' : 'a'), 0 };
+    v->chunked = true;
+    v->previousGeneration = replacing ? previous.generation : 0;
+    v->previousChunks = replacing ? chunksOf(previous) : 0;
+    v->buf = new uint8_t[STREAM_CHUNK_SIZE];
+
+    if(v->buf == nullptr) {
+        deleteChunkedValue(v);
+        return false;
+    }
+
+    state = v;
+
+    return true;
+}
+
+bool KVStoreInterface::_write(void* state, const uint8_t data[], size_t len) {
+    ChunkedValue* v = (ChunkedValue*)state;
+
+    while(len > 0) {
+        size_t chunk = len < STREAM_CHUNK_SIZE - v->fill ? len : STREAM_CHUNK_SIZE - v->fill;
+
+        memcpy(v->buf + v->fill, data, chunk);
+        v->fill += chunk;
+        data += chunk;
+        len -= chunk;
+
+        if(v->fill == STREAM_CHUNK_SIZE) {
+            if(putBytes(chunkName(v, v->manifest.generation, v->index), v->buf, v->fill) != (res_t)v->fill) {
+                return false;
+            }
+
+            v->index++;
+            v->fill = 0;
+        }
+    }
+
+    return true;
+}
+
+bool KVStoreInterface::_closeWriter(void* state, bool commit) {
+    ChunkedValue* v = (ChunkedValue*)state;
+
+    if(commit && v->fill > 0) {
+        commit = putBytes(chunkName(v, v->manifest.generation, v->index), v->buf, v->fill) == (res_t)v->fill;
+        v->index++;
+    }
+
+    commit = commit && putBytes(v->key, (const uint8_t*)&v->manifest, sizeof(v->manifest)) == (res_t)sizeof(v->manifest);
+
+    // the chunks of the value that is not referenced by the manifest are removed
+    uint8_t generation = commit ? v->previousGeneration : v->manifest.generation;
+    uint32_t chunks = commit ? v->previousChunks : v->index;
+
+    for(uint32_t i=0; i<chunks; i++) {
+        remove(chunkName(v, generation, i));
+    }
+
+    deleteChunkedValue(v);
+
+    return commit;
+}
+
+bool KVStoreInterface::_openReader(const key_t& key, size_t& total, void*& state) {
+    size_t len = key != nullptr ? getBytesLength(key) : 0;
+
+    if(len == 0) {
+        return false;
+    }
+
+    ChunkedValue* v = newChunkedValue(key);
+    if(v == nullptr) {
+        return false;
+    }
+
+    v->chunked = readManifest(*this, key, v->manifest);
+
+    if(v->chunked) {
+        v->chunkSize = v->manifest.chunkSize;
+        v->buf = new uint8_t[v->chunkSize];
+        v->index = NO_CHUNK;
     } else {
+        // the value is held as a single chunk
+        v->manifest.total = len;
+        v->chunkSize = len;
+        v->buf = new uint8_t[len];
+        v->index = 0;
+    }
+
+    if(v->buf == nullptr || (!v->chunked && getBytes(key, v->buf, len) != (res_t)len)) {
+        deleteChunkedValue(v);
+        return false;
+    }
+
+    total = v->manifest.total;
+    state = v;
+
+    return true;
+}
+
+size_t KVStoreInterface::_read(void* state, size_t offset, uint8_t data[], size_t len) {
+    ChunkedValue* v = (ChunkedValue*)state;
+    size_t res = 0;
+
+    while(res < len) {
+        uint32_t chunk = offset / v->chunkSize;
+        size_t start = offset % v->chunkSize;
+
+        if(chunk != v->index) {
+            size_t expected = v->manifest.total - chunk * v->chunkSize;
+            expected = expected < v->chunkSize ? expected : v->chunkSize;
+
+            v->index = NO_CHUNK;
+            if(getBytes(chunkName(v, v->manifest.generation, chunk), v->buf, expected) != (res_t)expected) {
+                break;
+            }
+            v->index = chunk;
+        }
+
+        size_t n = v->chunkSize - start < len - res ? v->chunkSize - start : len - res;
+        memcpy(data + res, v->buf + start, n);
+        res += n;
+        offset += n;
+    }
+
+    return res;
+}
+
+void KVStoreInterface::_closeReader(void* state) {
+    deleteChunkedValue((ChunkedValue*)state);
+}
+
+bool KVStoreInterface::findChunks(const key_t& key, Type type, size_t len, Chunks& chunks) const {
+    ChunkManifest m;
+
+    if(key == nullptr || type != PT_BLOB || len != sizeof(m) || isChunkKey(key) ||
+        getBytes(key, (uint8_t*)&m, sizeof(m)) != (res_t)sizeof(m) || !isManifest(m)) {
+        return false;
+    }
+
+    chunks = { m.id, chunksOf(m), m.generation };
+
+    return true;
+}
+
+void KVStoreInterface::removeChunks(const Chunks& chunks) {
+    char name[CHUNK_NAME_SIZE];
+
+    for(uint32_t i=0; i<chunks.count; i++) {
+        remove(chunkName(name, chunks.id, chunks.generation, i));
+    }
+}
+
+void KVStoreInterface::removeChunks(const key_t& key) {
+    Chunks chunks;
+
+    if(key != nullptr && !isChunkKey(key) && findChunks(key, PT_BLOB, getBytesLength(key), chunks)) {
+        removeChunks(chunks);
+    }
+}
+
+static inline bool isHexDigit(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+}
+
+bool KVStoreInterface::isChunkKey(const char* key) {
+    if(key == nullptr || key[0] != '#') {
+        return false;
+    }
+
+    for(size_t i=1; i<=8; i++) {
+        if(!isHexDigit(key[i])) {
+            return false;
+        }
+    }
+
+    if(key[9] != 'a' && key[9] != 'b') {
+        return false;
+    }
+
+    size_t i = 10;
+    while(i < CHUNK_NAME_SIZE - 1 && isHexDigit(key[i])) {
+        i++;
+    }
+
+    return i > 10 && key[i] == '\0';
+}
+
+bool KVStoreInterface::_wrapWriter(KVStoreInterface& store, const key_t& key, size_t total, void*& state) {
+    Writer* writer = new Writer(store.openWriter(key, total));
+    if(writer == nullptr) {
+        return false;
+    } else if(!writer->isOpen()) {
+        delete writer;
+        return false;
+    }
+
+    state = writer;
+
+    return true;
+}
+
+bool KVStoreInterface::_writeWrapped(void* state, const uint8_t data[], size_t len) {
+    return ((Writer*)state)->write(data, len) == len;
+}
+
+bool KVStoreInterface::_closeWrappedWriter(void* state, bool commit) {
+    Writer* writer = (Writer*)state;
+    bool res = true;
+
+    if(commit) {
+        res = writer->close();
+    } else {
+        writer->abort();
+    }
+    delete writer;
+
+    return res;
+}
+
+bool KVStoreInterface::_wrapReader(KVStoreInterface& store, const key_t& key, size_t& total, void*& state) {
+    Reader* reader = new Reader(store.openReader(key));
+    if(reader == nullptr) {
+        return false;
+    } else if(!reader->isOpen()) {
+        delete reader;
+        return false;
+    }
+
+    total = reader->size();
+    state = reader;
+
+    return true;
+}
+
+size_t KVStoreInterface::_readWrapped(void* state, size_t offset, uint8_t data[], size_t len) {
+    Reader* reader = (Reader*)state;
+
+    if(reader->position() != offset && !reader->seek(offset)) {
         return 0;
     }
+
+    return reader->read(data, len);
+}
+
+void KVStoreInterface::_closeWrappedReader(void* state) {
+    delete (Reader*)state;
 }
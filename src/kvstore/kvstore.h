@@ -18,6 +18,8 @@
 
 #include <math.h>
 #include <type_traits>
+#include "utility/key.h"
+#include "utility/schema.h"
 
 /** KVStoreInterface class
  *
@@ -30,7 +32,8 @@
 class KVStoreInterface {
 public:
 
-    typedef const char* Key;
+    // plain strings are converted implicitly, see KVKey
+    typedef KVKey Key;
     typedef Key key_t;
     typedef int res_t;
 
@@ -38,6 +41,29 @@ public:
         PT_I8, PT_U8, PT_I16, PT_U16, PT_I32, PT_U32, PT_I64, PT_U64, PT_STR, PT_BLOB, PT_INVALID, PT_FLOAT, PT_DOUBLE,
     } Type;
 
+    /**
+     * @brief callback used by view() to provide read-only access to a value, the memory pointed by
+     *        value is valid only for the duration of the call
+     */
+    typedef void (*ViewCallback)(const uint8_t value[], size_t len, void* ctx);
+
+    /**
+     * @brief callback used by forEach() for every key, the memory pointed by key is valid only for
+     *        the duration of the call
+     *
+     * @returns true to continue the enumeration, false to stop it
+     */
+    typedef bool (*KeyCallback)(const char* key, Type t, size_t len, void* ctx);
+
+    // values up to this size are copied on the stack by the default implementation of view()
+    static constexpr size_t VIEW_BUFFER_SIZE = 64;
+
+    // size of the chunks the default implementation of openWriter() splits values into
+    static constexpr size_t STREAM_CHUNK_SIZE = 256;
+
+    // size of the manifest stored under the key of a value split in chunks
+    static constexpr size_t STREAM_MANIFEST_SIZE = 16;
+
     // TODO this is an utility function for kvstore should this stay here?
     /**
      * @brief This function translate a cpp kind to a Preferences Type at compile time
@@ -83,7 +109,7 @@ public:
         inline T getValue() const    { return value; }
 
         // load the stored value
-        void load()                  { value = owner.get<T>(key).value; }
+        void load()                  { value = T(); owner.tryGet(key, value); }
 
         // save the value contained in this reference
         void save()                  { owner.put(key, value); }
@@ -100,6 +126,136 @@ public:
         KVStoreInterface& owner;
     };
 
+    /** PutEntry struct
+     *
+     * Describes a single value to be inserted with putMany(), the outcome of the
+     * operation is reported in res with the same semantics of put()
+     */
+    struct PutEntry {
+        PutEntry(): key(nullptr), value(nullptr), len(0), type(PT_INVALID), res(0) {}
+        PutEntry(const key_t& key, const uint8_t value[], size_t len, Type type=PT_BLOB)
+        : key(key), value(value), len(len), type(type), res(0) {}
+
+        key_t key;
+        const uint8_t* value;
+        size_t len;
+        Type type;
+        res_t res;
+    };
+
+    /** GetEntry struct
+     *
+     * Describes a single value to be retrieved with getMany(), the outcome of the
+     * operation is reported in res with the same semantics of _get()
+     */
+    struct GetEntry {
+        GetEntry(): key(nullptr), value(nullptr), len(0), type(PT_INVALID), res(0) {}
+        GetEntry(const key_t& key, uint8_t value[], size_t len, Type type=PT_BLOB)
+        : key(key), value(value), len(len), type(type), res(0) {}
+
+        key_t key;
+        uint8_t* value;
+        size_t len;
+        Type type;
+        res_t res;
+    };
+
+    /** Writer class
+     *
+     * Writes a value whose size is known in advance a chunk at a time, it is obtained from
+     * openWriter(). The value is stored only when close() is called after exactly size() bytes
+     * were written, a writer that is destroyed without being closed is aborted
+     */
+    class Writer {
+    public:
+        Writer(): store(nullptr), state(nullptr), total(0), offset(0) {}
+        Writer(Writer&& w): store(w.store), state(w.state), total(w.total), offset(w.offset) { w.store = nullptr; }
+        Writer& operator=(Writer&& w);
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+        ~Writer() { abort(); }
+
+        /**
+         * @brief append data to the value, the writer is aborted on failure
+         *
+         * @param[in]  data             the data to append
+         * @param[in]  len              its length, data beyond size() is not written
+         *
+         * @returns the number of bytes written, 0 on failure
+         */
+        size_t write(const uint8_t data[], size_t len);
+
+        /**
+         * @brief store the value, the writer is closed in any case
+         *
+         * @returns true if size() bytes were written and the value was stored, false otherwise
+         */
+        bool close();
+
+        /**
+         * @brief close the writer discarding the data written, the previous value is left untouched
+         */
+        void abort();
+
+        inline bool isOpen() const      { return store != nullptr; }
+        inline size_t size() const      { return total; }
+        inline size_t written() const   { return offset; }
+    private:
+        friend class KVStoreInterface;
+        Writer(KVStoreInterface* store, void* state, size_t total): store(store), state(state), total(total), offset(0) {}
+
+        KVStoreInterface* store;
+        void* state;        // owned by the store
+        size_t total;
+        size_t offset;
+    };
+
+    /** Reader class
+     *
+     * Reads a value a chunk at a time, it is obtained from openReader()
+     */
+    class Reader {
+    public:
+        Reader(): store(nullptr), state(nullptr), total(0), offset(0) {}
+        Reader(Reader&& r): store(r.store), state(r.state), total(r.total), offset(r.offset) { r.store = nullptr; }
+        Reader& operator=(Reader&& r);
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        ~Reader() { close(); }
+
+        /**
+         * @brief read the next chunk of the value
+         *
+         * @param[out] data             the buffer
+         * @param[in]  len              its length
+         *
+         * @returns the number of bytes read, 0 at the end of the value or on failure
+         */
+        size_t read(uint8_t data[], size_t len);
+
+        /**
+         * @brief move the position of the next read
+         *
+         * @returns false if offset is beyond the end of the value
+         */
+        bool seek(size_t offset);
+
+        void close();
+
+        inline bool isOpen() const      { return store != nullptr; }
+        inline size_t size() const      { return total; }
+        inline size_t position() const  { return offset; }
+        inline size_t available() const { return total - offset; }
+    private:
+        friend class KVStoreInterface;
+        Reader(KVStoreInterface* store, void* state, size_t total): store(store), state(state), total(total), offset(0) {}
+
+        KVStoreInterface* store;
+        void* state;        // owned by the store
+        size_t total;
+        size_t offset;
+    };
+
     /**
      * @brief virtual empty destructor
      */
@@ -166,6 +322,34 @@ public:
      */
     virtual res_t getBytes(const key_t& key, uint8_t b[], size_t s) const = 0;
 
+    /**
+     * @brief get a range of a value. Backends that can read a value from an offset do it
+     *        natively, the default implementation reads the whole value and copies the range
+     *
+     * @param[in]  key              Key to get
+     * @param[in]  offset           the offset of the range in the value
+     * @param[out] b                byte array
+     * @param[in]  s                the length of the range
+     *
+     * @returns the number of bytes read, 0 if the key does not exist or offset is beyond its end
+     */
+    virtual res_t getBytes(const key_t& key, size_t offset, uint8_t b[], size_t s) const;
+
+    /**
+     * @brief overwrite a range of an existing value, the length of the value does not change.
+     *        The default implementation reads the whole value and puts it back, it patches only
+     *        blobs so that the stored type never changes
+     *
+     * @param[in]  key              Key to update
+     * @param[in]  offset           the offset of the range in the value
+     * @param[in]  b                byte array
+     * @param[in]  s                the length of the range
+     *
+     * @returns the number of bytes written, 0 if the key does not exist, the range goes beyond
+     *          the end of the value or the value cannot be patched
+     */
+    virtual res_t patchBytes(const key_t& key, size_t offset, const uint8_t b[], size_t s);
+
     /**
      * @brief get the number of bytes used by a certain value referenced by key
      *
@@ -175,9 +359,137 @@ public:
      */
     virtual size_t getBytesLength(const key_t& key) const = 0;
 
+    /**
+     * @brief put multiple values in the store with a single call. The default implementation
+     *        puts every entry one at a time, backends that can amortize the cost of a write
+     *        (e.g. a single commit for all the values) should override it
+     *
+     * @param[in,out] entries       array of entries to insert, res is updated for each of them
+     * @param[in]     n             the length of the array
+     *
+     * @returns the number of entries that were correctly inserted
+     */
+    virtual size_t putMany(PutEntry entries[], size_t n);
+
+    /**
+     * @brief get multiple values from the store with a single call. The default implementation
+     *        gets every entry one at a time
+     *
+     * @param[in,out] entries       array of entries to get, value and res are updated for each of them
+     * @param[in]     n             the length of the array
+     *
+     * @returns the number of entries that were correctly retrieved
+     */
+    virtual size_t getMany(GetEntry entries[], size_t n);
+
+    /**
+     * @brief remove multiple keys from the store with a single call. The default implementation
+     *        removes every key one at a time
+     *
+     * @param[in]  keys             array of keys to remove
+     * @param[in]  n                the length of the array
+     *
+     * @returns the number of keys that were correctly removed
+     */
+    virtual size_t removeMany(const key_t keys[], size_t n);
+
+    /**
+     * @brief remove multiple keys given as plain strings, they are passed to removeMany() in
+     *        batches built on the stack
+     *
+     * @param[in]  keys             array of keys to remove
+     * @param[in]  n                the length of the array
+     *
+     * @returns the number of keys that were correctly removed
+     */
+    size_t removeMany(const char* const keys[], size_t n);
+
+    /**
+     * @brief provide read-only access to a value without copying it into a caller buffer.
+     *        Backends that keep values in memory pass a pointer to it, the default implementation
+     *        copies the value in a small internal buffer, or on the heap if it doesn't fit
+     *
+     * @param[in]  key              Key
+     * @param[in]  cb               callback that is called with the value, if the key exists
+     * @param[in]  ctx              user pointer passed to the callback
+     * @param[in]  t                the type of the value, only PT_BLOB and PT_STR are meaningful
+     *
+     * @returns the length of the value if it exists, anything <=0 otherwise
+     */
+    virtual res_t view(const key_t& key, ViewCallback cb, void* ctx=nullptr, Type t=PT_BLOB);
+
+    /**
+     * @brief enumerate the keys starting with a prefix, in no particular order, providing their type
+     *        and the length of their value without reading it. Backends that do not keep the type of
+     *        values report PT_BLOB. The store must not be modified from the callback, keys to be
+     *        removed should be collected and removed afterwards. Enumeration is not supported by every
+     *        backend, the default implementation always fails
+     *
+     * @param[in]  prefix           only keys starting with it are enumerated, nullptr or "" for all of them
+     * @param[in]  cb               callback that is called for every key
+     * @param[in]  ctx              user pointer passed to the callback
+     *
+     * @returns true on correct execution, also if stopped by the callback, false if it failed or it is not supported
+     */
+    virtual bool forEach(const char* prefix, KeyCallback cb, void* ctx=nullptr);
+
+    /**
+     * @brief start a transaction: the puts and removes performed until commit() are staged and
+     *        then applied all together, or not at all if power is lost while committing, paying
+     *        the cost of making them durable once. Reads performed meanwhile return the committed
+     *        values. Transactions are not supported by every backend, the default implementation
+     *        always fails
+     *
+     * @returns true if the transaction was started, false if one is already open or they are not supported
+     */
+    virtual bool beginTransaction();
+
+    /**
+     * @brief apply the writes staged by the open transaction
+     *
+     * @returns true on correct execution false otherwise, in which case none of the writes is applied
+     */
+    virtual bool commit();
+
+    /**
+     * @brief discard the writes staged by the open transaction
+     *
+     * @returns true if a transaction was open
+     */
+    virtual bool abort();
+
+    /**
+     * @brief open a writer for a value that does not fit in RAM, see Writer. Backends that can
+     *        write a value incrementally do it natively, by default the value is split in chunks
+     *        of STREAM_CHUNK_SIZE bytes stored under "#<id of the value in hex><a|b><index in hex>",
+     *        which fits in 15 characters, plus a manifest stored under the key itself. The id is
+     *        derived from the hash of the key and it is kept in the manifest, ids used by other
+     *        values are skipped. Chunked values can only be read with openReader(), their chunks
+     *        are not reported by forEach(), keys of that form are reserved. The chunks are removed
+     *        by remove(), and by the writes replacing the value on backends that track the types
+     *        of their keys: on UnoR4 a streamed value has to be removed before it is replaced
+     *
+     * @param[in]  key              Key
+     * @param[in]  totalSize        the size of the value
+     *
+     * @returns the writer, it is not open if the value cannot be written
+     */
+    Writer openWriter(const key_t& key, size_t totalSize);
+
+    /**
+     * @brief open a reader for a value, see Reader. Values that were not written by a writer are
+     *        read in RAM all at once by the default implementation
+     *
+     * @param[in]  key              Key
+     *
+     * @returns the reader, it is not open if the key does not exist
+     */
+    Reader openReader(const key_t& key);
+
     /**
      * @brief templated method that puts a value of a certain type T
-     *        by converting it to a bytearray and puts it into the KV store
+     *        by converting it to a bytearray and puts it into the KV store. Trivially copyable
+     *        structs and enums are stored as a single PT_BLOB preceded by a KVSchemaHeader, see KVSchema
      *
      * @param[in]  key              Key
      * @param[in]  value            Value to insert
@@ -197,7 +509,20 @@ public:
      * @returns a reference to the desired key
      */
     template<typename T> // TODO this could be called when class is const
-    reference<T> get(const key_t& key, const T def = 0);
+    reference<T> get(const key_t& key, const T def = T());
+
+    /**
+     * @brief templated method that gets a value of a certain type T with a single lookup
+     *        on the KV store, without checking its existence first. Structs stored with another
+     *        layout are migrated by KVSchema<T>::migrate(), which requires further lookups
+     *
+     * @param[in]  key              Key
+     * @param[out] out              the value retrieved, it is left untouched if the key does not exist
+     *
+     * @returns a value >0 on correct execution anything else otherwise
+     */
+    template<typename T>
+    res_t tryGet(const key_t& key, T& out);
     /**
      * @brief RW direct access to a value with the operator[]
      *
@@ -535,6 +860,106 @@ protected:
     virtual res_t _put(const key_t& key, const uint8_t value[], size_t len, Type t);
 
     virtual res_t _get(const key_t& key, uint8_t value[], size_t len, Type t);
+
+    // type of a stored value, PT_INVALID if it is missing. By default every value is reported
+    // as a blob, backends that keep the type of values override it
+    virtual Type _typeOf(const key_t& key) const;
+
+    // incremental access to values used by Writer and Reader, the state is private to the backend
+
+    virtual bool _openWriter(const key_t& key, size_t total, void*& state);
+    virtual bool _write(void* state, const uint8_t data[], size_t len);
+    virtual bool _closeWriter(void* state, bool commit);
+
+    virtual bool _openReader(const key_t& key, size_t& total, void*& state);
+    virtual size_t _read(void* state, size_t offset, uint8_t data[], size_t len);
+    virtual void _closeReader(void* state);
+
+    // chunks of a value written by the default implementation of openWriter()
+    struct Chunks {
+        uint32_t id;
+        uint32_t count;
+        uint8_t generation;
+    };
+
+    /**
+     * @brief find the chunks of the value stored under a key, the manifest is read only if
+     *        the value is a blob of STREAM_MANIFEST_SIZE bytes. Backends that track the types
+     *        and the lengths of their keys pass them, so that other values cost no lookup
+     *
+     * @param[in]  key              Key
+     * @param[in]  type             the type of the stored value
+     * @param[in]  len              the length of the stored value
+     * @param[out] chunks           the chunks of the value
+     *
+     * @returns true if the value is the manifest of a chunked value
+     */
+    bool findChunks(const key_t& key, Type type, size_t len, Chunks& chunks) const;
+
+    /**
+     * @brief remove the chunks found by findChunks(), backends relying on the default
+     *        implementation of openWriter() call it once the key was removed or replaced
+     *
+     * @param[in]  chunks           the chunks of the value
+     */
+    void removeChunks(const Chunks& chunks);
+
+    /**
+     * @brief remove the chunks of the value stored under a key, for backends that do not
+     *        track their keys: it costs a lookup of the length of the key, the manifest is
+     *        read only when the length matches
+     *
+     * @param[in]  key              Key
+     */
+    void removeChunks(const key_t& key);
+
+    /**
+     * @brief tell the keys of the chunks written by the default implementation of openWriter(),
+     *        they are not reported by forEach()
+     *
+     * @param[in]  key              Key
+     *
+     * @returns true if key is the name of a chunk
+     */
+    static bool isChunkKey(const char* key);
+
+    // writers and readers of decorators wrapping the ones of the underlying store, so that values
+    // are streamed natively by the backends that can
+
+    static bool _wrapWriter(KVStoreInterface& store, const key_t& key, size_t total, void*& state);
+    static bool _writeWrapped(void* state, const uint8_t data[], size_t len);
+    static bool _closeWrappedWriter(void* state, bool commit);
+
+    static bool _wrapReader(KVStoreInterface& store, const key_t& key, size_t& total, void*& state);
+    static size_t _readWrapped(void* state, size_t offset, uint8_t data[], size_t len);
+    static void _closeWrappedReader(void* state);
+
+private:
+    typedef bool (*MigrateCallback)(uint16_t from, const uint8_t data[], size_t len, void* out);
+
+    // put() and tryGet() of plain values and of structs, which are preceded by a KVSchemaHeader
+    template<typename T>
+    res_t putValue(const key_t& key, const T& value, std::false_type);
+    template<typename T>
+    res_t putValue(const key_t& key, const T& value, std::true_type);
+    template<typename T>
+    res_t getValue(const key_t& key, T& out, std::false_type);
+    template<typename T>
+    res_t getValue(const key_t& key, T& out, std::true_type);
+
+    /**
+     * @brief migrate a struct whose stored layout is not the current one
+     *
+     * @param[in]  key              Key
+     * @param[in]  record           the header and the value already read, if res <= len
+     * @param[in]  len              the size of the header and of the current layout
+     * @param[in]  res              the result of reading record
+     * @param[in]  cb               KVSchema<T>::migrate()
+     * @param[out] out              the value to migrate into
+     *
+     * @returns true if the value was migrated
+     */
+    bool migrate(const key_t& key, const uint8_t record[], size_t len, res_t res, MigrateCallback cb, void* out);
 };
 
 /* We need to ignore the warning "unused parameter" since we cannot add more instructions
@@ -546,8 +971,7 @@ protected:
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 template<typename T>
 constexpr typename KVStoreInterface::Type KVStoreInterface::getType(T t) {
-    (void) t;
-    return PT_INVALID;
+    return KVStruct<T>::value ? PT_BLOB : PT_INVALID;
 }
 
 template<>
@@ -599,3 +1023,89 @@ template<>
 constexpr typename KVStoreInterface::Type KVStoreInterface::getType<const uint8_t*>(const uint8_t* t)   { return PT_BLOB; }
 
 #pragma GCC diagnostic pop
+
+template<typename T> // TODO this could be called when class is const
+KVStoreInterface::reference<T> KVStoreInterface::get(const key_t& key, const T def) {
+    T t = def;
+    tryGet(key, t);
+
+    return KVStoreInterface::reference<T>(key, t, *this);
+}
+
+template<typename T>
+typename KVStoreInterface::res_t KVStoreInterface::put(const key_t& key, T value) {
+    return putValue(key, value, KVStruct<T>());
+}
+
+template<>
+typename KVStoreInterface::res_t KVStoreInterface::put<const char*>(const key_t& key, const char* value);
+
+#ifdef ARDUINO
+template<>
+typename KVStoreInterface::res_t KVStoreInterface::put<String>(const key_t& key, String value);
+#endif // ARDUINO
+
+template<typename T>
+typename KVStoreInterface::res_t KVStoreInterface::tryGet(const key_t& key, T& out) {
+    return getValue(key, out, KVStruct<T>());
+}
+
+template<typename T>
+typename KVStoreInterface::res_t KVStoreInterface::putValue(const key_t& key, const T& value, std::false_type) {
+    return _put(key, (const uint8_t*)&value, sizeof(value), getType(value));
+}
+
+template<typename T>
+typename KVStoreInterface::res_t KVStoreInterface::putValue(const key_t& key, const T& value, std::true_type) {
+    static_assert(sizeof(T) <= UINT16_MAX, "structs larger than 64KiB cannot be stored");
+
+    // header and value are stored in a single record
+    uint8_t record[sizeof(KVSchemaHeader) + sizeof(T)];
+    KVSchemaHeader header = { KVSchema<T>::version, sizeof(T) };
+
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header), &value, sizeof(T));
+
+    return _put(key, record, sizeof(record), PT_BLOB) == (res_t)sizeof(record) ? sizeof(T) : 0;
+}
+
+template<typename T>
+typename KVStoreInterface::res_t KVStoreInterface::getValue(const key_t& key, T& out, std::false_type) {
+    T t;
+    auto res = _get(key, (uint8_t*)&t, sizeof(t), getType(out));
+
+    if(res > 0) {
+        out = t;
+    }
+
+    return res;
+}
+
+template<typename T>
+typename KVStoreInterface::res_t KVStoreInterface::getValue(const key_t& key, T& out, std::true_type) {
+    uint8_t record[sizeof(KVSchemaHeader) + sizeof(T)];
+    auto res = _get(key, record, sizeof(record), PT_BLOB);
+
+    if(res == (res_t)sizeof(record)) {
+        KVSchemaHeader header;
+        memcpy(&header, record, sizeof(header));
+
+        if(header.version == KVSchema<T>::version && header.size == sizeof(T)) {
+            memcpy((uint8_t*)&out, record + sizeof(header), sizeof(T));
+            return sizeof(T);
+        }
+    }
+
+    // the migration starts from the default value, out is left untouched on failure
+    T t = out;
+    auto cb = [](uint16_t from, const uint8_t data[], size_t len, void* out) -> bool {
+        return KVSchema<T>::migrate(from, data, len, *(T*)out);
+    };
+
+    if(!migrate(key, record, sizeof(record), res, cb, &t)) {
+        return 0;
+    }
+    out = t;
+
+    return sizeof(T);
+}
@@ -0,0 +1,24 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief compute the CRC32 (IEEE 802.3) of a buffer, it can be computed incrementally
+ *        by passing the result of a previous call as crc parameter
+ *
+ * @param[in]  data             the buffer
+ * @param[in]  len              the length of the buffer
+ * @param[in]  crc              the crc of the previous chunks, 0 for the first one
+ *
+ * @returns the crc of the data
+ */
+uint32_t kvstore_crc32(const void* data, size_t len, uint32_t crc=0);
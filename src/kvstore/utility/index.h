@@ -0,0 +1,58 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include "key.h"
+
+/** KVIndexKey class
+ *
+ * Key of the in-RAM indexes of the backends, see KVIndex. A key built for a lookup borrows
+ * the string and the hash of the KVKey, so that looking up a key does not allocate. The copies
+ * stored in an index own their string
+ */
+class KVIndexKey {
+public:
+    KVIndexKey(const KVKey& key): str(key.c_str()), h(key.hash()) {}
+    KVIndexKey(const char* key): KVIndexKey(KVKey(key)) {}
+    KVIndexKey(const std::string& key): owned(key), str(nullptr), h(KVKey(key.c_str()).hash()) {}
+
+    KVIndexKey(const KVIndexKey& key): owned(key.c_str()), str(nullptr), h(key.h) {}
+    KVIndexKey& operator=(const KVIndexKey& key) {
+        owned = key.c_str();
+        str = nullptr;
+        h = key.h;
+
+        return *this;
+    }
+
+    inline const char* c_str() const    { return str != nullptr ? str : owned.c_str(); }
+    inline uint32_t hash() const        { return h; }
+
+    inline bool operator==(const KVIndexKey& key) const {
+        return h == key.h && strcmp(c_str(), key.c_str()) == 0;
+    }
+
+    struct Hash {
+        inline size_t operator()(const KVIndexKey& key) const { return key.hash(); }
+    };
+
+private:
+    std::string owned;
+    const char* str;    // borrowed, nullptr if the string is owned
+    uint32_t h;
+};
+
+/**
+ * @brief map from keys to V, looked up with the hash carried by KVKey
+ */
+template<typename V>
+using KVIndex = std::unordered_map<KVIndexKey, V, KVIndexKey::Hash>;
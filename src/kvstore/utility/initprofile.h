@@ -0,0 +1,80 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+constexpr size_t INIT_PROFILE_MAX_PHASES = 4;
+
+/** InitProfile class
+ *
+ * Records how long each phase of the initialization of a store took. Phases are measured
+ * one after the other: each one lasts from the end of the previous one, or from start(),
+ * to the call of phase() that names it
+ */
+class InitProfile {
+public:
+    typedef uint32_t (*clock_f)();
+
+    struct Phase {
+        const char* name;
+        uint32_t us;
+    };
+
+    /**
+     * @param[in]  clock            function returning the time in microseconds
+     */
+    InitProfile(clock_f clock): clock(clock), count(0), last(0) {}
+
+    /**
+     * @brief start measuring, the phases measured before are dropped
+     */
+    inline void start() {
+        count = 0;
+        last = clock();
+    }
+
+    /**
+     * @brief end the current phase, phases beyond INIT_PROFILE_MAX_PHASES are not recorded
+     *
+     * @param[in]  name             the name of the phase, it must be a string literal
+     */
+    inline void phase(const char* name) {
+        uint32_t now = clock();
+
+        if(count < INIT_PROFILE_MAX_PHASES) {
+            phases[count++] = { name, now - last };
+        }
+        last = now;
+    }
+
+    inline size_t size() const                          { return count; }
+    inline const Phase& operator[](size_t i) const      { return phases[i]; }
+    inline void setClock(clock_f clock)                 { this->clock = clock; }
+
+    /**
+     * @brief the duration of all the recorded phases, in microseconds
+     */
+    inline uint32_t total() const {
+        uint32_t res = 0;
+
+        for(size_t i=0; i<count; i++) {
+            res += phases[i].us;
+        }
+
+        return res;
+    }
+
+private:
+    clock_f clock;
+    Phase phases[INIT_PROFILE_MAX_PHASES];
+    size_t count;
+    uint32_t last;
+};
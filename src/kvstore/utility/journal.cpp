@@ -0,0 +1,217 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "journal.h"
+#include "crc.h"
+#include <string.h>
+
+static constexpr uint32_t JOURNAL_MAGIC = 0x4E4A564B;  // "KVJN"
+static constexpr uint8_t ENTRY_REMOVED = 0x01;
+static constexpr size_t INITIAL_CAPACITY = 128;
+
+struct JournalHeader {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t size;      // of the entries
+    uint32_t crc;       // of the entries
+};
+
+static_assert(sizeof(JournalHeader) == 16, "JournalHeader must not be padded");
+
+// followed by the key and the value, each one null terminated
+struct EntryHeader {
+    uint8_t type;
+    uint8_t flags;
+    uint16_t keyLen;
+    uint32_t len;
+};
+
+static_assert(sizeof(EntryHeader) == 8, "EntryHeader must not be padded");
+
+static inline size_t entrySize(const EntryHeader& e) {
+    return sizeof(EntryHeader) + e.keyLen + 1 + e.len + 1;
+}
+
+KVJournal::KVJournal(size_t maxBytes)
+: maxBytes(maxBytes), buf(nullptr), size(sizeof(JournalHeader)), capacity(0), count(0) {}
+
+KVJournal::~KVJournal() {
+    delete [] buf;
+}
+
+bool KVJournal::put(const char* key, const uint8_t value[], size_t len, KVStoreInterface::Type t) {
+    if(key == nullptr || (value == nullptr && len > 0)) {
+        return false;
+    }
+
+    return append(key, strlen(key), value, len, t, 0);
+}
+
+bool KVJournal::remove(const char* key) {
+    if(key == nullptr) {
+        return false;
+    }
+
+    return append(key, strlen(key), nullptr, 0, KVStoreInterface::PT_INVALID, ENTRY_REMOVED);
+}
+
+bool KVJournal::staged(const char* key, bool& removed) const {
+    size_t keyLen = strlen(key);
+    bool found = false;
+    Entry e;
+
+    // the whole journal is walked, the latest entry wins
+    for(size_t offset = next(0, e); offset != 0; offset = next(offset, e)) {
+        if(e.keyLen == keyLen && memcmp(e.key, key, keyLen) == 0) {
+            found = true;
+            removed = e.removed;
+        }
+    }
+
+    return found;
+}
+
+size_t KVJournal::next(size_t offset, KVJournal::Entry& e) const {
+    if(offset == 0) {
+        offset = sizeof(JournalHeader);
+    }
+
+    if(offset >= size) {
+        return 0;
+    }
+
+    EntryHeader h;
+    memcpy(&h, buf + offset, sizeof(h));
+
+    e.key = (const char*)buf + offset + sizeof(h);
+    e.keyLen = h.keyLen;
+    e.value = (const uint8_t*)e.key + h.keyLen + 1;
+    e.len = h.len;
+    e.type = (KVStoreInterface::Type)h.type;
+    e.removed = h.flags & ENTRY_REMOVED;
+
+    return offset + entrySize(h);
+}
+
+void KVJournal::clear() {
+    delete [] buf;
+    buf = nullptr;
+    size = sizeof(JournalHeader);
+    capacity = 0;
+    count = 0;
+}
+
+const uint8_t* KVJournal::image(size_t& len) {
+    if(count == 0) {
+        len = 0;
+        return nullptr;
+    }
+
+    JournalHeader header;
+    header.magic = JOURNAL_MAGIC;
+    header.count = count;
+    header.size = size - sizeof(header);
+    header.crc = kvstore_crc32(buf + sizeof(header), header.size);
+    memcpy(buf, &header, sizeof(header));
+
+    len = size;
+
+    return buf;
+}
+
+bool KVJournal::load(const uint8_t image[], size_t len) {
+    clear();
+
+    JournalHeader header;
+    if(image == nullptr || len < sizeof(header)) {
+        return false;
+    }
+
+    memcpy(&header, image, sizeof(header));
+    if(header.magic != JOURNAL_MAGIC || header.size != len - sizeof(header) ||
+            header.crc != kvstore_crc32(image + sizeof(header), header.size) || !reserve(header.size)) {
+        return false;
+    }
+
+    memcpy(buf, image, len);
+    size = len;
+
+    // the entries must end exactly with the image
+    size_t offset = sizeof(header);
+    while(offset + sizeof(EntryHeader) <= size && count < header.count) {
+        EntryHeader h;
+        memcpy(&h, buf + offset, sizeof(h));
+        offset += entrySize(h);
+        count++;
+    }
+
+    if(offset != size || count != header.count) {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool KVJournal::append(const char* key, size_t keyLen, const uint8_t value[], size_t len, KVStoreInterface::Type t, uint8_t flags) {
+    EntryHeader h;
+    h.type = t;
+    h.flags = flags;
+    h.keyLen = keyLen;
+    h.len = len;
+
+    if(keyLen == 0 || keyLen > UINT16_MAX || !reserve(entrySize(h))) {
+        return false;
+    }
+
+    uint8_t* p = buf + size;
+    memcpy(p, &h, sizeof(h));
+    p += sizeof(h);
+    memcpy(p, key, keyLen);
+    p[keyLen] = '\0';
+    p += keyLen + 1;
+    if(len > 0) {
+        memcpy(p, value, len);
+    }
+    p[len] = '\0';
+
+    size += entrySize(h);
+    count++;
+
+    return true;
+}
+
+bool KVJournal::reserve(size_t len) {
+    if(len > maxBytes || size + len > maxBytes) {
+        return false;
+    } else if(size + len <= capacity) {
+        return true;
+    }
+
+    size_t grown = capacity > 0 ? capacity : INITIAL_CAPACITY;
+    while(grown < size + len) {
+        grown *= 2;
+    }
+    grown = grown < maxBytes ? grown : maxBytes;
+
+    uint8_t* p = new uint8_t[grown];
+    if(p == nullptr) {
+        return false;
+    }
+
+    if(buf != nullptr) {
+        memcpy(p, buf, size);
+        delete [] buf;
+    }
+
+    buf = p;
+    capacity = grown;
+
+    return true;
+}
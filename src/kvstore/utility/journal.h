@@ -0,0 +1,105 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "../kvstore.h"
+
+// maximum size of the writes staged by a transaction, including the overhead of each entry
+constexpr size_t DEFAULT_JOURNAL_MAX_BYTES = 4096;
+
+/** KVJournal class
+ *
+ * Puts and removes staged in RAM by a transaction, in the order they were performed. The entries
+ * are kept in a single buffer prefixed by a header holding their count and CRC, so that the whole
+ * journal can be saved with a single write and validated when it is loaded back after a reset.
+ * Keys and values are stored null terminated, the entries can be passed as they are to put methods
+ */
+class KVJournal {
+public:
+    struct Entry {
+        const char* key;
+        size_t keyLen;
+        const uint8_t* value;
+        size_t len;
+        KVStoreInterface::Type type;
+        bool removed;
+    };
+
+    KVJournal(size_t maxBytes=DEFAULT_JOURNAL_MAX_BYTES);
+    ~KVJournal();
+
+    /**
+     * @brief stage a put
+     *
+     * @returns false if the journal is full
+     */
+    bool put(const char* key, const uint8_t value[], size_t len, KVStoreInterface::Type t);
+
+    /**
+     * @brief stage a removal
+     *
+     * @returns false if the journal is full
+     */
+    bool remove(const char* key);
+
+    /**
+     * @brief find the latest entry staged for a key
+     *
+     * @param[in]  key              the key
+     * @param[out] removed          true if the latest entry is a removal
+     *
+     * @returns true if an entry was staged for the key
+     */
+    bool staged(const char* key, bool& removed) const;
+
+    /**
+     * @brief iterate over the entries in the order they were staged
+     *
+     * @param[in]  offset           0 for the first entry, the result of the previous call otherwise
+     * @param[out] e                the entry
+     *
+     * @returns the offset to be passed to get the following entry, 0 when there are no more entries
+     */
+    size_t next(size_t offset, KVJournal::Entry& e) const;
+
+    /**
+     * @brief drop all the entries
+     */
+    void clear();
+
+    /**
+     * @brief get the journal in the format in which it is saved, header included
+     *
+     * @param[out] len              the length of the image
+     *
+     * @returns the image, nullptr if the journal is empty
+     */
+    const uint8_t* image(size_t& len);
+
+    /**
+     * @brief replace the entries with the ones of a saved image
+     *
+     * @returns false if the image is corrupted, in which case the journal is left empty
+     */
+    bool load(const uint8_t image[], size_t len);
+
+    inline size_t entries() const   { return count; }
+    inline size_t bytes() const     { return size; }
+
+private:
+    bool append(const char* key, size_t keyLen, const uint8_t value[], size_t len, KVStoreInterface::Type t, uint8_t flags);
+    bool reserve(size_t len);
+
+    const size_t maxBytes;
+    uint8_t* buf;
+    size_t size;        // used bytes of buf, header included
+    size_t capacity;
+    size_t count;
+};
@@ -0,0 +1,104 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <cstddef>
+#include <type_traits>
+
+constexpr uint32_t KVSTORE_HASH_SEED = 2166136261u;
+
+/**
+ * @brief compute the FNV-1a hash of a key, it is the hash used by the in-RAM indexes and
+ *        caches of the stores and it can be evaluated at compile time
+ *
+ * @param[in]  key              the key
+ * @param[in]  len              its length
+ * @param[in]  h                the hash of the previous characters
+ *
+ * @returns the hash of the key
+ */
+constexpr uint32_t kvstore_hash(const char* key, size_t len, uint32_t h=KVSTORE_HASH_SEED) {
+    return len == 0 ? h : kvstore_hash(key + 1, len - 1, (h ^ (uint8_t)*key) * 16777619u);
+}
+
+/**
+ * @brief length of a key that can be evaluated at compile time
+ */
+constexpr size_t kvstore_strlen(const char* key, size_t len=0) {
+    return key[len] == '\0' ? len : kvstore_strlen(key, len + 1);
+}
+
+/** KVKey class
+ *
+ * Key of a store, carrying its length and its hash so that backends and decorators do not
+ * scan it again on every access. Keys built from string literals, e.g. KVKey("wifi.ssid"),
+ * are constexpr and hashed at compile time. Keys built from other strings are measured and
+ * hashed on the first call to length() or hash(), so that backends that only need the string
+ * do not pay for it. The string is not copied, it has to outlive the key
+ */
+class KVKey {
+public:
+    constexpr KVKey(std::nullptr_t key=nullptr): KVKey(key, 0, KVSTORE_HASH_SEED) {}
+
+    // literals and constant arrays
+    template<size_t N>
+    constexpr KVKey(const char (&key)[N]): KVKey(key, kvstore_strlen(key), kvstore_hash(key, kvstore_strlen(key))) {}
+
+    // buffers filled at runtime
+    template<size_t N>
+    KVKey(char (&key)[N]): KVKey((const char*)key, 0) {}
+
+    template<typename T, typename std::enable_if<
+        std::is_same<T, const char*>::value || std::is_same<T, char*>::value, int>::type = 0>
+    KVKey(T key): KVKey((const char*)key, 0) {}
+
+    constexpr KVKey(const char* key, size_t len, uint32_t hash)
+    : str(key), len(len), h(hash), measured(true), lazyMeasured(false), lazyLen(0), lazyHash(0) {}
+
+    constexpr operator const char*() const  { return str; }
+    constexpr const char* c_str() const     { return str; }
+    constexpr size_t length() const         { return measured ? len : measure().lazyLen; }
+    constexpr uint32_t hash() const         { return measured ? h : measure().lazyHash; }
+
+private:
+    KVKey(const char* key, int)
+    : str(key), len(0), h(KVSTORE_HASH_SEED), measured(false), lazyMeasured(false), lazyLen(0), lazyHash(0) {}
+
+    // measures and hashes a key built at runtime in a single pass
+    const KVKey& measure() const {
+        if(!lazyMeasured) {
+            lazyHash = KVSTORE_HASH_SEED;
+            for(lazyLen = 0; str != nullptr && str[lazyLen] != '\0'; lazyLen++) {
+                lazyHash = (lazyHash ^ (uint8_t)str[lazyLen]) * 16777619u;
+            }
+            lazyMeasured = true;
+        }
+
+        return *this;
+    }
+
+    const char* str;
+    size_t len;
+    uint32_t h;
+    bool measured;          // at construction, len and h are valid
+
+    // cache of keys measured on first use
+    mutable bool lazyMeasured;
+    mutable size_t lazyLen;
+    mutable uint32_t lazyHash;
+};
+
+/**
+ * @brief build a key from a literal at compile time, e.g. "wifi.ssid"_kvkey
+ */
+constexpr KVKey operator"" _kvkey(const char* key, size_t len) {
+    return KVKey(key, len, kvstore_hash(key, len));
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of Arduino_KVStore.
+ *
+ * Copyright (c) 2024 Arduino SA
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+
+/** KVSchemaHeader struct
+ *
+ * Stored in front of structs and enums put in a store, it describes the layout of the value
+ * that follows it
+ */
+struct KVSchemaHeader {
+    uint16_t version;
+    uint16_t size;
+};
+
+static_assert(sizeof(KVSchemaHeader) == 4, "KVSchemaHeader must not be padded");
+
+/**
+ * @brief true for the types stored with a KVSchemaHeader, trivially copyable structs and enums
+ */
+template<typename T>
+struct KVStruct: std::integral_constant<bool,
+    (std::is_class<T>::value || std::is_enum<T>::value) && std::is_trivially_copyable<T>::value> {};
+
+/** KVSchema struct
+ *
+ * Version of the layout of a type stored as a struct and migration of the values stored with
+ * another layout. It has to be specialized when the layout of T changes, e.g.
+ *
+ * template<>
+ * struct KVSchema<Config> {
+ *     static constexpr uint16_t version = 2;
+ *
+ *     static bool migrate(uint16_t from, const uint8_t data[], size_t len, Config& out) {
+ *         ...
+ *     }
+ * };
+ *
+ * migrate() is called when the stored value has a different version or size, from may be
+ * newer than version if the value was written by a newer firmware. out holds the default value
+ * passed to get(), the fields that cannot be migrated can be left untouched. A migrated value
+ * is not written back, it is stored with the current layout by the next put(). By default
+ * values stored with another layout are ignored
+ */
+template<typename T>
+struct KVSchema {
+    static constexpr uint16_t version = 0;
+
+    static bool migrate(uint16_t from, const uint8_t data[], size_t len, T& out) {
+        (void) from;
+        (void) data;
+        (void) len;
+        (void) out;
+
+        return false;
+    }
+};